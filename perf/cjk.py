@@ -0,0 +1,57 @@
+#!/usr/bin/env python
+#
+# Copyright © 2026 the VTE authors
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# Generates a large corpus of CJK build-log-like output, for measuring
+# the throughput of double-width text, e.g.
+#
+#   ./cjk.py --lines 200000 > /tmp/cjk.txt
+#   ./cjk.py --lines 200000 --ascii > /tmp/ascii.txt
+#
+# and then 'time cat /tmp/cjk.txt' vs 'time cat /tmp/ascii.txt' in the
+# terminal. The --ascii variant has the same layout and occupies the same
+# number of cells, so the two should take about the same time.
+
+import argparse
+import sys
+
+words = [
+    'コンパイル', 'リンク', '警告', 'モジュール', 'ファイル', '生成', '完了',
+    '编译', '链接', '目标', '正在构建', '依赖', '测试', '通过',
+    '빌드', '컴파일', '완료',
+]
+
+def line(n, total, ascii):
+    words_in_line = [words[(n * 7 + i * 3) % len(words)] for i in range(0, 6)]
+    if ascii:
+        # Same number of cells: each double width char becomes two letters
+        words_in_line = ['x' * (2 * len(w)) for w in words_in_line]
+
+    percent = n * 100 // max(total, 1)
+    return f'[{percent:3d}%] {words_in_line[0]}: src/{words_in_line[1]}/{words_in_line[2]}{n}.cc ' \
+        f'{" ".join(words_in_line[3:])}\n'
+
+''' main '''
+if __name__ == '__main__':
+
+    parser = argparse.ArgumentParser(description='CJK throughput corpus')
+    parser.add_argument('--lines', type=int, default=100000, help='number of lines')
+    parser.add_argument('--ascii', action='store_true', help='output ASCII with the same layout')
+    args = parser.parse_args()
+
+    out = sys.stdout
+    for n in range(0, args.lines):
+        out.write(line(n, args.lines, args.ascii))
@@ -107,8 +107,10 @@ public:
         gboolean shaping{true};
         gboolean shell{true};
         gboolean sixel{true};
+        gboolean statistics{false};
         gboolean systemd_scope{true};
         gboolean test_mode{false};
+        gboolean threaded_pty_read{false};
         gboolean track_clipboard_targets{false};
         gboolean use_scrolled_window{false};
         gboolean use_theme_colors{false};
@@ -129,6 +131,7 @@ public:
         char* geometry{nullptr};
         char* output_filename{nullptr};
         char* title{nullptr};
+        char* trace_filename{nullptr};
         char* word_char_exceptions{nullptr};
         char* working_directory{nullptr};
         char** dingus{nullptr};
@@ -167,6 +170,7 @@ public:
                 g_free(font_string);
                 g_free(geometry);
                 g_free(output_filename);
+                g_free(trace_filename);
                 g_free(word_char_exceptions);
                 g_free(working_directory);
                 g_strfreev(dingus);
@@ -1208,6 +1212,10 @@ public:
                                 0, &pty,
                                 "Enable PTY creation with --no-shell",
                                 "Disable PTY creation with --no-shell");
+                add_bool_option("threaded-pty-read", 0, "no-threaded-pty-read", 0,
+                                0, &threaded_pty_read,
+                                "Read the PTY on a separate thread",
+                                "Read the PTY on the main loop");
                 add_bool_option("rewrap", 0, "no-rewrap", 'R',
                                 0, &rewrap,
                                 "Enable rewrapping on resize",
@@ -1220,6 +1228,10 @@ public:
                                 0, &shaping,
                                 "Enable Arabic shaping",
                                 "Disable Arabic shaping");
+                add_bool_option("statistics", 0, "no-statistics", 0,
+                                0, &statistics,
+                                "Print the terminal statistics on exit",
+                                "Don't print the terminal statistics on exit");
                 add_bool_option("shell", 0, "no-shell", 'S',
                                 0, &shell,
                                 "Enable spawning a shell inside the terminal",
@@ -1358,6 +1370,8 @@ public:
                         { "scrollback-lines", 'n', 0, G_OPTION_ARG_INT, &scrollback_lines,
                           "Specify the number of scrollback-lines (-1 for infinite)", nullptr },
                         { "title", 0, 0, G_OPTION_ARG_STRING, &title, "Set the initial title of the window", "TITLE" },
+                        { "trace-file", 0, 0, G_OPTION_ARG_FILENAME, &trace_filename,
+                          "Record a trace of the frame timeline, and save it to FILE at exit", "FILE" },
                         { "transparent", 'T', 0, G_OPTION_ARG_INT, &transparency_percent,
                           "Enable the use of a transparent background", "0..100" },
                         { "verbose", 'v', G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK,
@@ -2232,6 +2246,8 @@ struct _VteappWindow {
         int cached_csd_width{0};
         int cached_csd_height{0};
 
+        bool printed_statistics{false};
+
 #if VTE_GTK == 3
         GtkClipboard* clipboard;
         GdkWindowState window_state{GdkWindowState(0)};
@@ -3385,6 +3401,7 @@ vteapp_window_constructed(GObject *object)
         vte_terminal_set_enable_sixel(window->terminal, options.sixel);
         vte_terminal_set_enable_fallback_scrolling(window->terminal, options.fallback_scrolling);
         vte_terminal_set_enable_legacy_osc777(window->terminal, options.legacy_osc777);
+        vte_terminal_set_enable_threaded_pty_read(window->terminal, options.threaded_pty_read);
         vte_terminal_set_mouse_autohide(window->terminal, true);
         vte_terminal_set_rewrap_on_resize(window->terminal, options.rewrap);
         vte_terminal_set_scroll_on_insert(window->terminal, options.scroll_on_insert);
@@ -3474,11 +3491,35 @@ vteapp_window_constructed(GObject *object)
         g_assert(!gtk_widget_get_realized(GTK_WIDGET(window)));
 }
 
+static void
+vteapp_window_print_statistics(VteappWindow* window)
+{
+        auto const dict = vte::take_freeable(vte_terminal_ref_statistics(window->terminal));
+        if (!dict)
+                return;
+
+        g_print("Statistics:\n");
+
+        auto iter = GVariantIter{};
+        char const* key;
+        GVariant* value;
+        g_variant_iter_init(&iter, dict.get());
+        while (g_variant_iter_loop(&iter, "{&sv}", &key, &value)) {
+                auto const str = vte::glib::take_string(g_variant_print(value, false));
+                g_print("  %s: %s\n", key, str.get());
+        }
+}
+
 static void
 vteapp_window_dispose(GObject *object)
 {
         VteappWindow* window = VTEAPP_WINDOW(object);
 
+        if (options.statistics && !window->printed_statistics) {
+                vteapp_window_print_statistics(window);
+                window->printed_statistics = true;
+        }
+
         if (window->clipboard != nullptr) {
                 g_signal_handlers_disconnect_by_func(window->clipboard,
 #if VTE_GTK == 3
@@ -3985,11 +4026,21 @@ main(int argc,
                }
        }
 
+       if (options.trace_filename != nullptr)
+               vte_set_trace_enabled(true);
+
        auto app = vte::glib::take_ref(vteapp_application_new());
        auto rv = g_application_run(app.get(), 0, nullptr);
 
        if (reset_termios)
                tcsetattr(STDIN_FILENO, TCSANOW, &saved_tcattr);
 
+       if (options.trace_filename != nullptr) {
+               auto error = vte::glib::Error{};
+               if (!vte_write_trace(options.trace_filename, error))
+                       verbose_printerr("Failed to write trace to \"%s\": %s\n",
+                                        options.trace_filename, error.message());
+       }
+
        return rv;
 }
@@ -0,0 +1,673 @@
+/*
+ * Copyright © 2026 the VTE authors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * vte-bench:
+ *
+ * Measures end-to-end throughput of a real Terminal: input is fed
+ * through Terminal::feed() and processed as it would be from a PTY, so
+ * that the numbers include the parser, insert_char(), the ring and its
+ * streams, and optionally drawing to an offscreen surface.
+ *
+ * The built-in corpora are generated deterministically, so that runs
+ * are comparable across machines and versions.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <gtk/gtk.h>
+#include <locale.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <vte/vte.h>
+
+#include "cairo-glue.hh"
+#include "debug.h"
+#include "glib-glue.hh"
+#include "std-glue.hh"
+#include "vteinternal.hh"
+
+using namespace std::literals;
+
+/* Corpora */
+
+class Generator {
+public:
+        explicit Generator(size_t size) noexcept :
+                m_size{size}
+        {
+                m_data.reserve(size + 4096);
+        }
+
+        inline bool done() const noexcept { return m_data.size() >= m_size; }
+        inline std::string take() noexcept { return std::move(m_data); }
+
+        /* Not std::uniform_int_distribution, whose output is up to the
+         * standard library; mt19937's sequence is specified. */
+        inline unsigned int next(unsigned int n) noexcept
+        {
+                return m_random() % n;
+        }
+
+        inline void append(std::string_view const& str) { m_data.append(str); }
+        inline void append(char c) { m_data.push_back(c); }
+
+        void append_printf(char const* format,
+                           ...) G_GNUC_PRINTF(2, 3)
+        {
+                char buf[256];
+                va_list args;
+                va_start(args, format);
+                auto const len = g_vsnprintf(buf, sizeof(buf), format, args);
+                va_end(args);
+                m_data.append(buf, std::min(size_t(len), sizeof(buf) - 1));
+        }
+
+        void append_unichar(gunichar c)
+        {
+                char buf[6];
+                m_data.append(buf, g_unichar_to_utf8(c, buf));
+        }
+
+        void append_word()
+        {
+                static constexpr char const* words[] = {
+                        "the", "request", "completed", "in", "connection", "from",
+                        "error", "warning", "retrying", "after", "timeout", "user",
+                        "session", "opened", "closed", "for", "module", "loaded",
+                        "config", "value", "is", "not", "set", "using", "default",
+                };
+                append(words[next(G_N_ELEMENTS(words))]);
+        }
+
+private:
+        size_t m_size;
+        std::string m_data{};
+        std::mt19937 m_random{42};
+}; // class Generator
+
+/* Log lines: timestamp, level, and a sentence of plain ASCII */
+static void
+generate_ascii(Generator& gen)
+{
+        static constexpr char const* levels[] = { "INFO", "DEBUG", "WARN", "ERROR" };
+
+        for (auto line = 0u; !gen.done(); ++line) {
+                gen.append_printf("2026-01-%02u %02u:%02u:%02u.%03u %-5s [worker-%u] ",
+                                  1 + line / 86400 % 28,
+                                  line / 3600 % 24, line / 60 % 60, line % 60,
+                                  gen.next(1000),
+                                  levels[gen.next(G_N_ELEMENTS(levels))],
+                                  gen.next(16));
+                for (auto n = 4 + gen.next(16); n; --n) {
+                        gen.append_word();
+                        gen.append(' ');
+                }
+                gen.append("\r\n"sv);
+        }
+}
+
+/* Colourised output, like ls --color, compiler diagnostics or git log */
+static void
+generate_sgr(Generator& gen)
+{
+        while (!gen.done()) {
+                for (auto n = 2 + gen.next(12); n; --n) {
+                        switch (gen.next(5)) {
+                        case 0: gen.append_printf("\e[%um", 30 + gen.next(8)); break;
+                        case 1: gen.append_printf("\e[1;%um", 90 + gen.next(8)); break;
+                        case 2: gen.append_printf("\e[38;5;%um", gen.next(256)); break;
+                        case 3: gen.append_printf("\e[38;2;%u;%u;%u;48;5;%um",
+                                                  gen.next(256), gen.next(256), gen.next(256),
+                                                  gen.next(256)); break;
+                        case 4: gen.append("\e[4;3m"sv); break;
+                        }
+                        gen.append_word();
+                        gen.append("\e[0m "sv);
+                }
+                gen.append("\r\n"sv);
+        }
+}
+
+/* Wide characters from the CJK unified ideographs block, with some kana and ASCII */
+static void
+generate_cjk(Generator& gen)
+{
+        while (!gen.done()) {
+                for (auto n = 8 + gen.next(32); n; --n) {
+                        switch (gen.next(8)) {
+                        case 0: gen.append_unichar(0x3041 + gen.next(0x56)); break;
+                        case 1: gen.append_unichar(0x30a1 + gen.next(0x5a)); break;
+                        case 2: gen.append_word(); gen.append(' '); break;
+                        default: gen.append_unichar(0x4e00 + gen.next(0x5000)); break;
+                        }
+                }
+                gen.append("\r\n"sv);
+        }
+}
+
+/* Paragraphs mixing Hebrew, Arabic (with combining marks) and ASCII */
+static void
+generate_bidi(Generator& gen)
+{
+        while (!gen.done()) {
+                for (auto n = 4 + gen.next(12); n; --n) {
+                        auto const len = 2 + gen.next(7);
+                        switch (gen.next(3)) {
+                        case 0:
+                                for (auto i = 0u; i < len; ++i)
+                                        gen.append_unichar(0x05d0 + gen.next(27));
+                                break;
+                        case 1:
+                                for (auto i = 0u; i < len; ++i) {
+                                        gen.append_unichar(0x0621 + gen.next(26));
+                                        if (gen.next(4) == 0)
+                                                gen.append_unichar(0x064b + gen.next(8));
+                                }
+                                break;
+                        case 2:
+                                gen.append_word();
+                                break;
+                        }
+                        gen.append(' ');
+                }
+                gen.append("\r\n"sv);
+        }
+}
+
+#if WITH_SIXEL
+
+/* Small DECSIXEL images with a few colours, interleaved with text */
+static void
+generate_sixel(Generator& gen)
+{
+        while (!gen.done()) {
+                gen.append("\eP0;1;0q\"1;1;64;48"sv);
+                for (auto i = 0u; i < 4; ++i)
+                        gen.append_printf("#%u;2;%u;%u;%u", i,
+                                          gen.next(101), gen.next(101), gen.next(101));
+                for (auto band = 0u; band < 8; ++band) {
+                        for (auto i = 0u; i < 4; ++i) {
+                                gen.append_printf("#%u", i);
+                                for (auto x = 0u; x < 64; ) {
+                                        auto const count = 1 + gen.next(16);
+                                        auto const c = char('?' + gen.next(64));
+                                        if (count > 3)
+                                                gen.append_printf("!%u%c", count, c);
+                                        else
+                                                for (auto j = 0u; j < count; ++j)
+                                                        gen.append(c);
+                                        x += count;
+                                }
+                                gen.append(i + 1 < 4 ? '$' : '-');
+                        }
+                }
+                gen.append("\e\\\r\n"sv);
+                gen.append_word();
+                gen.append("\r\n"sv);
+        }
+}
+
+#endif /* WITH_SIXEL */
+
+/* A full-screen editor scrolling through a file: a scrolling region
+ * above a status line, with IL/DL and RI to scroll, and CUP to redraw
+ * single lines; like perf/scroll.vim does interactively.
+ */
+static void
+generate_scroll(Generator& gen)
+{
+        auto const rows = 24u;
+
+        gen.append("\e[?1049h\e[H\e[2J"sv);
+        for (auto line = 0u; !gen.done(); ++line) {
+                gen.append_printf("\e[1;%ur", rows - 1);
+                switch (gen.next(4)) {
+                case 0:
+                        gen.append_printf("\e[%uH\n", rows - 1);
+                        break;
+                case 1:
+                        gen.append("\e[H\eM"sv);
+                        break;
+                case 2:
+                        gen.append_printf("\e[%uH\e[%uM", 1 + gen.next(rows - 2), 1 + gen.next(3));
+                        break;
+                case 3:
+                        gen.append_printf("\e[%uH\e[%uL", 1 + gen.next(rows - 2), 1 + gen.next(3));
+                        break;
+                }
+                gen.append("\e[r"sv);
+                gen.append_printf("\e[%uH\e[K\e[33m%5u \e[0m", 1 + gen.next(rows - 1), line);
+                for (auto n = gen.next(12); n; --n) {
+                        gen.append_word();
+                        gen.append(' ');
+                }
+                gen.append_printf("\e[%uH\e[7m\"file.c\" line %u\e[K\e[0m\e[%u;%uH",
+                                  rows, line, 1 + gen.next(rows - 1), 1 + gen.next(80));
+        }
+        gen.append("\e[?1049l"sv);
+}
+
+struct Corpus {
+        char const* name;
+        void (*generate)(Generator&);
+};
+
+static constexpr Corpus const corpora[] = {
+        { "ascii", generate_ascii },
+        { "sgr", generate_sgr },
+        { "cjk", generate_cjk },
+        { "bidi", generate_bidi },
+#if WITH_SIXEL
+        { "sixel", generate_sixel },
+#endif
+        { "scroll", generate_scroll },
+};
+
+/* Options */
+
+class Options {
+private:
+        bool m_draw{false};
+        bool m_json{false};
+        int m_chunk_size{16384};
+        int m_columns{80};
+        int m_repeat{3};
+        int m_rows{24};
+        int m_scrollback{10000};
+        int m_size{16};
+        vte::glib::StrvPtr m_corpora{};
+        vte::glib::StrvPtr m_filenames{};
+
+public:
+
+        Options() noexcept = default;
+        Options(Options const&) = delete;
+        Options(Options&&) = delete;
+
+        ~Options() = default;
+
+        inline constexpr bool   draw()       const noexcept { return m_draw;       }
+        inline constexpr bool   json()       const noexcept { return m_json;       }
+        inline constexpr size_t chunk_size() const noexcept { return m_chunk_size; }
+        inline constexpr int    columns()    const noexcept { return m_columns;    }
+        inline constexpr int    repeat()     const noexcept { return m_repeat;     }
+        inline constexpr int    rows()       const noexcept { return m_rows;       }
+        inline constexpr int    scrollback() const noexcept { return m_scrollback; }
+        inline constexpr size_t size()       const noexcept { return size_t(m_size) << 20; }
+        inline char const* const* corpora()   const noexcept { return m_corpora.get(); }
+        inline char const* const* filenames() const noexcept { return m_filenames.get(); }
+
+        bool parse(int argc,
+                   char* argv[],
+                   GError** error) noexcept
+        {
+                using BoolOption = vte::ValueGetter<bool, gboolean>;
+                using IntOption = vte::ValueGetter<int, int>;
+                using StrvOption = vte::ValueGetter<vte::glib::StrvPtr, char**, nullptr>;
+
+                auto draw = BoolOption{m_draw, false};
+                auto json = BoolOption{m_json, false};
+                auto chunk_size = IntOption{m_chunk_size, 16384};
+                auto columns = IntOption{m_columns, 80};
+                auto repeat = IntOption{m_repeat, 3};
+                auto rows = IntOption{m_rows, 24};
+                auto scrollback = IntOption{m_scrollback, 10000};
+                auto size = IntOption{m_size, 16};
+                auto corpora = StrvOption{m_corpora, nullptr};
+                auto filenames = StrvOption{m_filenames, nullptr};
+
+                GOptionEntry const entries[] = {
+                        { "chunk-size", 'B', 0, G_OPTION_ARG_INT, &chunk_size,
+                          "Feed input in chunks of SIZE bytes", "SIZE" },
+                        { "columns", 'c', 0, G_OPTION_ARG_INT, &columns,
+                          "Terminal width", "COLUMNS" },
+                        { "corpus", 'C', 0, G_OPTION_ARG_STRING_ARRAY, &corpora,
+                          "Run the built-in corpus NAME (ascii, sgr, cjk, bidi, sixel, scroll, all)", "NAME" },
+                        { "draw", 'd', 0, G_OPTION_ARG_NONE, &draw,
+                          "Draw to an offscreen surface after each chunk", nullptr },
+                        { "json", 'j', 0, G_OPTION_ARG_NONE, &json,
+                          "Output results as JSON", nullptr },
+                        { "repeat", 'r', 0, G_OPTION_ARG_INT, &repeat,
+                          "Run each corpus COUNT times and report the fastest run", "COUNT" },
+                        { "rows", 'R', 0, G_OPTION_ARG_INT, &rows,
+                          "Terminal height", "ROWS" },
+                        { "scrollback", 's', 0, G_OPTION_ARG_INT, &scrollback,
+                          "Scrollback lines", "LINES" },
+                        { "size", 'S', 0, G_OPTION_ARG_INT, &size,
+                          "Size of generated corpora in MiB", "SIZE" },
+                        { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &filenames,
+                          nullptr, nullptr },
+                        { nullptr },
+                };
+
+                auto context = vte::take_freeable(g_option_context_new("[FILE…] — VTE throughput benchmark"));
+                g_option_context_set_help_enabled(context.get(), true);
+                g_option_context_add_main_entries(context.get(), entries, nullptr);
+
+                if (!g_option_context_parse(context.get(), &argc, &argv, error))
+                        return false;
+
+                if (m_chunk_size < 1 || m_columns < 1 || m_rows < 1 ||
+                    m_repeat < 1 || m_scrollback < 0 || m_size < 1) {
+                        g_set_error_literal(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                                            "Values must be positive");
+                        return false;
+                }
+
+                return true;
+        }
+}; // class Options
+
+/* Benchmark */
+
+struct Result {
+        std::string name{};
+        size_t bytes{0};
+        int64_t elapsed{std::numeric_limits<int64_t>::max()}; /* µs, feeding and processing */
+        int64_t draw_elapsed{0}; /* µs */
+        size_t frames{0};
+        size_t rows_frozen{0};
+        size_t rows_thawed{0};
+        size_t stream_bytes_written{0};
+
+        inline double mb_per_s() const noexcept
+        {
+                return elapsed ? double(bytes) / double(elapsed) : 0.;
+        }
+
+        inline double ns_per_byte() const noexcept
+        {
+                return bytes ? double(elapsed) * 1000. / double(bytes) : 0.;
+        }
+};
+
+class Bench {
+public:
+        Bench(Options const& options) noexcept :
+                m_options{options}
+        {
+        }
+
+        Bench(Bench const&) = delete;
+        Bench(Bench&&) = delete;
+
+        void run(char const* name,
+                 std::string const& data)
+        {
+                auto best = Result{};
+                best.name = name;
+
+                for (auto i = 0; i < m_options.repeat(); ++i) {
+                        auto result = run_once(data);
+                        if (result.elapsed < best.elapsed) {
+                                result.name = name;
+                                best = std::move(result);
+                        }
+                }
+
+                m_results.push_back(std::move(best));
+        }
+
+        void print() const noexcept
+        {
+                if (m_options.json())
+                        print_json();
+                else
+                        print_human();
+        }
+
+private:
+        Options const& m_options;
+        std::vector<Result> m_results{};
+
+        Result run_once(std::string const& data)
+        {
+                auto terminal = VTE_TERMINAL(g_object_ref_sink(vte_terminal_new()));
+                vte_terminal_set_size(terminal, m_options.columns(), m_options.rows());
+                vte_terminal_set_scrollback_lines(terminal, m_options.scrollback());
+                #if WITH_SIXEL
+                vte_terminal_set_enable_sixel(terminal, true);
+                #endif
+
+                #if VTE_GTK == 3
+                GtkWidget* window = nullptr;
+                if (m_options.draw()) {
+                        window = gtk_offscreen_window_new();
+                        gtk_container_add(GTK_CONTAINER(window), GTK_WIDGET(terminal));
+                        gtk_widget_show_all(window);
+                        while (gtk_events_pending())
+                                gtk_main_iteration();
+                }
+                #endif
+
+                auto impl = _vte_terminal_get_impl(terminal);
+                auto result = Result{};
+                result.bytes = data.size();
+                result.elapsed = 0;
+
+                auto const chunk_size = m_options.chunk_size();
+                for (auto offset = size_t{0}; offset < data.size(); offset += chunk_size) {
+                        auto const chunk = std::string_view{data}.substr(offset, chunk_size);
+
+                        auto const start = g_get_monotonic_time();
+                        impl->feed(chunk, false);
+                        while (impl->process())
+                                ;
+                        result.elapsed += g_get_monotonic_time() - start;
+
+                        #if VTE_GTK == 3
+                        if (window) {
+                                auto const draw_start = g_get_monotonic_time();
+                                draw(GTK_WIDGET(terminal));
+                                result.draw_elapsed += g_get_monotonic_time() - draw_start;
+                                ++result.frames;
+                        }
+                        #endif
+                }
+
+                for (auto ring : {&impl->m_normal_screen.m_ring, &impl->m_alternate_screen.m_ring}) {
+                        result.rows_frozen += ring->rows_frozen();
+                        result.rows_thawed += ring->rows_thawed();
+                        result.stream_bytes_written += ring->stream_bytes_written();
+                }
+
+                #if VTE_GTK == 3
+                if (window)
+                        gtk_widget_destroy(window);
+                #endif
+                g_object_unref(terminal);
+                vte::base::Chunk::prune();
+
+                return result;
+        }
+
+        #if VTE_GTK == 3
+        static void draw(GtkWidget* widget)
+        {
+                auto surface = vte::take_freeable
+                        (cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+                                                    gtk_widget_get_allocated_width(widget),
+                                                    gtk_widget_get_allocated_height(widget)));
+                auto cr = vte::take_freeable(cairo_create(surface.get()));
+                gtk_widget_draw(widget, cr.get());
+                cairo_surface_flush(surface.get());
+        }
+        #endif
+
+        void print_human() const noexcept
+        {
+                g_print("%-24s %10s %10s %9s %12s %12s %12s",
+                        "corpus", "MiB", "MB/s", "ns/byte",
+                        "rows frozen", "rows thawed", "stream MiB");
+                if (m_options.draw())
+                        g_print(" %12s", "draw µs/frame");
+                g_print("\n");
+
+                for (auto const& r : m_results) {
+                        g_print("%-24s %10.2f %10.2f %9.2f %12zu %12zu %12.2f",
+                                r.name.c_str(),
+                                double(r.bytes) / (1 << 20),
+                                r.mb_per_s(),
+                                r.ns_per_byte(),
+                                r.rows_frozen,
+                                r.rows_thawed,
+                                double(r.stream_bytes_written) / (1 << 20));
+                        if (m_options.draw())
+                                g_print(" %12.1f", r.frames ? double(r.draw_elapsed) / double(r.frames) : 0.);
+                        g_print("\n");
+                }
+        }
+
+        void print_json() const noexcept
+        {
+                g_print("{\n"
+                        "  \"columns\": %d,\n"
+                        "  \"rows\": %d,\n"
+                        "  \"scrollback\": %d,\n"
+                        "  \"chunk_size\": %zu,\n"
+                        "  \"repeat\": %d,\n"
+                        "  \"results\": [",
+                        m_options.columns(),
+                        m_options.rows(),
+                        m_options.scrollback(),
+                        m_options.chunk_size(),
+                        m_options.repeat());
+
+                auto first = true;
+                for (auto const& r : m_results) {
+                        auto name = vte::glib::take_string(g_strescape(r.name.c_str(), nullptr));
+                        g_print("%s\n    {\n"
+                                "      \"name\": \"%s\",\n"
+                                "      \"bytes\": %zu,\n"
+                                "      \"elapsed_us\": %" G_GINT64_FORMAT ",\n"
+                                "      \"mb_per_s\": %.3f,\n"
+                                "      \"ns_per_byte\": %.3f,\n"
+                                "      \"rows_frozen\": %zu,\n"
+                                "      \"rows_thawed\": %zu,\n"
+                                "      \"stream_bytes_written\": %zu",
+                                first ? "" : ",",
+                                name.get(),
+                                r.bytes,
+                                r.elapsed,
+                                r.mb_per_s(),
+                                r.ns_per_byte(),
+                                r.rows_frozen,
+                                r.rows_thawed,
+                                r.stream_bytes_written);
+                        if (m_options.draw())
+                                g_print(",\n"
+                                        "      \"frames\": %zu,\n"
+                                        "      \"draw_us\": %" G_GINT64_FORMAT,
+                                        r.frames,
+                                        r.draw_elapsed);
+                        g_print("\n    }");
+                        first = false;
+                }
+
+                g_print("\n  ]\n}\n");
+        }
+}; // class Bench
+
+static void
+run_corpus(Bench& bench,
+           Options const& options,
+           Corpus const& corpus)
+{
+        auto gen = Generator{options.size()};
+        corpus.generate(gen);
+        bench.run(corpus.name, gen.take());
+}
+
+int
+main(int argc,
+     char *argv[])
+{
+        setlocale(LC_ALL, "");
+        _vte_debug_init();
+
+        Options options{};
+        auto error = vte::glib::Error{};
+        if (!options.parse(argc, argv, error)) {
+                g_printerr("Failed to parse arguments: %s\n", error.message());
+                return EXIT_FAILURE;
+        }
+
+        #if VTE_GTK == 3
+        if (!gtk_init_check(nullptr, nullptr)) {
+        #elif VTE_GTK == 4
+        if (!gtk_init_check()) {
+        #endif
+                g_printerr("Failed to initialise GTK; a display is required\n");
+                return EXIT_FAILURE;
+        }
+
+        #if VTE_GTK == 4
+        if (options.draw()) {
+                g_printerr("Offscreen drawing is only supported with GTK 3\n");
+                return EXIT_FAILURE;
+        }
+        #endif
+
+        auto bench = Bench{options};
+
+        auto const names = options.corpora();
+        auto const filenames = options.filenames();
+        if (!names && !filenames) {
+                for (auto const& corpus : corpora)
+                        run_corpus(bench, options, corpus);
+        }
+
+        for (auto i = 0; names && names[i]; ++i) {
+                auto found = false;
+                for (auto const& corpus : corpora) {
+                        if (g_str_equal(names[i], "all") || g_str_equal(names[i], corpus.name)) {
+                                run_corpus(bench, options, corpus);
+                                found = true;
+                        }
+                }
+                if (!found) {
+                        g_printerr("Unknown corpus \"%s\"\n", names[i]);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        for (auto i = 0; filenames && filenames[i]; ++i) {
+                auto contents = vte::glib::StringPtr{};
+                auto length = gsize{0};
+                if (!g_file_get_contents(filenames[i], vte::glib::StringGetter{contents}, &length, error)) {
+                        g_printerr("Failed to read \"%s\": %s\n", filenames[i], error.message());
+                        return EXIT_FAILURE;
+                }
+
+                auto name = vte::glib::take_string(g_path_get_basename(filenames[i]));
+                bench.run(name.get(), std::string{contents.get(), length});
+        }
+
+        bench.print();
+        return EXIT_SUCCESS;
+}
@@ -246,8 +246,8 @@ static_assert(offsetof (VteCellAttr, hyperlink_idx) == VTE_CELL_ATTR_COMMON_BYTE
  */
 
 typedef struct _VTE_GNUC_PACKED _VteStreamCellAttr {
-        uint32_t attr; /* Same as VteCellAttr. We only access columns
-                        * and fragment, however.
+        uint32_t attr; /* Same as VteCellAttr. We only access columns,
+                        * fragment and shellintegration, however.
                         */
         /* 4-byte boundary */
         uint64_t colors;
@@ -257,6 +257,7 @@ typedef struct _VTE_GNUC_PACKED _VteStreamCellAttr {
         /* Methods */
         CELL_ATTR_UINT(columns, COLUMNS)
         CELL_ATTR_BOOL(fragment, FRAGMENT)
+        CELL_ATTR_UINT(shellintegration, SHELLINTEGRATION)
 } VteStreamCellAttr;
 static_assert(sizeof (VteStreamCellAttr) == 14, "VteStreamCellAttr has wrong size");
 static_assert(offsetof (VteStreamCellAttr, hyperlink_length) == VTE_CELL_ATTR_COMMON_BYTES, "VteStreamCellAttr layout is wrong");
@@ -46,6 +46,29 @@ DrawingContext::clear_font_cache()
         }
 }
 
+void
+DrawingContext::get_font_cache_statistics(uint64_t& hits,
+                                          uint64_t& misses) const noexcept
+{
+        hits = misses = 0;
+
+        for (auto style = int{0}; style < 4; ++style) {
+                auto const font = m_fonts[style];
+                if (font == nullptr)
+                        continue;
+
+                // The styles may share a font
+                auto shared = false;
+                for (auto other = int{0}; other < style; ++other)
+                        shared |= m_fonts[other] == font;
+                if (shared)
+                        continue;
+
+                hits += font->cache_hits();
+                misses += font->cache_misses();
+        }
+}
+
 void
 DrawingContext::set_text_font(GtkWidget* widget,
                               PangoFontDescription const* fontdesc,
@@ -234,6 +234,8 @@ public:
                             vte::color::rgb const* color);
 
         void clear_font_cache();
+        void get_font_cache_statistics(uint64_t& hits,
+                                       uint64_t& misses) const noexcept;
         void set_text_font(GtkWidget* widget,
                            PangoFontDescription const* fontdesc,
                            cairo_font_options_t const* font_options,
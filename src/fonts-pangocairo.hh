@@ -229,6 +229,10 @@ public:
         inline constexpr int height() const { return m_height; }
         inline constexpr int ascent() const { return m_ascent; }
 
+        /* Counters of get_unistr_info() lookups, for statistics */
+        inline constexpr auto cache_hits() const noexcept { return m_cache_hits; }
+        inline constexpr auto cache_misses() const noexcept { return m_cache_misses; }
+
 private:
 
         static void unistr_info_destroy(UnistrInfo* uinfo)
@@ -269,6 +273,9 @@ private:
         // FIXME: use std::string
 	GString* m_string{nullptr};
 
+        uint64_t m_cache_hits{0};
+        uint64_t m_cache_misses{0};
+
 #if VTE_DEBUG
 	/* profiling info */
 	int m_coverage_count[4]{0, 0, 0, 0};
@@ -26,12 +26,14 @@ public:
         explicit FreezeObjectNotify(void* object) noexcept
                 : m_object{G_OBJECT(object)}
         {
-                g_object_freeze_notify(m_object);
+                if (m_object)
+                        g_object_freeze_notify(m_object);
         }
 
         ~FreezeObjectNotify() noexcept
         {
-                g_object_thaw_notify(m_object);
+                if (m_object)
+                        g_object_thaw_notify(m_object);
         }
 
         FreezeObjectNotify() = delete;
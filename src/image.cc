@@ -20,7 +20,7 @@
 
 #include <glib.h>
 #include <stdio.h>
-#include "vteinternal.hh"
+#include "vteutils.h"
 
 #include "image.hh"
 
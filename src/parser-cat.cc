@@ -952,10 +952,12 @@ private:
         bool m_no_sixel{false};
         bool m_statistics{false};
         bool m_benchmark{false};
+        bool m_graphic_runs{false};
 
         gsize m_seq_stats[VTE_SEQ_N];
         gsize m_cmd_stats[VTE_CMD_N];
         GArray* m_bench_times;
+        uint32_t* m_graphic_buf{nullptr};
 
         static constexpr const size_t k_buf_overlap = 1u;
 
@@ -1050,6 +1052,17 @@ private:
                                         if (!process_seq(seq))
                                                 return sptr;
                                 }
+
+                                /* Like Terminal::process_incoming_utf8(), consume a run of
+                                 * printable ASCII following a graphic character without
+                                 * going through the decoder and parser.
+                                 */
+                                if (ret == VTE_SEQ_GRAPHIC && m_graphic_runs) {
+                                        auto const n = vte::base::widen_printable_ascii(sptr, bufend, m_graphic_buf);
+                                        m_seq_stats[VTE_SEQ_GRAPHIC] += n;
+                                        m_cmd_stats[VTE_CMD_GRAPHIC] += n;
+                                        sptr += n;
+                                }
                                 break;
                         }
                         default:
@@ -1187,16 +1200,20 @@ public:
                   size_t buffer_size,
                   bool no_sixel,
                   bool statistics,
-                  bool benchmark) noexcept
+                  bool benchmark,
+                  bool graphic_runs) noexcept
                 : m_delegate{delegate},
                   m_buffer_size{std::max(buffer_size, k_buf_overlap + 1)},
                   m_no_sixel{no_sixel},
                   m_statistics{statistics},
-                  m_benchmark{benchmark}
+                  m_benchmark{benchmark},
+                  m_graphic_runs{graphic_runs}
         {
                 memset(&m_seq_stats, 0, sizeof(m_seq_stats));
                 memset(&m_cmd_stats, 0, sizeof(m_cmd_stats));
                 m_bench_times = g_array_new(false, true, sizeof(int64_t));
+                if (m_graphic_runs)
+                        m_graphic_buf = g_new(uint32_t, m_buffer_size);
 
 #if WITH_SIXEL
                 m_parser.set_dispatch_unripe(!m_no_sixel);
@@ -1211,6 +1228,7 @@ public:
                         print_benchmark();
 
                 g_array_free(m_bench_times, true);
+                g_free(m_graphic_buf);
         }
 
         bool
@@ -1295,6 +1313,7 @@ class Options {
 private:
         bool m_benchmark{false};
         bool m_codepoints{false};
+        bool m_graphic_runs{false};
         bool m_lint{false};
         bool m_no_sixel{false};
         bool m_plain{false};
@@ -1303,6 +1322,7 @@ private:
         int m_buffer_size{16384};
         int m_repeat{1};
         vte::glib::StrvPtr m_filenames{};
+        vte::glib::StringPtr m_simd{};
 
 public:
 
@@ -1315,6 +1335,7 @@ public:
         inline constexpr bool   benchmark()   const noexcept { return m_benchmark;  }
         inline constexpr size_t buffer_size() const noexcept { return m_buffer_size; }
         inline constexpr bool   codepoints()  const noexcept { return m_codepoints; }
+        inline constexpr bool   graphic_runs() const noexcept { return m_graphic_runs; }
         inline constexpr bool   lint()        const noexcept { return m_lint;       }
         inline constexpr bool   no_sixel()    const noexcept { return m_no_sixel;   }
         inline constexpr bool   plain()       const noexcept { return m_plain;      }
@@ -1322,6 +1343,7 @@ public:
         inline constexpr bool   statistics()  const noexcept { return m_statistics; }
         inline constexpr int    repeat()      const noexcept { return m_repeat;     }
         inline char const* const* filenames() const noexcept { return m_filenames.get(); }
+        inline char const* simd() const noexcept { return m_simd.get(); }
 
         bool parse(int argc,
                    char* argv[],
@@ -1333,6 +1355,7 @@ public:
 
                 auto benchmark = BoolOption{m_benchmark, false};
                 auto codepoints = BoolOption{m_codepoints, false};
+                auto graphic_runs = BoolOption{m_graphic_runs, false};
                 auto lint = BoolOption{m_lint, false};
                 auto no_sixel = BoolOption{m_no_sixel, false};
                 auto plain = BoolOption{m_plain, false};
@@ -1341,6 +1364,7 @@ public:
                 auto buffer_size = IntOption{m_buffer_size, 16384};
                 auto repeat = IntOption{m_repeat, 1};
                 auto filenames = StrvOption{m_filenames, nullptr};
+                auto simd = vte::glib::StringGetter{m_simd, nullptr};
 
                 GOptionEntry const entries[] = {
                         { "benchmark", 'b', 0, G_OPTION_ARG_NONE, &benchmark,
@@ -1349,6 +1373,8 @@ public:
                           "Buffer size", "SIZE" },
                         { "codepoints", 'u', 0, G_OPTION_ARG_NONE, &codepoints,
                           "Output unicode code points by number", nullptr },
+                        { "graphic-runs", 'g', 0, G_OPTION_ARG_NONE, &graphic_runs,
+                          "Consume printable ASCII runs like the terminal does (requires --quiet)", nullptr },
                         { "lint", 'l', 0, G_OPTION_ARG_NONE, &lint,
                           "Check input", nullptr },
 #if WITH_SIXEL
@@ -1361,6 +1387,8 @@ public:
                           "Suppress output except for statistics and benchmark", nullptr },
                         { "repeat", 'r', 0, G_OPTION_ARG_INT, &repeat,
                           "Repeat each file COUNT times", "COUNT" },
+                        { "simd", 0, 0, G_OPTION_ARG_STRING, &simd,
+                          "SIMD level for printable ASCII runs (none, sse2)", "LEVEL" },
                         { "statistics", 's', 0, G_OPTION_ARG_NONE, &statistics,
                           "Output statistics", nullptr },
                         { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &filenames,
@@ -1385,7 +1413,8 @@ process(Options const& options,
                               options.buffer_size(),
                               options.no_sixel(),
                               options.statistics(),
-                              options.benchmark()};
+                              options.benchmark(),
+                              options.graphic_runs()};
 
         return proc.process_files(options.filenames(), options.repeat());
 }
@@ -1404,6 +1433,28 @@ main(int argc,
                 return EXIT_FAILURE;
         }
 
+        if (auto const simd = options.simd()) {
+                auto level = vte::base::SIMDLevel{};
+                if (g_str_equal(simd, "none"))
+                        level = vte::base::SIMDLevel::eNONE;
+                else if (g_str_equal(simd, "sse2"))
+                        level = vte::base::SIMDLevel::eSSE2;
+                else {
+                        g_printerr("Unknown SIMD level \"%s\"\n", simd);
+                        return EXIT_FAILURE;
+                }
+
+                if (!vte::base::set_widen_printable_ascii_simd_level(level)) {
+                        g_printerr("SIMD level \"%s\" not available in this build\n", simd);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        if (options.graphic_runs() && !options.quiet()) {
+                g_printerr("Cannot use graphic-runs option without quiet\n");
+                return EXIT_FAILURE;
+        }
+
         auto rv = false;
         if (options.lint()) {
                 if (options.repeat() != 1) {
@@ -18,6 +18,8 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cstdint>
 #include <cstdio>
 #include <optional>
@@ -366,6 +368,408 @@ enum State {
         SCI,              /* single character introducer sequence was started */
 };
 
+/*
+ * Transition table
+ *
+ * The state machine is evaluated at compile time into a table indexed
+ * by the current state and the input character, whose entries are the
+ * next state and the action to perform on entering it. No state tells
+ * characters from 0xa0 upwards apart, so they share the last column.
+ */
+enum Action : uint8_t {
+        ACTION_NOP,
+        ACTION_CLEAR,
+        ACTION_CLEAR_INT,
+        ACTION_CLEAR_PARAMS,
+        ACTION_CLEAR_INT_AND_PARAMS,
+        ACTION_COLLECT_CSI,
+        ACTION_COLLECT_ESC,
+        ACTION_COLLECT_PARAMETER,
+        ACTION_CSI_DISPATCH,
+        ACTION_DCS_COLLECT,
+        ACTION_DCS_CONSUME,
+        ACTION_DCS_DISPATCH,
+        ACTION_DCS_START,
+        ACTION_ESC_DISPATCH,
+        ACTION_EXECUTE,
+        ACTION_FINISH_PARAM,
+        ACTION_FINISH_SUBPARAM,
+        ACTION_IGNORE,
+        ACTION_OSC_COLLECT,
+        ACTION_OSC_DISPATCH,
+        ACTION_OSC_START,
+        ACTION_PARAM,
+        ACTION_PRINT,
+        ACTION_SCI_DISPATCH,
+
+        /* Flag: first do the clear that was deferred when ESC was
+         * received in DCS_PASS or OSC_STRING.
+         */
+        ACTION_FLAG_CLEAR_INT = 0x80,
+};
+
+struct Transition {
+        uint8_t state{GROUND};
+        uint8_t action{ACTION_NOP};
+
+        constexpr Transition() noexcept = default;
+        constexpr Transition(unsigned int state_,
+                             unsigned int action_) noexcept :
+                state(state_),
+                action(action_)
+        {
+        }
+
+        constexpr Transition with_flags(unsigned int flags) const noexcept
+        {
+                return Transition{state, action | flags};
+        }
+};
+
+inline constexpr auto const N_STATES = unsigned{SCI} + 1;
+inline constexpr auto const N_INPUTS = unsigned{0xa0} + 1;
+
+constexpr Transition
+transition(unsigned int state,
+           uint32_t raw) noexcept
+{
+        /*
+         * Notes:
+         *  * DEC treats GR codes as GL. We don't do that as we require UTF-8
+         *    as charset and, thus, it doesn't make sense to treat GR special.
+         *  * During control sequences, unexpected C1 codes cancel the sequence
+         *    and immediately start a new one. C0 codes, however, may or may not
+         *    be ignored/executed depending on the sequence.
+         */
+        switch (raw) {
+        case 0x18:                /* CAN */
+                return Transition{GROUND, ACTION_IGNORE};
+        case 0x1a:                /* SUB */
+                return Transition{GROUND, ACTION_EXECUTE};
+        case 0x7f:                 /* DEL */
+                return Transition{state, ACTION_NOP};
+        case 0x80 ... 0x8f:        /* C1 \ {DCS, SOS, SCI, CSI, ST, OSC, PM, APC} */
+        case 0x91 ... 0x97:
+        case 0x99:
+                return Transition{GROUND, ACTION_EXECUTE};
+        case 0x98:                /* SOS */
+        case 0x9e:                /* PM */
+        case 0x9f:                /* APC */
+                return Transition{ST_IGNORE, ACTION_NOP};
+                // FIXMEchpe shouldn't this use action_clear?
+        case 0x90:                /* DCS */
+                return Transition{DCS_ENTRY, ACTION_DCS_START};
+        case 0x9a:                /* SCI */
+                return Transition{SCI, ACTION_CLEAR};
+        case 0x9d:                /* OSC */
+                return Transition{OSC_STRING, ACTION_OSC_START};
+        case 0x9b:                /* CSI */
+                return Transition{CSI_ENTRY, ACTION_CLEAR_INT_AND_PARAMS};
+        default:
+                break;
+        }
+
+        switch (state) {
+        case GROUND:
+                switch (raw) {
+                case 0x00 ... 0x1a:        /* C0 \ { ESC } */
+                case 0x1c ... 0x1f:
+                case 0x80 ... 0x9f:        /* C1 */
+                        return Transition{state, ACTION_EXECUTE};
+                case 0x1b:                /* ESC */
+                        return Transition{ESC, ACTION_CLEAR_INT};
+                default:
+                        return Transition{state, ACTION_PRINT};
+                }
+
+        case DCS_PASS_ESC:
+        case OSC_STRING_ESC:
+                if (raw == 0x5c /* '\' */)
+                        return Transition{GROUND, state == DCS_PASS_ESC
+                                          ? ACTION_DCS_DISPATCH
+                                          : ACTION_OSC_DISPATCH};
+
+                /* Do the deferred clear, and continue as in ESC */
+                return transition(ESC, raw).with_flags(ACTION_FLAG_CLEAR_INT);
+        case ESC:
+                switch (raw) {
+                case 0x00 ... 0x1a:        /* C0 \ { ESC } */
+                case 0x1c ... 0x1f:
+                        return Transition{state, ACTION_EXECUTE};
+                case 0x1b:                /* ESC */
+                        return Transition{ESC, ACTION_CLEAR_INT};
+                case 0x20 ... 0x2f:        /* [' ' - '\'] */
+                        return Transition{ESC_INT, ACTION_COLLECT_ESC};
+                case 0x30 ... 0x4f:        /* ['0' - '~'] \ */
+                case 0x51 ... 0x57:        /* { 'P', 'X', 'Z' '[', ']', '^', '_' } */
+                case 0x59:
+                case 0x5c:
+                case 0x60 ... 0x7e:
+                        return Transition{GROUND, ACTION_ESC_DISPATCH};
+                case 0x50:                /* 'P' */
+                        return Transition{DCS_ENTRY, ACTION_DCS_START};
+                case 0x5a:                /* 'Z' */
+                        return Transition{SCI, ACTION_CLEAR};
+                case 0x5b:                /* '[' */
+                        return Transition{CSI_ENTRY, ACTION_CLEAR_PARAMS
+                                          /* rest already cleaned on ESC state entry */};
+                case 0x5d:                /* ']' */
+                        return Transition{OSC_STRING, ACTION_OSC_START};
+                case 0x58:                /* 'X' */
+                case 0x5e:                /* '^' */
+                case 0x5f:                /* '_' */
+                        return Transition{ST_IGNORE, ACTION_NOP};
+                case 0x9c:                /* ST */
+                        return Transition{GROUND, ACTION_IGNORE};
+                }
+
+                return Transition{GROUND, ACTION_IGNORE};
+        case ESC_INT:
+                switch (raw) {
+                case 0x00 ... 0x1a:        /* C0 \ { ESC } */
+                case 0x1c ... 0x1f:
+                        return Transition{state, ACTION_EXECUTE};
+                case 0x1b:                /* ESC */
+                        return Transition{ESC, ACTION_CLEAR_INT};
+                case 0x20 ... 0x2f:        /* [' ' - '\'] */
+                        return Transition{state, ACTION_COLLECT_ESC};
+                case 0x30 ... 0x7e:        /* ['0' - '~'] */
+                        return Transition{GROUND, ACTION_ESC_DISPATCH};
+                case 0x9c:                /* ST */
+                        return Transition{GROUND, ACTION_IGNORE};
+                }
+
+                return Transition{GROUND, ACTION_IGNORE};
+        case CSI_ENTRY:
+                switch (raw) {
+                case 0x00 ... 0x1a:        /* C0 \ { ESC } */
+                case 0x1c ... 0x1f:
+                        return Transition{state, ACTION_EXECUTE};
+                case 0x1b:                /* ESC */
+                        return Transition{ESC, ACTION_CLEAR_INT};
+                case 0x20 ... 0x2f:        /* [' ' - '\'] */
+                        return Transition{CSI_INT, ACTION_COLLECT_CSI};
+                case 0x30 ... 0x39:        /* ['0' - '9'] */
+                        return Transition{CSI_PARAM, ACTION_PARAM};
+                case 0x3a:                 /* ':' */
+                        return Transition{CSI_PARAM, ACTION_FINISH_SUBPARAM};
+                case 0x3b:                 /* ';' */
+                        return Transition{CSI_PARAM, ACTION_FINISH_PARAM};
+                case 0x3c ... 0x3f:        /* ['<' - '?'] */
+                        return Transition{CSI_PARAM, ACTION_COLLECT_PARAMETER};
+                case 0x40 ... 0x7e:        /* ['@' - '~'] */
+                        return Transition{GROUND, ACTION_CSI_DISPATCH};
+                case 0x9c:                /* ST */
+                        return Transition{GROUND, ACTION_IGNORE};
+                }
+
+                return Transition{CSI_IGNORE, ACTION_NOP};
+        case CSI_PARAM:
+                switch (raw) {
+                case 0x00 ... 0x1a:        /* C0 \ { ESC } */
+                case 0x1c ... 0x1f:
+                        return Transition{state, ACTION_EXECUTE};
+                case 0x1b:                /* ESC */
+                        return Transition{ESC, ACTION_CLEAR_INT};
+                case 0x20 ... 0x2f:        /* [' ' - '\'] */
+                        return Transition{CSI_INT, ACTION_COLLECT_CSI};
+                case 0x30 ... 0x39:        /* ['0' - '9'] */
+                        return Transition{state, ACTION_PARAM};
+                case 0x3a:                 /* ':' */
+                        return Transition{state, ACTION_FINISH_SUBPARAM};
+                case 0x3b:                 /* ';' */
+                        return Transition{state, ACTION_FINISH_PARAM};
+                case 0x3c ... 0x3f:        /* ['<' - '?'] */
+                        return Transition{CSI_IGNORE, ACTION_NOP};
+                case 0x40 ... 0x7e:        /* ['@' - '~'] */
+                        return Transition{GROUND, ACTION_CSI_DISPATCH};
+                case 0x9c:                /* ST */
+                        return Transition{GROUND, ACTION_IGNORE};
+                }
+
+                return Transition{CSI_IGNORE, ACTION_NOP};
+        case CSI_INT:
+                switch (raw) {
+                case 0x00 ... 0x1a:        /* C0 \ { ESC } */
+                case 0x1c ... 0x1f:
+                        return Transition{state, ACTION_EXECUTE};
+                case 0x1b:                /* ESC */
+                        return Transition{ESC, ACTION_CLEAR_INT};
+                case 0x20 ... 0x2f:        /* [' ' - '\'] */
+                        return Transition{state, ACTION_COLLECT_CSI};
+                case 0x30 ... 0x3f:        /* ['0' - '?'] */
+                        return Transition{CSI_IGNORE, ACTION_NOP};
+                case 0x40 ... 0x7e:        /* ['@' - '~'] */
+                        return Transition{GROUND, ACTION_CSI_DISPATCH};
+                case 0x9c:                /* ST */
+                        return Transition{GROUND, ACTION_IGNORE};
+                }
+
+                return Transition{CSI_IGNORE, ACTION_NOP};
+        case CSI_IGNORE:
+                switch (raw) {
+                case 0x00 ... 0x1a:        /* C0 \ { ESC } */
+                case 0x1c ... 0x1f:
+                        return Transition{state, ACTION_EXECUTE};
+                case 0x1b:                /* ESC */
+                        return Transition{ESC, ACTION_CLEAR_INT};
+                case 0x20 ... 0x3f:        /* [' ' - '?'] */
+                        return Transition{state, ACTION_NOP};
+                case 0x40 ... 0x7e:        /* ['@' - '~'] */
+                        return Transition{GROUND, ACTION_NOP};
+                case 0x9c:                /* ST */
+                        return Transition{GROUND, ACTION_IGNORE};
+                }
+
+                return Transition{state, ACTION_NOP};
+        case DCS_ENTRY:
+                switch (raw) {
+                case 0x00 ... 0x1a:        /* C0 \ ESC */
+                case 0x1c ... 0x1f:
+                        return Transition{state, ACTION_IGNORE};
+                case 0x1b:                /* ESC */
+                        return Transition{ESC, ACTION_CLEAR_INT};
+                case 0x20 ... 0x2f:        /* [' ' - '\'] */
+                        return Transition{DCS_INT, ACTION_COLLECT_CSI};
+                case 0x30 ... 0x39:        /* ['0' - '9'] */
+                        return Transition{DCS_PARAM, ACTION_PARAM};
+                case 0x3a:                 /* ':' */
+                        return Transition{DCS_PARAM, ACTION_FINISH_SUBPARAM};
+                case 0x3b:                 /* ';' */
+                        return Transition{DCS_PARAM, ACTION_FINISH_PARAM};
+                case 0x3c ... 0x3f:        /* ['<' - '?'] */
+                        return Transition{DCS_PARAM, ACTION_COLLECT_PARAMETER};
+                case 0x40 ... 0x7e:        /* ['@' - '~'] */
+                        return Transition{DCS_PASS, ACTION_DCS_CONSUME};
+                case 0x9c:                /* ST */
+                        return Transition{GROUND, ACTION_IGNORE};
+                }
+
+                return Transition{DCS_PASS, ACTION_DCS_CONSUME};
+        case DCS_PARAM:
+                switch (raw) {
+                case 0x00 ... 0x1a:        /* C0 \ { ESC } */
+                case 0x1c ... 0x1f:
+                        return Transition{state, ACTION_IGNORE};
+                case 0x1b:                /* ESC */
+                        return Transition{ESC, ACTION_CLEAR_INT};
+                case 0x20 ... 0x2f:        /* [' ' - '\'] */
+                        return Transition{DCS_INT, ACTION_COLLECT_CSI};
+                case 0x30 ... 0x39:        /* ['0' - '9'] */
+                        return Transition{state, ACTION_PARAM};
+                case 0x3a:                 /* ':' */
+                        return Transition{state, ACTION_FINISH_SUBPARAM};
+                case 0x3b:                 /* ';' */
+                        return Transition{state, ACTION_FINISH_PARAM};
+                case 0x3c ... 0x3f:        /* ['<' - '?'] */
+                        return Transition{DCS_IGNORE, ACTION_NOP};
+                case 0x40 ... 0x7e:        /* ['@' - '~'] */
+                        return Transition{DCS_PASS, ACTION_DCS_CONSUME};
+                case 0x9c:                /* ST */
+                        return Transition{GROUND, ACTION_IGNORE};
+                }
+
+                return Transition{DCS_PASS, ACTION_DCS_CONSUME};
+        case DCS_INT:
+                switch (raw) {
+                case 0x00 ... 0x1a:        /* C0 \ { ESC } */
+                case 0x1c ... 0x1f:
+                        return Transition{state, ACTION_IGNORE};
+                case 0x1b:                /* ESC */
+                        return Transition{ESC, ACTION_CLEAR_INT};
+                case 0x20 ... 0x2f:        /* [' ' - '\'] */
+                        return Transition{state, ACTION_COLLECT_CSI};
+                case 0x30 ... 0x3f:        /* ['0' - '?'] */
+                        return Transition{DCS_IGNORE, ACTION_NOP};
+                case 0x40 ... 0x7e:        /* ['@' - '~'] */
+                        return Transition{DCS_PASS, ACTION_DCS_CONSUME};
+                case 0x9c:                /* ST */
+                        return Transition{GROUND, ACTION_IGNORE};
+                }
+
+                return Transition{DCS_PASS, ACTION_DCS_CONSUME};
+        case DCS_PASS:
+                switch (raw) {
+                case 0x00 ... 0x1a:        /* ASCII \ { ESC } */
+                case 0x1c ... 0x7f:
+                        return Transition{state, ACTION_DCS_COLLECT};
+                case 0x1b:                /* ESC */
+                        return Transition{DCS_PASS_ESC, ACTION_NOP};
+                case 0x9c:                /* ST */
+                        return Transition{GROUND, ACTION_DCS_DISPATCH};
+                }
+
+                return Transition{state, ACTION_DCS_COLLECT};
+        case DCS_IGNORE:
+                switch (raw) {
+                case 0x00 ... 0x1a:        /* ASCII \ { ESC } */
+                case 0x1c ... 0x7f:
+                        return Transition{state, ACTION_NOP};
+                case 0x1b:                /* ESC */
+                        return Transition{ESC, ACTION_CLEAR_INT};
+                case 0x9c:                /* ST */
+                        return Transition{GROUND, ACTION_NOP};
+                }
+
+                return Transition{state, ACTION_NOP};
+        case OSC_STRING:
+                switch (raw) {
+                case 0x00 ... 0x06:        /* C0 \ { BEL, ESC } */
+                case 0x08 ... 0x1a:
+                case 0x1c ... 0x1f:
+                        return Transition{state, ACTION_NOP};
+                case 0x1b:                /* ESC */
+                        return Transition{OSC_STRING_ESC, ACTION_NOP};
+                case 0x20 ... 0x7f:        /* [' ' - DEL] */
+                        return Transition{state, ACTION_OSC_COLLECT};
+                case 0x07:                /* BEL */
+                case 0x9c:                /* ST */
+                        return Transition{GROUND, ACTION_OSC_DISPATCH};
+                }
+
+                return Transition{state, ACTION_OSC_COLLECT};
+        case ST_IGNORE:
+                switch (raw) {
+                case 0x00 ... 0x1a:        /* ASCII \ { ESC } */
+                case 0x1c ... 0x7f:
+                        return Transition{state, ACTION_NOP};
+                case 0x1b:                /* ESC */
+                        return Transition{ESC, ACTION_CLEAR_INT};
+                case 0x9c:                /* ST */
+                        return Transition{GROUND, ACTION_IGNORE};
+                }
+
+                return Transition{state, ACTION_NOP};
+        case SCI:
+                switch (raw) {
+                case 0x1b:                /* ESC */
+                        return Transition{ESC, ACTION_CLEAR_INT};
+                case 0x08 ... 0x0d:        /* BS, HT, LF, VT, FF, CR */
+                case 0x20 ... 0x7e:        /* [' ' - '~'] */
+                        return Transition{GROUND, ACTION_SCI_DISPATCH};
+                }
+
+                return Transition{GROUND, ACTION_IGNORE};
+        }
+
+        return Transition{GROUND, ACTION_IGNORE};
+}
+
+using TransitionTable = std::array<std::array<Transition, N_INPUTS>, N_STATES>;
+
+constexpr TransitionTable
+make_transition_table() noexcept
+{
+        auto table = TransitionTable{};
+        for (auto state = 0u; state < N_STATES; ++state)
+                for (auto raw = 0u; raw < N_INPUTS; ++raw)
+                        table[state][raw] = transition(state, raw);
+
+        return table;
+}
+
+inline constexpr auto const transition_table = make_transition_table();
+
 class Sequence;
 
 class Parser {
@@ -389,43 +793,22 @@ public:
         Parser& operator=(Parser const&) = delete;
         Parser& operator=(Parser&&) = delete;
 
+        [[gnu::always_inline]]
         inline int feed(uint32_t raw) noexcept
         {
-                /*
-                 * Notes:
-                 *  * DEC treats GR codes as GL. We don't do that as we require UTF-8
-                 *    as charset and, thus, it doesn't make sense to treat GR special.
-                 *  * During control sequences, unexpected C1 codes cancel the sequence
-                 *    and immediately start a new one. C0 codes, however, may or may not
-                 *    be ignored/executed depending on the sequence.
+                auto const t = transition_table[m_state][std::min(raw, uint32_t{N_INPUTS - 1})];
+
+                /* Only store the state when it changes, so that runs of
+                 * characters in the same state don't form a dependency
+                 * chain through m_state.
                  */
-                switch (raw) {
-                case 0x18:                /* CAN */
-                        return VTE_TRANSITION(raw, GROUND, action_ignore);
-                case 0x1a:                /* SUB */
-                        return VTE_TRANSITION(raw, GROUND, action_execute);
-                case 0x7f:                 /* DEL */
-                        return action_nop(raw);
-                case 0x80 ... 0x8f:        /* C1 \ {DCS, SOS, SCI, CSI, ST, OSC, PM, APC} */
-                case 0x91 ... 0x97:
-                case 0x99:
-                        return VTE_TRANSITION(raw, GROUND, action_execute);
-                case 0x98:                /* SOS */
-                case 0x9e:                /* PM */
-                case 0x9f:                /* APC */
-                        return VTE_TRANSITION_NO_ACTION(raw, ST_IGNORE);
-                        // FIXMEchpe shouldn't this use action_clear?
-                case 0x90:                /* DCS */
-                        return VTE_TRANSITION(raw, DCS_ENTRY, action_dcs_start);
-                case 0x9a:                /* SCI */
-                        return VTE_TRANSITION(raw, SCI, action_clear);
-                case 0x9d:                /* OSC */
-                        return VTE_TRANSITION(raw, OSC_STRING, action_osc_start);
-                case 0x9b:                /* CSI */
-                        return VTE_TRANSITION(raw, CSI_ENTRY, action_clear_int_and_params);
-                default: [[likely]]
-                        return feed_to_state(raw);
-                }
+                if (t.state != m_state)
+                        m_state = t.state;
+
+                if (t.action == ACTION_PRINT) [[likely]]
+                        return action_print(raw);
+
+                return perform(t.action, raw);
         }
 
         inline void reset() noexcept
@@ -433,6 +816,11 @@ public:
                 VTE_TRANSITION(0, GROUND, action_ignore);
         }
 
+        inline constexpr bool is_ground() const noexcept
+        {
+                return m_state == GROUND;
+        }
+
         /*
          * set_dispatch_unripe:
          *
@@ -496,299 +884,47 @@ protected:
         guint m_state{0};
         bool m_dispatch_unripe{false};
 
-        inline int feed_to_state(uint32_t raw) noexcept
-        {
-                switch (m_state) {
-                case GROUND: [[likely]]
-                        switch (raw) {
-                        case 0x00 ... 0x1a:        /* C0 \ { ESC } */
-                        case 0x1c ... 0x1f:
-                        case 0x80 ... 0x9f:        /* C1 */
-                                return action_execute(raw);
-                        case 0x1b:                /* ESC */
-                                return VTE_TRANSITION(raw, ESC, action_clear_int);
-                        default: [[likely]]
-                                return action_print(raw);
-                        }
-
-                case DCS_PASS_ESC:
-                case OSC_STRING_ESC:
-                        if (raw == 0x5c /* '\' */) {
-                                switch (m_state) {
-                                case DCS_PASS_ESC:
-                                        return VTE_TRANSITION(raw, GROUND, action_dcs_dispatch);
-                                case OSC_STRING_ESC:
-                                        return VTE_TRANSITION(raw, GROUND, action_osc_dispatch);
-                                }
-                        }
-
-                        /* Do the deferred clear and fallthrough to ESC */
-                        VTE_TRANSITION(0x1b /* ESC */, ESC, action_clear_int);
-
-                        [[fallthrough]];
-                case ESC:
-                        switch (raw) {
-                        case 0x00 ... 0x1a:        /* C0 \ { ESC } */
-                        case 0x1c ... 0x1f:
-                                return action_execute(raw);
-                        case 0x1b:                /* ESC */
-                                return VTE_TRANSITION(raw, ESC, action_clear_int);
-                        case 0x20 ... 0x2f:        /* [' ' - '\'] */
-                                return VTE_TRANSITION(raw, ESC_INT, action_collect_esc);
-                        case 0x30 ... 0x4f:        /* ['0' - '~'] \ */
-                        case 0x51 ... 0x57:        /* { 'P', 'X', 'Z' '[', ']', '^', '_' } */
-                        case 0x59:
-                        case 0x5c:
-                        case 0x60 ... 0x7e:
-                                return VTE_TRANSITION(raw, GROUND, action_esc_dispatch);
-                        case 0x50:                /* 'P' */
-                                return VTE_TRANSITION(raw, DCS_ENTRY, action_dcs_start);
-                        case 0x5a:                /* 'Z' */
-                                return VTE_TRANSITION(raw, SCI, action_clear);
-                        case 0x5b:                /* '[' */
-                                return VTE_TRANSITION(raw, CSI_ENTRY, action_clear_params
-                                                  /* rest already cleaned on ESC state entry */);
-                        case 0x5d:                /* ']' */
-                                return VTE_TRANSITION(raw, OSC_STRING, action_osc_start);
-                        case 0x58:                /* 'X' */
-                        case 0x5e:                /* '^' */
-                        case 0x5f:                /* '_' */
-                                return VTE_TRANSITION_NO_ACTION(raw, ST_IGNORE);
-                        case 0x9c:                /* ST */
-                                return VTE_TRANSITION(raw, GROUND, action_ignore);
-                        }
-
-                        return VTE_TRANSITION(raw, GROUND, action_ignore);
-                case ESC_INT:
-                        switch (raw) {
-                        case 0x00 ... 0x1a:        /* C0 \ { ESC } */
-                        case 0x1c ... 0x1f:
-                                return action_execute(raw);
-                        case 0x1b:                /* ESC */
-                                return VTE_TRANSITION(raw, ESC, action_clear_int);
-                        case 0x20 ... 0x2f:        /* [' ' - '\'] */
-                                return action_collect_esc(raw);
-                        case 0x30 ... 0x7e:        /* ['0' - '~'] */
-                                return VTE_TRANSITION(raw, GROUND, action_esc_dispatch);
-                        case 0x9c:                /* ST */
-                                return VTE_TRANSITION(raw, GROUND, action_ignore);
-                        }
-
-                        return VTE_TRANSITION(raw, GROUND, action_ignore);
-                case CSI_ENTRY:
-                        switch (raw) {
-                        case 0x00 ... 0x1a:        /* C0 \ { ESC } */
-                        case 0x1c ... 0x1f:
-                                return action_execute(raw);
-                        case 0x1b:                /* ESC */
-                                return VTE_TRANSITION(raw, ESC, action_clear_int);
-                        case 0x20 ... 0x2f:        /* [' ' - '\'] */
-                                return VTE_TRANSITION(raw, CSI_INT, action_collect_csi);
-                        case 0x30 ... 0x39:        /* ['0' - '9'] */
-                                return VTE_TRANSITION(raw, CSI_PARAM, action_param);
-                        case 0x3a:                 /* ':' */
-                                return VTE_TRANSITION(raw, CSI_PARAM, action_finish_subparam);
-                        case 0x3b:                 /* ';' */
-                                return VTE_TRANSITION(raw, CSI_PARAM, action_finish_param);
-                        case 0x3c ... 0x3f:        /* ['<' - '?'] */
-                                return VTE_TRANSITION(raw, CSI_PARAM, action_collect_parameter);
-                        case 0x40 ... 0x7e:        /* ['@' - '~'] */
-                                return VTE_TRANSITION(raw, GROUND, action_csi_dispatch);
-                        case 0x9c:                /* ST */
-                                return VTE_TRANSITION(raw, GROUND, action_ignore);
-                        }
-
-                        return VTE_TRANSITION_NO_ACTION(raw, CSI_IGNORE);
-                case CSI_PARAM:
-                        switch (raw) {
-                        case 0x00 ... 0x1a:        /* C0 \ { ESC } */
-                        case 0x1c ... 0x1f:
-                                return action_execute(raw);
-                        case 0x1b:                /* ESC */
-                                return VTE_TRANSITION(raw, ESC, action_clear_int);
-                        case 0x20 ... 0x2f:        /* [' ' - '\'] */
-                                return VTE_TRANSITION(raw, CSI_INT, action_collect_csi);
-                        case 0x30 ... 0x39:        /* ['0' - '9'] */
-                                return action_param(raw);
-                        case 0x3a:                 /* ':' */
-                                return action_finish_subparam(raw);
-                        case 0x3b:                 /* ';' */
-                                return action_finish_param(raw);
-                        case 0x3c ... 0x3f:        /* ['<' - '?'] */
-                                return VTE_TRANSITION_NO_ACTION(raw, CSI_IGNORE);
-                        case 0x40 ... 0x7e:        /* ['@' - '~'] */
-                                return VTE_TRANSITION(raw, GROUND, action_csi_dispatch);
-                        case 0x9c:                /* ST */
-                                return VTE_TRANSITION(raw, GROUND, action_ignore);
-                        }
-
-                        return VTE_TRANSITION_NO_ACTION(raw, CSI_IGNORE);
-                case CSI_INT:
-                        switch (raw) {
-                        case 0x00 ... 0x1a:        /* C0 \ { ESC } */
-                        case 0x1c ... 0x1f:
-                                return action_execute(raw);
-                        case 0x1b:                /* ESC */
-                                return VTE_TRANSITION(raw, ESC, action_clear_int);
-                        case 0x20 ... 0x2f:        /* [' ' - '\'] */
-                                return action_collect_csi(raw);
-                        case 0x30 ... 0x3f:        /* ['0' - '?'] */
-                                return VTE_TRANSITION_NO_ACTION(raw, CSI_IGNORE);
-                        case 0x40 ... 0x7e:        /* ['@' - '~'] */
-                                return VTE_TRANSITION(raw, GROUND, action_csi_dispatch);
-                        case 0x9c:                /* ST */
-                                return VTE_TRANSITION(raw, GROUND, action_ignore);
-                        }
-
-                        return VTE_TRANSITION_NO_ACTION(raw, CSI_IGNORE);
-                case CSI_IGNORE:
-                        switch (raw) {
-                        case 0x00 ... 0x1a:        /* C0 \ { ESC } */
-                        case 0x1c ... 0x1f:
-                                return action_execute(raw);
-                        case 0x1b:                /* ESC */
-                                return VTE_TRANSITION(raw, ESC, action_clear_int);
-                        case 0x20 ... 0x3f:        /* [' ' - '?'] */
-                                return action_nop(raw);
-                        case 0x40 ... 0x7e:        /* ['@' - '~'] */
-                                return VTE_TRANSITION_NO_ACTION(raw, GROUND);
-                        case 0x9c:                /* ST */
-                                return VTE_TRANSITION(raw, GROUND, action_ignore);
-                        }
-
-                        return action_nop(raw);
-                case DCS_ENTRY:
-                        switch (raw) {
-                        case 0x00 ... 0x1a:        /* C0 \ ESC */
-                        case 0x1c ... 0x1f:
-                                return action_ignore(raw);
-                        case 0x1b:                /* ESC */
-                                return VTE_TRANSITION(raw, ESC, action_clear_int);
-                        case 0x20 ... 0x2f:        /* [' ' - '\'] */
-                                return VTE_TRANSITION(raw, DCS_INT, action_collect_csi);
-                        case 0x30 ... 0x39:        /* ['0' - '9'] */
-                                return VTE_TRANSITION(raw, DCS_PARAM, action_param);
-                        case 0x3a:                 /* ':' */
-                                return VTE_TRANSITION(raw, DCS_PARAM, action_finish_subparam);
-                        case 0x3b:                 /* ';' */
-                                return VTE_TRANSITION(raw, DCS_PARAM, action_finish_param);
-                        case 0x3c ... 0x3f:        /* ['<' - '?'] */
-                                return VTE_TRANSITION(raw, DCS_PARAM, action_collect_parameter);
-                        case 0x40 ... 0x7e:        /* ['@' - '~'] */
-                                return VTE_TRANSITION(raw, DCS_PASS, action_dcs_consume);
-                        case 0x9c:                /* ST */
-                                return VTE_TRANSITION(raw, GROUND, action_ignore);
-                        }
-
-                        return VTE_TRANSITION(raw, DCS_PASS, action_dcs_consume);
-                case DCS_PARAM:
-                        switch (raw) {
-                        case 0x00 ... 0x1a:        /* C0 \ { ESC } */
-                        case 0x1c ... 0x1f:
-                                return action_ignore(raw);
-                        case 0x1b:                /* ESC */
-                                return VTE_TRANSITION(raw, ESC, action_clear_int);
-                        case 0x20 ... 0x2f:        /* [' ' - '\'] */
-                                return VTE_TRANSITION(raw, DCS_INT, action_collect_csi);
-                        case 0x30 ... 0x39:        /* ['0' - '9'] */
-                                return action_param(raw);
-                        case 0x3a:                 /* ':' */
-                                return action_finish_subparam(raw);
-                        case 0x3b:                 /* ';' */
-                                return action_finish_param(raw);
-                        case 0x3c ... 0x3f:        /* ['<' - '?'] */
-                                return VTE_TRANSITION_NO_ACTION(raw, DCS_IGNORE);
-                        case 0x40 ... 0x7e:        /* ['@' - '~'] */
-                                return VTE_TRANSITION(raw, DCS_PASS, action_dcs_consume);
-                        case 0x9c:                /* ST */
-                                return VTE_TRANSITION(raw, GROUND, action_ignore);
-                        }
-
-                        return VTE_TRANSITION(raw, DCS_PASS, action_dcs_consume);
-                case DCS_INT:
-                        switch (raw) {
-                        case 0x00 ... 0x1a:        /* C0 \ { ESC } */
-                        case 0x1c ... 0x1f:
-                                return action_ignore(raw);
-                        case 0x1b:                /* ESC */
-                                return VTE_TRANSITION(raw, ESC, action_clear_int);
-                        case 0x20 ... 0x2f:        /* [' ' - '\'] */
-                                return action_collect_csi(raw);
-                        case 0x30 ... 0x3f:        /* ['0' - '?'] */
-                                return VTE_TRANSITION_NO_ACTION(raw, DCS_IGNORE);
-                        case 0x40 ... 0x7e:        /* ['@' - '~'] */
-                                return VTE_TRANSITION(raw, DCS_PASS, action_dcs_consume);
-                        case 0x9c:                /* ST */
-                                return VTE_TRANSITION(raw, GROUND, action_ignore);
-                        }
-
-                        return VTE_TRANSITION(raw, DCS_PASS, action_dcs_consume);
-                case DCS_PASS:
-                        switch (raw) {
-                        case 0x00 ... 0x1a:        /* ASCII \ { ESC } */
-                        case 0x1c ... 0x7f:
-                                return action_dcs_collect(raw);
-                        case 0x1b:                /* ESC */
-                                return VTE_TRANSITION_NO_ACTION(raw, DCS_PASS_ESC);
-                        case 0x9c:                /* ST */
-                                return VTE_TRANSITION(raw, GROUND, action_dcs_dispatch);
-                        }
-
-                        return action_dcs_collect(raw);
-                case DCS_IGNORE:
-                        switch (raw) {
-                        case 0x00 ... 0x1a:        /* ASCII \ { ESC } */
-                        case 0x1c ... 0x7f:
-                                return action_nop(raw);
-                        case 0x1b:                /* ESC */
-                                return VTE_TRANSITION(raw, ESC, action_clear_int);
-                        case 0x9c:                /* ST */
-                                return VTE_TRANSITION_NO_ACTION(raw, GROUND);
-                        }
-
-                        return action_nop(raw);
-                case OSC_STRING:
-                        switch (raw) {
-                        case 0x00 ... 0x06:        /* C0 \ { BEL, ESC } */
-                        case 0x08 ... 0x1a:
-                        case 0x1c ... 0x1f:
-                                return action_nop(raw);
-                        case 0x1b:                /* ESC */
-                                return VTE_TRANSITION_NO_ACTION(raw, OSC_STRING_ESC);
-                        case 0x20 ... 0x7f:        /* [' ' - DEL] */
-                                return action_osc_collect(raw);
-                        case 0x07:                /* BEL */
-                        case 0x9c:                /* ST */
-                                return VTE_TRANSITION(raw, GROUND, action_osc_dispatch);
-                        }
-
-                        return action_osc_collect(raw);
-                case ST_IGNORE:
-                        switch (raw) {
-                        case 0x00 ... 0x1a:        /* ASCII \ { ESC } */
-                        case 0x1c ... 0x7f:
-                                return action_nop(raw);
-                        case 0x1b:                /* ESC */
-                                return VTE_TRANSITION(raw, ESC, action_clear_int);
-                        case 0x9c:                /* ST */
-                                return VTE_TRANSITION(raw, GROUND, action_ignore);
-                        }
-
-                        return action_nop(raw);
-                case SCI:
-                        switch (raw) {
-                        case 0x1b:                /* ESC */
-                                return VTE_TRANSITION(raw, ESC, action_clear_int);
-                        case 0x08 ... 0x0d:        /* BS, HT, LF, VT, FF, CR */
-                        case 0x20 ... 0x7e:        /* [' ' - '~'] */
-                                return VTE_TRANSITION(raw, GROUND, action_sci_dispatch);
-                        }
-
-                        return VTE_TRANSITION(raw, GROUND, action_ignore);
+        [[gnu::always_inline]]
+        inline int perform(unsigned int action,
+                           uint32_t raw) noexcept
+        {
+                switch (action) {
+                case ACTION_NOP:                  return action_nop(raw);
+                case ACTION_CLEAR:                return action_clear(raw);
+                case ACTION_CLEAR_INT:            return action_clear_int(raw);
+                case ACTION_CLEAR_PARAMS:         return action_clear_params(raw);
+                case ACTION_CLEAR_INT_AND_PARAMS: return action_clear_int_and_params(raw);
+                case ACTION_COLLECT_CSI:          return action_collect_csi(raw);
+                case ACTION_COLLECT_ESC:          return action_collect_esc(raw);
+                case ACTION_COLLECT_PARAMETER:    return action_collect_parameter(raw);
+                case ACTION_CSI_DISPATCH:         return action_csi_dispatch(raw);
+                case ACTION_DCS_COLLECT:          return action_dcs_collect(raw);
+                case ACTION_DCS_CONSUME:          return action_dcs_consume(raw);
+                case ACTION_DCS_DISPATCH:         return action_dcs_dispatch(raw);
+                case ACTION_DCS_START:            return action_dcs_start(raw);
+                case ACTION_ESC_DISPATCH:         return action_esc_dispatch(raw);
+                case ACTION_EXECUTE:              return action_execute(raw);
+                case ACTION_FINISH_PARAM:         return action_finish_param(raw);
+                case ACTION_FINISH_SUBPARAM:      return action_finish_subparam(raw);
+                case ACTION_IGNORE:               return action_ignore(raw);
+                case ACTION_OSC_COLLECT:          return action_osc_collect(raw);
+                case ACTION_OSC_DISPATCH:         return action_osc_dispatch(raw);
+                case ACTION_OSC_START:            return action_osc_start(raw);
+                case ACTION_PARAM:                return action_param(raw);
+                case ACTION_PRINT:                return action_print(raw);
+                case ACTION_SCI_DISPATCH:         return action_sci_dispatch(raw);
+                default:                          return perform_deferred_clear(action, raw);
                 }
+        }
 
-                g_assert_not_reached();
-                return VTE_SEQ_NONE;
+        [[gnu::noinline]]
+        int perform_deferred_clear(unsigned int action,
+                                   uint32_t raw) noexcept
+        {
+                g_assert(action & ACTION_FLAG_CLEAR_INT);
+
+                action_clear_int(0x1b /* ESC */);
+                return perform(action & ~ACTION_FLAG_CLEAR_INT, raw);
         }
 
         /*
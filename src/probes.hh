@@ -0,0 +1,46 @@
+/*
+ * Copyright © 2026 the VTE authors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*
+ * Static tracepoints.
+ *
+ * When built with -Dsdt=true, VTE_PROBE() places a USDT probe named
+ * vte:@name in the library; it compiles to a single nop and an ELF note,
+ * so it costs nothing until a tracer attaches to it. For example
+ *
+ *   bpftrace -e 'usdt:/usr/lib64/libvte-2.91.so:vte:process_incoming_end { @[tid] = hist(arg1); }'
+ *
+ * Use `readelf -n libvte-2.91.so` to list the available probes. The
+ * arguments must be integers or pointers.
+ *
+ * Otherwise VTE_PROBE() expands to nothing, and its arguments are not
+ * evaluated.
+ */
+
+#if WITH_SDT
+
+#include <sys/sdt.h>
+
+#define VTE_PROBE(name, ...) STAP_PROBEV(vte, name, __VA_ARGS__)
+
+#else
+
+#define VTE_PROBE(name, ...) do { } while (0)
+
+#endif /* WITH_SDT */
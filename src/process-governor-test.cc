@@ -0,0 +1,151 @@
+/*
+ * Copyright © 2026 the VTE authors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "process-governor.hh"
+
+using namespace vte::terminal;
+
+// Processes a full budget at 10 bytes/µs
+static void
+saturate(ProcessGovernor& g)
+{
+        g.record_process(g.budget() * 10, g.budget());
+}
+
+static void
+test_governor_default(void)
+{
+        auto g = ProcessGovernor{};
+
+        g_assert_true(g.mode() == ProcessGovernor::Mode::eFRAME);
+        g_assert_cmpuint(g.budget(), ==, ProcessGovernor::k_min_budget_bytes);
+}
+
+static void
+test_governor_budget(void)
+{
+        auto g = ProcessGovernor{};
+        g.set_frame_interval(16000);
+
+        // Nothing spent on painting yet
+        saturate(g);
+        g_assert_cmpint(g.process_time(), ==, 12000);
+        g_assert_cmpuint(g.budget(), ==, 120000);
+
+        // Painting cost is subtracted from the processing time
+        g.record_draw(4000);
+        g.record_process(1, 1);
+        g_assert_cmpint(g.process_time(), ==, 8000);
+        g_assert_cmpuint(g.budget(), ==, 80000);
+
+        // But never below the minimum
+        g.record_draw(100000);
+        g.record_draw(100000);
+        g.record_process(1, 1);
+        g_assert_cmpint(g.process_time(), ==, ProcessGovernor::k_min_process_time_us);
+
+        // Faster refresh rate, smaller budget
+        auto g2 = ProcessGovernor{};
+        g2.set_frame_interval(8000);
+        saturate(g2);
+        g_assert_cmpint(g2.process_time(), ==, 6000);
+        g_assert_cmpuint(g2.budget(), ==, 60000);
+}
+
+static void
+test_governor_jump(void)
+{
+        auto g = ProcessGovernor{};
+        g.set_frame_interval(16000);
+
+        for (auto i = 1u; i < ProcessGovernor::k_jump_enter_ticks; ++i) {
+                saturate(g);
+                g_assert_true(g.mode() == ProcessGovernor::Mode::eFRAME);
+        }
+
+        auto const frame_budget = g.budget();
+        saturate(g);
+        g_assert_true(g.mode() == ProcessGovernor::Mode::eJUMP);
+        g_assert_cmpuint(g.budget(), >, frame_budget);
+        g_assert_cmpint(g.process_time(), ==, ProcessGovernor::k_jump_frames * 16000);
+
+        // Stays in jump mode while saturated
+        saturate(g);
+        g_assert_true(g.mode() == ProcessGovernor::Mode::eJUMP);
+
+        // and drops back as soon as the input is caught up with
+        g.record_process(100, 10);
+        g_assert_true(g.mode() == ProcessGovernor::Mode::eFRAME);
+        g_assert_cmpuint(g.budget(), ==, frame_budget);
+
+        // An interrupted run of saturated ticks starts over
+        for (auto i = 1u; i < ProcessGovernor::k_jump_enter_ticks; ++i)
+                saturate(g);
+        g.record_process(100, 10);
+        saturate(g);
+        g_assert_true(g.mode() == ProcessGovernor::Mode::eFRAME);
+}
+
+static void
+test_governor_time_slice(void)
+{
+        auto g = ProcessGovernor{};
+        g.set_frame_interval(16000);
+        saturate(g);
+        g_assert_cmpint(g.process_time(), ==, 12000);
+
+        // Sharing the frame with other terminals
+        g.set_time_slice(3000);
+        g_assert_cmpint(g.process_time(), ==, 3000);
+        g_assert_cmpuint(g.budget(), ==, 30000);
+
+        // A larger slice does not extend the frame's own processing time
+        g.set_time_slice(100000);
+        g_assert_cmpint(g.process_time(), ==, 12000);
+
+        // There is always some progress
+        g.set_time_slice(0);
+        g_assert_cmpint(g.process_time(), ==, ProcessGovernor::k_min_time_slice_us);
+
+        // Nor can the slice be exceeded by jump scrolling
+        g.set_time_slice(3000);
+        for (auto i = 0u; i < ProcessGovernor::k_jump_enter_ticks; ++i)
+                saturate(g);
+        g_assert_true(g.mode() == ProcessGovernor::Mode::eJUMP);
+        g_assert_cmpint(g.process_time(), ==, 3000);
+
+        g.set_time_slice(-1);
+        g_assert_cmpint(g.process_time(), ==, ProcessGovernor::k_jump_frames * 16000);
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+        g_test_init(&argc, &argv, nullptr);
+
+        g_test_add_func("/vte/process-governor/default", test_governor_default);
+        g_test_add_func("/vte/process-governor/budget", test_governor_budget);
+        g_test_add_func("/vte/process-governor/jump", test_governor_jump);
+        g_test_add_func("/vte/process-governor/time-slice", test_governor_time_slice);
+
+        return g_test_run();
+}
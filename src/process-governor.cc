@@ -0,0 +1,139 @@
+/*
+ * Copyright © 2026 the VTE authors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "process-governor.hh"
+
+#include <algorithm>
+
+#include <glib.h>
+
+#include "debug.h"
+
+namespace vte::terminal {
+
+void
+ProcessGovernor::set_frame_interval(int64_t interval_us) noexcept
+{
+        if (interval_us <= 0 || interval_us == m_frame_interval_us)
+                return;
+
+        _vte_debug_print(VTE_DEBUG_TIMEOUT, "Governor: frame interval %" G_GINT64_FORMAT "µs\n",
+                         interval_us);
+
+        m_frame_interval_us = interval_us;
+        update_budget();
+}
+
+void
+ProcessGovernor::set_time_slice(int64_t slice_us) noexcept
+{
+        if (slice_us < 0)
+                slice_us = -1;
+        if (slice_us == m_time_slice_us)
+                return;
+
+        m_time_slice_us = slice_us;
+        update_budget();
+}
+
+void
+ProcessGovernor::record_draw(int64_t elapsed_us) noexcept
+{
+        if (elapsed_us < 0)
+                return;
+
+        m_draw_cost_us = m_draw_cost_us ? (3 * m_draw_cost_us + elapsed_us) / 4 : elapsed_us;
+}
+
+void
+ProcessGovernor::record_process(size_t bytes,
+                                int64_t elapsed_us) noexcept
+{
+        auto const saturated = bytes >= m_budget;
+
+        // Small amounts are dominated by fixed overhead and would
+        // make the throughput look much worse than it is
+        if (elapsed_us > 0 && (saturated || bytes >= k_min_budget_bytes)) {
+                auto const sample = double(bytes) / double(elapsed_us);
+                m_throughput = m_throughput > 0. ? (3. * m_throughput + sample) / 4. : sample;
+        }
+
+        if (saturated) {
+                if (++m_saturated_ticks >= k_jump_enter_ticks &&
+                    m_mode != Mode::eJUMP) {
+                        _vte_debug_print(VTE_DEBUG_TIMEOUT,
+                                         "Governor: input saturated for %u ticks, jump scrolling\n",
+                                         m_saturated_ticks);
+                        m_mode = Mode::eJUMP;
+                }
+        } else {
+                m_saturated_ticks = 0;
+                if (m_mode != Mode::eFRAME) {
+                        _vte_debug_print(VTE_DEBUG_TIMEOUT,
+                                         "Governor: input caught up, per-frame updates\n");
+                        m_mode = Mode::eFRAME;
+                }
+        }
+
+        update_budget();
+
+        _vte_debug_print(VTE_DEBUG_TIMEOUT,
+                         "Governor: processed %" G_GSIZE_FORMAT " bytes in %" G_GINT64_FORMAT "µs%s, "
+                         "throughput %.1f bytes/µs, draw %" G_GINT64_FORMAT "µs, "
+                         "next budget %" G_GSIZE_FORMAT " bytes in %" G_GINT64_FORMAT "µs\n",
+                         bytes, elapsed_us, saturated ? " (saturated)" : "",
+                         m_throughput, m_draw_cost_us,
+                         m_budget, process_time());
+}
+
+int64_t
+ProcessGovernor::process_time() const noexcept
+{
+        auto time = int64_t{0};
+        switch (m_mode) {
+        case Mode::eFRAME:
+                time = m_frame_interval_us - m_frame_interval_us / k_headroom_divisor - m_draw_cost_us;
+                break;
+        case Mode::eJUMP:
+                time = k_jump_frames * m_frame_interval_us - m_draw_cost_us;
+                break;
+        }
+
+        time = std::max(time, k_min_process_time_us);
+        if (m_time_slice_us >= 0)
+                time = std::min(time, std::max(m_time_slice_us, k_min_time_slice_us));
+
+        return time;
+}
+
+void
+ProcessGovernor::update_budget() noexcept
+{
+        if (m_throughput <= 0.) {
+                m_budget = k_min_budget_bytes;
+                return;
+        }
+
+        auto const budget = m_throughput * double(process_time());
+        m_budget = size_t(std::clamp(budget,
+                                     double(k_min_budget_bytes),
+                                     double(k_max_budget_bytes)));
+}
+
+} // namespace vte::terminal
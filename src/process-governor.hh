@@ -0,0 +1,113 @@
+/*
+ * Copyright © 2026 the VTE authors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vte::terminal {
+
+/*
+ * ProcessGovernor decides how much input the terminal may process per
+ * frame-clock tick.
+ *
+ * The time available for processing in a frame is the frame interval
+ * minus what painting the frame costs (as measured), minus some headroom
+ * for the rest of the toolkit. This is converted into a byte budget
+ * using the measured processing throughput.
+ *
+ * When the input keeps exceeding the budget for a number of consecutive
+ * frames, the governor switches to jump scrolling: it then budgets
+ * several frame intervals per tick, so that less time is spent painting
+ * intermediate states nobody can read anyway. As soon as a tick does not
+ * use up its budget (e.g. because the output became interactive), it
+ * switches back to per-frame updates.
+ *
+ * When several terminals share the frame, the scheduler hands each a
+ * time slice; the processing time is then limited to that slice.
+ */
+class ProcessGovernor {
+public:
+        enum class Mode {
+                eFRAME,
+                eJUMP,
+        };
+
+        // Budget while nothing has been measured yet; also the minimum
+        static constexpr auto const k_min_budget_bytes = size_t{0x1000};
+        static constexpr auto const k_max_budget_bytes = size_t{64 * 1024 * 1024};
+
+        // Fraction of the frame interval left for the toolkit
+        static constexpr auto const k_headroom_divisor = int64_t{4};
+        // Minimum processing time per tick, even if painting is slow
+        static constexpr auto const k_min_process_time_us = int64_t{2000};
+        // Consecutive saturated ticks before switching to jump scrolling
+        static constexpr auto const k_jump_enter_ticks = 6u;
+        // Frame intervals to budget per tick while jump scrolling
+        static constexpr auto const k_jump_frames = int64_t{8};
+        // Minimum processing time per tick when limited to a time slice
+        static constexpr auto const k_min_time_slice_us = int64_t{500};
+
+        constexpr ProcessGovernor() noexcept = default;
+        ~ProcessGovernor() = default;
+
+        ProcessGovernor(ProcessGovernor const&) = delete;
+        ProcessGovernor(ProcessGovernor&&) = delete;
+        ProcessGovernor& operator=(ProcessGovernor const&) = delete;
+        ProcessGovernor& operator=(ProcessGovernor&&) = delete;
+
+        // Sets the frame interval, in µs, of the frame clock driving the ticks
+        void set_frame_interval(int64_t interval_us) noexcept;
+
+        // Sets the time slice, in µs, of the next tick; or -1 for no limit
+        void set_time_slice(int64_t slice_us) noexcept;
+
+        // Records the time spent painting a frame
+        void record_draw(int64_t elapsed_us) noexcept;
+
+        // Records that @bytes were processed in @elapsed_us µs in this tick,
+        // out of a budget of budget(); and computes the budget for the next tick.
+        void record_process(size_t bytes,
+                            int64_t elapsed_us) noexcept;
+
+        // Returns: the number of bytes that may be read for the next tick
+        inline constexpr size_t budget() const noexcept { return m_budget; }
+
+        inline constexpr Mode mode() const noexcept { return m_mode; }
+
+        inline constexpr int64_t frame_interval() const noexcept { return m_frame_interval_us; }
+        inline constexpr int64_t draw_cost() const noexcept { return m_draw_cost_us; }
+        inline constexpr int64_t time_slice() const noexcept { return m_time_slice_us; }
+
+        // Returns: the time budgeted for processing per tick, in µs
+        int64_t process_time() const noexcept;
+
+private:
+        Mode m_mode{Mode::eFRAME};
+        int64_t m_frame_interval_us{16667};
+        int64_t m_draw_cost_us{0};
+        int64_t m_time_slice_us{-1};
+        double m_throughput{0.}; // bytes per µs
+        size_t m_budget{k_min_budget_bytes};
+        unsigned m_saturated_ticks{0};
+
+        void update_budget() noexcept;
+
+}; // class ProcessGovernor
+
+} // namespace vte::terminal
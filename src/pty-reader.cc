@@ -0,0 +1,346 @@
+/*
+ * Copyright © 2026 the VTE authors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "pty-reader.hh"
+
+#include <cerrno>
+#include <system_error>
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib-unix.h>
+
+#include "debug.h"
+#include "glib-glue.hh"
+#include "probes.hh"
+
+namespace vte::base {
+
+static bool
+open_pipe(vte::libc::FD (&pipe)[2]) noexcept
+{
+        int fds[2];
+        auto error = vte::glib::Error{};
+        if (!g_unix_open_pipe(fds, FD_CLOEXEC, error))
+                return false;
+
+        pipe[0] = fds[0];
+        pipe[1] = fds[1];
+
+        return g_unix_set_fd_nonblocking(fds[0], true, nullptr) &&
+                g_unix_set_fd_nonblocking(fds[1], true, nullptr);
+}
+
+static void
+notify_pipe(vte::libc::FD const& fd) noexcept
+{
+        auto const c = char{0};
+        ssize_t r;
+        do {
+                r = write(fd.get(), &c, 1);
+        } while (r == -1 && errno == EINTR);
+        // EAGAIN means the pipe is full, which is just as good
+}
+
+static void
+drain_pipe(vte::libc::FD const& fd) noexcept
+{
+        char buf[64];
+        ssize_t r;
+        do {
+                r = read(fd.get(), buf, sizeof(buf));
+        } while (r == sizeof(buf) || (r == -1 && errno == EINTR));
+}
+
+PtyReader::~PtyReader()
+{
+        stop();
+
+        // Main thread, so these can go back into the global free list
+        while (pop()) {
+        }
+
+        Chunk* chunk{nullptr};
+        while (m_spare.pop(chunk))
+                delete chunk;
+}
+
+bool
+PtyReader::start() noexcept
+try
+{
+        if (m_thread.joinable())
+                return true;
+
+        if (!open_pipe(m_wakeup_pipe) ||
+            !open_pipe(m_control_pipe))
+                return false;
+
+        replenish();
+
+        m_stop.store(false, std::memory_order_relaxed);
+        m_thread = std::thread{&PtyReader::run, this};
+
+        _vte_debug_print(VTE_DEBUG_IO, "Started PTY reader thread for fd %d\n", m_fd);
+        return true;
+}
+catch (std::system_error const& e)
+{
+        _vte_debug_print(VTE_DEBUG_IO, "Failed to start PTY reader thread: %s\n", e.what());
+        return false;
+}
+
+void
+PtyReader::stop() noexcept
+{
+        if (!m_thread.joinable())
+                return;
+
+        m_stop.store(true, std::memory_order_release);
+        notify_pipe(m_control_pipe[1]);
+        m_thread.join();
+
+        _vte_debug_print(VTE_DEBUG_IO, "Stopped PTY reader thread for fd %d\n", m_fd);
+}
+
+void
+PtyReader::acknowledge_wakeup() noexcept
+{
+        drain_pipe(m_wakeup_pipe[0]);
+
+        // Re-arm before looking at the queue; pairs with the
+        // fence in publish(), so that either we see the new chunk,
+        // or the reader thread sees the armed flag and wakes us.
+        m_wakeup_armed.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+Chunk::unique_type
+PtyReader::pop() noexcept
+{
+        Chunk* chunk{nullptr};
+        if (!m_queue.pop(chunk))
+                return {};
+
+        // Pairs with the fence in run() before the reader thread
+        // re-checks whether the queue is still full.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_blocked.exchange(false, std::memory_order_relaxed))
+                notify_pipe(m_control_pipe[1]);
+
+        return Chunk::unique_type{chunk};
+}
+
+void
+PtyReader::replenish() noexcept
+{
+        while (!m_spare.full()) {
+                auto chunk = Chunk::get(nullptr).release();
+                if (!m_spare.push(chunk)) {
+                        delete chunk;
+                        break;
+                }
+        }
+}
+
+Chunk*
+PtyReader::take_spare() noexcept
+{
+        Chunk* chunk{nullptr};
+        if (!m_spare.pop(chunk))
+                chunk = new Chunk();
+
+        return chunk;
+}
+
+void
+PtyReader::wakeup() noexcept
+{
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_wakeup_armed.exchange(false, std::memory_order_relaxed))
+                notify_pipe(m_wakeup_pipe[1]);
+}
+
+void
+PtyReader::publish(Chunk* chunk) noexcept
+{
+        // Cannot fail, since run() only reads when the queue isn't full
+        m_queue.push(chunk);
+        wakeup();
+}
+
+// Returns: the revents of the PTY fd
+short
+PtyReader::wait(bool pty) noexcept
+{
+        struct pollfd fds[2] = {
+                { m_control_pipe[0].get(), POLLIN, 0 },
+                { m_fd, POLLIN | POLLPRI, 0 },
+        };
+
+        int r;
+        do {
+                r = poll(fds, pty ? 2 : 1, -1);
+        } while (r == -1 && errno == EINTR);
+        if (r == -1)
+                return pty ? POLLERR : 0;
+
+        if (fds[0].revents & POLLIN)
+                drain_pipe(m_control_pipe[0]);
+
+        return pty ? fds[1].revents : 0;
+}
+
+void
+PtyReader::run() noexcept
+{
+        auto chunk = take_spare();
+        auto eos = false;
+
+        while (!eos && !m_stop.load(std::memory_order_acquire)) {
+                if (m_queue.full()) {
+                        // The main thread has fallen behind; stop reading
+                        // until it has caught up. Not reading is what makes
+                        // the kernel apply backpressure to the child.
+                        m_blocked.store(true, std::memory_order_relaxed);
+                        std::atomic_thread_fence(std::memory_order_seq_cst);
+                        if (m_queue.full())
+                                wait(false);
+                        else
+                                m_blocked.store(false, std::memory_order_relaxed);
+                        continue;
+                }
+
+                auto const revents = wait(true);
+                if (revents == 0)
+                        continue;
+
+                // See the comment in Terminal::pty_io_read() about G_IO_HUP
+                // without G_IO_IN.
+                if (revents == POLLHUP ||
+                    (revents & POLLNVAL)) {
+                        eos = true;
+                } else if (revents & (POLLIN | POLLPRI)) {
+                        auto err = int{0};
+
+                        // Keep reading into this chunk while data is immediately
+                        // available and the chunk is at most ¾ full, so that a fast
+                        // writer doesn't produce lots of tiny chunks.
+                        do {
+                                auto const bp = chunk->begin_writing();
+                                auto const rem = chunk->capacity_writing();
+                                ssize_t ret;
+
+#if defined(TIOCPKT)
+                                /* Due to TIOCPKT mode, there's an extra input byte
+                                 * returned at the beginning; see Terminal::pty_io_read().
+                                 */
+                                auto const save = bp[-1];
+                                errno = 0;
+                                do {
+                                        ret = read(m_fd, bp - 1, rem + 1);
+                                } while (ret == -1 && errno == EINTR);
+                                auto const pkt_header = bp[-1];
+                                bp[-1] = save;
+#else /* !TIOCPKT */
+                                do {
+                                        ret = read(m_fd, bp, rem);
+                                } while (ret == -1 && errno == EINTR);
+#endif /* TIOCPKT */
+
+                                if (ret == -1) {
+                                        err = errno;
+                                        break;
+                                }
+                                if (ret == 0) {
+                                        eos = true;
+                                        break;
+                                }
+
+#if defined(TIOCPKT)
+                                ret--;
+
+                                if (pkt_header == TIOCPKT_DATA) {
+                                        chunk->add_size(ret);
+                                } else {
+                                        auto events = 0u;
+                                        if (pkt_header & TIOCPKT_IOCTL)
+                                                events |= eTERMIOS_CHANGED;
+                                        if (pkt_header & TIOCPKT_STOP)
+                                                events |= eSCROLL_LOCKED;
+                                        if (pkt_header & TIOCPKT_START)
+                                                events |= eSCROLL_UNLOCKED;
+                                        if (events) {
+                                                m_events.fetch_or(events, std::memory_order_release);
+                                                wakeup();
+                                        }
+                                }
+#else
+                                chunk->add_size(ret);
+#endif
+                        } while (chunk->capacity_writing() >= chunk->capacity() / 4);
+
+                        switch (err) {
+                        case 0:
+                        case EAGAIN:
+                        case EBUSY:
+                                break;
+                        case EIO: /* EOS */
+                                eos = true;
+                                break;
+                        default:
+                                _vte_debug_print(VTE_DEBUG_IO, "Error reading from child: %s\n",
+                                                 g_strerror(err));
+                                break;
+                        }
+                }
+
+                if (!eos && (revents & POLLERR))
+                        eos = true;
+
+                if (eos)
+                        break;
+
+                if (chunk->has_reading()) {
+                        VTE_PROBE(pty_reader_read, this, m_fd, chunk->size_reading());
+
+                        auto next = take_spare();
+                        next->chain(chunk);
+                        publish(chunk);
+                        chunk = next;
+                }
+        }
+
+        if (eos) {
+                _vte_debug_print(VTE_DEBUG_IO, "PTY reader thread got EOF\n");
+
+                // Same as Terminal::pty_io_read(), hand the EOS over in the
+                // last chunk, together with any data it may still contain.
+                chunk->set_sealed();
+                chunk->set_eos();
+                m_eos.store(true, std::memory_order_release);
+                publish(chunk);
+        } else {
+                delete chunk;
+        }
+}
+
+} // namespace vte::base
@@ -0,0 +1,142 @@
+/*
+ * Copyright © 2026 the VTE authors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+#include <sys/ioctl.h>
+
+#include "chunk.hh"
+#include "libc-glue.hh"
+#include "spsc-queue.hh"
+
+namespace vte::base {
+
+class PtyReader {
+        // A PtyReader reads the PTY on a dedicated thread into Chunks,
+        // and hands them over to the main thread through a lock-free
+        // queue, so that a slow main loop does not stall the child
+        // on a full kernel buffer.
+        //
+        // The main thread polls wakeup_fd(), which is only made
+        // readable when there is something new to collect, and then
+        // calls acknowledge_wakeup(), take_events() and pop() until
+        // it returns nullptr, followed by replenish().
+        //
+        // Chunks are recycled: the main thread hands spare chunks back
+        // to the reader thread in replenish(), so that the steady state
+        // does not allocate.
+        //
+public:
+        // Out-of-band PTY events (from the TIOCPKT header) which
+        // need to be handled on the main thread
+        enum Event : unsigned {
+                eTERMIOS_CHANGED = 1u << 0,
+                eSCROLL_LOCKED   = 1u << 1,
+                eSCROLL_UNLOCKED = 1u << 2,
+        };
+
+        // Note that the reader does not own @fd; it must be stop()ped
+        // before the fd is closed.
+        explicit PtyReader(int fd) noexcept
+                : m_fd{fd}
+        {
+        }
+
+        ~PtyReader();
+
+        PtyReader(PtyReader const&) = delete;
+        PtyReader(PtyReader&&) = delete;
+        PtyReader& operator=(PtyReader const&) = delete;
+        PtyReader& operator=(PtyReader&&) = delete;
+
+        // Starts the reader thread.
+        // Returns: %true on success, %false if the thread could not be started
+        bool start() noexcept;
+
+        // Stops the reader thread, and waits for it to exit. Chunks that
+        // were already read are still available from pop() afterwards.
+        void stop() noexcept;
+
+        // Returns: the file descriptor the main thread polls for G_IO_IN
+        inline constexpr int wakeup_fd() const noexcept { return m_wakeup_pipe[0].get(); }
+
+        // Main thread only. Must be called when wakeup_fd() polled
+        // readable, and before collecting events and chunks.
+        void acknowledge_wakeup() noexcept;
+
+        // Main thread only.
+        // Returns: the Event flags that occurred since the last call
+        inline unsigned take_events() noexcept
+        {
+                return m_events.exchange(0, std::memory_order_acq_rel);
+        }
+
+        // Main thread only.
+        // Returns: the next chunk read, or nullptr if there is none (yet)
+        Chunk::unique_type pop() noexcept;
+
+        // Main thread only. Hands recycled chunks to the reader thread.
+        void replenish() noexcept;
+
+        // Returns: whether the reader thread has seen EOS on the PTY
+        inline bool eos() const noexcept { return m_eos.load(std::memory_order_acquire); }
+
+        // Returns: whether the PTY can be read by a PtyReader. This is
+        // not the case for STREAMS PTYs without TIOCPKT.
+        static inline constexpr bool is_supported() noexcept
+        {
+#if !defined(TIOCPKT) && defined(__sun) && defined(HAVE_STROPTS_H)
+                return false;
+#else
+                return true;
+#endif
+        }
+
+private:
+        // Up to 256 × 8k chunks in flight before the reader thread
+        // stops reading and lets the PTY apply backpressure to the child
+        static constexpr auto const k_queue_size = std::size_t{256};
+        static constexpr auto const k_spare_size = std::size_t{32};
+
+        int m_fd{-1};
+        vte::libc::FD m_wakeup_pipe[2]{};
+        vte::libc::FD m_control_pipe[2]{};
+        std::thread m_thread{};
+
+        std::atomic<bool> m_stop{false};
+        std::atomic<bool> m_eos{false};
+        std::atomic<bool> m_wakeup_armed{true};
+        std::atomic<bool> m_blocked{false};
+        std::atomic<unsigned> m_events{0};
+
+        // Filled chunks, reader thread to main thread
+        SPSCQueue<Chunk*, k_queue_size> m_queue{};
+        // Spare chunks, main thread to reader thread
+        SPSCQueue<Chunk*, k_spare_size> m_spare{};
+
+        void run() noexcept;
+        short wait(bool pty) noexcept;
+        Chunk* take_spare() noexcept;
+        void publish(Chunk* chunk) noexcept;
+        void wakeup() noexcept;
+
+}; // class PtyReader
+
+} // namespace vte::base
@@ -0,0 +1,653 @@
+/*
+ * Copyright © 2026 the VTE authors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <glib.h>
+
+#include "glib-glue.hh"
+#include "refptr.hh"
+#include "ring.hh"
+
+using namespace std::literals;
+using vte::base::Ring;
+
+/*
+ * Writer:
+ *
+ * Lays plain text out in a Ring the way Terminal writes it with autowrap,
+ * keeping a cursor that rewrap() moves along. Wide characters are those
+ * g_unichar_iswide() says are, and combining ones must follow another on
+ * their row.
+ */
+class Writer {
+public:
+        Writer(Ring::column_t columns,
+               Ring::row_t rows,
+               Ring::row_t max_rows) :
+                m_column_count{columns},
+                m_ring{max_rows, true}
+        {
+                m_ring.set_visible_rows(rows);
+                m_ring.append(0);
+        }
+
+        void write(std::string_view const& str,
+                   VteCellAttr const& attr = basic_cell.attr)
+        {
+                auto row = m_ring.index_writable(m_ring.next() - 1);
+                for (auto p = str.data(); p < str.data() + str.size(); p = g_utf8_next_char(p)) {
+                        auto const c = g_utf8_get_char(p);
+                        if (g_unichar_iszerowidth(c)) {
+                                g_assert_cmpint(m_column, >, 0);
+                                auto col = m_column - 1;
+                                while (_vte_row_data_get(row, col)->attr.fragment())
+                                        --col;
+                                auto const cell = _vte_row_data_get_writable(row, col);
+                                auto const combined = _vte_unistr_append_unichar(cell->c, c);
+                                for (auto i = 0u; i < cell->attr.columns(); ++i)
+                                        _vte_row_data_get_writable(row, col + i)->c = combined;
+                                continue;
+                        }
+
+                        auto const columns = g_unichar_iswide(c) ? 2 : 1;
+                        if (m_column + columns > m_column_count) {
+                                row->attr.soft_wrapped = true;
+                                row = m_ring.append(0);
+                                m_column = 0;
+                        }
+
+                        auto cell = VteCell{c, attr};
+                        cell.attr.set_columns(columns);
+                        for (auto i = 0; i < columns; ++i) {
+                                _vte_row_data_append(row, &cell);
+                                cell.attr.set_fragment(true);
+                        }
+                        m_column += columns;
+                }
+        }
+
+        void newline()
+        {
+                m_ring.append(0);
+                m_column = 0;
+        }
+
+        /* Rewraps the ring to @columns, as Terminal does on resize */
+        void rewrap(Ring::column_t columns)
+        {
+                auto cursor = VteVisualPosition{long(m_ring.next()) - 1, m_column};
+                VteVisualPosition* markers[] = {&cursor, nullptr};
+                m_ring.rewrap(columns, markers);
+                g_assert_cmpint(cursor.row, ==, long(m_ring.next()) - 1);
+
+                m_column_count = columns;
+                m_column = cursor.col;
+        }
+
+        inline Ring& ring() noexcept { return m_ring; }
+        inline auto column_count() const noexcept { return m_column_count; }
+
+private:
+        Ring::column_t m_column_count;
+        Ring::column_t m_column{0};
+        Ring m_ring;
+};
+
+/* The text of the rows from @start to @end, each one followed by a newline,
+ * or by a backslash and a newline if it's soft wrapped. */
+static std::string
+rows_text(Ring& ring,
+          Ring::row_t start,
+          Ring::row_t end)
+{
+        auto str = std::string{};
+        auto gstr = vte::take_freeable(g_string_new(nullptr));
+
+        for (auto i = start; i < end; ++i) {
+                g_assert_true(ring.contains(i));
+                auto const row = ring.index(i);
+                auto const len = _vte_row_data_nonempty_length(row);
+
+                g_string_truncate(gstr.get(), 0);
+                for (auto col = 0u; col < len; ++col) {
+                        auto const cell = _vte_row_data_get(row, col);
+                        if (cell->attr.fragment())
+                                continue;
+                        if (cell->c == 0)
+                                g_string_append_c(gstr.get(), ' ');
+                        else
+                                _vte_unistr_append_to_string(cell->c, gstr.get());
+                }
+
+                str.append(gstr->str, gstr->len);
+                str.append(row->attr.soft_wrapped ? "\\\n" : "\n");
+        }
+
+        return str;
+}
+
+/* Asserts that the last @rows rows of @ring read the same as those of
+ * @reference, attributes included, or all of them if @rows is 0. */
+static void
+assert_rows(Ring& ring,
+            Ring& reference,
+            Ring::row_t rows = 0)
+{
+        if (rows == 0) {
+                g_assert_cmpuint(ring.length(), ==, reference.length());
+                rows = ring.length();
+        }
+
+        auto const text = rows_text(ring, ring.next() - rows, ring.next());
+        auto const expected = rows_text(reference, reference.next() - rows, reference.next());
+        g_assert_cmpstr(text.c_str(), ==, expected.c_str());
+
+        for (auto i = Ring::row_t{1}; i <= rows; ++i) {
+                // index() reuses its row for the next frozen one it reads
+                auto const row = ring.index(ring.next() - i);
+                auto const len = row->len;
+                auto const cells = std::vector<VteCell>{row->cells, row->cells + len};
+                auto const reference_row = reference.index(reference.next() - i);
+                g_assert_cmpuint(reference_row->len, ==, len);
+                for (auto col = 0u; col < len; ++col)
+                        g_assert_cmpint(memcmp(&cells[col].attr, &reference_row->cells[col].attr,
+                                               sizeof(cells[col].attr)), ==, 0);
+        }
+}
+
+static VteCellAttr
+colored(int color,
+        bool bold = false)
+{
+        auto attr = basic_cell.attr;
+        attr.set_fore(VTE_LEGACY_COLORS_OFFSET + color);
+        attr.set_bold(bold);
+        return attr;
+}
+
+/* Lines of the same length, so that the writable rows keep their size */
+static void
+write_quota_line(Writer& writer,
+                 int i)
+{
+        writer.write(std::to_string(1000000 + i));
+        writer.write("xyz"sv, colored(i % 8));
+        writer.newline();
+}
+
+static void
+test_ring_quota(void)
+{
+        auto writer = Writer{20, 5, 100000};
+        auto reference = Writer{20, 5, 100000};
+        auto& ring = writer.ring();
+        auto const quota = size_t{64 * 1024};
+        ring.set_max_bytes(quota);
+
+        // Writing past the quota discards the oldest rows, just enough of them
+        for (auto i = 0; i < 5000; ++i) {
+                write_quota_line(writer, i);
+                write_quota_line(reference, i);
+                g_assert_cmpuint(ring.scrollback_bytes(), <=, quota);
+        }
+        g_assert_cmpuint(ring.scrollback_bytes(), >, quota - 1024);
+        g_assert_cmpuint(ring.length(), <, reference.ring().length());
+        assert_rows(ring, reference.ring(), ring.length());
+
+        // Lowering the quota discards right away
+        auto length = ring.length();
+        ring.set_max_bytes(quota / 4);
+        g_assert_cmpuint(ring.scrollback_bytes(), <=, quota / 4);
+        g_assert_cmpuint(ring.scrollback_bytes(), >, quota / 4 - 1024);
+        g_assert_cmpuint(ring.length(), <, length);
+        assert_rows(ring, reference.ring(), ring.length());
+
+        // But never the writable rows, which include the screen
+        ring.set_max_bytes(1);
+        g_assert_cmpuint(ring.length(), >, 5);
+        g_assert_cmpuint(ring.scrollback_bytes(), >, 1);
+        assert_rows(ring, reference.ring(), ring.length());
+
+        // 0 is no quota
+        ring.set_max_bytes(0);
+        length = ring.length();
+        for (auto i = 5000; i < 6000; ++i) {
+                write_quota_line(writer, i);
+                write_quota_line(reference, i);
+        }
+        g_assert_cmpuint(ring.length(), ==, length + 1000);
+        assert_rows(ring, reference.ring(), ring.length());
+}
+
+static void
+write_history_line(Writer& writer,
+                   int i)
+{
+        writer.write(std::to_string(i) + ':');
+        for (auto j = 0; j < i % 13; ++j)
+                writer.write(i % 3 ? "abc"sv : "\xc3\xa4\xe4\xb8\xad"sv);
+        writer.newline();
+}
+
+static void
+test_ring_rewrap_lazy(void)
+{
+        // Enough history for the rows above the screen to be rewrapped lazily
+        auto writer = Writer{20, 5, 100000};
+        for (auto i = 0; i < 6000; ++i)
+                write_history_line(writer, i);
+        auto& ring = writer.ring();
+
+        // Compares with the same lines written at the current width
+        auto const reference = [&](int lines) {
+                auto ref = std::make_unique<Writer>(writer.column_count(), 5, 100000);
+                for (auto i = 0; i < lines; ++i)
+                        write_history_line(*ref, i);
+                return ref;
+        };
+
+        // The screen is rewrapped right away, the rows above are left for later
+        writer.rewrap(7);
+        g_assert_true(ring.rewrap_pending());
+        g_assert_cmpuint(ring.rewrapped_start(), >, ring.delta());
+        g_assert_cmpuint(ring.rewrapped_start(), <, ring.next() - 5);
+        assert_rows(ring, reference(6000)->ring(), ring.next() - ring.rewrapped_start());
+
+        // Lines written meanwhile go below the rows that aren't rewrapped yet,
+        // and the second resize carries on from the first one
+        for (auto i = 6000; i < 6100; ++i)
+                write_history_line(writer, i);
+        writer.rewrap(33);
+        g_assert_true(ring.rewrap_pending());
+        for (auto i = 6100; i < 6110; ++i)
+                write_history_line(writer, i);
+        ring.finish_rewrap();
+        g_assert_false(ring.rewrap_pending());
+        assert_rows(ring, reference(6110)->ring());
+
+        // Rewrapping a bit at a time gets there as well
+        writer.rewrap(12);
+        auto slices = 0;
+        while (ring.rewrap_some(1000))
+                ++slices;
+        g_assert_cmpint(slices, >, 0);
+        g_assert_false(ring.rewrap_pending());
+        assert_rows(ring, reference(6110)->ring());
+
+        // Without much history, everything is rewrapped right away
+        auto small = Writer{20, 5, 1000};
+        for (auto i = 0; i < 50; ++i)
+                write_history_line(small, i);
+        small.rewrap(9);
+        g_assert_false(small.ring().rewrap_pending());
+        auto small_reference = Writer{9, 5, 1000};
+        for (auto i = 0; i < 50; ++i)
+                write_history_line(small_reference, i);
+        assert_rows(small.ring(), small_reference.ring());
+}
+
+static void
+test_ring_rewrap_discard(void)
+{
+        auto writer = Writer{20, 5, 100000};
+        auto original = Writer{20, 5, 100000};
+        for (auto i = 0; i < 6000; ++i) {
+                write_history_line(writer, i);
+                write_history_line(original, i);
+        }
+        auto& ring = writer.ring();
+
+        writer.rewrap(7);
+        g_assert_true(ring.rewrap_pending());
+        auto const delta = ring.delta();
+
+        // Discard about half of the rows not rewrapped yet
+        auto const quota = ring.scrollback_bytes() / 2;
+        ring.set_max_bytes(quota);
+        g_assert_true(ring.rewrap_pending());
+        auto const discarded = ring.delta() - delta;
+        g_assert_cmpuint(discarded, >, 0);
+
+        // These are still the rows at the old width, find the first line
+        // that begins in the ones kept
+        auto& original_ring = original.ring();
+        auto row = original_ring.delta() + discarded;
+        while (original_ring.is_soft_wrapped(row - 1))
+                ++row;
+        auto const first_line = std::stoi(rows_text(original_ring, row, row + 1));
+
+        // Once rewrapped, the ones discarded don't come back, not even all of
+        // the line before
+        ring.finish_rewrap();
+        g_assert_cmpuint(ring.scrollback_bytes(), <=, quota);
+        auto tail = Writer{7, 5, 100000};
+        for (auto i = first_line - 1; i < 6000; ++i)
+                write_history_line(tail, i);
+        g_assert_cmpuint(ring.length(), <, tail.ring().length());
+        assert_rows(ring, tail.ring(), ring.length());
+}
+
+static void
+test_ring_rewrap_parallel(void)
+{
+        // Enough rows to be rewrapped on several threads, even on a machine
+        // with fewer processors
+        Ring::set_rewrap_threads(4);
+        auto const write = [](Writer& writer) {
+                for (auto i = 0; i < 20000; ++i) {
+                        writer.write(std::to_string(i) + ':');
+                        for (auto j = 0; j < i % 11; ++j) {
+                                if (i % 4)
+                                        writer.write("xyz"sv, colored(i % 8, true));
+                                else
+                                        writer.write("\xe4\xb8\xad\xc3\xa4"sv);
+                        }
+                        writer.newline();
+                }
+        };
+
+        auto writer = Writer{20, 5, 200000};
+        write(writer);
+        auto& ring = writer.ring();
+
+        for (auto const columns : {7, 33, 12}) {
+                writer.rewrap(columns);
+                ring.finish_rewrap();
+
+                auto reference = Writer{columns, 5, 200000};
+                write(reference);
+                assert_rows(ring, reference.ring());
+        }
+        Ring::set_rewrap_threads(0);
+}
+
+static void
+test_ring_thaw(void)
+{
+        auto const write = [](Writer& writer) {
+                for (auto i = 0; i < 40; ++i) {
+                        writer.write(std::to_string(i), colored(i % 8));
+                        writer.write(i % 3 ? "e\xcc\x81"sv : "\xe4\xb8\xad"sv, colored(i % 8, true));
+                        writer.write(":" + std::string(i % 15, 'x'));
+                        writer.newline();
+                }
+        };
+
+        auto writer = Writer{10, 5, 1000};
+        write(writer);
+        auto& ring = writer.ring();
+        auto reference = Writer{12, 5, 1000};
+        write(reference);
+
+        // Rewrapping freezes all the rows; thawing them all at once, as growing
+        // the screen does, brings them back with their cells as they were
+        writer.rewrap(12);
+        auto const thawed = ring.rows_thawed();
+        auto const first = ring.delta();
+        ring.index_writable(first);
+        g_assert_cmpuint(ring.rows_thawed() - thawed, ==, ring.next() - first);
+        assert_rows(ring, reference.ring());
+
+        // Once frozen again, the rows read back the same
+        writer.rewrap(12);
+        assert_rows(ring, reference.ring());
+}
+
+static void
+test_ring_cached_rows(void)
+{
+        auto writer = Writer{10, 10, 1000};
+        for (auto i = 0; i < 200; ++i) {
+                writer.write("row " + std::to_string(i));
+                writer.newline();
+        }
+        auto& ring = writer.ring();
+
+        // Two screenfuls of scrollback are thawed once, however often they're read
+        auto const top = ring.next() - 50;
+        auto const text = rows_text(ring, top, top + 20);
+        auto const bytes_read = ring.stream_bytes_read();
+        auto const row = ring.index(top);
+        g_assert_true(rows_text(ring, top, top + 20) == text);
+        g_assert_cmpuint(ring.stream_bytes_read(), ==, bytes_read);
+        g_assert_true(ring.index(top) == row);
+        auto const first_line = "row " + std::to_string(top) + '\n';
+        g_assert_true(text.starts_with(first_line));
+
+        // A row thawed for writing is dropped from the cache, so once frozen
+        // again it reads back with its new contents
+        _vte_row_data_get_writable(ring.index_writable(top), 0)->c = 'z';
+        for (auto i = 0; i < 100; ++i)
+                writer.newline();
+        g_assert_cmpuint(ring.index(top)->cells[0].c, ==, 'z');
+        g_assert_true(rows_text(ring, top + 1, top + 20) == text.substr(first_line.size()));
+}
+
+static void
+test_ring_prompts(void)
+{
+        // Prompts of several rows, and some beginning after the end of the output,
+        // on its row or on the next one that the output soft wraps to
+        auto prompt = basic_cell.attr;
+        prompt.set_shellintegration(ShellIntegrationMode::ePROMPT);
+        auto command = basic_cell.attr;
+        command.set_shellintegration(ShellIntegrationMode::eCOMMAND);
+
+        auto prompts = 0;
+        auto const write = [&](Writer& writer) {
+                prompts = 0;
+                for (auto i = 0; i < 2000; ++i) {
+                        if (i % 7 == 0)
+                                writer.write("partial"sv);
+                        else if (i % 11 == 0)
+                                writer.write(std::string(12, '-'));
+                        writer.write("user@host:~"sv, prompt);
+                        for (auto j = 0; j < i % 5; ++j)
+                                writer.write("/dir"sv, prompt);
+                        writer.write("$ "sv, prompt);
+                        writer.write("ls"sv, command);
+                        writer.newline();
+                        ++prompts;
+                        for (auto j = 0; j < i % 4; ++j) {
+                                writer.write("file" + std::to_string(j));
+                                writer.newline();
+                        }
+                }
+        };
+
+        auto writer = Writer{12, 5, 100000};
+        write(writer);
+        auto& ring = writer.ring();
+
+        // Compares the rows already rewrapped first, then all of them, with the
+        // same output kept on the screen, where it's never frozen
+        auto const assert_prompts = [&]() {
+                auto reference = Writer{writer.column_count(), 20000, 20000};
+                write(reference);
+                auto& reference_ring = reference.ring();
+
+                auto delta = reference_ring.next() - ring.next();
+                auto const start = ring.rewrap_pending() ? ring.rewrapped_start() : ring.next();
+                for (auto row = start; row < ring.next(); ++row) {
+                        g_assert_true(ring.contains_prompt_beginning(row) ==
+                                      reference_ring.contains_prompt_beginning(row + delta));
+                        g_assert_true(ring.is_soft_wrapped(row) ==
+                                      reference_ring.is_soft_wrapped(row + delta));
+                }
+
+                ring.finish_rewrap();
+                g_assert_cmpuint(ring.length(), ==, reference_ring.length());
+                delta = reference_ring.next() - ring.next();
+                auto count = 0;
+                for (auto row = ring.delta(); row < ring.next(); ++row) {
+                        g_assert_true(ring.contains_prompt_beginning(row) ==
+                                      reference_ring.contains_prompt_beginning(row + delta));
+                        g_assert_true(ring.is_soft_wrapped(row) ==
+                                      reference_ring.is_soft_wrapped(row + delta));
+                        count += ring.contains_prompt_beginning(row);
+                }
+                g_assert_cmpint(count, ==, prompts);
+        };
+
+        assert_prompts();
+
+        writer.rewrap(7);
+        g_assert_true(ring.rewrap_pending());
+        assert_prompts();
+        writer.rewrap(30);
+        g_assert_true(ring.rewrap_pending());
+        assert_prompts();
+}
+
+static vte::Freeable<GBytes>
+save_snapshot(Ring& ring)
+{
+        auto const output = vte::glib::take_ref(g_memory_output_stream_new_resizable());
+        g_assert_true(ring.save_snapshot(output.get(), nullptr, nullptr));
+        g_assert_true(g_output_stream_close(output.get(), nullptr, nullptr));
+        return vte::take_freeable(g_memory_output_stream_steal_as_bytes(G_MEMORY_OUTPUT_STREAM(output.get())));
+}
+
+static bool
+load_snapshot(Ring& ring,
+              GBytes* data,
+              GError** error)
+{
+        auto const input = vte::glib::take_ref(g_memory_input_stream_new_from_bytes(data));
+        return ring.load_snapshot(input.get(), nullptr, error);
+}
+
+static void
+test_ring_snapshot(void)
+{
+        auto writer = Writer{20, 5, 100000};
+        for (auto i = 0; i < 5000; ++i) {
+                write_history_line(writer, i);
+                if (i % 7 == 0) {
+                        writer.write("xyz"sv, colored(i % 8));
+                        writer.newline();
+                }
+        }
+        writer.write("partial"sv, colored(1, true));
+        auto& ring = writer.ring();
+        auto const next = ring.next();
+        auto const bytes = save_snapshot(ring);
+
+        // The rows come back where they were, the writable ones included
+        auto restored = Writer{20, 5, 100000};
+        restored.write("other contents"sv);
+        restored.newline();
+        g_assert_true(load_snapshot(restored.ring(), bytes.get(), nullptr));
+        g_assert_cmpuint(restored.ring().delta(), ==, ring.delta());
+        g_assert_cmpuint(restored.ring().next(), ==, ring.next());
+        assert_rows(restored.ring(), ring);
+
+        // Writing after restoring is as writing to the original
+        for (auto w : {&writer, &restored}) {
+                w->newline();
+                w->write("more"sv, colored(2, true));
+                w->newline();
+        }
+        assert_rows(restored.ring(), ring);
+
+        // Into a ring with less scrollback, only the last rows are kept, and
+        // they rewrap the same
+        auto small = Writer{20, 5, 1000};
+        g_assert_true(load_snapshot(small.ring(), bytes.get(), nullptr));
+        g_assert_cmpuint(small.ring().length(), <=, 1000);
+        g_assert_cmpuint(small.ring().next(), ==, next);
+        auto reference = Writer{20, 5, 100000};
+        g_assert_true(load_snapshot(reference.ring(), bytes.get(), nullptr));
+        small.rewrap(7);
+        small.ring().finish_rewrap();
+        reference.rewrap(7);
+        reference.ring().finish_rewrap();
+        assert_rows(small.ring(), reference.ring(), 500);
+
+        // A truncated or corrupt snapshot leaves the ring alone
+        auto error = vte::glib::Error{};
+        auto const size = g_bytes_get_size(bytes.get());
+        auto const truncated = vte::take_freeable(g_bytes_new_from_bytes(bytes.get(), 0, size - 1));
+        g_assert_false(load_snapshot(restored.ring(), truncated.get(), error));
+        g_assert_true(error.matches(G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT));
+        error.reset();
+
+        auto data = std::string{(char const*)g_bytes_get_data(bytes.get(), nullptr), size};
+        data[0] ^= 0x55;
+        auto const corrupt = vte::take_freeable(g_bytes_new(data.data(), data.size()));
+        g_assert_false(load_snapshot(restored.ring(), corrupt.get(), error));
+        g_assert_true(error.matches(G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED));
+
+        assert_rows(restored.ring(), ring);
+}
+
+static void
+test_ring_snapshot_damaged(void)
+{
+        // Damage to the streams' data, which ends the snapshot, makes neither
+        // loading it nor reading or rewrapping the rows crash
+        auto writer = Writer{20, 5, 1000};
+        for (auto i = 0; i < 200; ++i) {
+                writer.write(std::to_string(i), colored(i % 8));
+                writer.write("\xc3\xa4"sv);
+                writer.newline();
+        }
+        auto const bytes = save_snapshot(writer.ring());
+
+        auto const size = g_bytes_get_size(bytes.get());
+        auto data = std::string{(char const*)g_bytes_get_data(bytes.get(), nullptr), size};
+        for (auto offset = size > 1024 ? size - 1024 : 0; offset < size; ++offset) {
+                data[offset] ^= 0x55;
+                auto const damaged = vte::take_freeable(g_bytes_new(data.data(), data.size()));
+                auto ring = Ring{1000, true};
+                ring.set_visible_rows(5);
+                if (load_snapshot(ring, damaged.get(), nullptr)) {
+                        rows_text(ring, ring.delta(), ring.next());
+                        VteVisualPosition* markers[] = {nullptr};
+                        ring.rewrap(7, markers);
+                        ring.finish_rewrap();
+                        rows_text(ring, ring.delta(), ring.next());
+                }
+                data[offset] ^= 0x55;
+        }
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+        g_test_init(&argc, &argv, nullptr);
+
+        g_test_add_func("/vte/ring/quota", test_ring_quota);
+        g_test_add_func("/vte/ring/rewrap/lazy", test_ring_rewrap_lazy);
+        g_test_add_func("/vte/ring/rewrap/discard", test_ring_rewrap_discard);
+        g_test_add_func("/vte/ring/rewrap/parallel", test_ring_rewrap_parallel);
+        g_test_add_func("/vte/ring/thaw", test_ring_thaw);
+        g_test_add_func("/vte/ring/cached-rows", test_ring_cached_rows);
+        g_test_add_func("/vte/ring/prompts", test_ring_prompts);
+        g_test_add_func("/vte/ring/snapshot", test_ring_snapshot);
+        g_test_add_func("/vte/ring/snapshot/damaged", test_ring_snapshot_damaged);
+
+        return g_test_run();
+}
@@ -20,11 +20,16 @@
 #include "config.h"
 
 #include "debug.h"
+#include "probes.hh"
 #include "ring.hh"
 #include "vterowdata.hh"
 
 #include <string.h>
 
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
 #if WITH_SIXEL
 
 #include "cxx-utils.hh"
@@ -84,16 +89,18 @@ Ring::Ring(row_t max_rows,
 	m_array = (VteRowData* ) g_malloc0 (sizeof (m_array[0]) * (m_mask + 1));
 
 	if (has_streams) {
-		m_attr_stream = _vte_file_stream_new ();
-		m_text_stream = _vte_file_stream_new ();
-		m_row_stream = _vte_file_stream_new ();
+                m_stream_cache = _vte_block_cache_new (k_default_stream_cache_size);
+		m_attr_stream = new_stream();
+		m_text_stream = new_stream();
+		m_row_stream = new_stream();
 	} else {
 		m_attr_stream = m_text_stream = m_row_stream = nullptr;
+                m_stream_cache = nullptr;
 	}
 
 	m_utf8_buffer = g_string_sized_new (128);
 
-	_vte_row_data_init (&m_cached_row);
+	resize_cached_rows();
 
         m_hyperlinks = g_ptr_array_new();
         auto empty_str = g_string_new_len("", 0);
@@ -110,9 +117,11 @@ Ring::~Ring()
 	g_free (m_array);
 
 	if (m_has_streams) {
+		cancel_rewrap();
 		g_object_unref (m_attr_stream);
 		g_object_unref (m_text_stream);
 		g_object_unref (m_row_stream);
+                _vte_block_cache_unref (m_stream_cache);
 	}
 
 	g_string_free (m_utf8_buffer, TRUE);
@@ -121,7 +130,144 @@ Ring::~Ring()
                 g_string_free (hyperlink_get(i), TRUE);
         g_ptr_array_free (m_hyperlinks, TRUE);
 
-	_vte_row_data_fini(&m_cached_row);
+	for (auto& cached : m_cached_rows)
+		_vte_row_data_fini(&cached.row);
+}
+
+/* Make room for two screenfuls of cached rows, dropping the cached ones. */
+void
+Ring::resize_cached_rows()
+{
+	auto size = k_cached_rows_min;
+	while (size < 2 * m_visible_rows)
+		size <<= 1;
+	if (size == m_cached_rows.size())
+		return;
+
+	for (auto& cached : m_cached_rows)
+		_vte_row_data_fini(&cached.row);
+	m_cached_rows.assign(size, CachedRow{(row_t)-1, {}});
+	m_cached_rows_mask = size - 1;
+}
+
+void
+Ring::invalidate_cached_rows() noexcept
+{
+	for (auto& cached : m_cached_rows)
+		cached.position = (row_t)-1;
+}
+
+/* Invalidate the cached rows [@start, @end), after they're thawed for writing. */
+void
+Ring::invalidate_cached_rows(row_t start,
+                             row_t end) noexcept
+{
+	if (end - start > m_cached_rows_mask)
+		return invalidate_cached_rows();
+
+	for (auto position = start; position < end; position++) {
+		auto& cached = cached_row(position);
+		if (cached.position == position)
+			cached.position = (row_t)-1;
+	}
+}
+
+void
+Ring::RowFlags::reset(row_t position) noexcept
+{
+	m_words.clear();
+	m_base = position / 64 * 64;
+	m_tail = m_head = position;
+}
+
+void
+Ring::RowFlags::append_bits(bool const (&bits)[eCOUNT])
+{
+	auto const index = m_head / 64 - m_base / 64;
+	if (index == m_words.size())
+		m_words.push_back(Word{});
+
+	auto& word = m_words[index];
+	auto const mask = uint64_t{1} << (m_head % 64);
+	for (auto i = 0; i < eCOUNT; i++) {
+		if (bits[i])
+			word.bits[i] |= mask;
+		else
+			word.bits[i] &= ~mask;
+	}
+	m_head++;
+}
+
+void
+Ring::RowFlags::append(RowRecord const& record)
+{
+	bool bits[eCOUNT];
+
+	bits[eSOFT_WRAPPED] = record.soft_wrapped;
+	bits[ePROMPT_START] = record.prompt_start;
+	bits[eHAS_HYPERLINK] = record.has_hyperlink;
+	append_bits(bits);
+}
+
+/* Append the flags of the rows [@start, @end) of @flags. */
+void
+Ring::RowFlags::append(RowFlags const& flags,
+                       row_t start,
+                       row_t end)
+{
+	bool bits[eCOUNT];
+
+	m_words.reserve((m_head + end - start + 63) / 64 - m_base / 64);
+	for (auto position = start; position < end; position++) {
+		for (auto i = 0; i < eCOUNT; i++)
+			bits[i] = flags.contains(position) && flags.get(position, Flag(i));
+		append_bits(bits);
+	}
+}
+
+void
+Ring::RowFlags::truncate(row_t position)
+{
+	if (position >= m_head)
+		return;
+
+	m_head = MAX(position, m_tail);
+	m_words.resize((m_head + 63) / 64 - m_base / 64);
+}
+
+/* Forget about the rows before @position, dropping their words once there are
+ * as many of those as of the rest, so that it takes amortized constant time. */
+void
+Ring::RowFlags::advance_tail(row_t position)
+{
+	if (position <= m_tail)
+		return;
+
+	m_tail = MIN(position, m_head);
+	auto const dead = m_tail / 64 - m_base / 64;
+	if (dead == 0 || 2 * dead < m_words.size())
+		return;
+
+	m_words.erase(m_words.begin(), m_words.begin() + dead);
+	m_base += dead * 64;
+}
+
+/* Append the bytes [@offset, @end) of @src to @dst. */
+static void
+copy_stream(VteStream* dst,
+            VteStream* src,
+            gsize offset,
+            gsize end)
+{
+        char buf[4096];
+
+        while (offset < end) {
+                auto const len = MIN(sizeof(buf), end - offset);
+                if (!_vte_stream_read(src, offset, buf, len))
+                        memset(buf, 0, len);
+                _vte_stream_append(dst, buf, len);
+                offset += len;
+        }
 }
 
 #define SET_BIT(buf, n) buf[(n) / 8] |= (1 << ((n) % 8))
@@ -311,6 +457,43 @@ Ring::rewrap_images_in_range(Ring::image_by_top_map_type::iterator& it,
         return true;
 }
 
+/* Move the images on the rows [@start, @end) to the rows they rewrapped to,
+ * whose records are in @stream at the rows [@new_start, @new_end), @shift
+ * rows further down. */
+void
+Ring::rewrap_images_to_rows(row_t start,
+                            row_t end,
+                            VteStream* stream,
+                            row_t new_start,
+                            row_t new_end,
+                            row_t shift) noexcept
+{
+        for (auto it = m_image_by_top_map.lower_bound(start), map_end = m_image_by_top_map.end();
+             it != map_end && it->first < end;
+             ++it) {
+                auto const& image = it->second;
+                auto ofs = CellTextOffset{};
+                if (!frozen_row_column_to_text_offset(image->get_top(), 0, &ofs))
+                        continue;
+
+                /* Find the last new row that starts at or before the image */
+                auto low = new_start, high = new_end;
+                while (low + 1 < high) {
+                        auto const mid = low + (high - low) / 2;
+                        RowRecord record;
+                        if (!_vte_stream_read(stream, mid * sizeof(record),
+                                              (char*)&record, sizeof(record)))
+                                break;
+                        if (record.text_start_offset <= ofs.text_offset)
+                                low = mid;
+                        else
+                                high = mid;
+                }
+
+                image->set_top(shift + low);
+        }
+}
+
 #endif /* WITH_SIXEL */
 
 /*
@@ -406,6 +589,27 @@ Ring::get_hyperlink_idx(char const* hyperlink)
         return m_hyperlink_current_idx;
 }
 
+static inline bool
+cell_is_prompt(VteCell const* cell)
+{
+        return cell->attr.shellintegration() == ShellIntegrationMode::ePROMPT;
+}
+
+/* Whether a prompt begins in @row past its first cell, see Ring::contains_prompt_beginning(). */
+static bool
+row_prompt_begins_past_start(VteRowData const* row)
+{
+        /* The previous character is readily available in these places. */
+        int col = 0;
+        while (col < row->len && cell_is_prompt(&row->cells[col])) {
+                col++;
+        }
+        while (col < row->len && !cell_is_prompt(&row->cells[col])) {
+                col++;
+        }
+        return col < row->len;
+}
+
 void
 Ring::freeze_row(row_t position,
                  VteRowData const* row)
@@ -417,6 +621,7 @@ Ring::freeze_row(row_t position,
         gboolean froze_hyperlink = FALSE;
 
 	_vte_debug_print (VTE_DEBUG_RING, "Freezing row %lu.\n", position);
+        VTE_PROBE(freeze_row, this, position);
 
         g_assert(m_has_streams);
 
@@ -427,6 +632,17 @@ Ring::freeze_row(row_t position,
         record.width = row->len;
 	record.is_ascii = 1;
 
+        /* A prompt beginning in the first cell continues the previous row's if
+         * that one is soft wrapped and its last character, the last one frozen,
+         * is in the prompt too. */
+        if (row->len > 0) {
+                record.prompt_start = row_prompt_begins_past_start(row) ||
+                        (cell_is_prompt(&row->cells[0]) &&
+                         !(m_row_flags.contains(position - 1) &&
+                           m_row_flags.get(position - 1, RowFlags::eSOFT_WRAPPED) &&
+                           m_last_attr.shellintegration() == ShellIntegrationMode::ePROMPT));
+        }
+
 	g_string_truncate (buffer, 0);
 	for (i = 0, cell = row->cells; i < row->len; i++, cell++) {
 		VteCellAttr attr;
@@ -490,6 +706,7 @@ Ring::freeze_row(row_t position,
 			}
 
 			if (cell->c < 32 || cell->c > 126) record.is_ascii = 0;
+			if (attr.hyperlink_idx != 0) record.has_hyperlink = 1;
 			_vte_unistr_append_to_string (cell->c, buffer);
 		}
 	}
@@ -501,6 +718,10 @@ Ring::freeze_row(row_t position,
 	_vte_stream_append(m_text_stream, buffer->str, buffer->len);
 	append_row_record(&record, position);
 
+        m_stream_bytes_written += buffer->len +
+                (_vte_stream_head(m_attr_stream) - record.attr_start_offset) +
+                sizeof(record);
+
         /* After freezing some hyperlinks, do a hyperlink GC. The constant is totally arbitrary, feel free to fine tune. */
         if (froze_hyperlink)
                 hyperlink_maybe_gc(1024);
@@ -519,27 +740,19 @@ Ring::thaw_row(row_t position,
                int hyperlink_column,
                char const** hyperlink)
 {
-	RowRecord records[2], record;
-	VteCellAttr attr;
-	CellAttrChange attr_change;
-	VteCell cell;
-	char const* p, *q, *end;
+	RowRecord records[2];
 	GString *buffer = m_utf8_buffer;
-        char hyperlink_readbuf[VTE_HYPERLINK_TOTAL_LENGTH_MAX + 1];
-
-        hyperlink_readbuf[0] = '\0';
-        if (hyperlink) {
-                m_hyperlink_buf[0] = '\0';
-                *hyperlink = m_hyperlink_buf;
-        }
 
 	_vte_debug_print (VTE_DEBUG_RING, "Thawing row %lu.\n", position);
+        VTE_PROBE(thaw_row, this, position, do_truncate);
 
         g_assert(m_has_streams);
 
 	_vte_row_data_clear (row);
-
-	attr_change.text_end_offset = 0;
+        if (hyperlink) {
+                m_hyperlink_buf[0] = '\0';
+                *hyperlink = m_hyperlink_buf;
+        }
 
 	if (!read_row_record(&records[0], position))
 		return;
@@ -552,31 +765,72 @@ Ring::thaw_row(row_t position,
 	g_string_set_size (buffer, records[1].text_start_offset - records[0].text_start_offset);
 	if (!_vte_stream_read (m_text_stream, records[0].text_start_offset, buffer->str, buffer->len))
 		return;
+        m_stream_bytes_read += buffer->len;
 
-	record = records[0];
+	if (!thaw_row_cells(records[0], buffer->str, buffer->len, row,
+			    do_truncate, hyperlink_column, hyperlink, nullptr))
+		return;
 
-	if (G_LIKELY (buffer->len && buffer->str[buffer->len - 1] == '\n'))
-                g_string_truncate (buffer, buffer->len - 1);
+	if (do_truncate)
+		truncate_streams(position, records[0]);
+}
+
+/* Fill in @row from its @record and @text, reading its attributes from
+ * the attr stream, or from @attrs if given. */
+bool
+Ring::thaw_row_cells(RowRecord record,
+                     char const* text,
+                     size_t text_len,
+                     VteRowData* row,
+                     bool do_truncate,
+                     int hyperlink_column,
+                     char const** hyperlink,
+                     StreamCopy const* attrs)
+{
+	VteCellAttr attr;
+	CellAttrChange attr_change;
+	VteCell cell;
+	char const* p, *q, *end;
+        char hyperlink_readbuf[VTE_HYPERLINK_TOTAL_LENGTH_MAX + 1];
+
+        auto const read_attrs = [&](size_t offset,
+                                    void* buf,
+                                    size_t len) -> bool {
+                if (attrs == nullptr)
+                        return _vte_stream_read(m_attr_stream, offset, (char*) buf, len);
+                if (offset < attrs->offset || offset - attrs->offset + len > attrs->data.size())
+                        return false;
+                memcpy(buf, attrs->data.data() + offset - attrs->offset, len);
+                return true;
+        };
+
+        hyperlink_readbuf[0] = '\0';
+	attr_change.text_end_offset = 0;
+
+	if (G_LIKELY (text_len && text[text_len - 1] == '\n'))
+                text_len--;
 	else
 		row->attr.soft_wrapped = TRUE;
-        row->attr.bidi_flags = records[0].bidi_flags;
+        row->attr.bidi_flags = record.bidi_flags;
 
-	p = buffer->str;
-	end = p + buffer->len;
+	p = text;
+	end = p + text_len;
 	while (p < end) {
 		if (record.text_start_offset >= m_last_attr_text_start_offset) {
 			attr = m_last_attr;
                         strcpy(hyperlink_readbuf, hyperlink_get(attr.hyperlink_idx)->str);
 		} else {
 			if (record.text_start_offset >= attr_change.text_end_offset) {
-				if (!_vte_stream_read (m_attr_stream, record.attr_start_offset, (char *) &attr_change, sizeof (attr_change)))
-					return;
+				if (!read_attrs (record.attr_start_offset, &attr_change, sizeof (attr_change)))
+					return false;
 				record.attr_start_offset += sizeof (attr_change);
-                                vte_assert_cmpuint (attr_change.attr.hyperlink_length, <=, VTE_HYPERLINK_TOTAL_LENGTH_MAX);
-                                if (attr_change.attr.hyperlink_length && !_vte_stream_read (m_attr_stream, record.attr_start_offset, hyperlink_readbuf, attr_change.attr.hyperlink_length))
-                                        return;
+                                if (G_UNLIKELY (attr_change.attr.hyperlink_length > VTE_HYPERLINK_TOTAL_LENGTH_MAX))
+                                        return false;
+                                if (attr_change.attr.hyperlink_length && !read_attrs (record.attr_start_offset, hyperlink_readbuf, attr_change.attr.hyperlink_length))
+                                        return false;
                                 hyperlink_readbuf[attr_change.attr.hyperlink_length] = '\0';
                                 record.attr_start_offset += attr_change.attr.hyperlink_length + 2;
+                                m_stream_bytes_read += sizeof (attr_change) + attr_change.attr.hyperlink_length;
 
                                 _attrcpy(&attr, &attr_change.attr);
                                 attr.hyperlink_idx = 0;
@@ -604,9 +858,19 @@ Ring::thaw_row(row_t position,
                                 cell.attr.attr ^= VTE_ATTR_REVERSE;
                         }
                 }
-		cell.c = g_utf8_get_char (p);
-
-		q = g_utf8_next_char (p);
+                /* The text may come from a restored snapshot, don't trust it to be UTF-8 */
+                if (G_LIKELY ((guchar) *p < 0x80)) {
+                        cell.c = (guchar) *p;
+                        q = p + 1;
+                } else {
+                        cell.c = g_utf8_get_char_validated (p, end - p);
+                        if (G_LIKELY (cell.c < 0x110000)) {
+                                q = g_utf8_next_char (p);
+                        } else {
+                                cell.c = 0xfffd;
+                                q = p + 1;
+                        }
+                }
 		record.text_start_offset += q - p;
 		p = q;
 
@@ -642,52 +906,65 @@ Ring::thaw_row(row_t position,
 		}
 	}
 
+	return true;
+}
+
+/* Truncate the streams to just before the row at @position, whose record is @record,
+ * after thawing it. */
+void
+Ring::truncate_streams(row_t position,
+                       RowRecord const& record)
+{
+	CellAttrChange attr_change;
+        char hyperlink_readbuf[VTE_HYPERLINK_TOTAL_LENGTH_MAX + 1];
+
         /* FIXME this is extremely complicated (by design), figure out something better.
            This is the only place where we need to walk backwards in attr_stream,
            which is the reason for the hyperlink's length being repeated after the hyperlink itself. */
-	if (do_truncate) {
-		gsize attr_stream_truncate_at = records[0].attr_start_offset;
-		_vte_debug_print (VTE_DEBUG_RING, "Truncating\n");
-		if (records[0].text_start_offset <= m_last_attr_text_start_offset) {
-			/* Check the previous attr record. If its text ends where truncating, this attr record also needs to be removed. */
-                        guint16 hyperlink_length;
-                        if (_vte_stream_read (m_attr_stream, attr_stream_truncate_at - 2, (char *) &hyperlink_length, 2)) {
-                                vte_assert_cmpuint (hyperlink_length, <=, VTE_HYPERLINK_TOTAL_LENGTH_MAX);
-                                if (_vte_stream_read (m_attr_stream, attr_stream_truncate_at - 2 - hyperlink_length - sizeof (attr_change), (char *) &attr_change, sizeof (attr_change))) {
-                                        if (records[0].text_start_offset == attr_change.text_end_offset) {
-                                                _vte_debug_print (VTE_DEBUG_RING, "... at attribute change\n");
-                                                attr_stream_truncate_at -= sizeof (attr_change) + hyperlink_length + 2;
-                                        }
-				}
+	gsize attr_stream_truncate_at = record.attr_start_offset;
+	_vte_debug_print (VTE_DEBUG_RING, "Truncating\n");
+	if (record.text_start_offset <= m_last_attr_text_start_offset) {
+		/* Check the previous attr record. If its text ends where truncating, this attr record also needs to be removed. */
+                guint16 hyperlink_length;
+                if (_vte_stream_read (m_attr_stream, attr_stream_truncate_at - 2, (char *) &hyperlink_length, 2) &&
+                    hyperlink_length <= VTE_HYPERLINK_TOTAL_LENGTH_MAX) {
+                        if (_vte_stream_read (m_attr_stream, attr_stream_truncate_at - 2 - hyperlink_length - sizeof (attr_change), (char *) &attr_change, sizeof (attr_change))) {
+                                if (record.text_start_offset == attr_change.text_end_offset) {
+                                        _vte_debug_print (VTE_DEBUG_RING, "... at attribute change\n");
+                                        attr_stream_truncate_at -= sizeof (attr_change) + hyperlink_length + 2;
+                                }
 			}
-			/* Reconstruct last_attr from the first record of attr_stream that we cut off,
-			   last_attr_text_start_offset from the last record that we keep. */
-			if (_vte_stream_read (m_attr_stream, attr_stream_truncate_at, (char *) &attr_change, sizeof (attr_change))) {
-                                _attrcpy(&m_last_attr, &attr_change.attr);
-                                m_last_attr.hyperlink_idx = 0;
-                                if (attr_change.attr.hyperlink_length && _vte_stream_read (m_attr_stream, attr_stream_truncate_at + sizeof (attr_change), (char *) &hyperlink_readbuf, attr_change.attr.hyperlink_length)) {
-                                        hyperlink_readbuf[attr_change.attr.hyperlink_length] = '\0';
-                                        m_last_attr.hyperlink_idx = get_hyperlink_idx(hyperlink_readbuf);
+		}
+		/* Reconstruct last_attr from the first record of attr_stream that we cut off,
+		   last_attr_text_start_offset from the last record that we keep. */
+		if (_vte_stream_read (m_attr_stream, attr_stream_truncate_at, (char *) &attr_change, sizeof (attr_change))) {
+                        _attrcpy(&m_last_attr, &attr_change.attr);
+                        m_last_attr.hyperlink_idx = 0;
+                        if (attr_change.attr.hyperlink_length &&
+                            attr_change.attr.hyperlink_length <= VTE_HYPERLINK_TOTAL_LENGTH_MAX &&
+                            _vte_stream_read (m_attr_stream, attr_stream_truncate_at + sizeof (attr_change), (char *) &hyperlink_readbuf, attr_change.attr.hyperlink_length)) {
+                                hyperlink_readbuf[attr_change.attr.hyperlink_length] = '\0';
+                                m_last_attr.hyperlink_idx = get_hyperlink_idx(hyperlink_readbuf);
+                        }
+                        if (_vte_stream_read (m_attr_stream, attr_stream_truncate_at - 2, (char *) &hyperlink_length, 2) &&
+                            hyperlink_length <= VTE_HYPERLINK_TOTAL_LENGTH_MAX) {
+                                if (_vte_stream_read (m_attr_stream, attr_stream_truncate_at - 2 - hyperlink_length - sizeof (attr_change), (char *) &attr_change, sizeof (attr_change))) {
+                                        m_last_attr_text_start_offset = attr_change.text_end_offset;
+                                } else {
+                                        m_last_attr_text_start_offset = 0;
                                 }
-                                if (_vte_stream_read (m_attr_stream, attr_stream_truncate_at - 2, (char *) &hyperlink_length, 2)) {
-                                        vte_assert_cmpuint (hyperlink_length, <=, VTE_HYPERLINK_TOTAL_LENGTH_MAX);
-                                        if (_vte_stream_read (m_attr_stream, attr_stream_truncate_at - 2 - hyperlink_length - sizeof (attr_change), (char *) &attr_change, sizeof (attr_change))) {
-                                                m_last_attr_text_start_offset = attr_change.text_end_offset;
-                                        } else {
-                                                m_last_attr_text_start_offset = 0;
-                                        }
-				} else {
-					m_last_attr_text_start_offset = 0;
-				}
 			} else {
 				m_last_attr_text_start_offset = 0;
-				m_last_attr = basic_cell.attr;
 			}
+		} else {
+			m_last_attr_text_start_offset = 0;
+			m_last_attr = basic_cell.attr;
 		}
-		_vte_stream_truncate (m_row_stream, position * sizeof (record));
-		_vte_stream_truncate (m_attr_stream, attr_stream_truncate_at);
-		_vte_stream_truncate (m_text_stream, records[0].text_start_offset);
 	}
+	_vte_stream_truncate (m_row_stream, position * sizeof (record));
+	m_row_flags.truncate(position);
+	_vte_stream_truncate (m_attr_stream, attr_stream_truncate_at);
+	_vte_stream_truncate (m_text_stream, record.text_start_offset);
 }
 
 void
@@ -696,13 +973,16 @@ Ring::reset_streams(row_t position)
 	_vte_debug_print (VTE_DEBUG_RING, "Reseting streams to %lu.\n", position);
 
 	if (m_has_streams) {
+		cancel_rewrap();
 		_vte_stream_reset(m_row_stream, position * sizeof(RowRecord));
+		m_row_flags.reset(position);
                 _vte_stream_reset(m_text_stream, _vte_stream_head(m_text_stream));
                 _vte_stream_reset(m_attr_stream, _vte_stream_head(m_attr_stream));
 	}
 
 	m_last_attr_text_start_offset = 0;
 	m_last_attr = basic_cell.attr;
+	invalidate_cached_rows();
 }
 
 Ring::row_t
@@ -712,7 +992,7 @@ Ring::reset()
 
         reset_streams(m_end);
         m_start = m_writable = m_end;
-        m_cached_row_num = (row_t)-1;
+        invalidate_cached_rows();
 
 #if WITH_SIXEL
         m_image_by_top_map.clear();
@@ -730,13 +1010,16 @@ Ring::index(row_t position)
 	if (G_LIKELY (position >= m_writable))
 		return get_writable_index(position);
 
-	if (m_cached_row_num != position) {
+	ensure_rewrapped(position);
+
+	auto& cached = cached_row(position);
+	if (cached.position != position) {
 		_vte_debug_print(VTE_DEBUG_RING, "Caching row %lu.\n", position);
-                thaw_row(position, &m_cached_row, false, -1, nullptr);
-		m_cached_row_num = position;
+                thaw_row(position, &cached.row, false, -1, nullptr);
+		cached.position = position;
 	}
 
-	return &m_cached_row;
+	return &cached.row;
 }
 
 bool
@@ -754,7 +1037,12 @@ Ring::is_soft_wrapped(row_t position)
         }
 
         /* The row is scrolled out to the stream. Save work by not reading the actual row.
-         * The requested information is readily available in row_stream, too. */
+         * The requested information is readily available in row_flags, too.
+         * The one right above the rewrapped rows is a hard wrapped one for any width. */
+        if (position + 1 != m_rewrap_seam)
+                ensure_rewrapped(position);
+        if (G_LIKELY (m_row_flags.contains(position)))
+                return m_row_flags.get(position, RowFlags::eSOFT_WRAPPED);
         if (G_UNLIKELY (!read_row_record(&record, position)))
                 return false;
         return record.soft_wrapped;
@@ -770,35 +1058,35 @@ Ring::is_soft_wrapped(row_t position)
  * FIXME extend support for deliberately multiline (hard wrapped) prompts:
  * https://gitlab.gnome.org/GNOME/vte/-/issues/2681#note_1904004
  *
- * FIXME this is very slow, it unnecessarily reads text_stream
- * in which we're not interested at all. Implement a faster algorithm. */
+ * For rows scrolled out to the stream, this was found out when freezing or
+ * rewrapping them, and is readily available in row_flags. */
 bool
 Ring::contains_prompt_beginning(row_t position)
 {
+        if (position >= m_start && position < m_writable) {
+                ensure_rewrapped(position);
+                if (G_LIKELY (m_row_flags.contains(position)))
+                        return m_row_flags.get(position, RowFlags::ePROMPT_START);
+        }
+
         const VteRowData *row = index(position);
         if (row == NULL || row->len == 0) {
                 return false;
         }
 
         /* First check the places where the previous character is also readily available. */
-        int col = 0;
-        while (col < row->len && row->cells[col].attr.shellintegration() == ShellIntegrationMode::ePROMPT) {
-                col++;
-        }
-        while (col < row->len && row->cells[col].attr.shellintegration() != ShellIntegrationMode::ePROMPT) {
-                col++;
-        }
-        if (col < row->len) {
+        if (row_prompt_begins_past_start(row)) {
                 return true;
         }
 
         /* Finally check the first character where we might need to look at the previous row. */
-        if (row->cells[0].attr.shellintegration() == ShellIntegrationMode::ePROMPT) {
+        if (cell_is_prompt(&row->cells[0])) {
+                if (!is_soft_wrapped(position - 1))
+                        return true;
                 row = index(position - 1);
                 if (row == NULL ||
-                    !row->attr.soft_wrapped ||
                     (row->len >= 1 /* this is guaranteed beucase soft_wrapped */ &&
-                     row->cells[row->len - 1].attr.shellintegration() != ShellIntegrationMode::ePROMPT)) {
+                     !cell_is_prompt(&row->cells[row->len - 1]))) {
                         return true;
                 }
         }
@@ -833,7 +1121,7 @@ Ring::get_hyperlink_at_position(row_t position,
 
         if (update_hover_idx) {
                 /* Invalidate the cache because new hover idx might result in new idxs to report. */
-                m_cached_row_num = (row_t)-1;
+                invalidate_cached_rows();
         }
 
         if (G_UNLIKELY (!contains(position) || col < 0)) {
@@ -852,9 +1140,19 @@ Ring::get_hyperlink_at_position(row_t position,
                 *hyperlink = hyperlink_get(row->cells[col].attr.hyperlink_idx)->str;
                 idx = row->cells[col].attr.hyperlink_idx;
         } else {
-                thaw_row(position, &m_cached_row, false, col, hyperlink);
-                /* Note: Intentionally don't set cached_row_num. We're about to update
+                ensure_rewrapped(position);
+                if (m_row_flags.contains(position) &&
+                    !m_row_flags.get(position, RowFlags::eHAS_HYPERLINK)) {
+                        /* Save thawing the row */
+                        if (update_hover_idx)
+                                m_hyperlink_hover_idx = 0;
+                        return 0;
+                }
+                auto& cached = cached_row(position);
+                thaw_row(position, &cached.row, false, col, hyperlink);
+                /* Note: Intentionally don't keep the row cached. We're about to update
                  * m_hyperlink_hover_idx which makes some idxs no longer valid. */
+                cached.position = (row_t)-1;
                 idx = get_hyperlink_idx_no_update_current(*hyperlink);
         }
         if (**hyperlink == '\0')
@@ -876,6 +1174,7 @@ Ring::freeze_one_row()
 	freeze_row(m_writable, row);
 
 	m_writable++;
+        m_rows_frozen++;
 }
 
 void
@@ -889,17 +1188,82 @@ Ring::thaw_one_row()
 
 	m_writable--;
 
-	if (m_writable == m_cached_row_num)
-		m_cached_row_num = (row_t)-1; /* Invalidate cached row */
+	invalidate_cached_rows(m_writable, m_writable + 1);
 
 	row = get_writable_index(m_writable);
         thaw_row(m_writable, row, true, -1, nullptr);
+        m_rows_thawed++;
+}
+
+/* Thaw the rows from @position up to m_writable, reading their records,
+ * text and attributes with one read each, and truncating the streams once. */
+void
+Ring::thaw_rows(row_t position)
+{
+	vte_assert_cmpuint(m_start, <=, position);
+
+	if (position + 1 >= m_writable) {
+		while (position < m_writable)
+			thaw_one_row();
+		return;
+	}
+
+	auto const count = m_writable - position;
+	_vte_debug_print (VTE_DEBUG_RING, "Thawing rows %lu to %lu.\n", position, m_writable - 1);
+
+	auto records = std::vector<RowRecord>(count);
+	auto text = StreamCopy{};
+	auto attrs = StreamCopy{};
+	auto read = [](VteStream* stream,
+		       StreamCopy& copy,
+		       size_t offset) -> bool {
+		copy.offset = offset;
+		copy.data.resize(_vte_stream_head(stream) - offset);
+		return copy.data.empty() ||
+			_vte_stream_read(stream, offset, copy.data.data(), copy.data.size());
+	};
+	if (!read_row_records(records.data(), position, count) ||
+	    !read(m_text_stream, text, records[0].text_start_offset) ||
+	    !read(m_attr_stream, attrs, records[0].attr_start_offset)) {
+		while (position < m_writable)
+			thaw_one_row();
+		return;
+	}
+        m_stream_bytes_read += text.data.size() + attrs.data.size();
+
+	invalidate_cached_rows(position, m_writable);
+
+	/* Thaw from the bottom up, like thaw_one_row(), so that a hyperlink GC sees the rows thawed so far */
+	auto text_end = text.offset + text.data.size();
+	while (m_writable > position) {
+		ensure_writable_room();
+		m_writable--;
+
+		auto const& record = records[m_writable - position];
+		auto const row = get_writable_index(m_writable);
+		_vte_row_data_clear (row);
+		thaw_row_cells(record,
+			       text.data.data() + record.text_start_offset - text.offset,
+			       text_end - record.text_start_offset,
+			       row, true, -1, nullptr, &attrs);
+		text_end = record.text_start_offset;
+		m_rows_thawed++;
+	}
+
+	truncate_streams(position, records[0]);
 }
 
 void
 Ring::discard_one_row()
 {
 	m_start++;
+	if (G_UNLIKELY(m_start < m_rewrap_seam)) {
+		/* Keep the streams, the pending rewrap still reads them */
+		return;
+	} else if (G_UNLIKELY(rewrap_pending())) {
+		cancel_rewrap();
+	}
+
 	if (G_UNLIKELY(m_start == m_writable)) {
 		reset_streams(m_writable);
 	} else if (m_start < m_writable) {
@@ -907,6 +1271,7 @@ Ring::discard_one_row()
                 if (m_start % 256 == 0) {
                         RowRecord record;
                         _vte_stream_advance_tail(m_row_stream, m_start * sizeof (record));
+                        m_row_flags.advance_tail(m_start);
                         if (G_LIKELY(read_row_record(&record, m_start))) {
                                 _vte_stream_advance_tail(m_text_stream, record.text_start_offset);
                                 _vte_stream_advance_tail(m_attr_stream, record.attr_start_offset);
@@ -987,6 +1352,8 @@ Ring::resize(row_t max_rows)
 	/* Adjust the start of tail chunk now */
 	if (length() > max_rows) {
 		m_start = m_end - max_rows;
+		if (m_start >= m_rewrap_seam)
+			cancel_rewrap();
 		if (m_start >= m_writable) {
 			reset_streams(m_writable);
 			m_writable = m_start;
@@ -1057,6 +1424,7 @@ Ring::insert(row_t position, guint8 bidi_flags)
 	m_end++;
 
 	maybe_freeze_one_row();
+        maybe_discard_for_quota();
         validate();
 	return row;
 }
@@ -1138,68 +1506,291 @@ void
 Ring::set_visible_rows(row_t rows)
 {
         m_visible_rows = rows;
+        resize_cached_rows();
+}
+
+/**
+ * Ring::set_stream_cache_size:
+ * @size: the size in bytes
+ *
+ * Set how much memory to spend on caching uncompressed blocks read
+ * back from the streams. It's rounded down to whole blocks.
+ */
+void
+Ring::set_stream_cache_size(size_t size)
+{
+        if (m_has_streams)
+                _vte_block_cache_set_size(m_stream_cache, size);
 }
 
+size_t
+Ring::stream_cache_size() const noexcept
+{
+        return m_has_streams ? _vte_block_cache_get_size(m_stream_cache) : 0;
+}
 
-/* Convert a (row,col) into a CellTextOffset.
- * Requires the row to be frozen, or be outsize the range covered by the ring.
+uint64_t
+Ring::stream_cache_hits() const noexcept
+{
+        return m_has_streams ? _vte_block_cache_get_hits(m_stream_cache) : 0;
+}
+
+uint64_t
+Ring::stream_cache_misses() const noexcept
+{
+        return m_has_streams ? _vte_block_cache_get_misses(m_stream_cache) : 0;
+}
+
+/**
+ * Ring::set_stream_codec:
+ * @codec: a #VteStreamCodec
+ *
+ * Set the codec for compressing the streams' blocks written from now on.
+ * The codec must be supported by this build.
  */
-bool
-Ring::frozen_row_column_to_text_offset(row_t position,
-				       column_t column,
-				       CellTextOffset* offset)
+void
+Ring::set_stream_codec(VteStreamCodec codec)
 {
-	RowRecord records[2];
-	VteCell *cell;
-	GString *buffer = m_utf8_buffer;
-	VteRowData const* row;
-	unsigned int i, num_chars, off;
+        if (!m_has_streams)
+                return;
 
-	if (position >= m_end) {
-		offset->text_offset = _vte_stream_head(m_text_stream) + position - m_end;
-		offset->fragment_cells = 0;
-		offset->eol_cells = column;
-		return true;
-	}
+        m_stream_codec = codec;
+        _vte_file_stream_set_codec(m_attr_stream, codec);
+        _vte_file_stream_set_codec(m_text_stream, codec);
+        _vte_file_stream_set_codec(m_row_stream, codec);
+}
 
-	if (G_UNLIKELY (position < m_start)) {
-		/* This happens when the marker (saved cursor position) is
-		   scrolled off at the top of the scrollback buffer. */
-		position = m_start;
-		column = 0;
-		/* go on */
-	}
+/* Creates an empty stream with the ring's storage, cache and codec. */
+VteStream*
+Ring::new_stream() const
+{
+        auto const stream = m_streams_in_memory ? _vte_memory_stream_new(m_stream_cache)
+                                                : _vte_file_stream_new(m_stream_cache);
+        _vte_file_stream_set_codec(stream, m_stream_codec);
+        return stream;
+}
 
-	vte_assert_cmpuint(position, <, m_writable);
-	if (!read_row_record(&records[0], position))
-		return false;
-	if ((position + 1) * sizeof (records[0]) < _vte_stream_head(m_row_stream)) {
-		if (!read_row_record(&records[1], position + 1))
-			return false;
-	} else
-		records[1].text_start_offset = _vte_stream_head(m_text_stream);
+/**
+ * Ring::set_streams_in_memory:
+ * @in_memory: whether to keep the streams in memory
+ *
+ * Set whether the streams keep their compressed blocks in memory, or in
+ * a temporary file. The existing contents are copied over to the new
+ * streams.
+ */
+void
+Ring::set_streams_in_memory(bool in_memory)
+{
+        if (!m_has_streams || in_memory == m_streams_in_memory)
+                return;
 
-	offset->fragment_cells = 0;
-	offset->eol_cells = -1;
-	offset->text_offset = records[0].text_start_offset;
+        m_streams_in_memory = in_memory;
 
-        /* Save some work if we're in column 0. This holds true for images, whose column
-         * positions are disregarded for the purposes of wrapping. */
-        if (column == 0)
-                return true;
+        finish_rewrap();
 
-        g_string_set_size (buffer, records[1].text_start_offset - records[0].text_start_offset);
-	if (!_vte_stream_read(m_text_stream, records[0].text_start_offset, buffer->str, buffer->len))
-		return false;
+        auto const migrate = [&](VteStream*& stream) {
+                auto const copy = new_stream();
+                _vte_stream_reset(copy, _vte_stream_tail(stream));
+                copy_stream(copy, stream, _vte_stream_tail(stream), _vte_stream_head(stream));
 
-	if (G_LIKELY (buffer->len && buffer->str[buffer->len - 1] == '\n'))
-                g_string_truncate (buffer, buffer->len - 1);
+                g_object_unref(stream);
+                stream = copy;
+        };
 
-	row = index(position);
+        migrate(m_attr_stream);
+        migrate(m_text_stream);
+        migrate(m_row_stream);
+}
 
-	/* row and buffer now contain the same text, in different representation */
+/* Uncompressed bytes of the streams used by the frozen rows from start on. */
+size_t
+Ring::frozen_bytes(row_t start)
+{
+        if (start >= m_writable)
+                return 0;
 
-	/* count the number of characters up to the given column */
+        RowRecord record;
+        if (G_UNLIKELY(!read_row_record(&record, start)))
+                return 0;
+
+        return (m_writable - start) * sizeof(record) +
+                _vte_stream_head(m_text_stream) - record.text_start_offset +
+                _vte_stream_head(m_attr_stream) - record.attr_start_offset;
+}
+
+size_t
+Ring::writable_bytes() const noexcept
+{
+        auto bytes = size_t{0};
+        for (auto i = m_writable; i < m_end; i++)
+                bytes += sizeof(VteRowData) + get_writable_index(i)->len * sizeof(VteCell);
+        return bytes;
+}
+
+/* Discards the oldest frozen rows until the quota is met, or there are none left. */
+void
+Ring::maybe_discard_for_quota()
+{
+        if (G_LIKELY(m_max_bytes == 0) || m_start == m_writable)
+                return;
+
+        /* The streams' tails lag behind m_start, so this is an upper bound on
+         * the frozen rows' share. This runs for every row inserted, so don't walk
+         * the writable rows unless that bound, plus their size as last counted,
+         * is exceeded. They only change size by a screenful or so between counts,
+         * and with the frozen rows growing the count is refreshed soon enough. */
+        auto const bound =
+                (m_writable - m_start) * sizeof(RowRecord) +
+                _vte_stream_head(m_text_stream) - _vte_stream_tail(m_text_stream) +
+                _vte_stream_head(m_attr_stream) - _vte_stream_tail(m_attr_stream);
+        if (G_LIKELY(bound + m_writable_bytes <= m_max_bytes))
+                return;
+
+        auto const writable = m_writable_bytes = writable_bytes();
+        if (bound + writable <= m_max_bytes)
+                return;
+
+        auto const fits = [&](row_t start) {
+                return frozen_bytes(start) + writable <= m_max_bytes;
+        };
+
+        if (fits(m_start))
+                return;
+
+        /* Find the first row to keep; the usage only decreases with later starts.
+         * Usually that's just a row or two further, so gallop from the start
+         * rather than bisect the whole scrollback, then bisect (low, high]. */
+        auto low = m_start, high = m_start + 1;
+        for (auto step = row_t{2}; high < m_writable && !fits(high); step *= 2) {
+                low = high;
+                high = MIN(m_start + step, m_writable);
+        }
+        while (low + 1 < high) {
+                auto const mid = low + (high - low) / 2;
+                if (fits(mid))
+                        high = mid;
+                else
+                        low = mid;
+        }
+
+	_vte_debug_print(VTE_DEBUG_RING, "Discarding %lu rows to stay within %" G_GSIZE_FORMAT " bytes.\n",
+                         high - m_start, m_max_bytes);
+
+        while (m_start < high)
+                discard_one_row();
+}
+
+/**
+ * Ring::set_max_bytes:
+ * @max_bytes: the quota in bytes, or 0 for none
+ *
+ * Limits the ring's size in bytes as returned by scrollback_bytes(), in
+ * addition to its maximum number of rows. When it's exceeded, the oldest
+ * rows are discarded. The writable rows, which include the screen, are
+ * never discarded by this, so they can exceed the quota on their own.
+ */
+void
+Ring::set_max_bytes(size_t max_bytes)
+{
+        m_max_bytes = max_bytes;
+        maybe_discard_for_quota();
+}
+
+/**
+ * Ring::scrollback_bytes:
+ *
+ * Returns: the number of bytes counted against the quota: the uncompressed
+ *   size of the row, text and attr streams used by the frozen rows, plus the
+ *   cells of the writable rows. The memory or disk space the frozen rows
+ *   actually take up is usually a lot less, due to the compression.
+ */
+size_t
+Ring::scrollback_bytes()
+{
+        m_writable_bytes = writable_bytes();
+        return (m_has_streams ? frozen_bytes(m_start) : 0) + m_writable_bytes;
+}
+
+void
+Ring::stream_footprint(size_t& memory,
+                       size_t& disk) const
+{
+        memory = disk = 0;
+        if (!m_has_streams)
+                return;
+
+        VteStream* const streams[] = {m_attr_stream, m_text_stream, m_row_stream,
+                                      m_stale_row_stream, m_rewrap.new_row_stream};
+        for (auto stream : streams) {
+                auto stream_memory = gsize{0}, stream_disk = gsize{0};
+                if (stream == nullptr)
+                        continue;
+                _vte_file_stream_get_footprint(stream, &stream_memory, &stream_disk);
+                memory += stream_memory;
+                disk += stream_disk;
+        }
+}
+
+
+/* Convert a (row,col) into a CellTextOffset.
+ * Requires the row to be frozen, or be outsize the range covered by the ring.
+ */
+bool
+Ring::frozen_row_column_to_text_offset(row_t position,
+				       column_t column,
+				       CellTextOffset* offset)
+{
+	RowRecord records[2];
+	VteCell *cell;
+	GString *buffer = m_utf8_buffer;
+	VteRowData const* row;
+	unsigned int i, num_chars, off;
+
+	if (position >= m_end) {
+		offset->text_offset = _vte_stream_head(m_text_stream) + position - m_end;
+		offset->fragment_cells = 0;
+		offset->eol_cells = column;
+		return true;
+	}
+
+	if (G_UNLIKELY (position < m_start)) {
+		/* This happens when the marker (saved cursor position) is
+		   scrolled off at the top of the scrollback buffer. */
+		position = m_start;
+		column = 0;
+		/* go on */
+	}
+
+	vte_assert_cmpuint(position, <, m_writable);
+	if (!read_row_record(&records[0], position))
+		return false;
+	if ((position + 1) * sizeof (records[0]) < _vte_stream_head(m_row_stream)) {
+		if (!read_row_record(&records[1], position + 1))
+			return false;
+	} else
+		records[1].text_start_offset = _vte_stream_head(m_text_stream);
+
+	offset->fragment_cells = 0;
+	offset->eol_cells = -1;
+	offset->text_offset = records[0].text_start_offset;
+
+        /* Save some work if we're in column 0. This holds true for images, whose column
+         * positions are disregarded for the purposes of wrapping. */
+        if (column == 0)
+                return true;
+
+        g_string_set_size (buffer, records[1].text_start_offset - records[0].text_start_offset);
+	if (!_vte_stream_read(m_text_stream, records[0].text_start_offset, buffer->str, buffer->len))
+		return false;
+
+	if (G_LIKELY (buffer->len && buffer->str[buffer->len - 1] == '\n'))
+                g_string_truncate (buffer, buffer->len - 1);
+
+	row = index(position);
+
+	/* row and buffer now contain the same text, in different representation */
+
+	/* count the number of characters up to the given column */
 	num_chars = 0;
 	for (i = 0, cell = row->cells; i < row->len && i < column; i++, cell++) {
 		if (G_LIKELY (!cell->attr.fragment())) {
@@ -1305,6 +1896,580 @@ Ring::frozen_row_text_offset_to_column(row_t position,
 }
 
 
+void
+Ring::read_attr_change(size_t offset,
+                       CellAttrChange* attr_change)
+{
+	if (!_vte_stream_read(m_attr_stream, offset, (char *) attr_change, sizeof (*attr_change))) {
+                _attrcpy(&attr_change->attr, &m_last_attr);
+                attr_change->attr.hyperlink_length = hyperlink_get(m_last_attr.hyperlink_idx)->len;
+		attr_change->text_end_offset = _vte_stream_head(m_text_stream);
+	}
+}
+
+/* Prepare @state for rewrapping the rows [@start, @end), whose text ends at @text_end. */
+bool
+Ring::rewrap_begin(RewrapState& state,
+                   row_t start,
+                   row_t end,
+                   size_t text_end)
+{
+	if (!read_row_record(&state.old_record, start))
+		return false;
+
+	state.old_row = start + 1;
+	state.old_end = end;
+	state.text_offset = state.old_record.text_start_offset;
+	state.text_end = text_end;
+	state.attr_offset = state.old_record.attr_start_offset;
+	read_attr_change(state.attr_offset, &state.attr_change);
+	state.segment = nullptr;
+
+	return true;
+}
+
+/* Bulk read_row_record(). */
+bool
+Ring::read_row_records(RowRecord* records,
+                       row_t position,
+                       row_t count)
+{
+	if (position < m_rewrap_seam && position + count > m_rewrap_seam) {
+		auto const stale = m_rewrap_seam - position;
+		return read_row_records(records, position, stale) &&
+			read_row_records(records + stale, m_rewrap_seam, count - stale);
+	}
+
+	auto stream = m_row_stream;
+	if (G_UNLIKELY(position < m_rewrap_seam)) {
+		stream = m_stale_row_stream;
+		position = position - m_rewrap_seam + m_stale_row_end;
+	}
+	return _vte_stream_read(stream,
+				position * sizeof(*records),
+				(char*)records,
+				count * sizeof(*records));
+}
+
+/* The reads and writes of rewrap_paragraph(), from and to the streams,
+ * or the copies in state.segment on a worker thread. */
+inline bool
+Ring::rewrap_read_row_record(RewrapState& state,
+                             RowRecord* record,
+                             row_t position)
+{
+	if (G_LIKELY(state.segment == nullptr))
+		return read_row_record(record, position);
+
+	auto const& rows = state.segment->rows;
+	if (position < state.segment->start || position - state.segment->start >= rows.size())
+		return false;
+	*record = rows[position - state.segment->start];
+	return true;
+}
+
+inline void
+Ring::rewrap_read_attr_change(RewrapState& state)
+{
+	if (G_LIKELY(state.segment == nullptr))
+		return read_attr_change(state.attr_offset, &state.attr_change);
+
+	/* The segment's copy reaches beyond its text, this shouldn't fail */
+	auto const& attrs = state.segment->attrs;
+	auto const offset = state.attr_offset - state.segment->attr_start;
+	if (state.attr_offset < state.segment->attr_start ||
+	    offset + sizeof(state.attr_change) > attrs.size()) {
+		memset(&state.attr_change, 0, sizeof(state.attr_change));
+		state.attr_change.text_end_offset = state.text_end;
+		return;
+	}
+	memcpy(&state.attr_change, attrs.data() + offset, sizeof(state.attr_change));
+}
+
+inline bool
+Ring::rewrap_read_text(RewrapState& state,
+                       size_t offset,
+                       char* buf,
+                       size_t len)
+{
+	if (G_LIKELY(state.segment == nullptr))
+		return _vte_stream_read(m_text_stream, offset, buf, len);
+
+	auto const& text = state.segment->text;
+	if (offset < state.segment->text_start || offset - state.segment->text_start + len > text.size())
+		return false;
+	memcpy(buf, text.data() + offset - state.segment->text_start, len);
+	return true;
+}
+
+inline void
+Ring::rewrap_append_row_record(RewrapState& state,
+                               RowRecord const& record)
+{
+	if (G_LIKELY(state.segment == nullptr)) {
+		_vte_stream_append(state.new_row_stream, (char const*) &record, sizeof (record));
+		state.new_row_flags->append(record);
+	} else {
+		state.segment->new_rows.push_back(record);
+	}
+}
+
+/* Rewrap the next paragraph of @state, appending its new rows' records to state.new_row_stream. */
+bool
+Ring::rewrap_paragraph(RewrapState& state)
+{
+	/* Find the boundaries of the next paragraph */
+	gsize paragraph_start_text_offset = state.text_offset;
+	gsize paragraph_end_text_offset = state.text_end;  /* initialized to silence gcc */
+	gsize paragraph_len;  /* excluding trailing '\n' */
+        gsize paragraph_width = 0;
+	gboolean prev_record_was_soft_wrapped = FALSE;
+	gboolean paragraph_is_ascii = TRUE;
+        guint8 paragraph_bidi_flags = state.old_record.bidi_flags;
+	gsize text_offset = paragraph_start_text_offset;
+	auto const columns = state.columns;
+	RowRecord new_record;
+	column_t col = 0;
+	bool in_prompt = false;  /* whether the previous character is in a prompt */
+	int i;
+
+	_vte_debug_print(VTE_DEBUG_RING,
+			"  Old paragraph:  row %lu  (text_offset %" G_GSIZE_FORMAT ")  up to (exclusive)  ",  /* no '\n' */
+                         state.old_row - 1,
+                         paragraph_start_text_offset);
+	while (state.old_row <= state.old_end) {
+                paragraph_width += state.old_record.width;
+		prev_record_was_soft_wrapped = state.old_record.soft_wrapped;
+		paragraph_is_ascii = paragraph_is_ascii && state.old_record.is_ascii;
+		if (G_LIKELY (state.old_row < state.old_end)) {
+			if (!rewrap_read_row_record(state, &state.old_record, state.old_row))
+				return false;
+			paragraph_end_text_offset = state.old_record.text_start_offset;
+		} else {
+			paragraph_end_text_offset = state.text_end;
+		}
+		state.old_row++;
+		if (!prev_record_was_soft_wrapped)
+			break;
+	}
+
+	paragraph_len = paragraph_end_text_offset - paragraph_start_text_offset;
+	if (!prev_record_was_soft_wrapped)  /* The last paragraph can be soft wrapped! */
+		paragraph_len--;  /* Strip trailing '\n' */
+	_vte_debug_print(VTE_DEBUG_RING,
+			"row %lu  (text_offset %" G_GSIZE_FORMAT ")%s  len %" G_GSIZE_FORMAT "  is_ascii %d\n",
+                         state.old_row - 1,
+                         paragraph_end_text_offset,
+			prev_record_was_soft_wrapped ? "  soft_wrapped" : "",
+			paragraph_len, paragraph_is_ascii);
+	/* Wrap the paragraph */
+	if (state.attr_change.text_end_offset <= text_offset) {
+		/* Attr change at paragraph boundary, advance to next attr. */
+                state.attr_offset += sizeof (state.attr_change) + state.attr_change.attr.hyperlink_length + 2;
+		rewrap_read_attr_change(state);
+	}
+	memset(&new_record, 0, sizeof (new_record));
+	new_record.text_start_offset = text_offset;
+	new_record.attr_start_offset = state.attr_offset;
+	new_record.is_ascii = paragraph_is_ascii;
+        new_record.bidi_flags = paragraph_bidi_flags;
+
+	while (paragraph_len > 0) {
+		/* Wrap one continuous run of identical attributes within the paragraph. */
+		gsize runlength;  /* number of bytes we process in one run: identical attributes, within paragraph */
+		if (state.attr_change.text_end_offset <= text_offset) {
+			/* Attr change at line boundary, advance to next attr. */
+                        state.attr_offset += sizeof (state.attr_change) + state.attr_change.attr.hyperlink_length + 2;
+			rewrap_read_attr_change(state);
+		}
+		runlength = MIN(paragraph_len, state.attr_change.text_end_offset - text_offset);
+
+		/* Note where a prompt begins, see contains_prompt_beginning(), and
+		   which rows have hyperlinks. Combining characters go with the previous one. */
+		auto const has_hyperlink = state.attr_change.attr.hyperlink_length != 0;
+		auto prompt_start = false;
+		if (state.attr_change.attr.columns() != 0) {
+			auto const is_prompt = state.attr_change.attr.shellintegration() == ShellIntegrationMode::ePROMPT;
+			prompt_start = is_prompt && !in_prompt;
+			in_prompt = is_prompt;
+		}
+
+                if (paragraph_width <= (gsize) columns) {
+                        /* Quick shortcut code path if the entire paragraph fits in one row. */
+                        text_offset += runlength;
+                        paragraph_len -= runlength;
+                        /* The setting of "col" here is hacky. This very code here is potentially executed
+                           multiple times within a single paragraph, if it has attribute changes. The code above
+                           that reads the next attribute record has to iterate through those changes. Yet, we
+                           don't want to waste time tracking those attribute changes and finding their
+                           corresponding text offsets, we don't even want to read the text, as we won't need
+                           that. We rely on the fact that "paragraph_width" and "columns" are constants
+                           thoughout the wrapping of a particular paragraph, hence if this branch is hit once
+                           then it is hit every time; also "col" is unused then in this loop and only needs to
+                           have the correct value after we leave the loop. So each time simply set "col"
+                           straight away to its final value. */
+                        col = paragraph_width;
+                        if (prompt_start)
+                                new_record.prompt_start = 1;
+                        if (has_hyperlink)
+                                new_record.has_hyperlink = 1;
+                } else if (G_UNLIKELY (state.attr_change.attr.columns() == 0)) {
+			/* Combining characters all fit in the current row */
+			text_offset += runlength;
+			paragraph_len -= runlength;
+		} else {
+			while (runlength) {
+				if (col >= columns - state.attr_change.attr.columns() + 1) {
+					/* Wrap now, write the soft wrapped row's record */
+                                        new_record.width = col;
+					new_record.soft_wrapped = 1;
+					rewrap_append_row_record(state, new_record);
+					_vte_debug_print(VTE_DEBUG_RING,
+							"    New row %ld  text_offset %" G_GSIZE_FORMAT "  attr_offset %" G_GSIZE_FORMAT "  soft_wrapped\n",
+							state.new_row,
+							new_record.text_start_offset, new_record.attr_start_offset);
+					for (i = 0; i < state.num_markers; i++) {
+						if (G_UNLIKELY (state.marker_text_offsets[i].text_offset >= new_record.text_start_offset &&
+								state.marker_text_offsets[i].text_offset < text_offset)) {
+							state.new_markers[i].row = state.new_row;
+							_vte_debug_print(VTE_DEBUG_RING,
+									"      Marker #%d will be here in row %lu\n", i, state.new_row);
+						}
+					}
+
+#if WITH_SIXEL
+					if (state.rewrap_images &&
+                                            !rewrap_images_in_range(m_rewrap_image_it,
+                                                                    new_record.text_start_offset,
+                                                                    text_offset,
+                                                                    state.new_row))
+						return false;
+#endif
+
+					state.new_row++;
+					new_record.text_start_offset = text_offset;
+					new_record.attr_start_offset = state.attr_offset;
+					new_record.prompt_start = 0;
+					new_record.has_hyperlink = 0;
+					col = 0;
+				}
+				if (prompt_start) {
+					new_record.prompt_start = 1;
+					prompt_start = false;
+				}
+				if (has_hyperlink)
+					new_record.has_hyperlink = 1;
+				if (paragraph_is_ascii) {
+					/* Shortcut for quickly wrapping ASCII (excluding TAB) text.
+					   Don't read text_stream, and advance by a whole row of characters. */
+					int len = MIN(runlength, (gsize) (columns - col));
+					col += len;
+					text_offset += len;
+					paragraph_len -= len;
+					runlength -= len;
+				} else {
+					/* Process one character only. */
+					char textbuf[6];  /* fits at least one UTF-8 character */
+					int textbuf_len;
+					col += state.attr_change.attr.columns();
+					/* Find beginning of next UTF-8 character */
+					text_offset++; paragraph_len--; runlength--;
+					textbuf_len = MIN(runlength, sizeof (textbuf));
+					if (!rewrap_read_text(state, text_offset, textbuf, textbuf_len))
+						return false;
+					for (i = 0; i < textbuf_len && (textbuf[i] & 0xC0) == 0x80; i++) {
+						text_offset++; paragraph_len--; runlength--;
+					}
+				}
+			}
+		}
+	}
+
+	/* Write the record of the paragraph's last row. */
+	/* Hard wrapped, except maybe at the end of the very last paragraph */
+        new_record.width = col;
+	new_record.soft_wrapped = prev_record_was_soft_wrapped;
+	rewrap_append_row_record(state, new_record);
+	_vte_debug_print(VTE_DEBUG_RING,
+			"    New row %ld  text_offset %" G_GSIZE_FORMAT "  attr_offset %" G_GSIZE_FORMAT "\n",
+			state.new_row,
+			new_record.text_start_offset, new_record.attr_start_offset);
+	for (i = 0; i < state.num_markers; i++) {
+		if (G_UNLIKELY (state.marker_text_offsets[i].text_offset >= new_record.text_start_offset &&
+				state.marker_text_offsets[i].text_offset < paragraph_end_text_offset)) {
+			state.new_markers[i].row = state.new_row;
+			_vte_debug_print(VTE_DEBUG_RING,
+					"      Marker #%d will be here in row %lu\n", i, state.new_row);
+		}
+	}
+
+#if WITH_SIXEL
+	if (state.rewrap_images &&
+            !rewrap_images_in_range(m_rewrap_image_it,
+                                    new_record.text_start_offset,
+                                    paragraph_end_text_offset,
+                                    state.new_row))
+		return false;
+#endif
+
+	state.new_row++;
+	state.text_offset = paragraph_end_text_offset;
+
+	return true;
+}
+
+struct Ring::RewrapWave {
+        std::mutex mutex;
+        std::condition_variable cond;
+        size_t pending{0};
+};
+
+/* The number of threads to rewrap on, or 0 for one per processor */
+static int s_rewrap_threads = 0;
+
+/**
+ * Ring::set_rewrap_threads:
+ * @threads: the number of threads, or 0 for one per processor
+ *
+ * Set how many threads to rewrap on, for testing the parallel rewrap on
+ * machines with fewer processors. With less than 2, rewrapping stays on
+ * the calling thread.
+ */
+void
+Ring::set_rewrap_threads(int threads)
+{
+        s_rewrap_threads = MAX(threads, 0);
+}
+
+/* Returns nullptr if there's only one thread to rewrap on. */
+GThreadPool*
+Ring::rewrap_pool()
+{
+        static GThreadPool* pool = nullptr;
+        static bool failed = false;
+
+        auto const threads = s_rewrap_threads ? s_rewrap_threads : int(g_get_num_processors());
+        if (threads < 2 || failed)
+                return nullptr;
+
+        if (G_UNLIKELY(pool == nullptr)) {
+                GError* error = nullptr;
+                pool = g_thread_pool_new(rewrap_segment_func, nullptr, threads, false, &error);
+                if (pool == nullptr) {
+                        g_warning("Failed to create rewrap threads: %s", error->message);
+                        g_error_free(error);
+                        failed = true;
+                }
+        } else if (g_thread_pool_get_max_threads(pool) != threads) {
+                g_thread_pool_set_max_threads(pool, threads, nullptr);
+        }
+
+        return pool;
+}
+
+/* Rewrap the paragraphs of a segment, on a worker thread. */
+void
+Ring::rewrap_segment_func(void* data,
+                          void* user_data)
+{
+        auto const segment = reinterpret_cast<RewrapSegment*>(data);
+        auto& state = segment->state;
+
+        segment->ok = true;
+        while (segment->ok && state.text_offset < state.text_end)
+                segment->ok = segment->ring->rewrap_paragraph(state);
+
+        auto lock = std::lock_guard{segment->wave->mutex};
+        if (--segment->wave->pending == 0)
+                segment->wave->cond.notify_one();
+}
+
+/* Copy the next paragraphs of @state, some k_rewrap_segment_rows rows, into
+ * @segment, and advance @state past them. */
+bool
+Ring::rewrap_segment_begin(RewrapState& state,
+                           RewrapSegment& segment)
+{
+	RowRecord next_record;
+	auto const start = state.old_row - 1;
+	auto end = MIN(start + k_rewrap_segment_rows, state.old_end);
+
+	/* Read the rows, up to the end of a paragraph */
+	segment.start = start;
+	segment.rows.resize(end - start);
+	segment.rows[0] = state.old_record;
+	if (end > start + 1 &&
+	    !read_row_records(segment.rows.data() + 1, start + 1, end - start - 1))
+		return false;
+	while (end < state.old_end && segment.rows.back().soft_wrapped) {
+		if (!read_row_record(&next_record, end))
+			return false;
+		segment.rows.push_back(next_record);
+		end++;
+	}
+
+	auto const has_next = read_row_record(&next_record, end);
+	if (end < state.old_end && !has_next)
+		return false;
+
+	segment.state = state;
+	segment.state.old_end = end;
+	segment.state.text_end = end < state.old_end ? next_record.text_start_offset : state.text_end;
+	segment.state.new_row = 0;
+	segment.state.rewrap_images = false;
+	segment.state.segment = &segment;
+	segment.new_markers.assign(state.num_markers, VteVisualPosition{-1, -1});
+	segment.state.new_markers = segment.new_markers.data();
+
+	/* Copy the text, unless it's all ASCII and won't be read */
+	segment.text_start = state.text_offset;
+	for (auto const& record : segment.rows) {
+		if (record.is_ascii)
+			continue;
+
+		segment.text.resize(segment.state.text_end - segment.text_start);
+		if (!segment.text.empty() &&
+		    !_vte_stream_read(m_text_stream, segment.text_start, segment.text.data(), segment.text.size()))
+			return false;
+		break;
+	}
+
+	/* Copy the attributes up to where the next segment's begin, and then
+	 * on up to the one that reaches beyond the text, or the current one */
+	segment.attr_start = state.attr_offset;
+	auto attr_end = MAX(has_next ? next_record.attr_start_offset : _vte_stream_head(m_attr_stream),
+			    segment.attr_start);
+	segment.attrs.resize(attr_end - segment.attr_start);
+	if (!segment.attrs.empty() &&
+	    !_vte_stream_read(m_attr_stream, segment.attr_start, segment.attrs.data(), segment.attrs.size()))
+		return false;
+	CellAttrChange attr_change;
+	do {
+		read_attr_change(attr_end, &attr_change);
+		auto const len = sizeof (attr_change) + attr_change.attr.hyperlink_length + 2;
+		segment.attrs.resize(segment.attrs.size() + len);
+		memcpy(segment.attrs.data() + attr_end - segment.attr_start, &attr_change, sizeof (attr_change));
+		attr_end += len;
+	} while (attr_change.text_end_offset < segment.state.text_end);
+	rewrap_read_attr_change(segment.state);
+
+	/* The next segment begins with the next row */
+	state.old_row = end + 1;
+	state.text_offset = segment.state.text_end;
+	if (end < state.old_end) {
+		state.old_record = next_record;
+		state.attr_offset = next_record.attr_start_offset;
+	}
+
+	return true;
+}
+
+/* Rewrap the rest of @state's paragraphs in segments, spread across worker
+ * threads, a wave of a few segments per thread at a time. Only the thread
+ * calling this one reads the streams, but in bulk; the workers only see
+ * their segment's copy. */
+bool
+Ring::rewrap_parallel(RewrapState& state)
+{
+	auto const pool = rewrap_pool();
+	auto const wave_size = 4 * size_t(g_thread_pool_get_max_threads(pool));
+#if WITH_SIXEL
+	auto const first_row = state.old_row - 1;
+	auto const first_new_row = state.new_row;
+#endif
+	auto wave = RewrapWave{};
+	auto segments = std::vector<std::unique_ptr<RewrapSegment>>{};
+	auto ok = true;
+
+	_vte_debug_print(VTE_DEBUG_RING,
+			"Rewrapping rows %lu to %lu on %d threads\n",
+			state.old_row - 1, state.old_end, g_thread_pool_get_max_threads(pool));
+
+	while (ok && state.text_offset < state.text_end) {
+		while (segments.size() < wave_size && state.text_offset < state.text_end) {
+			auto segment = std::make_unique<RewrapSegment>();
+			segment->ring = this;
+			segment->wave = &wave;
+			if (!rewrap_segment_begin(state, *segment)) {
+				ok = false;
+				break;
+			}
+
+			{
+				auto lock = std::lock_guard{wave.mutex};
+				wave.pending++;
+			}
+			if (!g_thread_pool_push(pool, segment.get(), nullptr))
+				rewrap_segment_func(segment.get(), nullptr);
+			segments.push_back(std::move(segment));
+		}
+
+		{
+			auto lock = std::unique_lock{wave.mutex};
+			wave.cond.wait(lock, [&] { return wave.pending == 0; });
+		}
+
+		/* Append the new rows in order, numbering them on from the previous segment's */
+		for (auto const& segment : segments) {
+			ok = ok && segment->ok;
+			if (!ok)
+				break;
+
+			for (auto i = 0; i < state.num_markers; i++) {
+				if (segment->new_markers[i].row != -1)
+					state.new_markers[i].row = state.new_row + segment->new_markers[i].row;
+			}
+			_vte_stream_append(state.new_row_stream,
+					   (char const*) segment->new_rows.data(),
+					   segment->new_rows.size() * sizeof (RowRecord));
+			for (auto const& record : segment->new_rows)
+				state.new_row_flags->append(record);
+			state.new_row += segment->new_rows.size();
+		}
+		segments.clear();
+	}
+
+	if (!ok)
+		return false;
+
+#if WITH_SIXEL
+	if (state.rewrap_images)
+		rewrap_images_to_rows(first_row, state.old_end, state.new_row_stream, first_new_row, state.new_row, 0);
+#endif
+
+	state.old_row = state.old_end + 1;
+	return true;
+}
+
+/* Rewrap the rest of @state's paragraphs, in parallel if there are many. */
+bool
+Ring::rewrap_remaining(RewrapState& state)
+{
+	if (state.old_row + k_parallel_rewrap_min_rows <= state.old_end && rewrap_pool() != nullptr)
+		return rewrap_parallel(state);
+
+	while (state.text_offset < state.text_end) {
+		if (!rewrap_paragraph(state))
+			return false;
+	}
+
+	return true;
+}
+
+/* The start of the paragraph a screenful above @position, where rewrapping
+ * has to start to get the rows from there on right. */
+Ring::row_t
+Ring::rewrap_boundary(row_t position)
+{
+	RowRecord record;
+	auto row = position > m_start + m_visible_rows ? position - m_visible_rows : m_start;
+
+	while (row > m_start && read_row_record(&record, row - 1) && record.soft_wrapped)
+		row--;
+
+	return row;
+}
+
 /**
  * Ring::rewrap:
  * @columns: new number of columns
@@ -1313,34 +2478,37 @@ Ring::frozen_row_text_offset_to_column(row_t position,
  * Reflow the @ring to match the new number of @columns.
  * For all @markers, find the cell at that position and update them to
  * reflect the cell's new position.
+ *
+ * Only the paragraphs from a screenful above the topmost marker on are
+ * rewrapped right away, which is all that's visible usually. If there
+ * is much history above them, it's rewrapped later by rewrap_some(), or
+ * as soon as any of it is accessed. Meanwhile these rows keep their
+ * records for the old width, and the rows below them are numbered from
+ * high enough that they keep their numbers however many rows the ones
+ * above rewrap to. Resizing again before that carries on the same way,
+ * discarding the partial rewrap for the old width.
  */
 /* See ../doc/rewrap.txt for design and implementation details. */
 void
 Ring::rewrap(column_t columns,
              VteVisualPosition** markers)
 {
-	row_t old_row_index, new_row_index;
 	int i;
 	int num_markers = 0;
 	CellTextOffset *marker_text_offsets;
 	VteVisualPosition *new_markers;
-	RowRecord old_record;
-	CellAttrChange attr_change;
-	VteStream *new_row_stream;
-	gsize paragraph_start_text_offset;
-	gsize paragraph_end_text_offset;
-	gsize paragraph_len;  /* excluding trailing '\n' */
-	gsize attr_offset;
+	RewrapState state;
+	RowFlags new_row_flags;
+	RowRecord start_record;
+	row_t min_marker_row, boundary, stale_rows, seam = 0;
+	gsize stale_text_end = 0;
 	gsize old_ring_end;
-#if WITH_SIXEL
-	auto image_it = m_image_by_top_map.begin();
-#endif
 
 	if (G_UNLIKELY(length() == 0))
 		return;
+        VTE_PROBE(rewrap_start, this, columns, length());
 	_vte_debug_print(VTE_DEBUG_RING, "Ring before rewrapping:\n");
         validate();
-	new_row_stream = _vte_file_stream_new();
 
 	/* Freeze everything, because rewrapping is really complicated and we don't want to
 	   duplicate the code for frozen and thawed rows. */
@@ -1353,218 +2521,115 @@ Ring::rewrap(column_t columns,
 		num_markers++;
 	marker_text_offsets = (CellTextOffset *) g_malloc(num_markers * sizeof (marker_text_offsets[0]));
 	new_markers = (VteVisualPosition *) g_malloc(num_markers * sizeof (new_markers[0]));
+	state.new_row_stream = nullptr;
+	min_marker_row = m_end;
 	for (i = 0; i < num_markers; i++) {
 		/* Convert visual column into byte offset */
 		if (!frozen_row_column_to_text_offset(markers[i]->row, markers[i]->col, &marker_text_offsets[i]))
 			goto err;
 		new_markers[i].row = new_markers[i].col = -1;
+		min_marker_row = MIN(min_marker_row, (row_t) MAX(markers[i]->row, (long) m_start));
 		_vte_debug_print(VTE_DEBUG_RING,
 				"Marker #%d old coords:  row %ld  col %ld  ->  text_offset %" G_GSIZE_FORMAT " fragment_cells %d  eol_cells %d\n",
 				i, markers[i]->row, markers[i]->col, marker_text_offsets[i].text_offset,
 				marker_text_offsets[i].fragment_cells, marker_text_offsets[i].eol_cells);
 	}
 
-	/* Prepare for rewrapping */
-	if (!read_row_record(&old_record, m_start))
-		goto err;
-	paragraph_start_text_offset = old_record.text_start_offset;
-	paragraph_end_text_offset = _vte_stream_head(m_text_stream);  /* initialized to silence gcc */
-	new_row_index = 0;
-
-	attr_offset = old_record.attr_start_offset;
-	if (!_vte_stream_read(m_attr_stream, attr_offset, (char *) &attr_change, sizeof (attr_change))) {
-                _attrcpy(&attr_change.attr, &m_last_attr);
-                attr_change.attr.hyperlink_length = hyperlink_get(m_last_attr.hyperlink_idx)->len;
-		attr_change.text_end_offset = _vte_stream_head(m_text_stream);
+	/* Find where to start rewrapping now. The markers' text offsets stay valid
+	   across finishing a pending rewrap, their rows don't. */
+	boundary = rewrap_boundary(min_marker_row);
+	if (boundary < m_rewrap_seam) {
+		finish_rewrap();
+		boundary = m_start;
+	} else if (!rewrap_pending() && boundary - m_start < k_lazy_rewrap_min_rows) {
+		boundary = m_start;
 	}
+	stale_rows = boundary - m_start;
 
-	old_row_index = m_start + 1;
-	while (paragraph_start_text_offset < _vte_stream_head(m_text_stream)) {
-		/* Find the boundaries of the next paragraph */
-                gsize paragraph_width = 0;
-		gboolean prev_record_was_soft_wrapped = FALSE;
-		gboolean paragraph_is_ascii = TRUE;
-                guint8 paragraph_bidi_flags = old_record.bidi_flags;
-		gsize text_offset = paragraph_start_text_offset;
-		RowRecord new_record;
-		column_t col = 0;
-
-		_vte_debug_print(VTE_DEBUG_RING,
-				"  Old paragraph:  row %lu  (text_offset %" G_GSIZE_FORMAT ")  up to (exclusive)  ",  /* no '\n' */
-                                 old_row_index - 1,
-                                 paragraph_start_text_offset);
-		while (old_row_index <= m_end) {
-                        paragraph_width += old_record.width;
-			prev_record_was_soft_wrapped = old_record.soft_wrapped;
-			paragraph_is_ascii = paragraph_is_ascii && old_record.is_ascii;
-			if (G_LIKELY (old_row_index < m_end)) {
-				if (!read_row_record(&old_record, old_row_index))
-					goto err;
-				paragraph_end_text_offset = old_record.text_start_offset;
-			} else {
-				paragraph_end_text_offset = _vte_stream_head (m_text_stream);
-			}
-			old_row_index++;
-			if (!prev_record_was_soft_wrapped)
-				break;
-		}
-
-		paragraph_len = paragraph_end_text_offset - paragraph_start_text_offset;
-		if (!prev_record_was_soft_wrapped)  /* The last paragraph can be soft wrapped! */
-			paragraph_len--;  /* Strip trailing '\n' */
-		_vte_debug_print(VTE_DEBUG_RING,
-				"row %lu  (text_offset %" G_GSIZE_FORMAT ")%s  len %" G_GSIZE_FORMAT "  is_ascii %d\n",
-                                 old_row_index - 1,
-                                 paragraph_end_text_offset,
-				prev_record_was_soft_wrapped ? "  soft_wrapped" : "",
-				paragraph_len, paragraph_is_ascii);
-		/* Wrap the paragraph */
-		if (attr_change.text_end_offset <= text_offset) {
-			/* Attr change at paragraph boundary, advance to next attr. */
-                        attr_offset += sizeof (attr_change) + attr_change.attr.hyperlink_length + 2;
-			if (!_vte_stream_read(m_attr_stream, attr_offset, (char *) &attr_change, sizeof (attr_change))) {
-                                _attrcpy(&attr_change.attr, &m_last_attr);
-                                attr_change.attr.hyperlink_length = hyperlink_get(m_last_attr.hyperlink_idx)->len;
-				attr_change.text_end_offset = _vte_stream_head(m_text_stream);
-			}
-		}
-		memset(&new_record, 0, sizeof (new_record));
-		new_record.text_start_offset = text_offset;
-		new_record.attr_start_offset = attr_offset;
-		new_record.is_ascii = paragraph_is_ascii;
-                new_record.bidi_flags = paragraph_bidi_flags;
-
-		while (paragraph_len > 0) {
-			/* Wrap one continuous run of identical attributes within the paragraph. */
-			gsize runlength;  /* number of bytes we process in one run: identical attributes, within paragraph */
-			if (attr_change.text_end_offset <= text_offset) {
-				/* Attr change at line boundary, advance to next attr. */
-                                attr_offset += sizeof (attr_change) + attr_change.attr.hyperlink_length + 2;
-				if (!_vte_stream_read(m_attr_stream, attr_offset, (char *) &attr_change, sizeof (attr_change))) {
-                                        _attrcpy(&attr_change.attr, &m_last_attr);
-                                        attr_change.attr.hyperlink_length = hyperlink_get(m_last_attr.hyperlink_idx)->len;
-					attr_change.text_end_offset = _vte_stream_head(m_text_stream);
-				}
-			}
-			runlength = MIN(paragraph_len, attr_change.text_end_offset - text_offset);
-
-                        if (paragraph_width <= (gsize) columns) {
-                                /* Quick shortcut code path if the entire paragraph fits in one row. */
-                                text_offset += runlength;
-                                paragraph_len -= runlength;
-                                /* The setting of "col" here is hacky. This very code here is potentially executed
-                                   multiple times within a single paragraph, if it has attribute changes. The code above
-                                   that reads the next attribute record has to iterate through those changes. Yet, we
-                                   don't want to waste time tracking those attribute changes and finding their
-                                   corresponding text offsets, we don't even want to read the text, as we won't need
-                                   that. We rely on the fact that "paragraph_width" and "columns" are constants
-                                   thoughout the wrapping of a particular paragraph, hence if this branch is hit once
-                                   then it is hit every time; also "col" is unused then in this loop and only needs to
-                                   have the correct value after we leave the loop. So each time simply set "col"
-                                   straight away to its final value. */
-                                col = paragraph_width;
-                        } else if (G_UNLIKELY (attr_change.attr.columns() == 0)) {
-				/* Combining characters all fit in the current row */
-				text_offset += runlength;
-				paragraph_len -= runlength;
-			} else {
-				while (runlength) {
-					if (col >= columns - attr_change.attr.columns() + 1) {
-						/* Wrap now, write the soft wrapped row's record */
-                                                new_record.width = col;
-						new_record.soft_wrapped = 1;
-						_vte_stream_append(new_row_stream, (char const* ) &new_record, sizeof (new_record));
-						_vte_debug_print(VTE_DEBUG_RING,
-								"    New row %ld  text_offset %" G_GSIZE_FORMAT "  attr_offset %" G_GSIZE_FORMAT "  soft_wrapped\n",
-								new_row_index,
-								new_record.text_start_offset, new_record.attr_start_offset);
-						for (i = 0; i < num_markers; i++) {
-							if (G_UNLIKELY (marker_text_offsets[i].text_offset >= new_record.text_start_offset &&
-									marker_text_offsets[i].text_offset < text_offset)) {
-								new_markers[i].row = new_row_index;
-								_vte_debug_print(VTE_DEBUG_RING,
-										"      Marker #%d will be here in row %lu\n", i, new_row_index);
-							}
-						}
-
+	/* Prepare for rewrapping */
+	if (!rewrap_begin(state, boundary, m_end, _vte_stream_head(m_text_stream)))
+		goto err;
+	state.columns = columns;
+	state.new_row = 0;
+	state.new_row_stream = new_stream();
+	state.new_row_flags = &new_row_flags;
+	state.num_markers = num_markers;
+	state.marker_text_offsets = marker_text_offsets;
+	state.new_markers = new_markers;
+	state.rewrap_images = true;
 #if WITH_SIXEL
-						if (!rewrap_images_in_range(image_it,
-                                                                            new_record.text_start_offset,
-                                                                            text_offset,
-                                                                            new_row_index))
-							goto err;
+	m_rewrap_image_it = m_image_by_top_map.lower_bound(stale_rows ? boundary : 0);
 #endif
 
-						new_row_index++;
-						new_record.text_start_offset = text_offset;
-						new_record.attr_start_offset = attr_offset;
-						col = 0;
-					}
-					if (paragraph_is_ascii) {
-						/* Shortcut for quickly wrapping ASCII (excluding TAB) text.
-						   Don't read text_stream, and advance by a whole row of characters. */
-						int len = MIN(runlength, (gsize) (columns - col));
-						col += len;
-						text_offset += len;
-						paragraph_len -= len;
-						runlength -= len;
-					} else {
-						/* Process one character only. */
-						char textbuf[6];  /* fits at least one UTF-8 character */
-						int textbuf_len;
-						col += attr_change.attr.columns();
-						/* Find beginning of next UTF-8 character */
-						text_offset++; paragraph_len--; runlength--;
-						textbuf_len = MIN(runlength, sizeof (textbuf));
-						if (!_vte_stream_read(m_text_stream, text_offset, textbuf, textbuf_len))
-							goto err;
-						for (i = 0; i < textbuf_len && (textbuf[i] & 0xC0) == 0x80; i++) {
-							text_offset++; paragraph_len--; runlength--;
-						}
-					}
-				}
-			}
-		}
-
-		/* Write the record of the paragraph's last row. */
-		/* Hard wrapped, except maybe at the end of the very last paragraph */
-                new_record.width = col;
-		new_record.soft_wrapped = prev_record_was_soft_wrapped;
-		_vte_stream_append(new_row_stream, (char const* ) &new_record, sizeof (new_record));
-		_vte_debug_print(VTE_DEBUG_RING,
-				"    New row %ld  text_offset %" G_GSIZE_FORMAT "  attr_offset %" G_GSIZE_FORMAT "\n",
-				new_row_index,
-				new_record.text_start_offset, new_record.attr_start_offset);
-		for (i = 0; i < num_markers; i++) {
-			if (G_UNLIKELY (marker_text_offsets[i].text_offset >= new_record.text_start_offset &&
-					marker_text_offsets[i].text_offset < paragraph_end_text_offset)) {
-				new_markers[i].row = new_row_index;
-				_vte_debug_print(VTE_DEBUG_RING,
-						"      Marker #%d will be here in row %lu\n", i, new_row_index);
-			}
-		}
-
-#if WITH_SIXEL
-		if (!rewrap_images_in_range(image_it,
-                                            new_record.text_start_offset,
-                                            paragraph_end_text_offset,
-                                            new_row_index))
+	if (stale_rows) {
+		/* A paragraph rewraps to at most one row per character, plus one. */
+		if (!read_row_record(&start_record, m_start))
 			goto err;
-#endif
-
-		new_row_index++;
-		paragraph_start_text_offset = paragraph_end_text_offset;
+		stale_text_end = state.text_offset;
+		seam = stale_text_end - start_record.text_start_offset + stale_rows;
+		state.new_row = seam;
+		_vte_stream_reset(state.new_row_stream, seam * sizeof (RowRecord));
+		new_row_flags.reset(seam);
+		_vte_debug_print(VTE_DEBUG_RING,
+				"Rewrapping from row %lu on, the %lu rows above later\n",
+				boundary, stale_rows);
 	}
 
+	if (!rewrap_remaining(state))
+		goto err;
+
 	/* Update the ring. */
 	old_ring_end = m_end;
-	g_object_unref(m_row_stream);
-	m_row_stream = new_row_stream;
-	m_writable = m_end = new_row_index;
-	m_start = 0;
-	if (m_end > m_max)
-		m_start = m_end - m_max;
-	m_cached_row_num = (row_t) -1;
+	if (stale_rows) {
+		if (rewrap_pending()) {
+			/* Move the rows rewrapped last time, but above the markers now, to the stale ones */
+			_vte_stream_truncate(m_stale_row_stream, m_stale_row_end * sizeof (RowRecord));
+			copy_stream(m_stale_row_stream, m_row_stream,
+				    m_rewrap_seam * sizeof (RowRecord), boundary * sizeof (RowRecord));
+			m_stale_row_end += boundary - m_rewrap_seam;
+			g_object_unref(m_row_stream);
+			if (m_rewrap.new_row_stream != nullptr)
+				g_object_unref(m_rewrap.new_row_stream);
+			m_rewrap.new_row_stream = nullptr;
+		} else {
+			m_stale_row_stream = m_row_stream;
+			m_stale_row_end = boundary;
+		}
+		m_rewrap_seam = seam;
+		m_row_stream = state.new_row_stream;
+		m_row_flags = std::move(new_row_flags);
+		m_writable = m_end = state.new_row;
+		m_start = seam - stale_rows;
+		if (m_end - m_start > m_max)
+			m_start = m_end - m_max;
+
+		if (m_start >= m_rewrap_seam) {
+			cancel_rewrap();
+		} else if (rewrap_begin(m_rewrap, m_start, m_rewrap_seam, stale_text_end)) {
+			m_rewrap.columns = columns;
+			m_rewrap.new_row = 0;
+			m_rewrap.new_row_stream = new_stream();
+			m_rewrap.new_row_flags = &m_rewrap_row_flags;
+			m_rewrap_row_flags.reset(0);
+			m_rewrap.num_markers = 0;
+			m_rewrap.marker_text_offsets = nullptr;
+			m_rewrap.new_markers = nullptr;
+			m_rewrap.rewrap_images = false;
+		} else {
+			/* Drop what can't be rewrapped */
+			m_start = m_rewrap_seam;
+			cancel_rewrap();
+		}
+	} else {
+		g_object_unref(m_row_stream);
+		m_row_stream = state.new_row_stream;
+		m_row_flags = std::move(new_row_flags);
+		m_writable = m_end = state.new_row;
+		m_start = 0;
+		if (m_end > m_max)
+			m_start = m_end - m_max;
+	}
+	invalidate_cached_rows();
 
 	/* Find the markers. This requires that the ring is already updated. */
 	for (i = 0; i < num_markers; i++) {
@@ -1588,6 +2653,14 @@ Ring::rewrap(column_t columns,
 	g_free(new_markers);
 
 #if WITH_SIXEL
+	/* The images above the boundary move along with their rows */
+	if (stale_rows) {
+		for (auto it = m_image_by_top_map.begin(), end = m_image_by_top_map.lower_bound(boundary);
+		     it != end;
+		     ++it)
+			it->second->set_top(it->second->get_top() - long(boundary) + long(m_rewrap_seam));
+	}
+
         try {
                 rebuild_image_top_map();
         } catch (...) {
@@ -1597,6 +2670,7 @@ Ring::rewrap(column_t columns,
 
 	_vte_debug_print(VTE_DEBUG_RING, "Ring after rewrapping:\n");
         validate();
+        VTE_PROBE(rewrap_end, this, columns, length());
 	return;
 
 err:
@@ -1605,11 +2679,154 @@ err:
 			"Error while rewrapping\n");
 	g_assert_not_reached();
 #endif
-	g_object_unref(new_row_stream);
+	if (state.new_row_stream != nullptr)
+		g_object_unref(state.new_row_stream);
 	g_free(marker_text_offsets);
 	g_free(new_markers);
 }
 
+/**
+ * Ring::rewrap_some:
+ * @rows: roughly how many of the rows left by rewrap() to rewrap
+ *
+ * Continue a lazy rewrap, see rewrap().
+ *
+ * Returns: whether there's more to rewrap
+ */
+bool
+Ring::rewrap_some(row_t rows)
+{
+	if (!rewrap_pending())
+		return false;
+
+	auto const end = m_rewrap.old_row + rows;
+	while (m_rewrap.text_offset < m_rewrap.text_end) {
+		if (m_rewrap.old_row >= end)
+			return true;
+
+		if (!rewrap_paragraph(m_rewrap)) {
+			abandon_rewrap();
+			return false;
+		}
+	}
+
+	complete_rewrap();
+	return false;
+}
+
+/**
+ * Ring::finish_rewrap:
+ *
+ * Complete a lazy rewrap, see rewrap().
+ */
+void
+Ring::finish_rewrap()
+{
+	if (!rewrap_pending())
+		return;
+
+	if (rewrap_remaining(m_rewrap))
+		complete_rewrap();
+	else
+		abandon_rewrap();
+}
+
+/* Replace the stale rows by the ones they rewrapped to. */
+void
+Ring::complete_rewrap()
+{
+	auto const rewrapped = m_rewrap.new_row;
+	vte_assert_cmpuint(rewrapped, <=, m_rewrap_seam);
+	auto const start = m_rewrap_seam - rewrapped;
+
+	/* Stale rows discarded meanwhile were rewrapped too. Find the first
+	 * new row that doesn't start before the text of the oldest one kept,
+	 * so as not to bring them back. */
+	auto kept = row_t{0};
+	RowRecord record;
+	if (read_row_record(&record, m_start)) {
+		auto high = rewrapped;
+		while (kept < high) {
+			auto const mid = kept + (high - kept) / 2;
+			RowRecord new_record;
+			if (!_vte_stream_read(m_rewrap.new_row_stream, mid * sizeof(new_record),
+					      (char*)&new_record, sizeof(new_record)))
+				break;
+			if (new_record.text_start_offset < record.text_start_offset)
+				kept = mid + 1;
+			else
+				high = mid;
+		}
+	}
+
+	_vte_debug_print(VTE_DEBUG_RING,
+			"Rewrapped the %lu rows above row %lu to %lu\n",
+			m_rewrap_seam - m_start, m_rewrap_seam, rewrapped);
+
+#if WITH_SIXEL
+	rewrap_images_to_rows(0, m_rewrap_seam, m_rewrap.new_row_stream, 0, rewrapped, start);
+#endif
+
+	auto const stream = new_stream();
+	_vte_stream_reset(stream, start * sizeof (RowRecord));
+	copy_stream(stream, m_rewrap.new_row_stream, 0, rewrapped * sizeof (RowRecord));
+	copy_stream(stream, m_row_stream, m_rewrap_seam * sizeof (RowRecord), _vte_stream_head(m_row_stream));
+	g_object_unref(m_row_stream);
+	m_row_stream = stream;
+
+	auto flags = RowFlags{};
+	flags.reset(start);
+	flags.append(m_rewrap_row_flags, 0, rewrapped);
+	flags.append(m_row_flags, m_rewrap_seam, m_row_flags.head());
+	m_row_flags = std::move(flags);
+	cancel_rewrap();
+
+	/* Drop the discarded rows again. The new rows differ in size from the
+	 * stale ones, so check the quota too. */
+	m_start = start + kept;
+	if (m_end - m_start > m_max)
+		m_start = m_end - m_max;
+	invalidate_cached_rows();
+	maybe_discard_for_quota();
+
+#if WITH_SIXEL
+        try {
+                rebuild_image_top_map();
+        } catch (...) {
+                vte::log_exception();
+        }
+#endif
+
+        validate();
+}
+
+/* Drop the stale rows that can't be rewrapped. */
+void
+Ring::abandon_rewrap()
+{
+#if VTE_DEBUG
+	_vte_debug_print(VTE_DEBUG_RING,
+			"Error while rewrapping\n");
+	g_assert_not_reached();
+#endif
+	m_start = m_rewrap_seam;
+	invalidate_cached_rows();
+	cancel_rewrap();
+}
+
+/* Forget about the lazy rewrap, the stale rows are gone. */
+void
+Ring::cancel_rewrap()
+{
+	if (m_stale_row_stream != nullptr)
+		g_object_unref(m_stale_row_stream);
+	if (m_rewrap.new_row_stream != nullptr)
+		g_object_unref(m_rewrap.new_row_stream);
+	m_stale_row_stream = m_rewrap.new_row_stream = nullptr;
+	m_rewrap_row_flags.reset(0);
+	m_rewrap_seam = m_stale_row_end = 0;
+}
+
 
 bool
 Ring::write_row(GOutputStream* stream,
@@ -1657,6 +2874,8 @@ Ring::write_contents(GOutputStream* stream,
 
 	_vte_debug_print(VTE_DEBUG_RING, "Writing contents to GOutputStream.\n");
 
+	finish_rewrap();
+
 	if (m_start < m_writable)
 	{
 		RowRecord record;
@@ -1699,6 +2918,271 @@ Ring::write_contents(GOutputStream* stream,
 	return true;
 }
 
+/* The beginning of a ring's snapshot, see Ring::save_snapshot() */
+struct RingSnapshotHeader {
+        uint32_t row_record_size;
+        uint32_t attr_change_size;
+        uint64_t start;
+        uint64_t end;
+        uint64_t writable;
+        uint64_t last_attr_text_start_offset;
+};
+
+static bool
+snapshot_read(GInputStream* stream,
+              void* buffer,
+              gsize len,
+              GCancellable* cancellable,
+              GError** error)
+{
+        gsize bytes_read;
+
+        if (!g_input_stream_read_all(stream, buffer, len, &bytes_read, cancellable, error))
+                return false;
+        if (bytes_read != len) {
+                g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+                                    "Truncated scrollback snapshot");
+                return false;
+        }
+        return true;
+}
+
+/**
+ * Ring::save_snapshot:
+ * @stream: a #GOutputStream to write to
+ * @cancellable: optional #GCancellable object, %nullptr to ignore
+ * @error: a #GError location to store the error occuring, or %nullptr to ignore
+ *
+ * Write the ring's rows to @stream in its own format, for load_snapshot()
+ * to restore them without parsing them again. The writable rows are frozen
+ * meanwhile, and the streams' compressed blocks are copied as they are, see
+ * _vte_file_stream_save(). Images are not saved.
+ *
+ * Return: %TRUE on success, %FALSE if there was an error
+ */
+bool
+Ring::save_snapshot(GOutputStream* stream,
+                    GCancellable* cancellable,
+                    GError** error)
+{
+        if (!m_has_streams) {
+                g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                                    "The ring has no scrollback to save");
+                return false;
+        }
+
+        _vte_debug_print(VTE_DEBUG_RING, "Saving a snapshot.\n");
+
+        finish_rewrap();
+
+        auto const writable = m_writable;
+        while (m_writable < m_end)
+                freeze_one_row();
+
+        RingSnapshotHeader header;
+        memset(&header, 0, sizeof(header));
+        header.row_record_size = sizeof(RowRecord);
+        header.attr_change_size = sizeof(CellAttrChange);
+        header.start = m_start;
+        header.end = m_end;
+        header.writable = writable;
+        header.last_attr_text_start_offset = m_last_attr_text_start_offset;
+
+        /* Like in the attr stream, the hyperlink follows the attr */
+        CellAttrChange last_attr;
+        memset(&last_attr, 0, sizeof(last_attr));
+        _attrcpy(&last_attr.attr, &m_last_attr);
+        auto const hyperlink = hyperlink_get(m_last_attr.hyperlink_idx);
+        last_attr.attr.hyperlink_length = hyperlink->len;
+
+        gsize bytes_written;
+        auto const ok =
+                g_output_stream_write_all(stream, &header, sizeof(header), &bytes_written, cancellable, error) &&
+                g_output_stream_write_all(stream, &last_attr, sizeof(last_attr), &bytes_written, cancellable, error) &&
+                g_output_stream_write_all(stream, hyperlink->str, hyperlink->len, &bytes_written, cancellable, error) &&
+                _vte_file_stream_save(m_row_stream, stream, cancellable, error) &&
+                _vte_file_stream_save(m_text_stream, stream, cancellable, error) &&
+                _vte_file_stream_save(m_attr_stream, stream, cancellable, error);
+
+        thaw_rows(writable);
+        validate();
+
+        return ok;
+}
+
+/**
+ * Ring::load_snapshot:
+ * @stream: a #GInputStream to read from
+ * @cancellable: optional #GCancellable object, %nullptr to ignore
+ * @error: a #GError location to store the error occuring, or %nullptr to ignore
+ *
+ * Replace the ring's rows by the ones saved by save_snapshot(), at the same
+ * positions. If there are more of them than the ring can hold, only the last
+ * ones are kept. The row records and the attribute changes are checked
+ * against each other and the streams here; the text is checked for UTF-8
+ * as it's thawed.
+ *
+ * Return: %TRUE on success, %FALSE if there was an error, in which case the
+ *   ring is left as it was
+ */
+bool
+Ring::load_snapshot(GInputStream* stream,
+                    GCancellable* cancellable,
+                    GError** error)
+{
+        if (!m_has_streams) {
+                g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                                    "The ring has no scrollback to restore");
+                return false;
+        }
+
+        _vte_debug_print(VTE_DEBUG_RING, "Loading a snapshot.\n");
+
+        RingSnapshotHeader header;
+        if (!snapshot_read(stream, &header, sizeof(header), cancellable, error))
+                return false;
+        if (header.row_record_size != sizeof(RowRecord) ||
+            header.attr_change_size != sizeof(CellAttrChange)) {
+                g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                                    "Scrollback snapshot from a different architecture");
+                return false;
+        }
+
+        CellAttrChange last_attr;
+        char hyperlink[VTE_HYPERLINK_TOTAL_LENGTH_MAX + 1];
+        if (!snapshot_read(stream, &last_attr, sizeof(last_attr), cancellable, error))
+                return false;
+        if (header.start > header.writable ||
+            header.writable > header.end ||
+            header.end > G_MAXSIZE / sizeof(RowRecord) ||
+            last_attr.attr.hyperlink_length > VTE_HYPERLINK_TOTAL_LENGTH_MAX) {
+                g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                                    "Corrupt scrollback snapshot");
+                return false;
+        }
+        if (!snapshot_read(stream, hyperlink, last_attr.attr.hyperlink_length, cancellable, error))
+                return false;
+        hyperlink[last_attr.attr.hyperlink_length] = '\0';
+
+        auto const row_stream = new_stream();
+        auto const text_stream = new_stream();
+        auto const attr_stream = new_stream();
+        auto ok = _vte_file_stream_load(row_stream, stream, cancellable, error) &&
+                _vte_file_stream_load(text_stream, stream, cancellable, error) &&
+                _vte_file_stream_load(attr_stream, stream, cancellable, error);
+
+        row_t const end = header.end;
+        auto start = row_t(header.start);
+        if (end - start > m_max)
+                start = end - m_max;
+
+        /* Check the records against the streams, and keep their flags */
+        auto row_flags = RowFlags{};
+        if (ok) {
+                auto const text_head = _vte_stream_head(text_stream);
+                auto const attr_head = _vte_stream_head(attr_stream);
+                auto text_offset = _vte_stream_tail(text_stream);
+                auto attr_offset = _vte_stream_tail(attr_stream);
+                auto records = std::vector<RowRecord>(MIN(end - start, 4096));
+
+                /* Walk the attr stream from the first record on, alongside the
+                 * records: each change has to be well formed and end at a text
+                 * offset no earlier than the previous one's, and each record has
+                 * to start at a change. */
+                auto attr_walk = attr_head;
+                auto attr_text_end_offset = gsize{0};
+                auto const next_attr_change = [&]() -> bool {
+                        CellAttrChange attr_change;
+                        guint16 hyperlink_length;
+                        if (!_vte_stream_read(attr_stream, attr_walk, (char*)&attr_change, sizeof(attr_change)) ||
+                            attr_change.attr.hyperlink_length > VTE_HYPERLINK_TOTAL_LENGTH_MAX ||
+                            attr_change.text_end_offset < attr_text_end_offset ||
+                            attr_change.text_end_offset > text_head)
+                                return false;
+                        attr_walk += sizeof(attr_change) + attr_change.attr.hyperlink_length;
+                        if (!_vte_stream_read(attr_stream, attr_walk, (char*)&hyperlink_length, 2) ||
+                            hyperlink_length != attr_change.attr.hyperlink_length)
+                                return false;
+                        attr_walk += 2;
+                        attr_text_end_offset = attr_change.text_end_offset;
+                        return true;
+                };
+
+                auto valid = _vte_stream_tail(row_stream) <= start * sizeof(RowRecord) &&
+                        _vte_stream_head(row_stream) == end * sizeof(RowRecord) &&
+                        header.last_attr_text_start_offset <= text_head;
+                row_flags.reset(start);
+                for (auto position = start; valid && position < end; ) {
+                        auto const count = MIN(end - position, records.size());
+                        valid = _vte_stream_read(row_stream, position * sizeof(RowRecord),
+                                                 (char*)records.data(), count * sizeof(RowRecord));
+                        for (size_t i = 0; valid && i < count; i++) {
+                                auto const& record = records[i];
+                                valid = record.text_start_offset >= text_offset &&
+                                        record.text_start_offset <= text_head &&
+                                        record.attr_start_offset >= attr_offset &&
+                                        record.attr_start_offset <= attr_head;
+                                text_offset = record.text_start_offset;
+                                attr_offset = record.attr_start_offset;
+                                row_flags.append(record);
+
+                                if (position + i == start)
+                                        attr_walk = record.attr_start_offset;
+                                while (valid && attr_walk < record.attr_start_offset)
+                                        valid = next_attr_change();
+                                valid = valid && attr_walk == record.attr_start_offset;
+                        }
+                        position += count;
+                }
+                while (valid && attr_walk < attr_head)
+                        valid = next_attr_change();
+
+                if (!valid) {
+                        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                                            "Corrupt scrollback snapshot");
+                        ok = false;
+                }
+        }
+
+        if (!ok) {
+                g_object_unref(row_stream);
+                g_object_unref(text_stream);
+                g_object_unref(attr_stream);
+                return false;
+        }
+
+        cancel_rewrap();
+        g_object_unref(m_row_stream);
+        g_object_unref(m_text_stream);
+        g_object_unref(m_attr_stream);
+        m_row_stream = row_stream;
+        m_text_stream = text_stream;
+        m_attr_stream = attr_stream;
+        m_row_flags = std::move(row_flags);
+
+        m_start = start;
+        m_end = m_writable = end;
+        invalidate_cached_rows();
+
+        m_last_attr_text_start_offset = header.last_attr_text_start_offset;
+        _attrcpy(&m_last_attr, &last_attr.attr);
+        m_last_attr.hyperlink_idx = 0;
+        if (last_attr.attr.hyperlink_length)
+                m_last_attr.hyperlink_idx = get_hyperlink_idx(hyperlink);
+
+#if WITH_SIXEL
+        m_image_by_top_map.clear();
+        m_image_map.clear();
+        m_next_image_priority = 0;
+        m_image_fast_memory_used = 0;
+#endif
+
+        thaw_rows(MAX(row_t(header.writable), m_start));
+        validate();
+
+        return true;
+}
+
 #if WITH_SIXEL
 
 /**
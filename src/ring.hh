@@ -35,6 +35,7 @@
 #endif
 
 #include <type_traits>
+#include <vector>
 
 typedef struct _VteVisualPosition {
 	long row, col;
@@ -57,6 +58,9 @@ public:
         typedef glong column_t;
 
         static const row_t kDefaultMaxRows = VTE_SCROLLBACK_INIT;
+        static constexpr row_t const k_lazy_rewrap_min_rows = 4096;
+        static constexpr row_t const k_cached_rows_min = 64;
+        static constexpr size_t const k_default_stream_cache_size = 1024 * 1024;
 
         Ring(row_t max_rows = kDefaultMaxRows,
              bool has_streams = false);
@@ -101,16 +105,58 @@ public:
         void set_visible_rows(row_t rows);
         void rewrap(column_t columns,
                     VteVisualPosition** markers);
+        bool rewrap_some(row_t rows);
+        void finish_rewrap();
+        inline bool rewrap_pending() const noexcept { return m_stale_row_stream != nullptr; }
+        /* Rows from here on are wrapped for the current width, see rewrap() */
+        inline constexpr row_t rewrapped_start() const noexcept { return m_rewrap_seam; }
         bool write_contents(GOutputStream* stream,
                             VteWriteFlags flags,
                             GCancellable* cancellable,
                             GError** error);
+        bool save_snapshot(GOutputStream* stream,
+                           GCancellable* cancellable,
+                           GError** error);
+        bool load_snapshot(GInputStream* stream,
+                           GCancellable* cancellable,
+                           GError** error);
 
         inline VteRowData* index_writable(row_t position) {
                 ensure_writable(position);
                 return get_writable_index(position);
         }
 
+        /* Counters, for benchmarking and statistics */
+        inline constexpr auto rows_frozen() const noexcept { return m_rows_frozen; }
+        inline constexpr auto rows_thawed() const noexcept { return m_rows_thawed; }
+        inline constexpr auto stream_bytes_written() const noexcept { return m_stream_bytes_written; }
+        inline constexpr auto stream_bytes_read() const noexcept { return m_stream_bytes_read; }
+        uint64_t stream_cache_hits() const noexcept;
+        uint64_t stream_cache_misses() const noexcept;
+
+        /* Memory budget for uncompressed scrollback blocks, shared by the streams */
+        void set_stream_cache_size(size_t size);
+        size_t stream_cache_size() const noexcept;
+
+        /* Compression of the blocks written to the streams from now on */
+        void set_stream_codec(VteStreamCodec codec);
+
+        /* Whether the streams keep their blocks in memory rather than in a temporary file */
+        void set_streams_in_memory(bool in_memory);
+        inline constexpr auto streams_in_memory() const noexcept { return m_streams_in_memory; }
+
+        /* Memory and disk space used by the streams, not counting the cache */
+        void stream_footprint(size_t& memory,
+                              size_t& disk) const;
+
+        /* Limit on scrollback_bytes(), enforced by discarding the oldest rows; 0 for none */
+        void set_max_bytes(size_t max_bytes);
+        inline constexpr auto max_bytes() const noexcept { return m_max_bytes; }
+        size_t scrollback_bytes();
+
+        /* Threads to rewrap deep histories on, for all rings; 0 for one per processor */
+        static void set_rewrap_threads(int threads);
+
 private:
 
         #if VTE_DEBUG
@@ -136,6 +182,8 @@ private:
                 uint32_t is_ascii: 1;      /* for rewrapping speedup: guarantees that line contains 32..126 bytes only. Can be 0 even when ascii only. */
                 uint32_t soft_wrapped: 1;  /* end of line is not '\n' */
                 uint32_t bidi_flags: 4;
+                uint32_t prompt_start: 1;  /* a prompt begins here, see contains_prompt_beginning() */
+                uint32_t has_hyperlink: 1; /* some character has a hyperlink */
         } RowRecord;
 
         static_assert(std::is_standard_layout_v<RowRecord> && std::is_trivial_v<RowRecord>, "Ring::RowRecord is not POD");
@@ -149,10 +197,64 @@ private:
 
         static_assert(std::is_standard_layout_v<CellTextOffset> && std::is_trivial_v<CellTextOffset>, "Ring::CellTextOffset is not POD");
 
+        /* Some bits of the records in the row stream, kept in memory so that
+         * looking them up doesn't read the stream. Like the stream, it covers
+         * the rows from its tail up to its head, and is appended to, truncated
+         * and advanced along with it. */
+        class RowFlags {
+        public:
+                enum Flag {
+                        eSOFT_WRAPPED,
+                        ePROMPT_START,
+                        eHAS_HYPERLINK,
+                        eCOUNT
+                };
+
+                void reset(row_t position) noexcept;
+                void append(RowRecord const& record);
+                void append(RowFlags const& flags,
+                            row_t start,
+                            row_t end);
+                void truncate(row_t position);
+                void advance_tail(row_t position);
+
+                inline constexpr bool contains(row_t position) const noexcept { return position >= m_tail && position < m_head; }
+                inline constexpr row_t head() const noexcept { return m_head; }
+
+                inline bool get(row_t position,
+                                Flag flag) const noexcept
+                {
+                        return (m_words[position / 64 - m_base / 64].bits[flag] >> (position % 64)) & 1;
+                }
+
+        private:
+                /* The bits of 64 rows */
+                struct Word {
+                        uint64_t bits[eCOUNT];
+                };
+
+                row_t m_base{0};  /* the first row of m_words[0], a multiple of 64 */
+                row_t m_tail{0};
+                row_t m_head{0};
+                std::vector<Word> m_words{};
+
+                void append_bits(bool const (&bits)[eCOUNT]);
+        };
+
+        bool read_row_records(RowRecord* records /* out */,
+                              row_t position,
+                              row_t count);
+
         inline bool read_row_record(RowRecord* record /* out */,
                                     row_t position)
         {
-                return _vte_stream_read(m_row_stream,
+                auto stream = m_row_stream;
+                if (G_UNLIKELY(position < m_rewrap_seam)) {
+                        /* Still wrapped for an earlier width, see rewrap() */
+                        stream = m_stale_row_stream;
+                        position = position - m_rewrap_seam + m_stale_row_end;
+                }
+                return _vte_stream_read(stream,
                                         position * sizeof(*record),
                                         (char*)record,
                                         sizeof(*record));
@@ -164,6 +266,7 @@ private:
                 _vte_stream_append(m_row_stream,
                                    (char const*)record,
                                    sizeof(*record));
+                m_row_flags.append(*record);
         }
 
         bool frozen_row_column_to_text_offset(row_t position,
@@ -181,17 +284,22 @@ private:
 
         void ensure_writable_room();
 
+        inline void ensure_rewrapped(row_t position) {
+                if G_UNLIKELY (position < m_rewrap_seam)
+                        finish_rewrap();
+        }
+
         inline void ensure_writable(row_t position) {
                 if G_UNLIKELY (position < m_writable) {
-                        //FIXMEchpe surely this can be optimised
-                        while (position < m_writable)
-                                thaw_one_row();
+                        ensure_rewrapped(position);
+                        thaw_rows(position);
                 }
         }
 
         void freeze_one_row();
         void maybe_freeze_one_row();
         void thaw_one_row();
+        void thaw_rows(row_t position);
         void discard_one_row();
         void maybe_discard_one_row();
 
@@ -202,7 +310,31 @@ private:
                       bool do_truncate,
                       int hyperlink_column,
                       char const** hyperlink);
+
+        /* A copy of some of a stream's contents, see thaw_rows() */
+        struct StreamCopy {
+                size_t offset;
+                std::vector<char> data;
+        };
+
+        bool thaw_row_cells(RowRecord record,
+                            char const* text,
+                            size_t text_len,
+                            VteRowData* row,
+                            bool do_truncate,
+                            int hyperlink_column,
+                            char const** hyperlink,
+                            StreamCopy const* attrs);
+        void truncate_streams(row_t position,
+                              RowRecord const& record);
         void reset_streams(row_t position);
+        void read_attr_change(size_t offset,
+                              CellAttrChange* attr_change);
+        VteStream* new_stream() const;
+
+        size_t frozen_bytes(row_t start);
+        size_t writable_bytes() const noexcept;
+        void maybe_discard_for_quota();
 
 	row_t m_max;
 	row_t m_start{0};
@@ -229,14 +361,37 @@ private:
          */
 	bool m_has_streams;
 	VteStream *m_attr_stream, *m_text_stream, *m_row_stream;
+        RowFlags m_row_flags{};
+        VteBlockCache *m_stream_cache;
+        VteStreamCodec m_stream_codec{VTE_STREAM_CODEC_LZ4};
+        bool m_streams_in_memory{false};
 	size_t m_last_attr_text_start_offset{0};
 	VteCellAttr m_last_attr;
 	GString *m_utf8_buffer;
 
-	VteRowData m_cached_row;
-	row_t m_cached_row_num{(row_t)-1};
+	/* Frozen rows thawed for reading. Like m_array, it's indexed by the
+	 * row's position masked, so any two screenfuls of rows in a row fit. */
+	struct CachedRow {
+		row_t position;
+		VteRowData row;
+	};
+	std::vector<CachedRow> m_cached_rows{};
+	row_t m_cached_rows_mask{0};
+
+	inline CachedRow& cached_row(row_t position) { return m_cached_rows[position & m_cached_rows_mask]; }
+	void resize_cached_rows();
+	void invalidate_cached_rows() noexcept;
+	void invalidate_cached_rows(row_t start,
+				    row_t end) noexcept;
 
         row_t m_visible_rows{0};  /* to keep at least a screenful of lines in memory, bug 646098 comment 12 */
+        size_t m_max_bytes{0};  /* limit on scrollback_bytes(), 0 for none */
+        size_t m_writable_bytes{0};  /* writable_bytes() as last counted */
+
+        size_t m_rows_frozen{0};
+        size_t m_rows_thawed{0};
+        size_t m_stream_bytes_written{0};  /* to the row, text and attr streams, by freezing */
+        size_t m_stream_bytes_read{0};  /* from the text and attr streams, by thawing */
 
         GPtrArray *m_hyperlinks;  /* The hyperlink pool. Contains GString* items.
                                    [0] points to an empty GString, [1] to [VTE_HYPERLINK_COUNT_MAX] contain the id;uri pairs. */
@@ -248,6 +403,86 @@ private:
                                                  An idx is allocated on hover even if the cell is scrolled out to the streams. */
         row_t m_hyperlink_maybe_gc_counter{0};  /* Do a GC when it reaches 65536. */
 
+        struct RewrapSegment;
+        struct RewrapWave;
+
+        /* The state of rewrapping a range of rows, one paragraph at a time */
+        struct RewrapState {
+                column_t columns;
+                row_t old_row;                /* the row after the one in old_record */
+                row_t old_end;                /* the end of the rows to rewrap */
+                size_t text_offset;           /* where the next paragraph begins */
+                size_t text_end;              /* where the text of the rows to rewrap ends */
+                size_t attr_offset;
+                RowRecord old_record;         /* the first row of the next paragraph */
+                CellAttrChange attr_change;
+                row_t new_row;                /* the number of the next new row */
+                VteStream* new_row_stream;
+                RowFlags* new_row_flags;      /* of the records in new_row_stream */
+                int num_markers;
+                CellTextOffset const* marker_text_offsets;
+                VteVisualPosition* new_markers;
+                bool rewrap_images;
+                RewrapSegment* segment;       /* if set, the rows are read from and rewrapped into it */
+        };
+
+        /* Some paragraphs copied out of the streams to be rewrapped on a
+         * worker thread, see rewrap_parallel() */
+        struct RewrapSegment {
+                Ring* ring;
+                RewrapWave* wave;
+                RewrapState state;
+                row_t start;
+                std::vector<RowRecord> rows;           /* of the rows [start, state.old_end) */
+                size_t attr_start;
+                std::vector<char> attrs;               /* the attr stream from attr_start on */
+                size_t text_start;
+                std::vector<char> text;                /* the text stream from text_start on, unless it's all ASCII */
+                std::vector<RowRecord> new_rows;
+                std::vector<VteVisualPosition> new_markers;
+                bool ok;
+        };
+
+        static constexpr row_t const k_parallel_rewrap_min_rows = 32768;
+        static constexpr row_t const k_rewrap_segment_rows = 4096;
+
+        bool rewrap_begin(RewrapState& state,
+                          row_t start,
+                          row_t end,
+                          size_t text_end);
+        bool rewrap_read_row_record(RewrapState& state,
+                                    RowRecord* record,
+                                    row_t position);
+        void rewrap_read_attr_change(RewrapState& state);
+        bool rewrap_read_text(RewrapState& state,
+                              size_t offset,
+                              char* buf,
+                              size_t len);
+        void rewrap_append_row_record(RewrapState& state,
+                                      RowRecord const& record);
+        bool rewrap_paragraph(RewrapState& state);
+        bool rewrap_segment_begin(RewrapState& state,
+                                  RewrapSegment& segment);
+        bool rewrap_parallel(RewrapState& state);
+        bool rewrap_remaining(RewrapState& state);
+        row_t rewrap_boundary(row_t position);
+        void complete_rewrap();
+        void abandon_rewrap();
+        void cancel_rewrap();
+
+        static GThreadPool* rewrap_pool();
+        static void rewrap_segment_func(void* data,
+                                        void* user_data);
+
+        /* A lazy rewrap, see rewrap(): the rows before m_rewrap_seam still have
+         * their records for an earlier width in m_stale_row_stream, up to
+         * m_stale_row_end, and m_rewrap rewraps them into its own stream. */
+        row_t m_rewrap_seam{0};
+        VteStream* m_stale_row_stream{nullptr};
+        row_t m_stale_row_end{0};
+        RewrapState m_rewrap{};
+        RowFlags m_rewrap_row_flags{};
+
 #if WITH_SIXEL
 
 private:
@@ -272,6 +507,14 @@ private:
                                     size_t text_start_ofs,
                                     size_t text_end_ofs,
                                     row_t new_row_index) noexcept;
+        void rewrap_images_to_rows(row_t start,
+                                   row_t end,
+                                   VteStream* stream,
+                                   row_t new_start,
+                                   row_t new_end,
+                                   row_t shift) noexcept;
+
+        image_by_top_map_type::iterator m_rewrap_image_it{};  /* the next image to move while rewrapping */
 
 public:
         auto const& image_map() const noexcept { return m_image_map; }
@@ -19,6 +19,7 @@
 
 #include "bidi.hh"
 #include "debug.h"
+#include "trace.hh"
 #include "vtedefines.hh"
 #include "vteinternal.hh"
 
@@ -193,6 +194,9 @@ RingView::update()
 {
         if (!m_invalid)
                 return;
+
+        auto span = vte::base::TraceSpan{"ringview-update", this};
+        span.set_arg("rows", m_len);
         if (m_paused)
                 resume();
 
@@ -80,6 +80,10 @@ public:
 
         VteRowData const* get_row(vte::grid::row_t row) const;
 
+        inline constexpr bool contains(vte::grid::row_t row) const noexcept {
+                return !m_invalid && !m_paused && row >= m_start && row < m_start + m_len;
+        }
+
         inline BidiRow const* get_bidirow(vte::grid::row_t row) const {
                 vte_assert_cmpint (row, >=, m_start);
                 vte_assert_cmpint (row, <, m_start + m_len);
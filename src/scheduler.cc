@@ -14,10 +14,10 @@
  * You should have received a copy of the GNU Lesser General Public License
  * along with this library.  If not, see <https://www.gnu.org/licenses/>.
  */
-
 #include "config.h"
 
 #include "scheduler.h"
+#include "trace.hh"
 
 /* The scheduler API drives updates using GdkFrameClock when possible
  * and runs at 10hz when not.
@@ -27,23 +27,217 @@
  * window to a taskbar we may not get updates. Additionally, when moving a
  * window to another workspace, some display systems may not advance the
  * GdkFrameClock.
+ *
+ * All scheduled callbacks of the process are run together, in rounds:
+ * the first tick of a frame runs the callbacks of the mapped widgets and
+ * any other callback that is due, and the ticks of the other widgets in
+ * the same frame do nothing. Unmapped widgets, like terminals in hidden
+ * tabs, thus keep running at 10hz however many frames the visible ones
+ * get. Within a round, the focused (and any high priority) callbacks run
+ * first, then the others ordered by the (weighted) processing time they
+ * have used so far, i.e. stride scheduling. When more than one callback
+ * is run, the round is limited to a fraction of the frame interval. The
+ * focused callback gets at least half of that, however many others there
+ * are, and the rest is shared out between the others according to their
+ * weight; each callback is passed its share as time slice. Callbacks
+ * that do not fit into a round are simply run first in the next one.
  */
 
 #define NEXT_UPDATE_USEC (G_USEC_PER_SEC/10)
 
+/* The fraction of the frame interval a round may take, if shared */
+#define ROUND_NUMERATOR   3
+#define ROUND_DENOMINATOR 4
+
+/* The least fraction of a shared round the focused callback gets */
+#define FOCUS_NUMERATOR   1
+#define FOCUS_DENOMINATOR 2
+
 typedef struct _Scheduled
 {
-        GList                 link;
-        GtkWidget            *widget;
-        VteSchedulerCallback  callback;
-        gpointer              user_data;
-        guint                 handler;
-        gint64                ready_time;
+        GList                  link;
+        GtkWidget             *widget;
+        VteSchedulerCallback   callback;
+        gpointer               user_data;
+        guint                  handler;
+        gint64                 ready_time;
+        VteSchedulingPriority  priority;
+        gint64                 pass;
+        gboolean               removed;
 } Scheduled;
 
 static GQueue scheduled = G_QUEUE_INIT;
 static GSource *scheduled_source;
 
+/* Start of the last round run from a frame tick, and whether a round is
+ * still running. Fallback rounds don't count towards the former, so that
+ * one landing just before a frame doesn't take that frame's round away.
+ */
+static gint64 frame_round_time;
+static gboolean in_round;
+/* Callbacks removed while in a round */
+static GSList *removed_in_round;
+
+static guint
+priority_weight (VteSchedulingPriority priority)
+{
+        switch (priority) {
+        case VTE_SCHEDULING_PRIORITY_LOW:
+                return 1;
+        case VTE_SCHEDULING_PRIORITY_HIGH:
+                return 16;
+        case VTE_SCHEDULING_PRIORITY_NORMAL:
+        default:
+                return 4;
+        }
+}
+
+/* The focused widget always gets high priority; an unmapped one is
+ * demoted a level, since there is nothing to show for its output.
+ */
+static VteSchedulingPriority
+effective_priority (Scheduled *state)
+{
+        if (gtk_widget_has_focus (state->widget))
+                return VTE_SCHEDULING_PRIORITY_HIGH;
+
+        if (!gtk_widget_get_mapped (state->widget) &&
+            state->priority > VTE_SCHEDULING_PRIORITY_LOW)
+                return (VteSchedulingPriority)(state->priority - 1);
+
+        return state->priority;
+}
+
+typedef struct
+{
+        Scheduled             *state;
+        VteSchedulingPriority  priority;
+        guint                  weight;
+        gboolean               focused;
+} RoundEntry;
+
+static int
+round_entry_compare (gconstpointer a,
+                     gconstpointer b)
+{
+        const RoundEntry *ea = (const RoundEntry *)a;
+        const RoundEntry *eb = (const RoundEntry *)b;
+
+        if ((ea->priority == VTE_SCHEDULING_PRIORITY_HIGH) !=
+            (eb->priority == VTE_SCHEDULING_PRIORITY_HIGH))
+                return ea->priority == VTE_SCHEDULING_PRIORITY_HIGH ? -1 : 1;
+
+        if (ea->state->pass != eb->state->pass)
+                return ea->state->pass < eb->state->pass ? -1 : 1;
+
+        return 0;
+}
+
+/* Runs the callbacks that are due at @now (and those of mapped widgets
+ * too, if @frame) and returns the earliest ready time of those that were
+ * not run.
+ */
+static gint64
+run_round (gint64   now,
+           gint64   frame_interval,
+           gboolean frame)
+{
+        GArray *entries = g_array_sized_new (FALSE, FALSE, sizeof (RoundEntry), scheduled.length);
+        gint64 next = now + NEXT_UPDATE_USEC;
+        gint64 round_budget = -1;
+        gint64 focused_budget = -1;
+        gint64 remaining;
+        guint64 focused_weight = 0;
+        guint64 other_weight = 0;
+        gint64 trace_start = vte::base::trace_span_begin ();
+
+        if (frame)
+                frame_round_time = now;
+
+        for (const GList *iter = scheduled.head; iter != nullptr; iter = iter->next) {
+                Scheduled *state = (Scheduled *)iter->data;
+                RoundEntry entry;
+
+                if (state->ready_time > now &&
+                    !(frame && gtk_widget_get_mapped (state->widget))) {
+                        next = MIN (next, state->ready_time);
+                        continue;
+                }
+
+                entry.state = state;
+                entry.priority = effective_priority (state);
+                entry.weight = priority_weight (entry.priority);
+                entry.focused = gtk_widget_has_focus (state->widget);
+                if (entry.focused)
+                        focused_weight += entry.weight;
+                else
+                        other_weight += entry.weight;
+                g_array_append_val (entries, entry);
+        }
+
+        if (entries->len > 1) {
+                round_budget = frame_interval * ROUND_NUMERATOR / ROUND_DENOMINATOR;
+
+                /* The focused callback's share has a floor, so that it doesn't
+                 * shrink with the number of other callbacks */
+                if (focused_weight > 0 && other_weight > 0)
+                        focused_budget = MAX (round_budget * FOCUS_NUMERATOR / FOCUS_DENOMINATOR,
+                                              (gint64)(round_budget * focused_weight / (focused_weight + other_weight)));
+                else if (focused_weight > 0)
+                        focused_budget = round_budget;
+                else
+                        focused_budget = 0;
+        }
+        remaining = round_budget;
+
+        g_array_sort (entries, round_entry_compare);
+
+        in_round = TRUE;
+
+        for (guint i = 0; i < entries->len; i++) {
+                RoundEntry *entry = &g_array_index (entries, RoundEntry, i);
+                Scheduled *state = entry->state;
+                gint64 time_slice = -1;
+                gint64 begin, elapsed;
+
+                if (state->removed)
+                        continue;
+
+                if (round_budget >= 0) {
+                        if (remaining <= 0) {
+                                /* Out of time; it will be first in line next round */
+                                next = MIN (next, now);
+                                continue;
+                        }
+
+                        if (entry->focused)
+                                time_slice = (gint64)(focused_budget * entry->weight / focused_weight);
+                        else
+                                time_slice = (gint64)((round_budget - focused_budget) * entry->weight / other_weight);
+                        time_slice = MIN (remaining, time_slice);
+                }
+
+                begin = g_get_monotonic_time ();
+                state->ready_time = begin + NEXT_UPDATE_USEC;
+                state->callback (state->widget, time_slice, state->user_data);
+                elapsed = g_get_monotonic_time () - begin;
+
+                /* Heavier callbacks advance more slowly */
+                state->pass += elapsed * priority_weight (VTE_SCHEDULING_PRIORITY_HIGH) / entry->weight;
+
+                if (remaining >= 0)
+                        remaining -= elapsed;
+        }
+
+        in_round = FALSE;
+        vte::base::trace_span_end (trace_start, "scheduler-round", nullptr, "terminals", entries->len);
+
+        g_slist_free_full (g_steal_pointer (&removed_in_round), g_free);
+        g_array_unref (entries);
+
+        return next;
+}
+
 static void
 unarm_fallback_scheduler (void)
 {
@@ -59,28 +253,13 @@ fallback_scheduler_dispatch (GSource     *gsource,
                              GSourceFunc  callback,
                              gpointer     user_data)
 {
-        const GList *iter = scheduled.head;
         gint64 now = g_source_get_time (gsource);
-        gint64 next = now + NEXT_UPDATE_USEC;
 
         if (now < g_source_get_ready_time (gsource)) {
                 return G_SOURCE_CONTINUE;
         }
 
-        while (iter != nullptr) {
-                Scheduled *state = (Scheduled *)iter->data;
-
-                iter = iter->next;
-
-                if (state->ready_time <= now) {
-                        state->ready_time = next;
-                        state->callback (state->widget, state->user_data);
-                } else if (state->ready_time < next) {
-                        next = state->ready_time;
-                }
-        }
-
-        g_source_set_ready_time (gsource, next);
+        g_source_set_ready_time (gsource, run_round (now, NEXT_UPDATE_USEC, FALSE));
 
         if (scheduled.length == 0) {
                 unarm_fallback_scheduler ();
@@ -112,10 +291,14 @@ scheduler_tick_callback (GtkWidget     *widget,
                          GdkFrameClock *frame_clock,
                          gpointer       user_data)
 {
-        Scheduled *state = (Scheduled *)user_data;
+        gint64 frame_interval = _vte_scheduler_get_frame_interval (widget);
+        gint64 now = g_get_monotonic_time ();
 
-        state->ready_time = g_get_monotonic_time () + NEXT_UPDATE_USEC;
-        state->callback (widget, state->user_data);
+        /* Another widget's tick already ran this frame's round */
+        if (in_round || now - frame_round_time < frame_interval / 2)
+                return G_SOURCE_CONTINUE;
+
+        run_round (now, frame_interval, TRUE);
 
         return G_SOURCE_CONTINUE;
 }
@@ -132,8 +315,16 @@ _vte_scheduler_add_callback (GtkWidget            *widget,
         state->callback = callback;
         state->user_data = user_data;
         state->widget = widget;
+        state->priority = VTE_SCHEDULING_PRIORITY_NORMAL;
         state->handler = gtk_widget_add_tick_callback (widget, scheduler_tick_callback, state, nullptr);
 
+        /* Start level with the others instead of owing them all they used */
+        state->pass = G_MAXINT64;
+        for (const GList *iter = scheduled.head; iter != nullptr; iter = iter->next)
+                state->pass = MIN (state->pass, ((Scheduled *)iter->data)->pass);
+        if (state->pass == G_MAXINT64)
+                state->pass = 0;
+
         g_queue_push_tail_link (&scheduled, &state->link);
 
         if (scheduled_source == nullptr)
@@ -150,9 +341,44 @@ _vte_scheduler_remove_callback (GtkWidget *widget,
 
         g_queue_unlink (&scheduled, &state->link);
         gtk_widget_remove_tick_callback (widget, state->handler);
-        g_free (state);
+
+        /* The running round may still refer to it */
+        if (in_round) {
+                state->removed = TRUE;
+                removed_in_round = g_slist_prepend (removed_in_round, state);
+        } else {
+                g_free (state);
+        }
 
         if (scheduled.length == 0) {
                 unarm_fallback_scheduler ();
         }
 }
+
+void
+_vte_scheduler_set_priority (gpointer               handler,
+                             VteSchedulingPriority  priority)
+{
+        Scheduled *state = (Scheduled *)handler;
+
+        state->priority = priority;
+}
+
+/* Returns the interval between frames, in µs, of the frame clock
+ * driving @widget's updates; or the fallback interval if there is
+ * no frame clock (yet).
+ */
+gint64
+_vte_scheduler_get_frame_interval (GtkWidget *widget)
+{
+        GdkFrameClock *frame_clock = gtk_widget_get_frame_clock (widget);
+        gint64 refresh_interval = 0;
+
+        if (frame_clock != nullptr)
+                gdk_frame_clock_get_refresh_info (frame_clock,
+                                                  gdk_frame_clock_get_frame_time (frame_clock),
+                                                  &refresh_interval,
+                                                  nullptr);
+
+        return refresh_interval > 0 ? refresh_interval : NEXT_UPDATE_USEC;
+}
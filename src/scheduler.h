@@ -17,9 +17,15 @@
 
 #include <gtk/gtk.h>
 
+#include "vte/vteenums.h"
+
 G_BEGIN_DECLS
 
+/* @time_slice is the processing time, in µs, the callback should
+ * keep to in this round; or -1 if it is not limited.
+ */
 typedef void (*VteSchedulerCallback) (GtkWidget *widget,
+                                      gint64     time_slice,
                                       gpointer   user_data);
 
 gpointer _vte_scheduler_add_callback    (GtkWidget            *widget,
@@ -27,5 +33,8 @@ gpointer _vte_scheduler_add_callback    (GtkWidget            *widget,
                                          gpointer              user_data);
 void     _vte_scheduler_remove_callback (GtkWidget            *widget,
                                          gpointer              handler);
+void     _vte_scheduler_set_priority    (gpointer              handler,
+                                         VteSchedulingPriority priority);
+gint64   _vte_scheduler_get_frame_interval (GtkWidget         *widget);
 
 G_END_DECLS
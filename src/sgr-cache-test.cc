@@ -0,0 +1,145 @@
+/*
+ * Copyright © 2026 the VTE authors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string_view>
+
+#include <glib.h>
+
+#include "sgr-cache.hh"
+
+using namespace std::literals;
+using namespace vte::parser;
+
+static size_t
+cache_apply(SGRCache& cache,
+            std::string_view const& str,
+            VteCellAttr& attr)
+{
+        auto const start = reinterpret_cast<uint8_t const*>(str.data());
+        return cache.apply(start, start + str.size(), attr);
+}
+
+/* Applies @str through the parser and collect_sgr(), like Terminal::SGR() */
+static void
+parser_apply(std::string_view const& str,
+             VteCellAttr& attr)
+{
+        auto parser = Parser{};
+        auto rv = int{VTE_SEQ_NONE};
+        for (auto const c : str)
+                rv = parser.feed(uint8_t(c));
+
+        g_assert_cmpint(rv, ==, VTE_SEQ_CSI);
+        auto const seq = Sequence{parser};
+        g_assert_cmpuint(seq.command(), ==, VTE_CMD_SGR);
+        collect_sgr(seq, 0, attr);
+}
+
+static VteCellAttr
+make_attr(void)
+{
+        auto attr = VteCellAttr{};
+        attr.attr = VTE_ATTR_DEFAULT;
+        attr.reset_sgr_attributes();
+        attr.set_bold(true);
+        attr.set_underline(3);
+        attr.set_fore(VTE_LEGACY_COLORS_OFFSET + 2);
+        attr.set_back(VTE_RGB_COLOR(8, 8, 8, 0x12, 0x34, 0x56));
+        attr.set_deco(VTE_DEFAULT_FG);
+        return attr;
+}
+
+static void
+assert_same(std::string_view const& str)
+{
+        auto cache = SGRCache{};
+
+        // Twice, to check both the computed and the memoised delta
+        for (auto i = 0; i < 2; ++i) {
+                auto expected = make_attr();
+                parser_apply(str, expected);
+
+                auto attr = make_attr();
+                g_assert_cmpuint(cache_apply(cache, str, attr), ==, str.size());
+                g_assert_cmphex(attr.attr, ==, expected.attr);
+                g_assert_cmphex(attr.colors(), ==, expected.colors());
+        }
+}
+
+static void
+test_sgr_cache_apply(void)
+{
+        assert_same("\e[m"sv);
+        assert_same("\e[0m"sv);
+        assert_same("\e[1m"sv);
+        assert_same("\e[2;3;4;5;7;8;9m"sv);
+        assert_same("\e[21;22;23;24;25;27;28;29m"sv);
+        assert_same("\e[4:3m"sv);
+        assert_same("\e[4:9m"sv);
+        assert_same("\e[1;31m"sv);
+        assert_same("\e[39;49m"sv);
+        assert_same("\e[38;5;208m"sv);
+        assert_same("\e[48:5:17m"sv);
+        assert_same("\e[38;2;255;128;0m"sv);
+        assert_same("\e[38:2::1:2:3;58:2::4:5:6m"sv);
+        assert_same("\e[38;2;256;0;0m"sv);
+        assert_same("\e[0;53;91;103m"sv);
+        assert_same("\e[1;0m"sv);
+        assert_same("\e[59m"sv);
+}
+
+static void
+test_sgr_cache_reject(void)
+{
+        auto cache = SGRCache{};
+        auto const expected = make_attr();
+
+        for (auto str : {"\e["sv,
+                         "\e[1"sv,
+                         "\e[1;2;3"sv,
+                         "\e[?1m"sv,
+                         "\e[1 m"sv,
+                         "\e[1H"sv,
+                         "\eP1m"sv,
+                         "x\e[1m"sv,
+                         "\e[1;1;1;1;1;1;1;1;1;1;1;1;1;1;1;1;1m"sv}) {
+                auto attr = expected;
+                g_assert_cmpuint(cache_apply(cache, str, attr), ==, 0);
+                g_assert_cmphex(attr.attr, ==, expected.attr);
+                g_assert_cmphex(attr.colors(), ==, expected.colors());
+        }
+
+        // Only the sequence at the start is consumed
+        auto attr = expected;
+        g_assert_cmpuint(cache_apply(cache, "\e[1mx\e[2m"sv, attr), ==, 4);
+        g_assert_true(attr.bold());
+        g_assert_false(attr.dim());
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+        g_test_init(&argc, &argv, nullptr);
+
+        g_test_add_func("/vte/sgr-cache/apply", test_sgr_cache_apply);
+        g_test_add_func("/vte/sgr-cache/reject", test_sgr_cache_reject);
+
+        return g_test_run();
+}
@@ -0,0 +1,222 @@
+// Copyright © 2026 the VTE authors
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#include "cell.hh"
+#include "parser.hh"
+#include "sgr.hh"
+
+namespace vte::parser {
+
+// SGRDelta:
+//
+// The effect of an SGR sequence on a VteCellAttr. Every SGR parameter
+// sets some attribute bits or one of the colours to a value that does
+// not depend on their previous value, so the effect of a whole sequence
+// is the set of bits it touches, and the values it sets them to.
+//
+// This implements the pen interface used by collect_sgr().
+//
+class SGRDelta {
+public:
+        constexpr SGRDelta() noexcept = default;
+
+        inline constexpr void apply(VteCellAttr& attr) const noexcept
+        {
+                attr.attr = (attr.attr & ~m_attr_mask) | m_attr;
+                attr.m_colors = (attr.m_colors & ~m_colors_mask) | m_colors;
+        }
+
+        inline constexpr void reset_sgr_attributes() noexcept
+        {
+                set_attr(VTE_ATTR_ALL_SGR_MASK, 0);
+                set_colors(~uint64_t{0}, vte_color_triple_init());
+        }
+
+        inline constexpr void unset(uint32_t mask) noexcept
+        {
+                set_attr(mask, 0);
+        }
+
+#define SGR_DELTA_BOOL(lname,uname) \
+        inline constexpr void set_##lname(bool value) noexcept \
+        { \
+                set_attr(VTE_ATTR_##uname##_MASK, value ? VTE_ATTR_##uname##_MASK : 0); \
+        }
+
+        SGR_DELTA_BOOL(bold, BOLD)
+        SGR_DELTA_BOOL(dim, DIM)
+        SGR_DELTA_BOOL(italic, ITALIC)
+        SGR_DELTA_BOOL(strikethrough, STRIKETHROUGH)
+        SGR_DELTA_BOOL(overline, OVERLINE)
+        SGR_DELTA_BOOL(reverse, REVERSE)
+        SGR_DELTA_BOOL(blink, BLINK)
+        SGR_DELTA_BOOL(invisible, INVISIBLE)
+#undef SGR_DELTA_BOOL
+
+        inline constexpr void set_underline(unsigned int value) noexcept
+        {
+                set_attr(VTE_ATTR_UNDERLINE_MASK, VTE_ATTR_UNDERLINE(value));
+        }
+
+#define SGR_DELTA_COLOR(lname,uname) \
+        inline constexpr void set_##lname(uint32_t value) noexcept \
+        { \
+                set_colors(VTE_COLOR_TRIPLE_##uname##_MASK, \
+                           uint64_t(value) << VTE_COLOR_TRIPLE_##uname##_SHIFT); \
+        }
+
+        SGR_DELTA_COLOR(fore, FORE)
+        SGR_DELTA_COLOR(back, BACK)
+        SGR_DELTA_COLOR(deco, DECO)
+#undef SGR_DELTA_COLOR
+
+private:
+        uint32_t m_attr_mask{0};
+        uint32_t m_attr{0};
+        uint64_t m_colors_mask{0};
+        uint64_t m_colors{0};
+
+        inline constexpr void set_attr(uint32_t mask,
+                                       uint32_t value) noexcept
+        {
+                m_attr_mask |= mask;
+                m_attr = (m_attr & ~mask) | (value & mask);
+        }
+
+        inline constexpr void set_colors(uint64_t mask,
+                                         uint64_t value) noexcept
+        {
+                m_colors_mask |= mask;
+                m_colors = (m_colors & ~mask) | (value & mask);
+        }
+
+}; // class SGRDelta
+
+// SGRCache:
+//
+// Recognises a complete SGR sequence in C0 form (ESC [ parameters m,
+// with only digits, ';' and ':' as parameter bytes) at the start of
+// the input, and applies it without going through Parser and the
+// command dispatch. The SGRDelta of each sequence is memoised keyed
+// by its parameter bytes; colourful output tends to only use a few
+// distinct sequences.
+//
+// The caller must make sure that the parser is in the ground state,
+// since otherwise the ESC would not start a new sequence.
+//
+class SGRCache {
+public:
+        SGRCache() noexcept = default;
+        ~SGRCache() noexcept = default;
+
+        SGRCache(SGRCache const&) = delete;
+        SGRCache(SGRCache&&) = delete;
+        SGRCache& operator=(SGRCache const&) = delete;
+        SGRCache& operator=(SGRCache&&) = delete;
+
+        // apply:
+        // @start:
+        // @end:
+        // @attr: the attributes to apply the SGR to
+        //
+        // Returns: the length of the SGR sequence at @start, or 0 if
+        //   there is none, or it is incomplete, or too long, or
+        //   could not be applied; in which case @attr is unchanged
+        //
+        inline size_t apply(uint8_t const* start,
+                            uint8_t const* end,
+                            VteCellAttr& attr) noexcept
+        {
+                if (end - start < 3 ||
+                    start[0] != 0x1b /* ESC */ ||
+                    start[1] != 0x5b /* '[' */)
+                        return 0;
+
+                auto const params = start + 2;
+                auto const limit = std::min(end, params + k_max_params_length + 1);
+                auto hash = 0u;
+                auto p = params;
+                for (; p < limit; ++p) {
+                        auto const c = *p;
+                        if (c >= 0x30 /* '0' */ && c <= 0x3b /* ';' */) [[likely]] {
+                                hash = hash * 31 + c;
+                                continue;
+                        }
+                        if (c == 0x6d /* 'm' */)
+                                break;
+
+                        return 0;
+                }
+                if (p == limit)
+                        return 0;
+
+                auto const length = size_t(p - params);
+                auto& entry = m_entries[hash % m_entries.size()];
+                if (entry.length != length ||
+                    memcmp(entry.params, params, length) != 0) [[unlikely]] {
+                        if (!compute(params, length, entry))
+                                return 0;
+                }
+
+                entry.delta.apply(attr);
+                return length + 3;
+        }
+
+private:
+        static inline constexpr size_t const k_max_params_length = 31;
+
+        struct Entry {
+                uint8_t length{0xff};
+                uint8_t params[k_max_params_length];
+                SGRDelta delta{};
+        };
+
+        std::array<Entry, 64> m_entries{};
+        Parser m_parser{};
+
+        bool compute(uint8_t const* params,
+                     size_t length,
+                     Entry& entry) noexcept
+        {
+                m_parser.reset();
+
+                auto rv = m_parser.feed(0x1b /* ESC */);
+                rv = m_parser.feed(0x5b /* '[' */);
+                for (auto i = size_t{0}; i < length; ++i)
+                        rv = m_parser.feed(params[i]);
+                rv = m_parser.feed(0x6d /* 'm' */);
+
+                // The parameters may have overflowed
+                auto const seq = Sequence{m_parser};
+                if (rv != VTE_SEQ_CSI || seq.command() != VTE_CMD_SGR)
+                        return false;
+
+                entry.delta = SGRDelta{};
+                collect_sgr(seq, 0, entry.delta);
+
+                entry.length = length;
+                memcpy(entry.params, params, length);
+                return true;
+        }
+
+}; // class SGRCache
+
+} // namespace vte::parser
@@ -0,0 +1,123 @@
+/*
+ * Copyright © 2026 the VTE authors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "cell.hh"
+#include "modes.hh"
+
+namespace vte::terminal {
+
+/*
+ * SnapshotHeader:
+ *
+ * The beginning of a snapshot of the normal screen, as written by
+ * Terminal::save_snapshot(). It's followed by the screen's ring, see
+ * Ring::save_snapshot().
+ *
+ * The ring is saved in its own record and compressed block formats, in
+ * host byte order, so a snapshot can only be restored by the same version
+ * of VTE on the same architecture; the header's version and byte order
+ * tell.
+ */
+struct SnapshotHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        int64_t column_count;
+        int64_t row_count;
+        int64_t insert_delta;
+        int64_t cursor_row;     /* relative to insert_delta */
+        int64_t cursor_column;
+        uint32_t modes_ecma;
+        uint32_t modes_private;
+        VteCellAttr defaults;   /* with hyperlink_idx 0 */
+};
+
+static_assert(std::is_trivially_copyable_v<SnapshotHeader>, "SnapshotHeader is not POD");
+static_assert(sizeof(modes::ECMA::Storage) <= sizeof(SnapshotHeader::modes_ecma), "SnapshotHeader::modes_ecma is too small");
+static_assert(sizeof(modes::Private::Storage) <= sizeof(SnapshotHeader::modes_private), "SnapshotHeader::modes_private is too small");
+
+inline constexpr char const k_snapshot_magic[8] = "VTESNAP";
+inline constexpr uint32_t k_snapshot_version = 1;
+inline constexpr uint32_t k_snapshot_byte_order = 0x01020304;
+
+inline SnapshotHeader
+snapshot_header_new() noexcept
+{
+        auto header = SnapshotHeader{};
+        memcpy(header.magic, k_snapshot_magic, sizeof(header.magic));
+        header.version = k_snapshot_version;
+        header.byte_order = k_snapshot_byte_order;
+        return header;
+}
+
+/* Reads a header from @stream and checks that it's one this build can restore */
+inline bool
+snapshot_header_read(GInputStream* stream,
+                     SnapshotHeader* header /* out */,
+                     GCancellable* cancellable,
+                     GError** error)
+{
+        auto bytes_read = gsize{0};
+        if (!g_input_stream_read_all(stream, header, sizeof(*header), &bytes_read, cancellable, error))
+                return false;
+
+        if (bytes_read != sizeof(*header) ||
+            memcmp(header->magic, k_snapshot_magic, sizeof(header->magic)) != 0) {
+                g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                                    "Not a terminal snapshot");
+                return false;
+        }
+
+        if (header->version != k_snapshot_version ||
+            header->byte_order != k_snapshot_byte_order) {
+                g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                                    "Terminal snapshot from a different version or architecture");
+                return false;
+        }
+
+        if (header->column_count < 1 || header->row_count < 1 ||
+            header->insert_delta < 0 ||
+            header->cursor_row < 0 || header->cursor_row >= header->row_count ||
+            header->cursor_column < 0 || header->cursor_column > header->column_count) {
+                g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                                    "Corrupt terminal snapshot");
+                return false;
+        }
+
+        header->defaults.hyperlink_idx = 0;
+        return true;
+}
+
+inline bool
+snapshot_header_write(GOutputStream* stream,
+                      SnapshotHeader const& header,
+                      GCancellable* cancellable,
+                      GError** error)
+{
+        auto bytes_written = gsize{0};
+        return g_output_stream_write_all(stream, &header, sizeof(header), &bytes_written, cancellable, error);
+}
+
+} // namespace vte::terminal
@@ -0,0 +1,139 @@
+/*
+ * Copyright © 2026 the VTE authors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <cstddef>
+#include <thread>
+
+#include <glib.h>
+
+#include "spsc-queue.hh"
+
+using vte::base::SPSCQueue;
+
+static void
+test_spsc_queue_empty(void)
+{
+        auto queue = SPSCQueue<int, 4>{};
+        auto value = 42;
+
+        g_assert_true(queue.empty());
+        g_assert_false(queue.full());
+        g_assert_false(queue.pop(value));
+        g_assert_cmpint(value, ==, 42);
+
+        g_assert_true(queue.push(1));
+        g_assert_false(queue.empty());
+        g_assert_true(queue.pop(value));
+        g_assert_cmpint(value, ==, 1);
+        g_assert_true(queue.empty());
+        g_assert_false(queue.pop(value));
+}
+
+static void
+test_spsc_queue_order(void)
+{
+        auto queue = SPSCQueue<int, 8>{};
+        auto value = 0;
+
+        // Wrap the indices around the storage a few times
+        auto next_push = 0, next_pop = 0;
+        for (auto round = 0; round < 10; ++round) {
+                for (auto i = 0; i < 5; ++i)
+                        g_assert_true(queue.push(next_push++));
+                for (auto i = 0; i < 5; ++i) {
+                        g_assert_true(queue.pop(value));
+                        g_assert_cmpint(value, ==, next_pop++);
+                }
+                g_assert_true(queue.empty());
+        }
+}
+
+static void
+test_spsc_queue_full(void)
+{
+        auto queue = SPSCQueue<int, 4>{};
+        auto value = 0;
+
+        g_assert_cmpuint(queue.capacity(), ==, 4);
+        for (auto i = 0; i < 4; ++i) {
+                g_assert_false(queue.full());
+                g_assert_true(queue.push(i));
+        }
+        g_assert_true(queue.full());
+
+        // A full queue refuses the item, and keeps the ones it has
+        g_assert_false(queue.push(4));
+        g_assert_true(queue.pop(value));
+        g_assert_cmpint(value, ==, 0);
+        g_assert_false(queue.full());
+
+        g_assert_true(queue.push(4));
+        g_assert_true(queue.full());
+        for (auto i = 1; i <= 4; ++i) {
+                g_assert_true(queue.pop(value));
+                g_assert_cmpint(value, ==, i);
+        }
+        g_assert_true(queue.empty());
+}
+
+static void
+test_spsc_queue_threads(void)
+{
+        // Small enough that the producer keeps finding it full
+        // and the consumer keeps finding it empty
+        auto queue = SPSCQueue<std::size_t, 16>{};
+        auto const n_items = std::size_t{1} << 20;
+
+        auto producer = std::thread{[&queue, n_items]() {
+                for (auto i = std::size_t{0}; i < n_items; ) {
+                        if (queue.push(i))
+                                ++i;
+                        else
+                                std::this_thread::yield();
+                }
+        }};
+
+        auto expected = std::size_t{0};
+        auto value = std::size_t{0};
+        while (expected < n_items) {
+                if (queue.pop(value)) {
+                        g_assert_cmpuint(value, ==, expected);
+                        ++expected;
+                } else {
+                        std::this_thread::yield();
+                }
+        }
+
+        producer.join();
+        g_assert_true(queue.empty());
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+        g_test_init(&argc, &argv, nullptr);
+
+        g_test_add_func("/vte/spsc-queue/empty", test_spsc_queue_empty);
+        g_test_add_func("/vte/spsc-queue/order", test_spsc_queue_order);
+        g_test_add_func("/vte/spsc-queue/full", test_spsc_queue_full);
+        g_test_add_func("/vte/spsc-queue/threads", test_spsc_queue_threads);
+
+        return g_test_run();
+}
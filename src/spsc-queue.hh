@@ -0,0 +1,95 @@
+/*
+ * Copyright © 2026 the VTE authors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace vte::base {
+
+// A bounded, lock-free, single-producer/single-consumer queue.
+//
+// push() may only be called from one thread, and pop() only from
+// one (other) thread. Publishing an item has release semantics, so
+// everything the producer wrote before push()ing an item is visible
+// to the consumer after it pop()ped it.
+//
+template<typename T, std::size_t N>
+class SPSCQueue {
+        static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of two");
+
+public:
+        constexpr SPSCQueue() noexcept = default;
+        ~SPSCQueue() = default;
+
+        SPSCQueue(SPSCQueue const&) = delete;
+        SPSCQueue(SPSCQueue&&) = delete;
+        SPSCQueue& operator=(SPSCQueue const&) = delete;
+        SPSCQueue& operator=(SPSCQueue&&) = delete;
+
+        // Producer only.
+        // Returns: %true if @value was queued, %false if the queue was full
+        bool push(T const& value) noexcept
+        {
+                auto const tail = m_tail.load(std::memory_order_relaxed);
+                if (tail - m_head.load(std::memory_order_acquire) == N)
+                        return false;
+
+                m_items[tail & (N - 1)] = value;
+                m_tail.store(tail + 1, std::memory_order_release);
+                return true;
+        }
+
+        // Consumer only.
+        // Returns: %true if an item was dequeued into @value, %false if the queue was empty
+        bool pop(T& value) noexcept
+        {
+                auto const head = m_head.load(std::memory_order_relaxed);
+                if (head == m_tail.load(std::memory_order_acquire))
+                        return false;
+
+                value = m_items[head & (N - 1)];
+                m_head.store(head + 1, std::memory_order_release);
+                return true;
+        }
+
+        // Note that these are only a snapshot when called from
+        // the thread on the other side of the queue.
+        bool empty() const noexcept
+        {
+                return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+        }
+
+        bool full() const noexcept
+        {
+                return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire) == N;
+        }
+
+        static inline constexpr auto capacity() noexcept { return N; }
+
+private:
+        // Keep the indices on separate cache lines so that producer
+        // and consumer don't keep stealing the line from each other.
+        alignas(64) std::atomic<std::size_t> m_head{0};
+        alignas(64) std::atomic<std::size_t> m_tail{0};
+        alignas(64) std::array<T, N> m_items{};
+
+}; // class SPSCQueue
+
+} // namespace vte::base
@@ -0,0 +1,122 @@
+/*
+ * Copyright © 2026 the VTE authors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <cstring>
+
+#include <glib.h>
+
+#include "trace.hh"
+
+using namespace vte::base;
+
+static void
+test_trace_ring(void)
+{
+        auto tracer = Tracer{4};
+
+        for (auto i = 0; i < 6; ++i)
+                tracer.record({"span", nullptr, nullptr, 0, i * 10, 5});
+
+        // Only the most recent events are kept, in order
+        g_assert_cmpuint(tracer.size(), ==, 4);
+        auto const events = tracer.events();
+        g_assert_cmpuint(events.size(), ==, 4);
+        for (auto i = 0u; i < events.size(); ++i)
+                g_assert_cmpint(events[i].start, ==, (i + 2) * 10);
+
+        tracer.clear();
+        g_assert_cmpuint(tracer.size(), ==, 0);
+        g_assert_cmpuint(tracer.events().size(), ==, 0);
+}
+
+static void
+test_trace_json(void)
+{
+        auto tracer = Tracer{};
+        tracer.record({"process", nullptr, "bytes", 4096, 1000, 250});
+        tracer.record({"draw", nullptr, nullptr, 0, 1300, 40});
+
+        auto const json = tracer.to_json();
+        g_assert_nonnull(strstr(json.c_str(), "\"traceEvents\":["));
+        g_assert_nonnull(strstr(json.c_str(), "\"name\":\"process\",\"cat\":\"vte\",\"ph\":\"X\",\"ts\":1000,\"dur\":250"));
+        g_assert_nonnull(strstr(json.c_str(), "\"bytes\":4096}"));
+        g_assert_nonnull(strstr(json.c_str(), "\"name\":\"draw\",\"cat\":\"vte\",\"ph\":\"X\",\"ts\":1300,\"dur\":40"));
+        g_assert_true(strstr(json.c_str(), "process") < strstr(json.c_str(), "draw"));
+}
+
+static void
+test_trace_span(void)
+{
+        auto& tracer = Tracer::get();
+
+        {
+                auto span = TraceSpan{"disarmed"};
+        }
+        auto const start = trace_span_begin();
+        g_assert_cmpint(start, ==, 0);
+        trace_span_end(start, "disarmed");
+        g_assert_cmpuint(tracer.size(), ==, 0);
+
+        tracer.arm(true);
+        g_assert_true(Tracer::armed());
+        {
+                auto span = TraceSpan{"armed", &tracer};
+                span.set_arg("answer", 42);
+        }
+        trace_span_end(trace_span_begin(), "explicit", nullptr, "rows", 7);
+        tracer.arm(false);
+        g_assert_false(Tracer::armed());
+
+        g_assert_cmpuint(tracer.size(), ==, 2);
+        auto const events = tracer.events();
+        g_assert_cmpstr(events[0].name, ==, "armed");
+        g_assert_true(events[0].object == &tracer);
+        g_assert_cmpstr(events[0].arg_name, ==, "answer");
+        g_assert_cmpint(events[0].arg, ==, 42);
+        g_assert_cmpint(events[0].duration, >=, 0);
+        g_assert_cmpstr(events[1].name, ==, "explicit");
+        g_assert_null(events[1].object);
+        g_assert_cmpstr(events[1].arg_name, ==, "rows");
+        g_assert_cmpint(events[1].arg, ==, 7);
+
+        // Arming again starts over, but only once disarmed
+        tracer.arm(true);
+        {
+                auto span = TraceSpan{"rearmed"};
+        }
+        tracer.arm(true);
+        tracer.arm(false);
+        g_assert_cmpuint(tracer.size(), ==, 1);
+        g_assert_cmpstr(tracer.events()[0].name, ==, "rearmed");
+
+        tracer.clear();
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+        g_test_init(&argc, &argv, nullptr);
+
+        g_test_add_func("/vte/trace/ring", test_trace_ring);
+        g_test_add_func("/vte/trace/json", test_trace_json);
+        g_test_add_func("/vte/trace/span", test_trace_span);
+
+        return g_test_run();
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright © 2026 the VTE authors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "trace.hh"
+
+#include <unistd.h>
+
+#include "debug.h"
+
+namespace vte::base {
+
+bool Tracer::s_armed = false;
+
+Tracer&
+Tracer::get() noexcept
+{
+        static auto tracer = Tracer{};
+        return tracer;
+}
+
+void
+Tracer::init_from_environment() noexcept
+{
+        auto const env = g_getenv("VTE_TRACE");
+        if (!env || !env[0])
+                return;
+
+        _vte_debug_print(VTE_DEBUG_MISC, "Tracing armed from the environment\n");
+        get().arm(true);
+}
+
+void
+Tracer::arm(bool armed)
+{
+        if (armed && !m_armed) {
+                clear();
+                m_events.reserve(m_capacity);
+        }
+        m_armed = armed;
+
+        if (this == &get())
+                s_armed = armed;
+}
+
+void
+Tracer::clear() noexcept
+{
+        m_events.clear();
+        m_next = 0;
+}
+
+void
+Tracer::record(Event const& event) noexcept
+{
+        if (m_capacity == 0)
+                return;
+
+        if (m_events.size() < m_capacity) {
+                m_events.push_back(event);
+                return;
+        }
+
+        m_events[m_next] = event;
+        if (++m_next == m_capacity)
+                m_next = 0;
+}
+
+std::vector<Tracer::Event>
+Tracer::events() const
+{
+        auto events = std::vector<Event>{};
+        events.reserve(m_events.size());
+        events.insert(events.end(), m_events.begin() + m_next, m_events.end());
+        events.insert(events.end(), m_events.begin(), m_events.begin() + m_next);
+        return events;
+}
+
+std::string
+Tracer::to_json() const
+{
+        auto const pid = int(getpid());
+
+        auto str = g_string_sized_new(128 + m_events.size() * 128);
+        g_string_append(str, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+        // Spans are only recorded on the main thread, whose thread ID is the PID
+        g_string_append_printf(str,
+                               "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                               "\"args\":{\"name\":\"vte\"}}",
+                               pid, pid);
+
+        // The names are string literals, so they don't need escaping
+        for (auto const& event : events()) {
+                g_string_append_printf(str,
+                                       ",\n{\"name\":\"%s\",\"cat\":\"vte\",\"ph\":\"X\","
+                                       "\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT ","
+                                       "\"pid\":%d,\"tid\":%d,\"args\":{\"object\":\"%p\"",
+                                       event.name,
+                                       event.start,
+                                       event.duration,
+                                       pid, pid,
+                                       event.object);
+                if (event.arg_name)
+                        g_string_append_printf(str, ",\"%s\":%" G_GINT64_FORMAT,
+                                               event.arg_name, event.arg);
+                g_string_append(str, "}}");
+        }
+
+        g_string_append(str, "\n]}\n");
+
+        auto json = std::string{str->str, str->len};
+        g_string_free(str, true);
+        return json;
+}
+
+} // namespace vte::base
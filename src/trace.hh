@@ -0,0 +1,165 @@
+/*
+ * Copyright © 2026 the VTE authors
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glib.h>
+
+namespace vte::base {
+
+/*
+ * Tracer records timed spans (processing input, drawing a frame, etc.)
+ * into a fixed-size ring buffer, keeping only the most recent ones, and
+ * exports them in the Chrome trace event format, which can be loaded into
+ * chrome://tracing or ui.perfetto.dev.
+ *
+ * While disarmed, a span costs a single load of a global flag; while
+ * armed, two clock reads and a store into the buffer.
+ *
+ * Spans must only be recorded on the main thread.
+ */
+class Tracer {
+public:
+        static constexpr auto const k_default_capacity = size_t{64 * 1024};
+
+        struct Event {
+                char const* name;
+                void const* object;
+                char const* arg_name;
+                int64_t arg;
+                int64_t start;  /* µs, monotonic */
+                int64_t duration;  /* µs */
+        };
+
+        Tracer(size_t capacity = k_default_capacity) noexcept
+                : m_capacity{capacity}
+        {
+        }
+
+        ~Tracer() = default;
+
+        Tracer(Tracer const&) = delete;
+        Tracer(Tracer&&) = delete;
+        Tracer& operator=(Tracer const&) = delete;
+        Tracer& operator=(Tracer&&) = delete;
+
+        // The process-wide tracer
+        static Tracer& get() noexcept;
+
+        // Whether the process-wide tracer records spans
+        static inline bool armed() noexcept { return s_armed; }
+
+        // Arms the process-wide tracer if the VTE_TRACE environment variable is set
+        static void init_from_environment() noexcept;
+
+        // Arming a disarmed tracer starts over with an empty buffer
+        void arm(bool armed);
+        void clear() noexcept;
+
+        inline size_t size() const noexcept { return m_events.size(); }
+        inline size_t capacity() const noexcept { return m_capacity; }
+
+        void record(Event const& event) noexcept;
+
+        // Returns the recorded events, oldest first
+        std::vector<Event> events() const;
+
+        // Returns the recorded events as a Chrome trace event JSON document
+        std::string to_json() const;
+
+private:
+        static bool s_armed;
+
+        size_t m_capacity;
+        bool m_armed{false};
+        size_t m_next{0};  /* where to record the next event, once full */
+        std::vector<Event> m_events{};
+
+}; // class Tracer
+
+/*
+ * trace_span_begin() and trace_span_end() record a span like TraceSpan
+ * does, for code that doesn't use RAII. trace_span_begin() returns the
+ * start time to pass to trace_span_end(), or 0 if the tracer is disarmed.
+ */
+inline int64_t
+trace_span_begin() noexcept
+{
+        return Tracer::armed() ? g_get_monotonic_time() : 0;
+}
+
+inline void
+trace_span_end(int64_t start,
+               char const* name,
+               void const* object = nullptr,
+               char const* arg_name = nullptr,
+               int64_t arg = 0) noexcept
+{
+        if (start == 0) [[likely]]
+                return;
+
+        Tracer::get().record({name, object, arg_name, arg,
+                              start, g_get_monotonic_time() - start});
+}
+
+/*
+ * TraceSpan records the time from its construction to its destruction
+ * as a span, if the process-wide tracer is armed.
+ */
+class TraceSpan {
+public:
+        TraceSpan(char const* name,
+                  void const* object = nullptr) noexcept
+                : m_name{name},
+                  m_object{object},
+                  m_start{trace_span_begin()}
+        {
+        }
+
+        ~TraceSpan() noexcept
+        {
+                trace_span_end(m_start, m_name, m_object, m_arg_name, m_arg);
+        }
+
+        TraceSpan(TraceSpan const&) = delete;
+        TraceSpan(TraceSpan&&) = delete;
+        TraceSpan& operator=(TraceSpan const&) = delete;
+        TraceSpan& operator=(TraceSpan&&) = delete;
+
+        // Attaches a value to the span, e.g. the number of bytes processed
+        inline void set_arg(char const* name,
+                            int64_t value) noexcept
+        {
+                m_arg_name = name;
+                m_arg = value;
+        }
+
+private:
+        char const* m_name;
+        void const* m_object;
+        char const* m_arg_name{nullptr};
+        int64_t m_arg{0};
+        int64_t m_start;
+
+}; // class TraceSpan
+
+} // namespace vte::base
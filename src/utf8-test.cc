@@ -308,6 +308,50 @@ test_utf8_decoder_replacement(void)
         assert_decode("\xFE\xBF\xBF\xBF\xBF\xBF\xBF", -1, U"\uFFFD\uFFFD\uFFFD\uFFFD\uFFFD\uFFFD\uFFFD"s);
 }
 
+static void
+assert_widen_printable_ascii(SIMDLevel level)
+{
+        if (!set_widen_printable_ascii_simd_level(level))
+                return; // not available in this build
+
+        uint8_t const bad[] = { 0x00, 0x0a, 0x1b, 0x1f, 0x7f, 0x80, 0x9b, 0xc3, 0xff };
+
+        uint8_t buf[100];
+        uint32_t out[100];
+        for (auto len = 0u; len <= sizeof(buf); ++len) {
+                for (auto i = 0u; i < len; ++i)
+                        buf[i] = 0x20 + (i * 7) % 0x5f;
+
+                for (auto pos = 0u; pos <= len; ++pos) {
+                        for (auto c : bad) {
+                                if (pos < len)
+                                        buf[pos] = c;
+
+                                auto const n = widen_printable_ascii(buf, buf + len, out);
+                                g_assert_cmpuint(n, ==, pos);
+                                for (auto i = 0u; i < n; ++i)
+                                        g_assert_cmpuint(out[i], ==, buf[i]);
+
+                                if (pos < len)
+                                        buf[pos] = 0x20 + (pos * 7) % 0x5f;
+                                else
+                                        break;
+                        }
+                }
+        }
+}
+
+static void
+test_utf8_widen_printable_ascii(void)
+{
+        auto const level = widen_printable_ascii_simd_level();
+
+        assert_widen_printable_ascii(SIMDLevel::eNONE);
+        assert_widen_printable_ascii(SIMDLevel::eSSE2);
+
+        set_widen_printable_ascii_simd_level(level);
+}
+
 int
 main(int argc,
      char* argv[])
@@ -316,6 +360,7 @@ main(int argc,
 
         g_test_add_func("/vte/utf8/decoder/decode", test_utf8_decoder_decode);
         g_test_add_func("/vte/utf8/decoder/replacement", test_utf8_decoder_replacement);
+        g_test_add_func("/vte/utf8/widen-printable-ascii", test_utf8_widen_printable_ascii);
 
         return g_test_run();
 }
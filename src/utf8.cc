@@ -25,6 +25,11 @@
 
 #include "utf8.hh"
 
+#if defined(__SSE2__)
+#define VTE_UTF8_SSE2 1
+#include <emmintrin.h>
+#endif
+
 #define RJ vte::base::UTF8Decoder::REJECT
 #define RW vte::base::UTF8Decoder::REJECT_REWIND
 
@@ -111,3 +116,135 @@ uint8_t const vte::base::UTF8Decoder::kTable[] = {
         RW, 36, RW, RW, RW, RW, RW, RW, RW, RW, RW, RW, // state 96
         RJ, RJ, RJ, RJ, RJ, RJ, RJ, RJ, RJ, RJ, RJ, RJ, // state 108 (reject-rewind)
 };
+
+namespace vte::base {
+
+static size_t
+widen_printable_ascii_scalar(uint8_t const* start,
+                             uint8_t const* end,
+                             uint32_t* dst) noexcept
+{
+        auto ip = start;
+        while (ip < end && *ip >= 0x20 && *ip < 0x7f)
+                *dst++ = *ip++;
+
+        return size_t(ip - start);
+}
+
+#if VTE_UTF8_SSE2
+
+/* SSE2 is part of the x86-64 baseline, so there's no need to check for it at
+ * runtime. Wider vectors (AVX2) measured no faster on ASCII output, since the
+ * runs are short compared to the work done per run.
+ *
+ * Checks a whole block at once, and stores all of it widened; then if the
+ * block contained a non-printable byte, returns the length of the printable
+ * prefix. Bytes >= 0x80 are negative as signed chars, so a single signed
+ * compare against 0x1f excludes those too.
+ */
+
+static size_t
+widen_printable_ascii_sse2(uint8_t const* start,
+                           uint8_t const* end,
+                           uint32_t* dst) noexcept
+{
+        auto const lo = _mm_set1_epi8(0x1f);
+        auto const hi = _mm_set1_epi8(0x7f);
+        auto const zero = _mm_setzero_si128();
+
+        auto ip = start;
+        while (end - ip >= 16) {
+                auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(ip));
+                auto const printable = _mm_and_si128(_mm_cmpgt_epi8(v, lo),
+                                                     _mm_cmplt_epi8(v, hi));
+                auto const mask = unsigned(_mm_movemask_epi8(printable));
+
+                auto const v_lo = _mm_unpacklo_epi8(v, zero);
+                auto const v_hi = _mm_unpackhi_epi8(v, zero);
+                auto const out = reinterpret_cast<__m128i*>(dst);
+                _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(v_lo, zero));
+                _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(v_lo, zero));
+                _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(v_hi, zero));
+                _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(v_hi, zero));
+
+                if (mask != 0xffffu)
+                        return size_t(ip - start) + __builtin_ctz(~mask);
+
+                ip += 16;
+                dst += 16;
+        }
+
+        return size_t(ip - start) + widen_printable_ascii_scalar(ip, end, dst);
+}
+
+#endif /* VTE_UTF8_SSE2 */
+
+using widen_printable_ascii_func = size_t (*)(uint8_t const*, uint8_t const*, uint32_t*) noexcept;
+
+static bool
+simd_level_supported(SIMDLevel level) noexcept
+{
+        switch (level) {
+        case SIMDLevel::eNONE:
+                return true;
+#if VTE_UTF8_SSE2
+        case SIMDLevel::eSSE2:
+                return true;
+#endif
+        default:
+                return false;
+        }
+}
+
+static widen_printable_ascii_func
+widen_printable_ascii_impl(SIMDLevel level) noexcept
+{
+        switch (level) {
+#if VTE_UTF8_SSE2
+        case SIMDLevel::eSSE2:
+                return widen_printable_ascii_sse2;
+#endif
+        case SIMDLevel::eNONE:
+        default:
+                return widen_printable_ascii_scalar;
+        }
+}
+
+static SIMDLevel
+best_simd_level() noexcept
+{
+        if (simd_level_supported(SIMDLevel::eSSE2))
+                return SIMDLevel::eSSE2;
+
+        return SIMDLevel::eNONE;
+}
+
+static SIMDLevel g_simd_level = best_simd_level();
+static widen_printable_ascii_func g_widen_printable_ascii = widen_printable_ascii_impl(g_simd_level);
+
+size_t
+widen_printable_ascii(uint8_t const* start,
+                      uint8_t const* end,
+                      uint32_t* dst) noexcept
+{
+        return g_widen_printable_ascii(start, end, dst);
+}
+
+SIMDLevel
+widen_printable_ascii_simd_level() noexcept
+{
+        return g_simd_level;
+}
+
+bool
+set_widen_printable_ascii_simd_level(SIMDLevel level) noexcept
+{
+        if (!simd_level_supported(level))
+                return false;
+
+        g_simd_level = level;
+        g_widen_printable_ascii = widen_printable_ascii_impl(level);
+        return true;
+}
+
+} // namespace vte::base
@@ -25,6 +25,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 namespace vte {
@@ -62,6 +63,8 @@ public:
                 return m_state;
         }
 
+        inline constexpr bool is_accept() const noexcept { return m_state == ACCEPT; }
+
         inline void reset() noexcept {
                 m_state = ACCEPT;
                 m_codepoint = 0xfffdU;
@@ -82,6 +85,31 @@ private:
 
 }; // class UTF8Decoder
 
+/* Copies the run of printable ASCII characters (0x20..0x7e) at the start
+ * of [@start, @end) to @dst, widened to UTF-32. @dst must have room for
+ * (@end - @start) characters; note that more characters than the returned
+ * count may have been written to it.
+ *
+ * Returns: the number of characters in the run
+ */
+size_t widen_printable_ascii(uint8_t const* start,
+                             uint8_t const* end,
+                             uint32_t* dst) noexcept;
+
+/* The implementation used by widen_printable_ascii(). By default this is
+ * the best one available in this build; it can be overridden for testing and
+ * benchmarking.
+ */
+enum class SIMDLevel {
+        eNONE,
+        eSSE2,
+};
+
+SIMDLevel widen_printable_ascii_simd_level() noexcept;
+
+/* Returns: %false if @level is not available in this build */
+bool set_widen_printable_ascii_simd_level(SIMDLevel level) noexcept;
+
 } // namespace base
 
 } // namespace vte
@@ -50,7 +50,10 @@
 #include "caps.hh"
 #include "widget.hh"
 #include "cairo-glue.hh"
+#include "probes.hh"
 #include "scheduler.h"
+#include "snapshot.hh"
+#include "trace.hh"
 
 #if VTE_GTK == 4
 #include "graphene-glue.hh"
@@ -124,7 +127,7 @@ using namespace vte::color_palette;
 
 static void stop_processing(vte::terminal::Terminal* that);
 static void add_process_timeout(vte::terminal::Terminal* that);
-static void process_timeout (GtkWidget *widget, gpointer data) noexcept;
+static void process_timeout (GtkWidget *widget, gint64 time_slice, gpointer data) noexcept;
 
 #if VTE_GTK == 3
 static vte::Freeable<cairo_region_t> vte_cairo_get_clip_region(cairo_t* cr);
@@ -792,6 +795,9 @@ Terminal::cursor_blink_timer_callback()
 void
 Terminal::emit_selection_changed()
 {
+        if (!m_terminal)
+                return;
+
 	_vte_debug_print(VTE_DEBUG_SIGNALS,
 			"Emitting `selection-changed'.\n");
 	g_signal_emit(m_terminal, signals[SIGNAL_SELECTION_CHANGED], 0);
@@ -877,6 +883,9 @@ catch (...)
 void
 Terminal::queue_eof()
 {
+        if (!m_terminal)
+                return;
+
         _vte_debug_print(VTE_DEBUG_SIGNALS, "Queueing `eof'.\n");
 
         g_idle_add_full(G_PRIORITY_HIGH,
@@ -915,6 +924,9 @@ catch (...)
 void
 Terminal::queue_child_exited()
 {
+        if (!m_terminal)
+                return;
+
         _vte_debug_print(VTE_DEBUG_SIGNALS, "Queueing `child-exited'.\n");
 
         g_idle_add_full(G_PRIORITY_HIGH,
@@ -927,6 +939,9 @@ Terminal::queue_child_exited()
 void
 Terminal::emit_increase_font_size()
 {
+        if (!m_terminal)
+                return;
+
 	_vte_debug_print(VTE_DEBUG_SIGNALS,
 			"Emitting `increase-font-size'.\n");
 	g_signal_emit(m_terminal, signals[SIGNAL_INCREASE_FONT_SIZE], 0);
@@ -936,6 +951,9 @@ Terminal::emit_increase_font_size()
 void
 Terminal::emit_decrease_font_size()
 {
+        if (!m_terminal)
+                return;
+
 	_vte_debug_print(VTE_DEBUG_SIGNALS,
 			"Emitting `decrease-font-size'.\n");
 	g_signal_emit(m_terminal, signals[SIGNAL_DECREASE_FONT_SIZE], 0);
@@ -944,6 +962,9 @@ Terminal::emit_decrease_font_size()
 void
 Terminal::emit_copy_clipboard()
 {
+        if (!m_terminal)
+                return;
+
 	_vte_debug_print(VTE_DEBUG_SIGNALS, "Emitting 'copy-clipboard'.\n");
 	g_signal_emit(m_terminal, signals[SIGNAL_COPY_CLIPBOARD], 0);
 }
@@ -951,6 +972,9 @@ Terminal::emit_copy_clipboard()
 void
 Terminal::emit_paste_clipboard()
 {
+        if (!m_terminal)
+                return;
+
 	_vte_debug_print(VTE_DEBUG_SIGNALS, "Emitting 'paste-clipboard'.\n");
 	g_signal_emit(m_terminal, signals[SIGNAL_PASTE_CLIPBOARD], 0);
 }
@@ -959,6 +983,9 @@ Terminal::emit_paste_clipboard()
 void
 Terminal::emit_hyperlink_hover_uri_changed(const GdkRectangle *bbox)
 {
+        if (!m_terminal)
+                return;
+
         GObject *object = G_OBJECT(m_terminal);
 
         _vte_debug_print(VTE_DEBUG_SIGNALS,
@@ -1302,6 +1329,7 @@ Terminal::match_check_internal_pcre(vte::grid::column_t column,
                                                                        nullptr /* general context */));
 
 	/* Now iterate over each regex we need to match against. */
+        auto const start_time = g_get_monotonic_time();
         char* dingu_match{nullptr};
         for (auto const& rem : m_match_regexes) {
                 gsize sblank, eblank;
@@ -1325,6 +1353,7 @@ Terminal::match_check_internal_pcre(vte::grid::column_t column,
                         end_blank = eblank;
                 }
 	}
+        m_statistics.regex_time += g_get_monotonic_time() - start_time;
 
         if (dingu_match == nullptr) {
                 /* If we get here, there was no dingu match.
@@ -1869,6 +1898,7 @@ Terminal::regex_match_check_extra(vte::grid::column_t col,
         auto match_data = vte::take_freeable(pcre2_match_data_create_8(256 /* should be plenty */,
                                                                        nullptr /* general context */));
 
+        auto const start_time = g_get_monotonic_time();
         for (i = 0; i < n_regexes; i++) {
                 gsize start, end, sblank, eblank;
                 char *match_string;
@@ -1887,6 +1917,7 @@ Terminal::regex_match_check_extra(vte::grid::column_t col,
                 } else
                         matches[i] = nullptr;
         }
+        m_statistics.regex_time += g_get_monotonic_time() - start_time;
 
         return any_matches;
 }
@@ -1922,6 +1953,13 @@ Terminal::queue_adjustment_changed()
 void
 Terminal::queue_adjustment_value_changed(double v)
 {
+        /* Scrolling above the rows rewrapped on resize rewraps the rest too */
+        if (m_screen == &m_normal_screen &&
+            v < m_screen->row_data->rewrapped_start()) [[unlikely]] {
+                finish_rewrap();
+                v = std::max(v, double(m_screen->row_data->delta()));
+        }
+
         /* FIXME: do this check in pixel space? */
 	if (_vte_double_equal(v, m_screen->scroll_delta))
                 return;
@@ -3272,8 +3310,8 @@ Terminal::character_width(gunichar c) noexcept
 
 /* Insert a single character into the stored data array.
  *
- * Note that much of this method is duplicated below in insert_single_width_chars().
- * Make sure to keep the two in sync! */
+ * Note that much of this method is duplicated below in insert_single_width_chars()
+ * and insert_double_width_chars(). Make sure to keep them in sync! */
 void
 Terminal::insert_char(gunichar c,
                       bool invalidate_now)
@@ -3606,6 +3644,110 @@ Terminal::insert_single_width_chars(gunichar const *p, int len)
         }
 }
 
+/* Inserts each character of the string.
+ * The passed string MUST consist of double-width printable characters only.
+ * It performs the equivalent of calling insert_char(..., false) on each of them,
+ * but is usually much faster.
+ *
+ * Note that much of this method is duplicated above in insert_char() and
+ * insert_single_width_chars(). Make sure to keep them in sync! */
+void
+Terminal::insert_double_width_chars(gunichar const *p, int len)
+{
+        if (m_scrolling_region.is_restricted() ||
+            (*m_character_replacement == VTE_CHARACTER_REPLACEMENT_LINE_DRAWING) ||
+            !m_modes_private.DEC_AUTOWRAP() ||
+            m_modes_ecma.IRM() ||
+            m_column_count < 2) {
+                /* There is some special unusual circumstance.
+                 * Resort to inserting the characters one by one. */
+                while (len--) {
+                        insert_char(*p++, false);
+                }
+                return;
+        }
+
+        /* Same as insert_single_width_chars(), except that a character
+         * only fits into the row if both of its cells do, and that each
+         * character is followed by a fragment cell. */
+        auto attr = m_defaults.attr;
+        attr.set_columns(2);
+        auto fragment_attr = attr;
+        fragment_attr.set_fragment(true);
+
+        while (len) {
+                VteRowData *row;
+                long col;
+
+                /* If we're autowrapping here, do it. */
+                col = m_screen->cursor.col;
+                if (G_UNLIKELY (col + 2 > m_column_count)) {
+                        _vte_debug_print(VTE_DEBUG_ADJ,
+                                        "Autowrapping before character\n");
+                        /* Wrap. */
+                        /* XXX clear to the end of line */
+                        col = m_screen->cursor.col = 0;
+                        /* Mark this line as soft-wrapped. */
+                        row = ensure_row();
+                        set_soft_wrapped(m_screen->cursor.row);
+                        /* See insert_single_width_chars() about not using bce here. */
+                        cursor_down_with_scrolling(false);
+                        ensure_row();
+                        apply_bidi_attributes(m_screen->cursor.row, row->attr.bidi_flags, VTE_BIDI_FLAG_ALL);
+                }
+
+                /* The number of characters we can populate in this row. */
+                int run = MIN(len, (m_column_count - col) / 2);
+                vte_assert_cmpint(run, >=, 1);
+
+                _VTE_DEBUG_IF(VTE_DEBUG_PARSER) {
+                        gchar *utf8 = g_ucs4_to_utf8(p, run, NULL, NULL, NULL);
+                        _vte_debug_print(VTE_DEBUG_PARSER,
+                                         "Inserting string of %d double-width characters \"%s\" (colors %" G_GUINT64_FORMAT ") (%ld+%d, %ld), delta = %ld; ",
+                                         run, utf8, m_color_defaults.attr.colors(),
+                                         col, run * 2, (long)m_screen->cursor.row,
+                                         (long)m_screen->insert_delta);
+                        g_free(utf8);
+                }
+
+                /* Make sure we have enough rows to hold this data. */
+                row = ensure_cursor();
+                g_assert(row != NULL);
+
+                cleanup_fragments(col, col + run * 2);
+                _vte_row_data_fill (row, &basic_cell, col);
+                _vte_row_data_expand (row, col + run * 2);
+
+                len -= run;
+                while (run--) {
+                        VteCell *pcell = _vte_row_data_get_writable (row, col);
+                        pcell->c = *p;
+                        pcell->attr = attr;
+                        pcell++;
+                        pcell->c = *p;
+                        pcell->attr = fragment_attr;
+                        p++;
+                        col += 2;
+                }
+
+                if (_vte_row_data_length (row) > m_column_count)
+                        cleanup_fragments(m_column_count, _vte_row_data_length (row));
+                _vte_row_data_shrink (row, m_column_count);
+
+                m_screen->cursor.col = col;
+
+                m_last_graphic_character = *(p - 1);
+                m_screen->cursor_advanced_by_graphic_character = true;
+
+                /* We added text, so make a note of it. */
+                m_text_inserted_flag = TRUE;
+
+                _vte_debug_print(VTE_DEBUG_ADJ|VTE_DEBUG_PARSER,
+                                 "insertion delta => %ld.\n",
+                                 (long)m_screen->insert_delta);
+        }
+}
+
 #if WITH_SIXEL
 
 void
@@ -3776,7 +3918,20 @@ Terminal::child_watch_done(pid_t pid,
                 /* Read and process about 64k synchronously, up to EOF or EAGAIN
                  * or other error, to make sure we consume the child's output.
                  * See https://gitlab.gnome.org/GNOME/vte/-/issues/2627 */
-                pty_io_read(pty()->fd(), G_IO_IN, 65536);
+                auto reader_eos = false;
+                if (m_pty_reader) {
+                        /* Take over from the reader thread, keeping the data it
+                         * has already read; unless it already saw EOF, the
+                         * remainder is read synchronously below.
+                         */
+                        disconnect_pty_read();
+                        stop_pty_reader(true);
+                        reader_eos = !m_incoming_queue.empty() &&
+                                m_incoming_queue.back()->eos();
+                }
+
+                if (!reader_eos)
+                        pty_io_read(pty()->fd(), G_IO_IN, 65536);
                 if (!m_incoming_queue.empty()) {
                         process_incoming();
                 }
@@ -3807,12 +3962,55 @@ io_read_cb(int fd,
         return that->pty_io_read(fd, condition);
 }
 
+/* Collect data read by the PTY reader thread. */
+static gboolean
+pty_reader_wakeup_cb(int fd,
+                     GIOCondition condition,
+                     vte::terminal::Terminal* that)
+{
+        /* Like io_read_cb(), stop when the budget for this frame is
+         * used up; process() reconnects on the next frame. */
+        return that->pty_reader_drain(true) ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
+}
+
 void
 Terminal::connect_pty_read()
 {
 	if (m_pty_input_source != 0 || !pty())
 		return;
 
+        if (m_enable_threaded_pty_read &&
+            vte::base::PtyReader::is_supported()) {
+                if (!m_pty_reader) {
+                        auto reader = std::make_unique<vte::base::PtyReader>(pty()->fd());
+                        if (reader->start())
+                                m_pty_reader = std::move(reader);
+                }
+
+                /* If the thread couldn't be started, fall back to reading
+                 * on the main loop.
+                 */
+                if (m_pty_reader) {
+                        /* Pick up anything that was read while disconnected.
+                         * Like pty_reader_wakeup_cb(), stop when the budget
+                         * for this frame is used up, without adding the
+                         * source; process() reconnects on the next frame.
+                         */
+                        if (!pty_reader_drain(true))
+                                return;
+
+                        _vte_debug_print (VTE_DEBUG_IO, "Adding PTY reader thread source\n");
+
+                        m_pty_input_source = g_unix_fd_add_full(VTE_CHILD_INPUT_PRIORITY,
+                                                                m_pty_reader->wakeup_fd(),
+                                                                G_IO_IN,
+                                                                (GUnixFDSourceFunc)pty_reader_wakeup_cb,
+                                                                this,
+                                                                (GDestroyNotify)mark_input_source_invalid_cb);
+                        return;
+                }
+        }
+
         _vte_debug_print (VTE_DEBUG_IO, "Adding PTY input source\n");
 
         m_pty_input_source = g_unix_fd_add_full(VTE_CHILD_INPUT_PRIORITY,
@@ -3876,6 +4074,128 @@ Terminal::disconnect_pty_read()
 	}
 }
 
+/*
+ * Terminal::pty_reader_drain:
+ * @bounded: whether to stop at the processing budget
+ *
+ * Moves the chunks read by the PTY reader thread to the incoming queue,
+ * and handles the PTY events it saw.
+ *
+ * Returns: %false iff the processing budget for this frame was reached
+ */
+bool
+Terminal::pty_reader_drain(bool bounded)
+{
+        auto span = vte::base::TraceSpan{"pty-reader-drain", this};
+        auto& reader = *m_pty_reader;
+        reader.acknowledge_wakeup();
+
+        auto const events = reader.take_events();
+        if (events & vte::base::PtyReader::eTERMIOS_CHANGED)
+                pty_termios_changed();
+        if (events & vte::base::PtyReader::eSCROLL_LOCKED)
+                pty_scroll_lock_changed(true);
+        if (events & vte::base::PtyReader::eSCROLL_UNLOCKED)
+                pty_scroll_lock_changed(false);
+
+        auto bytes = size_t{0};
+        auto eos = false;
+        auto const max_bytes = bounded ? m_governor.budget() : G_MAXSIZE;
+        while (m_input_bytes + bytes < max_bytes) {
+                auto chunk = reader.pop();
+                if (!chunk)
+                        break;
+
+                bytes += chunk->size_reading();
+                eos |= chunk->eos();
+                m_incoming_queue.push(std::move(chunk));
+        }
+
+        reader.replenish();
+
+        if (bytes == 0 && !eos)
+                return m_input_bytes < max_bytes;
+
+        _vte_debug_print(VTE_DEBUG_IO, "collected %" G_GSIZE_FORMAT " bytes from reader thread%s\n",
+                         bytes, eos ? ", EOS" : "");
+
+        m_pty_input_active = bytes != 0;
+        m_input_bytes += bytes;
+        m_statistics.pty_bytes_read += bytes;
+        span.set_arg("bytes", bytes);
+
+        if (!is_processing()) {
+                add_process_timeout(this);
+        }
+
+        return m_input_bytes < max_bytes;
+}
+
+/*
+ * Terminal::stop_pty_reader:
+ * @drain: whether to move the data already read to the incoming queue
+ *
+ * Stops the PTY reader thread, if any.
+ */
+void
+Terminal::stop_pty_reader(bool drain)
+{
+        if (!m_pty_reader)
+                return;
+
+        m_pty_reader->stop();
+        if (drain)
+                pty_reader_drain(false);
+
+        m_pty_reader.reset();
+}
+
+/*
+ * Terminal::set_enable_threaded_pty_read:
+ * @enable: whether to read the PTY on a separate thread
+ *
+ * Returns: %true iff the setting changed
+ */
+bool
+Terminal::set_enable_threaded_pty_read(bool enable)
+{
+        if (enable == m_enable_threaded_pty_read)
+                return false;
+
+        m_enable_threaded_pty_read = enable;
+
+        /* Switch readers, unless reading is paused (e.g. while selecting) */
+        if (m_pty_input_source != 0) {
+                disconnect_pty_read();
+                stop_pty_reader(true);
+                connect_pty_read();
+        } else if (!enable) {
+                stop_pty_reader(true);
+        }
+
+        return true;
+}
+
+/*
+ * Terminal::set_scheduling_priority:
+ * @priority: the #VteSchedulingPriority
+ *
+ * Returns: %true iff the setting changed
+ */
+bool
+Terminal::set_scheduling_priority(VteSchedulingPriority priority)
+{
+        if (priority == m_scheduling_priority)
+                return false;
+
+        m_scheduling_priority = priority;
+
+        if (m_scheduler != nullptr)
+                _vte_scheduler_set_priority(m_scheduler, priority);
+
+        return true;
+}
+
 void
 Terminal::disconnect_pty_write()
 {
@@ -3975,6 +4295,10 @@ Terminal::process_incoming()
         /* We should only be called when there's data to process. */
         g_assert(!m_incoming_queue.empty());
 
+        VTE_PROBE(process_incoming_start, this, m_input_bytes, m_incoming_queue.size());
+
+        auto span = vte::base::TraceSpan{"process-incoming", this};
+        auto const start_time = g_get_monotonic_time();
         auto bytes_processed = ssize_t{0};
 
         auto context = ProcessingContext{*this};
@@ -4096,6 +4420,12 @@ Terminal::process_incoming()
         /* After processing some data, do a hyperlink GC. The multiplier is totally arbitrary, feel free to fine tune. */
         m_screen->row_data->hyperlink_maybe_gc(bytes_processed * 8);
 
+        m_statistics.bytes_processed += bytes_processed;
+        span.set_arg("bytes", bytes_processed);
+        m_statistics.process_time += g_get_monotonic_time() - start_time;
+
+        VTE_PROBE(process_incoming_end, this, bytes_processed, m_input_bytes);
+
         _vte_debug_print (VTE_DEBUG_WORK, ")");
         _vte_debug_print (VTE_DEBUG_IO,
                           "%" G_GSIZE_FORMAT " bytes in %" G_GSIZE_FORMAT " chunks left to process.\n",
@@ -4119,9 +4449,32 @@ Terminal::process_incoming_utf8(ProcessingContext& context,
         static_assert(vte::base::Chunk::max_size() <= 8 * 1024);
         gunichar *single_width_chars = g_newa(gunichar, iend - ip);
         int single_width_chars_count;
+        /* Double width chars take at least 2 bytes (with ambiguous width 2), so at most 16kB. */
+        gunichar *double_width_chars = g_newa(gunichar, (iend - ip) / 2 + 1);
+        int double_width_chars_count;
 
         while (ip < iend) [[likely]] {
 
+                // Apply common SGR sequences directly, without going
+                // through the parser and command dispatch; see SGR().
+                if (*ip == 0x1b /* ESC */ &&
+                    m_utf8_decoder.is_accept() &&
+                    m_parser.is_ground()) {
+                        if (auto const n = m_sgr_cache.apply(ip, iend, m_defaults.attr)) {
+                                _vte_debug_print(VTE_DEBUG_PARSER,
+                                                 "SGR fast path: %.*s\n",
+                                                 int(n - 1), (char const*)ip + 1);
+
+                                m_color_defaults.attr.copy_colors(m_defaults.attr);
+                                m_last_graphic_character = 0;
+                                ++m_statistics.sequences[VTE_SEQ_CSI];
+                                ip += n;
+
+                                context.post_CMD();
+                                continue;
+                        }
+                }
+
                 switch (m_utf8_decoder.decode(*(ip++))) {
                 case vte::base::UTF8Decoder::REJECT_REWIND:
                         /* Rewind the stream.
@@ -4181,33 +4534,67 @@ Terminal::process_incoming_utf8(ProcessingContext& context,
                                 // characters. So plan for that and avoid round-tripping
                                 // through the main UTF-8 decoder as well as the Parser. It
                                 // also allows for a single pre_GRAPHIC()/post_GRAPHIC().
-                                single_width_chars_count = 0;
                                 /* Super quickly process initial ASCII segment. */
-                                while (ip < iend && *ip >= 0x20 && *ip < 0x7F) [[likely]] {
-                                        single_width_chars[single_width_chars_count++] = *ip;
-                                        ip++;
-                                }
+                                single_width_chars_count = vte::base::widen_printable_ascii(ip, iend, single_width_chars);
+                                double_width_chars_count = 0;
+                                ip += single_width_chars_count;
                                 if (ip < iend && *ip >= 0x80) {
                                         /* Continue with UTF-8 (possibly including further ASCII) non-control chars. */
                                         /* This is just a little bit slower than the ASCII loop above. */
+                                        /* Runs of single and of double width chars are collected in separate
+                                         * arrays, at most one of which is non-empty at any time. */
                                         vte::base::UTF8Decoder decoder;
                                         auto ip_lookahead = ip;
                                         while (ip_lookahead < iend) [[likely]] {
+                                                /* At a character boundary, take any ASCII run in one go. */
+                                                if (ip == ip_lookahead && *ip < 0x80) {
+                                                        if (double_width_chars_count > 0 &&
+                                                            *ip >= 0x20 && *ip < 0x7F) {
+                                                                insert_double_width_chars(double_width_chars, double_width_chars_count);
+                                                                double_width_chars_count = 0;
+                                                        }
+
+                                                        auto const n = vte::base::widen_printable_ascii(ip, iend, single_width_chars + single_width_chars_count);
+                                                        single_width_chars_count += n;
+                                                        ip += n;
+                                                        ip_lookahead = ip;
+                                                        if (ip == iend)
+                                                                break;
+                                                }
+
                                                 auto state = decoder.decode(*ip_lookahead++);
                                                 if (state == vte::base::UTF8Decoder::ACCEPT) [[likely]] {
                                                         gunichar c = decoder.codepoint();
-                                                        if ((c >= 0x20 && c < 0x7F) ||
-                                                            (c >= 0xA0 && _vte_unichar_width(c, context.m_terminal->m_utf8_ambiguous_width) == 1)) [[likely]] {
+                                                        auto const width = (c >= 0x20 && c < 0x7F) ? 1 :
+                                                                c >= 0xA0 ? _vte_unichar_width(c, context.m_terminal->m_utf8_ambiguous_width) : -1;
+                                                        if (width == 1) [[likely]] {
                                                                 /* Single width char, append to the array. */
+                                                                if (double_width_chars_count > 0) {
+                                                                        insert_double_width_chars(double_width_chars, double_width_chars_count);
+                                                                        double_width_chars_count = 0;
+                                                                }
                                                                 single_width_chars[single_width_chars_count++] = c;
                                                                 ip = ip_lookahead;
                                                                 continue;
-                                                        } else if (c >= 0xA0) {
-                                                                /* Zero or double width char, flush the array of single width ones and then process this. */
+                                                        } else if (width == 2) {
+                                                                /* Double width char, append to the other array. */
                                                                 if (single_width_chars_count > 0) {
                                                                         insert_single_width_chars(single_width_chars, single_width_chars_count);
                                                                         single_width_chars_count = 0;
                                                                 }
+                                                                double_width_chars[double_width_chars_count++] = c;
+                                                                ip = ip_lookahead;
+                                                                continue;
+                                                        } else if (width == 0) {
+                                                                /* Zero width char, flush the arrays and then process this. */
+                                                                if (single_width_chars_count > 0) {
+                                                                        insert_single_width_chars(single_width_chars, single_width_chars_count);
+                                                                        single_width_chars_count = 0;
+                                                                }
+                                                                if (double_width_chars_count > 0) {
+                                                                        insert_double_width_chars(double_width_chars, double_width_chars_count);
+                                                                        double_width_chars_count = 0;
+                                                                }
                                                                 insert_char(c, false);
                                                                 ip = ip_lookahead;
                                                                 continue;
@@ -4223,9 +4610,12 @@ Terminal::process_incoming_utf8(ProcessingContext& context,
                                                 /* else: More bytes needed, continue. */
                                         }
                                 }
-                                /* Flush the array of single width chars. */
-                                if (single_width_chars_count > 0) [[likely]] {
-                                        insert_single_width_chars(single_width_chars, single_width_chars_count);
+                                /* Flush the array of single or double width chars. */
+                                if (single_width_chars_count > 0 || double_width_chars_count > 0) [[likely]] {
+                                        if (single_width_chars_count > 0)
+                                                insert_single_width_chars(single_width_chars, single_width_chars_count);
+                                        else
+                                                insert_double_width_chars(double_width_chars, double_width_chars_count);
                                         _vte_debug_print(VTE_DEBUG_PARSER,
                                                          "Last graphic is now U+%04X %lc\n",
                                                          m_last_graphic_character,
@@ -4241,6 +4631,8 @@ Terminal::process_incoming_utf8(ProcessingContext& context,
                                 break;
 
                         default: {
+                                ++m_statistics.sequences[seq.type()];
+
                                 switch (seq.command()) {
 #define _VTE_CMD_HANDLER(cmd)   \
                                 case VTE_CMD_##cmd: cmd(seq); break;
@@ -4358,6 +4750,8 @@ Terminal::process_incoming_pcterm(ProcessingContext& context,
                                 break;
 
                         default: {
+                                ++m_statistics.sequences[seq.type()];
+
                                 switch (seq.command()) {
 #define _VTE_CMD_HANDLER(cmd)   \
                                 case VTE_CMD_##cmd: cmd(seq); break;
@@ -4462,6 +4856,7 @@ Terminal::pty_io_read(int const fd,
                       GIOCondition const condition,
                       int amount)
 {
+        auto span = vte::base::TraceSpan{"pty-read", this};
 	_vte_debug_print (VTE_DEBUG_WORK, ".");
         _vte_debug_print(VTE_DEBUG_IO, "::pty_io_read condition %02x\n", condition);
 
@@ -4488,7 +4883,7 @@ Terminal::pty_io_read(int const fd,
 
 		bytes = m_input_bytes;
                 if (G_LIKELY (amount < 0)) {
-                        max_bytes = m_max_input_bytes;
+                        max_bytes = m_governor.budget();
                 } else {
                         /* 'amount' explicitly specified. Try to read this much on top
                          * of what we might already have read and not yet processed,
@@ -4658,6 +5053,9 @@ out:
 			add_process_timeout(this);
 		}
 		m_pty_input_active = len != 0;
+                VTE_PROBE(pty_io_read, this, fd, bytes - m_input_bytes, max_bytes);
+                span.set_arg("bytes", bytes - m_input_bytes);
+                m_statistics.pty_bytes_read += bytes - m_input_bytes;
 		m_input_bytes = bytes;
 		again = bytes < max_bytes;
 
@@ -5112,7 +5510,7 @@ Terminal::check_cursor_blink()
 void
 Terminal::beep()
 {
-	if (m_audible_bell)
+	if (m_audible_bell && widget())
                 m_real_widget->beep();
 }
 
@@ -7230,6 +7628,7 @@ void
 Terminal::select_all()
 {
 	deselect_all();
+        finish_rewrap();
 
 	m_selecting_had_delta = TRUE;
 
@@ -8143,8 +8542,11 @@ Terminal::screen_set_size(VteScreen *screen_,
 
 	old_top_lines = below_current_paragraph.row - screen_->insert_delta;
 
-	if (do_rewrap && old_columns != m_column_count)
+	if (do_rewrap && old_columns != m_column_count) {
 		ring->rewrap(m_column_count, markers);
+                if (ring->rewrap_pending())
+                        m_rewrap_timer.schedule(0, vte::glib::Timer::Priority::eLOW);
+        }
 
 	if (long(ring->length()) > m_row_count) {
 		/* The content won't fit without scrollbars. Before figuring out the position, we might need to
@@ -8226,6 +8628,52 @@ Terminal::screen_set_size(VteScreen *screen_,
 		screen_->scroll_delta = new_scroll_delta;
 }
 
+/* Rewrap some of the scrollback that resizing left for later, see Ring::rewrap() */
+bool
+Terminal::rewrap_timer_callback()
+{
+        auto const deadline = g_get_monotonic_time() + 5000;  /* µs */
+
+        while (m_normal_screen.row_data->rewrap_some(1024)) {
+                if (g_get_monotonic_time() >= deadline)
+                        return true;  /* run again */
+        }
+
+        rewrap_finished();
+        return false;
+}
+
+/* Rewrap the rest of the scrollback now, before accessing it */
+void
+Terminal::finish_rewrap()
+{
+        if (!m_normal_screen.row_data->rewrap_pending())
+                return;
+
+        m_rewrap_timer.abort();
+        m_normal_screen.row_data->finish_rewrap();
+        rewrap_finished();
+}
+
+/* The scrollback above the rows rewrapped on resize has been rewrapped too,
+ * which changed the number of rows there, but not the numbers of those below. */
+void
+Terminal::rewrap_finished()
+{
+        auto const screen = &m_normal_screen;
+        auto const low = long(screen->row_data->delta());
+
+        screen->insert_delta = std::max(screen->insert_delta, low);
+        if (screen != m_screen) {
+                screen->scroll_delta = std::max(screen->scroll_delta, double(low));
+                return;
+        }
+
+        if (screen->scroll_delta < low)
+                queue_adjustment_value_changed(low);
+        queue_adjustment_changed();
+}
+
 void
 Terminal::set_size(long columns,
                    long rows,
@@ -8281,12 +8729,14 @@ Terminal::set_size(long columns,
                                                            long(m_screen->row_data->next()) - 1));
 
 		adjust_adjustments_full();
+                if (m_widget) {
 #if VTE_GTK == 3
-		gtk_widget_queue_resize_no_redraw(m_widget);
+                        gtk_widget_queue_resize_no_redraw(m_widget);
 #elif VTE_GTK == 4
-		if (!allocating)
-			gtk_widget_queue_resize(m_widget); // FIXMEgtk4?
+                        if (!allocating)
+                                gtk_widget_queue_resize(m_widget); // FIXMEgtk4?
 #endif
+                }
 	}
 
         /* The visible bits might have changed even if the dimension in characters didn't,
@@ -8335,7 +8785,7 @@ Terminal::Terminal(vte::platform::Widget* w,
                    VteTerminal *t) :
         m_real_widget(w),
         m_terminal(t),
-        m_widget(&t->widget),
+        m_widget(t ? &t->widget : nullptr),
         m_normal_screen(VTE_SCROLLBACK_INIT, true),
         m_alternate_screen(VTE_ROWS, false),
         m_screen(&m_normal_screen),
@@ -8346,8 +8796,9 @@ Terminal::Terminal(vte::platform::Widget* w,
         assert(m_termprops_dirty.size() == vte::terminal::n_registered_termprops());
 
         /* Inits allocation to 1x1 @ -1,-1 */
-        cairo_rectangle_int_t allocation;
-        gtk_widget_get_allocation(m_widget, &allocation);
+        cairo_rectangle_int_t allocation{-1, -1, 1, 1};
+        if (m_widget)
+                gtk_widget_get_allocation(m_widget, &allocation);
         set_allocated_rect(allocation);
 
 	/* NOTE! We allocated zeroed memory, just fill in non-zero stuff. */
@@ -9378,6 +9829,34 @@ Terminal::ringview_update()
         m_ringview.update ();
 }
 
+/* Looks up the state that the following painting operates on. The
+ * visible rows are copied into the ringview, so that painting does not
+ * need to go back to the ring (which, for rows in the scrollback, would
+ * mean thawing each of them again from the stream).
+ */
+void
+Terminal::prepare_paint()
+{
+        ringview_update();
+
+        m_paint.first_row = first_displayed_row();
+        m_paint.end_row = last_displayed_row() + 1;
+        m_paint.cursor = m_screen->cursor;
+        m_paint.cursor_visible = cursor_is_onscreen();
+}
+
+/* Returns: the copy of @row made for the current frame, or %nullptr
+ * if @row is not part of it.
+ */
+VteRowData const*
+Terminal::painted_row_data(vte::grid::row_t row) const
+{
+        if (!m_ringview.contains(row))
+                return nullptr;
+
+        return m_ringview.get_row(row);
+}
+
 /* Paint the contents of a given row at the given location.  Take advantage
  * of multiple-draw APIs by finding runs of characters with identical
  * attributes and bundling them together. */
@@ -9406,11 +9885,15 @@ Terminal::draw_rows(VteScreen *screen_,
         auto const column_count = m_column_count;
         uint32_t const attr_mask = m_allow_bold ? ~0 : ~VTE_ATTR_BOLD_MASK;
 
-        /* Need to ensure the ringview is updated. */
-        ringview_update();
+        /* The rows come from the copies made by prepare_paint() in draw(). */
+        vte_assert_true(m_ringview.is_updated());
 
         auto items = g_newa(vte::view::DrawingContext::TextRequest, column_count);
 
+        VTE_PROBE(draw_rows_start, this, start_row, end_row);
+        auto span = vte::base::TraceSpan{"draw-rows", this};
+        span.set_arg("rows", end_row - start_row);
+
         /* Paint the background.
          * Do it first for all the cells we're about to paint, before drawing the glyphs,
          * so that overflowing bits of a glyph (to the right or downwards) won't be
@@ -9448,7 +9931,7 @@ Terminal::draw_rows(VteScreen *screen_,
                 auto const y = crect.cairo()->y;
 #endif
 
-		row_data = find_row_data(row);
+                row_data = painted_row_data(row);
                 bidirow = m_ringview.get_bidirow(row);
 
 #if VTE_GTK == 3
@@ -9574,7 +10057,7 @@ Terminal::draw_rows(VteScreen *screen_,
                         continue;
 #endif
 
-                row_data = find_row_data(row);
+                row_data = painted_row_data(row);
                 if (row_data == NULL)
                         continue; /* Skip row. */
 
@@ -9692,6 +10175,8 @@ Terminal::draw_rows(VteScreen *screen_,
                                    column_width, row_height);
                 }
         }
+
+        VTE_PROBE(draw_rows_end, this, start_row, end_row);
 }
 
 // Returns the rectangle the cursor would be drawn if a block cursor,
@@ -9772,28 +10257,25 @@ Terminal::paint_cursor()
 	if (focus && !blink)
 		return;
 
-        lcol = m_screen->cursor.col;
-        drow = m_screen->cursor.row;
+        lcol = m_paint.cursor.col;
+        drow = m_paint.cursor.row;
 	width = m_cell_width;
 	height = m_cell_height;
 
-        if (!cursor_is_onscreen())
+        if (!m_paint.cursor_visible)
                 return;
         if (CLAMP(lcol, 0, m_column_count - 1) != lcol)
 		return;
 
-        /* Need to ensure the ringview is updated. */
-        ringview_update();
-
         /* Find the first cell of the character "under" the cursor.
          * This is for CJK.  For TAB, paint the cursor where it really is. */
-        VteRowData const *row_data = find_row_data(drow);
+        VteRowData const *row_data = painted_row_data(drow);
         vte::base::BidiRow const *bidirow = m_ringview.get_bidirow(drow);
 
-        auto cell = find_charcell(lcol, drow);
+        auto cell = row_data ? _vte_row_data_get(row_data, lcol) : nullptr;
         while (cell != NULL && cell->attr.fragment() && cell->c != '\t' && lcol > 0) {
                 lcol--;
-                cell = find_charcell(lcol, drow);
+                cell = _vte_row_data_get(row_data, lcol);
 	}
 
 	/* Draw the cursor. */
@@ -9935,12 +10417,9 @@ Terminal::paint_im_preedit_string()
 	if (m_im_preedit.empty())
 		return;
 
-        /* Need to ensure the ringview is updated. */
-        ringview_update();
-
         /* Get the row's BiDi information. */
-        row = m_screen->cursor.row;
-        if (row < first_displayed_row() || row > last_displayed_row())
+        row = m_paint.cursor.row;
+        if (row < m_paint.first_row || row >= m_paint.end_row)
                 return;
         vte::base::BidiRow const *bidirow = m_ringview.get_bidirow(row);
 
@@ -9954,7 +10433,7 @@ Terminal::paint_im_preedit_string()
 
 	/* If the pre-edit string won't fit on the screen if we start
 	 * drawing it at the cursor's position, move it left. */
-        vcol = bidirow->log2vis(m_screen->cursor.col);
+        vcol = bidirow->log2vis(m_paint.cursor.col);
         if (vcol + columns > m_column_count) {
                 vcol = MAX(0, m_column_count - columns);
 	}
@@ -9970,14 +10449,14 @@ Terminal::paint_im_preedit_string()
                         items[i].columns = _vte_unichar_width(items[i].c,
                                                               m_utf8_ambiguous_width);
                         items[i].x = (vcol + columns) * width;
-			items[i].y = row_to_pixel(m_screen->cursor.row);
+			items[i].y = row_to_pixel(m_paint.cursor.row);
 			columns += items[i].columns;
 			preedit = g_utf8_next_char(preedit);
 		}
                 if (G_LIKELY(m_clear_background)) {
                         m_draw.clear(
                                         vcol * width,
-                                        row_to_pixel(m_screen->cursor.row),
+                                        row_to_pixel(m_paint.cursor.row),
                                         width * columns,
                                         height,
                                         get_color(ColorPaletteIndex::default_bg()), m_background_alpha);
@@ -10075,6 +10554,8 @@ Terminal::draw(cairo_region_t const* region) noexcept
         auto const ring = m_screen->row_data;
 #endif
         auto now_ms = int64_t{0};
+        auto const draw_start = g_get_monotonic_time();
+        auto const span = vte::base::TraceSpan{"draw", this};
 
         allocated_width = get_allocated_width();
         allocated_height = get_allocated_height();
@@ -10164,12 +10645,12 @@ Terminal::draw(cairo_region_t const* region) noexcept
         m_text_to_blink = false;
 
         /* and now paint them */
-        auto const first_row = first_displayed_row();
+        prepare_paint();
         draw_rows(m_screen,
                   region,
-                  first_row,
-                  last_displayed_row() + 1,
-                  row_to_pixel(first_row),
+                  m_paint.first_row,
+                  m_paint.end_row,
+                  row_to_pixel(m_paint.first_row),
                   m_cell_width,
                   m_cell_height);
 
@@ -10209,6 +10690,11 @@ Terminal::draw(cairo_region_t const* region) noexcept
                                             vte::glib::Timer::Priority::eLOW);
 
         m_invalidated_all = FALSE;
+
+        auto const draw_time = g_get_monotonic_time() - draw_start;
+        m_governor.record_draw(draw_time);
+        m_statistics.draw_time += draw_time;
+        ++m_statistics.frames_drawn;
 }
 
 #if VTE_GTK == 3
@@ -10691,6 +11177,133 @@ Terminal::set_scrollback_lines(long lines)
         return true;
 }
 
+/*
+ * Terminal::set_scrollback_compression:
+ * @compression: the #VteScrollbackCompression
+ *
+ * Returns: %true iff the setting changed
+ */
+bool
+Terminal::set_scrollback_compression(VteScrollbackCompression compression)
+{
+        if (compression == m_scrollback_compression)
+                return false;
+
+        _vte_debug_print(VTE_DEBUG_MISC,
+                         "Setting scrollback compression to %s\n",
+                         compression == VTE_SCROLLBACK_COMPRESSION_SMALL ? "small" : "fast");
+
+        m_scrollback_compression = compression;
+
+        /* Only the normal screen has streams. Without zstd, there's only LZ4. */
+        auto codec = VTE_STREAM_CODEC_LZ4;
+        if (compression == VTE_SCROLLBACK_COMPRESSION_SMALL &&
+            _vte_stream_codec_is_supported(VTE_STREAM_CODEC_ZSTD))
+                codec = VTE_STREAM_CODEC_ZSTD;
+        m_normal_screen.row_data->set_stream_codec(codec);
+
+        return true;
+}
+
+/*
+ * Terminal::set_scrollback_cache_size:
+ * @size: the size in bytes
+ *
+ * Returns: %true iff the setting changed
+ */
+bool
+Terminal::set_scrollback_cache_size(size_t size)
+{
+        if (size == m_scrollback_cache_size)
+                return false;
+
+	_vte_debug_print (VTE_DEBUG_MISC,
+			"Setting scrollback cache size to %" G_GSIZE_FORMAT " bytes\n", size);
+
+        m_scrollback_cache_size = size;
+
+        /* Only the normal screen has streams, and they share one cache */
+        m_normal_screen.row_data->set_stream_cache_size(size);
+
+        return true;
+}
+
+/*
+ * Terminal::set_scrollback_storage:
+ * @storage: the #VteScrollbackStorage
+ *
+ * Returns: %true iff the setting changed
+ */
+bool
+Terminal::set_scrollback_storage(VteScrollbackStorage storage)
+{
+        if (storage == m_scrollback_storage)
+                return false;
+
+        _vte_debug_print(VTE_DEBUG_MISC,
+                         "Setting scrollback storage to %s\n",
+                         storage == VTE_SCROLLBACK_STORAGE_MEMORY ? "memory" : "file");
+
+        m_scrollback_storage = storage;
+
+        /* Only the normal screen has streams */
+        m_normal_screen.row_data->set_streams_in_memory(storage == VTE_SCROLLBACK_STORAGE_MEMORY);
+
+        return true;
+}
+
+void
+Terminal::scrollback_footprint(size_t& memory,
+                               size_t& disk) const
+{
+        m_normal_screen.row_data->stream_footprint(memory, disk);
+}
+
+/*
+ * Terminal::set_scrollback_bytes:
+ * @bytes: the quota in bytes, or 0 for none
+ *
+ * Returns: %true iff the setting changed
+ */
+bool
+Terminal::set_scrollback_bytes(size_t bytes)
+{
+        if (bytes == m_scrollback_bytes)
+                return false;
+
+	_vte_debug_print (VTE_DEBUG_MISC,
+			"Setting scrollback quota to %" G_GSIZE_FORMAT " bytes\n", bytes);
+
+        m_scrollback_bytes = bytes;
+
+        /* Only the normal screen has scrollback. The rows discarded for the
+         * quota are all above the screen, so only the scroll position needs
+         * adjusting. */
+        auto const scrn = &m_normal_screen;
+        scrn->row_data->set_max_bytes(bytes);
+        auto const low = long(scrn->row_data->delta());
+        scrn->insert_delta = std::max(scrn->insert_delta, low);
+        scrn->scroll_delta = CLAMP(scrn->scroll_delta, low, scrn->insert_delta);
+
+        /* Force a change in scroll_delta, see set_scrollback_lines() */
+        auto const scroll_delta = m_screen->scroll_delta;
+        m_screen->scroll_delta = -1;
+        queue_adjustment_value_changed(scroll_delta);
+        adjust_adjustments_full();
+
+        m_ringview.invalidate();
+        invalidate_all();
+        match_contents_clear();
+
+        return true;
+}
+
+size_t
+Terminal::scrollback_usage()
+{
+        return m_normal_screen.row_data->scrollback_bytes();
+}
+
 bool
 Terminal::set_backspace_binding(EraseMode binding)
 {
@@ -10920,6 +11533,7 @@ Terminal::unset_pty(bool notify_widget)
 
         disconnect_pty_read();
         disconnect_pty_write();
+        stop_pty_reader(false);
 
         /* Clear incoming and outgoing queues */
         m_input_bytes = 0;
@@ -11028,14 +11642,32 @@ stop_processing(vte::terminal::Terminal* that)
 static void
 add_process_timeout(vte::terminal::Terminal* that)
 {
-        if (that->m_scheduler == nullptr)
-                that->m_scheduler = _vte_scheduler_add_callback (
-                        that->m_widget, process_timeout, that);
+        /* Without a widget there is no frame clock to schedule on;
+         * start_processing() processes the input right away instead. */
+        if (that->m_scheduler != nullptr || !that->m_widget)
+                return;
+
+        that->m_scheduler = _vte_scheduler_add_callback (
+                that->m_widget, process_timeout, that);
+        _vte_scheduler_set_priority (that->m_scheduler, that->m_scheduling_priority);
 }
 
 void
 Terminal::start_processing()
 {
+        if (!m_widget) {
+                if (is_processing())
+                        return;
+
+                m_is_processing = true;
+                while (process())
+                        ;
+                m_is_processing = false;
+
+                vte::base::Chunk::prune();
+                return;
+        }
+
 	if (!is_processing())
 		add_process_timeout(this);
 }
@@ -11043,6 +11675,7 @@ Terminal::start_processing()
 void
 Terminal::emit_pending_signals()
 {
+        auto const span = vte::base::TraceSpan{"emit-signals", this};
         auto const freezer = vte::glib::FreezeObjectNotify{m_terminal};
 
 	emit_adjustment_changed();
@@ -11066,7 +11699,8 @@ Terminal::emit_pending_signals()
                         }
                 }
 
-                widget()->notify_termprops_changed(changed_props, n_changed_props);
+                if (widget())
+                        widget()->notify_termprops_changed(changed_props, n_changed_props);
 
                 // If there was (at least) an epehmeral termprop in this set,
                 // reset its value(s).
@@ -11080,7 +11714,7 @@ Terminal::emit_pending_signals()
                 }
         }
 
-        if (!m_no_legacy_signals) {
+        if (!m_no_legacy_signals && m_terminal) {
                 // Emit deprecated signals and notify:: for deprecated properties,
 
                 if (m_pending_changes & vte::to_integral(PendingChanges::TITLE)) {
@@ -11112,7 +11746,8 @@ Terminal::emit_pending_signals()
         if (m_cursor_moved_pending) {
                 _vte_debug_print(VTE_DEBUG_SIGNALS,
                                  "Emitting `cursor-moved'.\n");
-                g_signal_emit(freezer.get(), signals[SIGNAL_CURSOR_MOVED], 0);
+                if (m_terminal)
+                        g_signal_emit(freezer.get(), signals[SIGNAL_CURSOR_MOVED], 0);
                 m_cursor_moved_pending = false;
         }
         if (m_text_modified_flag) {
@@ -11143,7 +11778,8 @@ Terminal::emit_pending_signals()
 
 		_vte_debug_print(VTE_DEBUG_SIGNALS,
 				"Emitting `contents-changed'.\n");
-		g_signal_emit(m_terminal, signals[SIGNAL_CONTENTS_CHANGED], 0);
+                if (m_terminal)
+                        g_signal_emit(m_terminal, signals[SIGNAL_CONTENTS_CHANGED], 0);
 		m_contents_changed_pending = false;
 	}
         if (m_bell_pending) {
@@ -11169,11 +11805,71 @@ Terminal::emit_pending_signals()
 void
 Terminal::time_process_incoming()
 {
-	g_timer_reset(process_timer);
+        auto const bytes = m_input_bytes;
+        auto const start = g_get_monotonic_time();
 	process_incoming();
-	auto elapsed = g_timer_elapsed(process_timer, NULL) * 1000;
-	gssize target = VTE_MAX_PROCESS_TIME / elapsed * m_input_bytes;
-	m_max_input_bytes = (m_max_input_bytes + target) / 2;
+        m_governor.record_process(bytes, g_get_monotonic_time() - start);
+}
+
+/*
+ * Terminal::ref_statistics:
+ *
+ * Returns: a new reference to an a{sv} variant with the counters
+ *   described in vte_terminal_ref_statistics()
+ */
+GVariant*
+Terminal::ref_statistics() const
+{
+        GVariantBuilder builder;
+        g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+
+        auto const add_uint = [&](char const* key,
+                                  uint64_t value) {
+                g_variant_builder_add(&builder, "{sv}", key, g_variant_new_uint64(value));
+        };
+        auto const add_time = [&](char const* key,
+                                  int64_t value) {
+                g_variant_builder_add(&builder, "{sv}", key, g_variant_new_int64(value));
+        };
+
+        add_uint("pty-bytes-read", m_statistics.pty_bytes_read);
+        add_uint("bytes-processed", m_statistics.bytes_processed);
+
+        static constinit std::pair<int, char const*> const sequence_keys[] = {
+                {VTE_SEQ_CONTROL, "sequences-control"},
+                {VTE_SEQ_ESCAPE, "sequences-escape"},
+                {VTE_SEQ_CSI, "sequences-csi"},
+                {VTE_SEQ_DCS, "sequences-dcs"},
+                {VTE_SEQ_OSC, "sequences-osc"},
+                {VTE_SEQ_SCI, "sequences-sci"},
+                {VTE_SEQ_APC, "sequences-apc"},
+                {VTE_SEQ_PM, "sequences-pm"},
+                {VTE_SEQ_SOS, "sequences-sos"},
+        };
+        for (auto const& [type, key] : sequence_keys)
+                add_uint(key, m_statistics.sequences[type]);
+
+        add_time("process-time", m_statistics.process_time);
+        add_uint("frames-drawn", m_statistics.frames_drawn);
+        add_time("draw-time", m_statistics.draw_time);
+
+        auto const& normal = m_normal_screen.m_ring;
+        auto const& alternate = m_alternate_screen.m_ring;
+        add_uint("rows-frozen", normal.rows_frozen() + alternate.rows_frozen());
+        add_uint("rows-thawed", normal.rows_thawed() + alternate.rows_thawed());
+        add_uint("stream-bytes-written", normal.stream_bytes_written() + alternate.stream_bytes_written());
+        add_uint("stream-bytes-read", normal.stream_bytes_read() + alternate.stream_bytes_read());
+        add_uint("stream-cache-hits", normal.stream_cache_hits() + alternate.stream_cache_hits());
+        add_uint("stream-cache-misses", normal.stream_cache_misses() + alternate.stream_cache_misses());
+
+        auto font_cache_hits = uint64_t{0}, font_cache_misses = uint64_t{0};
+        m_draw.get_font_cache_statistics(font_cache_hits, font_cache_misses);
+        add_uint("font-cache-hits", font_cache_hits);
+        add_uint("font-cache-misses", font_cache_misses);
+
+        add_time("regex-time", m_statistics.regex_time);
+
+        return g_variant_ref_sink(g_variant_builder_end(&builder));
 }
 
 bool
@@ -11189,11 +11885,7 @@ Terminal::process()
 
         bool is_active = !m_incoming_queue.empty();
         if (is_active) {
-                if (VTE_MAX_PROCESS_TIME) {
-                        time_process_incoming();
-                } else {
-                        process_incoming();
-                }
+                time_process_incoming();
                 m_input_bytes = 0;
         } else
                 emit_pending_signals();
@@ -11203,10 +11895,15 @@ Terminal::process()
 
 static void
 process_timeout (GtkWidget *widget,
+                 gint64 time_slice,
                  gpointer data) noexcept
 try
 {
         auto that = reinterpret_cast<vte::terminal::Terminal*>(data);
+        auto const span = vte::base::TraceSpan{"process-timeout", that};
+
+        that->m_governor.set_frame_interval(_vte_scheduler_get_frame_interval(widget));
+        that->m_governor.set_time_slice(time_slice);
 
         that->m_is_processing = true;
         auto is_active = that->process();
@@ -11231,6 +11928,8 @@ Terminal::invalidate_dirty_rects_and_process_updates()
         if (G_UNLIKELY(!widget_realized()))
                 return false;
 
+        auto const span = vte::base::TraceSpan{"invalidate", this};
+
 #if VTE_GTK == 3
 	if (G_UNLIKELY (!m_update_rects->len))
 		return false;
@@ -11270,9 +11969,93 @@ Terminal::write_contents_sync (GOutputStream *stream,
                                GCancellable *cancellable,
                                GError **error)
 {
+        finish_rewrap();
         return m_screen->row_data->write_contents(stream, flags, cancellable, error);
 }
 
+/* Save the normal screen with its scrollback, cursor and modes, see snapshot.hh */
+bool
+Terminal::save_snapshot(GOutputStream* stream,
+                        GCancellable* cancellable,
+                        GError** error)
+{
+        auto const screen = &m_normal_screen;
+
+        auto header = vte::terminal::snapshot_header_new();
+        header.column_count = m_column_count;
+        header.row_count = m_row_count;
+        header.insert_delta = screen->insert_delta;
+        header.cursor_row = screen->cursor.row - screen->insert_delta;
+        header.cursor_column = screen->cursor.col;
+        header.modes_ecma = m_modes_ecma.get_modes();
+        header.modes_private = m_modes_private.get_modes();
+        header.defaults = m_defaults.attr;
+        header.defaults.hyperlink_idx = 0;
+
+        finish_rewrap();
+        return vte::terminal::snapshot_header_write(stream, header, cancellable, error) &&
+                screen->row_data->save_snapshot(stream, cancellable, error);
+}
+
+/* Replace the normal screen by a snapshot saved by save_snapshot(), and switch to it */
+bool
+Terminal::restore_snapshot(GInputStream* stream,
+                           GCancellable* cancellable,
+                           GError** error)
+{
+        auto header = vte::terminal::SnapshotHeader{};
+        if (!vte::terminal::snapshot_header_read(stream, &header, cancellable, error))
+                return false;
+
+        /* As in switch_screen(), the hyperlinks' idxs don't carry over */
+        m_hyperlink_hover_idx = m_screen->row_data->get_hyperlink_at_position(-1, -1, true, NULL);
+        m_hyperlink_hover_uri = NULL;
+        emit_hyperlink_hover_uri_changed(NULL);
+
+        auto const screen = &m_normal_screen;
+        auto const ring = screen->row_data;
+        m_rewrap_timer.abort();
+        if (!ring->load_snapshot(stream, cancellable, error))
+                return false;
+
+        deselect_all();
+        m_screen = screen;
+
+        m_modes_ecma.set_modes(header.modes_ecma);
+        m_modes_private.set_modes(header.modes_private);
+        m_modes_private.set_XTERM_ALTBUF(false);
+        m_modes_private.set_XTERM_OPT_ALTBUF(false);
+        m_modes_private.set_XTERM_OPT_ALTBUF_SAVE_CURSOR(false);
+        update_mouse_protocol();
+
+        m_defaults = m_color_defaults = basic_cell;
+        m_defaults.attr = header.defaults;
+        m_color_defaults.attr.copy_colors(m_defaults.attr);
+        reset_scrolling_region();
+
+        /* Lay the screen out at the snapshot's size, then resize it to ours */
+        screen->insert_delta = std::clamp(long(header.insert_delta), long(ring->delta()), long(ring->next()));
+        screen->scroll_delta = screen->insert_delta;
+        screen->cursor.row = screen->insert_delta + header.cursor_row;
+        screen->cursor.col = header.cursor_column;
+        screen->cursor_advanced_by_graphic_character = false;
+        screen_set_size(screen, header.column_count, header.row_count, m_rewrap_on_resize);
+
+        screen->cursor.row = std::clamp(screen->cursor.row,
+                                        screen->insert_delta,
+                                        screen->insert_delta + m_row_count - 1);
+        screen->cursor.col = std::min(screen->cursor.col, m_column_count);
+        save_cursor(screen);
+
+        adjust_adjustments_full();
+        m_ringview.invalidate();
+        invalidate_all();
+        match_contents_clear();
+        emit_text_modified();
+
+        return true;
+}
+
 /*
  * Buffer search
  */
@@ -11324,6 +12107,8 @@ Terminal::search_rows(pcre2_match_context_8 *match_context,
 	VteCharAttributes *ca;
         VteCharAttrList *attrs;
 
+        VTE_PROBE(search_rows_start, this, start_row, end_row, backward);
+
         auto row_text = g_string_new(nullptr);
         get_text(start_row, 0,
                  end_row, 0,
@@ -11343,6 +12128,7 @@ Terminal::search_rows(pcre2_match_context_8 *match_context,
         else
                 match_fn = pcre2_match_8;
 
+        auto const start_time = g_get_monotonic_time();
         r = match_fn(m_search_regex->code(),
                      (PCRE2_SPTR8)row_text->str, row_text->len , /* subject, length */
                      0, /* start offset */
@@ -11351,6 +12137,10 @@ Terminal::search_rows(pcre2_match_context_8 *match_context,
                      match_data,
                      match_context);
 
+        m_statistics.regex_time += g_get_monotonic_time() - start_time;
+
+        VTE_PROBE(search_rows_end, this, row_text->len, r);
+
         if (r == PCRE2_ERROR_NOMATCH) {
                 g_string_free (row_text, TRUE);
                 return false;
@@ -11456,6 +12246,8 @@ Terminal::search_find (bool backward)
         if (!m_search_regex)
                 return false;
 
+        finish_rewrap();
+
 	/* TODO
 	 * Currently We only find one result per extended line, and ignore columns
 	 * Moreover, the whole search thing is implemented very inefficiently.
@@ -310,4 +310,58 @@ typedef enum {
 	_VTE_PROPERTY_ID_MAX = 0x7ffffff, /*< skip >*/
 } VtePropertyId;
 
+/**
+ * VteSchedulingPriority:
+ * @VTE_SCHEDULING_PRIORITY_LOW: the terminal gets a small share of the
+ *   processing time, e.g. for a background tab
+ * @VTE_SCHEDULING_PRIORITY_NORMAL: the default
+ * @VTE_SCHEDULING_PRIORITY_HIGH: the terminal is processed before the
+ *   others and gets the largest share of the processing time
+ *
+ * An enumeration type that specifies how the processing time available
+ * in each frame is shared between the terminals of the process. The
+ * terminal that has the focus is always processed with
+ * %VTE_SCHEDULING_PRIORITY_HIGH.
+ *
+ * Since: 0.80
+ */
+typedef enum {
+        VTE_SCHEDULING_PRIORITY_LOW    = 0,
+        VTE_SCHEDULING_PRIORITY_NORMAL = 1,
+        VTE_SCHEDULING_PRIORITY_HIGH   = 2,
+} VteSchedulingPriority;
+
+/**
+ * VteScrollbackCompression:
+ * @VTE_SCROLLBACK_COMPRESSION_FAST: compress the scrollback quickly
+ * @VTE_SCROLLBACK_COMPRESSION_SMALL: compress the scrollback more
+ *   tightly, at the expense of speed, if supported by this build
+ *
+ * An enumeration type that specifies how the terminal compresses the
+ * contents of its scrollback buffer.
+ *
+ * Since: 0.80
+ */
+typedef enum {
+        VTE_SCROLLBACK_COMPRESSION_FAST  = 0,
+        VTE_SCROLLBACK_COMPRESSION_SMALL = 1,
+} VteScrollbackCompression;
+
+/**
+ * VteScrollbackStorage:
+ * @VTE_SCROLLBACK_STORAGE_FILE: the scrollback is kept in an unlinked
+ *   temporary file
+ * @VTE_SCROLLBACK_STORAGE_MEMORY: the scrollback is kept in memory
+ *
+ * An enumeration type that specifies where the terminal keeps the
+ * compressed (and, where supported, encrypted) contents of its
+ * scrollback buffer.
+ *
+ * Since: 0.80
+ */
+typedef enum {
+        VTE_SCROLLBACK_STORAGE_FILE   = 0,
+        VTE_SCROLLBACK_STORAGE_MEMORY = 1,
+} VteScrollbackStorage;
+
 G_END_DECLS
@@ -42,6 +42,16 @@ void vte_set_test_flags(guint64 flags) _VTE_CXX_NOEXCEPT;
 _VTE_PUBLIC
 guint64 vte_get_test_flags(void) _VTE_CXX_NOEXCEPT;
 
+_VTE_PUBLIC
+void vte_set_trace_enabled(gboolean enabled) _VTE_CXX_NOEXCEPT;
+
+_VTE_PUBLIC
+gboolean vte_get_trace_enabled(void) _VTE_CXX_NOEXCEPT;
+
+_VTE_PUBLIC
+gboolean vte_write_trace(char const* filename,
+                         GError** error) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
+
 /**
  * VTE_TERMPROP_NAME_PREFIX:
  *
@@ -602,6 +602,19 @@ gboolean vte_terminal_write_contents_sync (VteTerminal *terminal,
                                            GCancellable *cancellable,
                                            GError **error) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1, 2);
 
+/* Saving and restoring the scrollback */
+_VTE_PUBLIC
+gboolean vte_terminal_save_snapshot(VteTerminal* terminal,
+                                    GOutputStream* stream,
+                                    GCancellable* cancellable,
+                                    GError** error) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1, 2);
+
+_VTE_PUBLIC
+gboolean vte_terminal_restore_snapshot(VteTerminal* terminal,
+                                       GInputStream* stream,
+                                       GCancellable* cancellable,
+                                       GError** error) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1, 2);
+
 /* Images */
 
 /* Set or get whether SIXEL image support is enabled */
@@ -647,6 +660,59 @@ void vte_terminal_set_enable_legacy_osc777(VteTerminal* terminal,
 _VTE_PUBLIC
 gboolean vte_terminal_get_enable_legacy_osc777(VteTerminal* terminal) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
 
+_VTE_PUBLIC
+void vte_terminal_set_enable_threaded_pty_read(VteTerminal* terminal,
+                                               gboolean enable) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
+
+_VTE_PUBLIC
+gboolean vte_terminal_get_enable_threaded_pty_read(VteTerminal* terminal) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
+
+_VTE_PUBLIC
+void vte_terminal_set_scheduling_priority(VteTerminal* terminal,
+                                          VteSchedulingPriority priority) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
+
+_VTE_PUBLIC
+VteSchedulingPriority vte_terminal_get_scheduling_priority(VteTerminal* terminal) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
+
+_VTE_PUBLIC
+void vte_terminal_set_scrollback_storage(VteTerminal* terminal,
+                                         VteScrollbackStorage storage) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
+
+_VTE_PUBLIC
+VteScrollbackStorage vte_terminal_get_scrollback_storage(VteTerminal* terminal) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
+
+_VTE_PUBLIC
+void vte_terminal_get_scrollback_footprint(VteTerminal* terminal,
+                                           guint64* memory,
+                                           guint64* disk) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
+
+_VTE_PUBLIC
+void vte_terminal_set_scrollback_bytes(VteTerminal* terminal,
+                                       guint64 bytes) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
+
+_VTE_PUBLIC
+guint64 vte_terminal_get_scrollback_bytes(VteTerminal* terminal) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
+
+_VTE_PUBLIC
+guint64 vte_terminal_get_scrollback_usage(VteTerminal* terminal) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
+
+_VTE_PUBLIC
+void vte_terminal_set_scrollback_compression(VteTerminal* terminal,
+                                             VteScrollbackCompression compression) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
+
+_VTE_PUBLIC
+VteScrollbackCompression vte_terminal_get_scrollback_compression(VteTerminal* terminal) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
+
+_VTE_PUBLIC
+void vte_terminal_set_scrollback_cache_size(VteTerminal* terminal,
+                                            guint64 size) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
+
+_VTE_PUBLIC
+guint64 vte_terminal_get_scrollback_cache_size(VteTerminal* terminal) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
+
+_VTE_PUBLIC
+GVariant* vte_terminal_ref_statistics(VteTerminal* terminal) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
+
 _VTE_PUBLIC
 void vte_terminal_set_context_menu_model(VteTerminal* terminal,
                                          GMenuModel* model) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
@@ -80,8 +80,6 @@
 #define VTE_HYPERLINK_CURSOR_DEBUG	std::string{"crosshair"}
 #define VTE_CHILD_INPUT_PRIORITY	G_PRIORITY_DEFAULT_IDLE
 #define VTE_CHILD_OUTPUT_PRIORITY	G_PRIORITY_HIGH
-#define VTE_MAX_INPUT_READ		0x1000
-#define VTE_MAX_PROCESS_TIME		100
 #define VTE_CELL_BBOX_SLACK		1
 #define VTE_DEFAULT_UTF8_AMBIGUOUS_WIDTH 1
 
@@ -54,6 +54,7 @@
 #include "gobject-glue.hh"
 #include "marshal.h"
 #include "reaper.hh"
+#include "trace.hh"
 #include "vtedefines.hh"
 #include "vteinternal.hh"
 #include "widget.hh"
@@ -263,7 +264,6 @@ _vte_terminal_get_impl(VteTerminal* terminal) /* throws */
 
 guint signals[LAST_SIGNAL];
 GParamSpec *pspecs[LAST_PROP];
-GTimer *process_timer;
 uint64_t g_test_flags = 0;
 
 static bool
@@ -1119,6 +1119,9 @@ try
                 case PROP_ENABLE_SIXEL:
                         g_value_set_boolean (value, vte_terminal_get_enable_sixel (terminal));
                         break;
+                case PROP_ENABLE_THREADED_PTY_READ:
+                        g_value_set_boolean(value, vte_terminal_get_enable_threaded_pty_read(terminal));
+                        break;
                 case PROP_ENCODING:
                         g_value_set_string (value, vte_terminal_get_encoding (terminal));
                         break;
@@ -1149,9 +1152,24 @@ try
                 case PROP_REWRAP_ON_RESIZE:
                         g_value_set_boolean (value, vte_terminal_get_rewrap_on_resize (terminal));
                         break;
+                case PROP_SCHEDULING_PRIORITY:
+                        g_value_set_enum(value, vte_terminal_get_scheduling_priority(terminal));
+                        break;
+                case PROP_SCROLLBACK_CACHE_SIZE:
+                        g_value_set_uint64(value, vte_terminal_get_scrollback_cache_size(terminal));
+                        break;
+                case PROP_SCROLLBACK_COMPRESSION:
+                        g_value_set_enum(value, vte_terminal_get_scrollback_compression(terminal));
+                        break;
+                case PROP_SCROLLBACK_BYTES:
+                        g_value_set_uint64(value, vte_terminal_get_scrollback_bytes(terminal));
+                        break;
                 case PROP_SCROLLBACK_LINES:
                         g_value_set_uint (value, vte_terminal_get_scrollback_lines(terminal));
                         break;
+                case PROP_SCROLLBACK_STORAGE:
+                        g_value_set_enum(value, vte_terminal_get_scrollback_storage(terminal));
+                        break;
                 case PROP_SCROLL_ON_INSERT:
                         g_value_set_boolean(value, vte_terminal_get_scroll_on_insert(terminal));
                         break;
@@ -1279,6 +1297,9 @@ try
                 case PROP_ENABLE_SIXEL:
                         vte_terminal_set_enable_sixel (terminal, g_value_get_boolean (value));
                         break;
+                case PROP_ENABLE_THREADED_PTY_READ:
+                        vte_terminal_set_enable_threaded_pty_read(terminal, g_value_get_boolean(value));
+                        break;
                 case PROP_ENCODING:
                         vte_terminal_set_encoding (terminal, g_value_get_string (value), NULL);
                         break;
@@ -1304,9 +1325,24 @@ try
                 case PROP_REWRAP_ON_RESIZE:
                         vte_terminal_set_rewrap_on_resize (terminal, g_value_get_boolean (value));
                         break;
+                case PROP_SCHEDULING_PRIORITY:
+                        vte_terminal_set_scheduling_priority(terminal, (VteSchedulingPriority)g_value_get_enum(value));
+                        break;
+                case PROP_SCROLLBACK_CACHE_SIZE:
+                        vte_terminal_set_scrollback_cache_size(terminal, g_value_get_uint64(value));
+                        break;
+                case PROP_SCROLLBACK_COMPRESSION:
+                        vte_terminal_set_scrollback_compression(terminal, (VteScrollbackCompression)g_value_get_enum(value));
+                        break;
+                case PROP_SCROLLBACK_BYTES:
+                        vte_terminal_set_scrollback_bytes(terminal, g_value_get_uint64(value));
+                        break;
                 case PROP_SCROLLBACK_LINES:
                         vte_terminal_set_scrollback_lines (terminal, g_value_get_uint (value));
                         break;
+                case PROP_SCROLLBACK_STORAGE:
+                        vte_terminal_set_scrollback_storage(terminal, (VteScrollbackStorage)g_value_get_enum(value));
+                        break;
                 case PROP_SCROLL_ON_INSERT:
                         vte_terminal_set_scroll_on_insert(terminal, g_value_get_boolean(value));
                         break;
@@ -1493,6 +1529,8 @@ catch (...)
 static void
 vte_terminal_class_init(VteTerminalClass *klass)
 {
+        vte::base::Tracer::init_from_environment();
+
 #if VTE_DEBUG
 	{
                 _vte_debug_init();
@@ -2744,6 +2782,63 @@ vte_terminal_class_init(VteTerminalClass *klass)
                                    VTE_SCROLLBACK_INIT,
                                    (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY));
 
+        /**
+         * VteTerminal:scrollback-bytes:
+         *
+         * The maximum size of the scrollback buffer in bytes, in addition to
+         * #VteTerminal:scrollback-lines, or 0 for no limit.
+         * See vte_terminal_set_scrollback_bytes() for details.
+         *
+         * Since: 0.80
+         */
+        pspecs[PROP_SCROLLBACK_BYTES] =
+                g_param_spec_uint64("scrollback-bytes", nullptr, nullptr,
+                                    0, G_MAXUINT64,
+                                    0,
+                                    GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY));
+
+        /**
+         * VteTerminal:scrollback-cache-size:
+         *
+         * How much memory in bytes to spend on caching scrollback read back
+         * from its compressed storage.
+         * See vte_terminal_set_scrollback_cache_size() for details.
+         *
+         * Since: 0.80
+         */
+        pspecs[PROP_SCROLLBACK_CACHE_SIZE] =
+                g_param_spec_uint64("scrollback-cache-size", nullptr, nullptr,
+                                    0, G_MAXUINT32,
+                                    vte::base::Ring::k_default_stream_cache_size,
+                                    GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY));
+
+        /**
+         * VteTerminal:scrollback-compression:
+         *
+         * How the terminal compresses the contents of its scrollback buffer.
+         * See vte_terminal_set_scrollback_compression() for details.
+         *
+         * Since: 0.80
+         */
+        pspecs[PROP_SCROLLBACK_COMPRESSION] =
+                g_param_spec_enum("scrollback-compression", nullptr, nullptr,
+                                  VTE_TYPE_SCROLLBACK_COMPRESSION,
+                                  VTE_SCROLLBACK_COMPRESSION_FAST,
+                                  GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY));
+
+        /**
+         * VteTerminal:scrollback-storage:
+         *
+         * Where the terminal keeps the contents of its scrollback buffer.
+         *
+         * Since: 0.80
+         */
+        pspecs[PROP_SCROLLBACK_STORAGE] =
+                g_param_spec_enum("scrollback-storage", nullptr, nullptr,
+                                  VTE_TYPE_SCROLLBACK_STORAGE,
+                                  VTE_SCROLLBACK_STORAGE_FILE,
+                                  GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY));
+
 
         /**
          * VteTerminal:scroll-on-insert:
@@ -2954,6 +3049,33 @@ vte_terminal_class_init(VteTerminalClass *klass)
                                      false,
                                      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY));
 
+        /**
+         * VteTerminal:enable-threaded-pty-read:
+         *
+         * Whether the PTY is read on a separate thread, so that
+         * the child can keep writing while the main loop is busy.
+         *
+         * Since: 0.80
+         */
+        pspecs[PROP_ENABLE_THREADED_PTY_READ] =
+                g_param_spec_boolean("enable-threaded-pty-read", nullptr, nullptr,
+                                     false,
+                                     GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY));
+
+        /**
+         * VteTerminal:scheduling-priority:
+         *
+         * How much of the processing time shared by all terminals of
+         * the process this terminal gets.
+         *
+         * Since: 0.80
+         */
+        pspecs[PROP_SCHEDULING_PRIORITY] =
+                g_param_spec_enum("scheduling-priority", nullptr, nullptr,
+                                  VTE_TYPE_SCHEDULING_PRIORITY,
+                                  VTE_SCHEDULING_PRIORITY_NORMAL,
+                                  GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY));
+
         g_object_class_install_properties(gobject_class, LAST_PROP, pspecs);
 
 #if VTE_GTK == 3
@@ -2967,8 +3089,6 @@ vte_terminal_class_init(VteTerminalClass *klass)
 	gtk_binding_entry_skip(binding_set, GDK_KEY_KP_F1, GDK_SHIFT_MASK);
 #endif /* VTE_GTK == 3 */
 
-        process_timer = g_timer_new();
-
         klass->priv = G_TYPE_CLASS_GET_PRIVATE (klass, VTE_TYPE_TERMINAL, VteTerminalClassPrivate);
 
         klass->priv->style_provider = GTK_STYLE_PROVIDER (gtk_css_provider_new ());
@@ -3747,6 +3867,81 @@ vte_get_test_flags(void) noexcept
 #endif
 }
 
+/**
+ * vte_set_trace_enabled:
+ * @enabled: whether to enable tracing
+ *
+ * Enables or disables recording the time spent in the stages of
+ * processing and drawing a frame (reading the PTY, processing the
+ * input, updating the view, drawing and emitting signals) in all
+ * terminals of the process.
+ *
+ * The most recent spans are kept in memory, and can be written out
+ * with vte_write_trace(). Enabling tracing while it is disabled
+ * discards the spans recorded before. Tracing is cheap enough to be
+ * left enabled.
+ *
+ * Tracing is also enabled if the VTE_TRACE environment variable is
+ * set when the first #VteTerminal is created.
+ *
+ * Since: 0.80
+ */
+void
+vte_set_trace_enabled(gboolean enabled) noexcept
+try
+{
+        vte::base::Tracer::get().arm(enabled != false);
+}
+catch (...)
+{
+        vte::log_exception();
+}
+
+/**
+ * vte_get_trace_enabled:
+ *
+ * Returns: whether tracing is enabled; see vte_set_trace_enabled()
+ *
+ * Since: 0.80
+ */
+gboolean
+vte_get_trace_enabled(void) noexcept
+{
+        return vte::base::Tracer::armed();
+}
+
+/**
+ * vte_write_trace:
+ * @filename: (type filename): the file to write to
+ * @error: return location for a #GError, or %NULL
+ *
+ * Writes the spans recorded since tracing was enabled (see
+ * vte_set_trace_enabled()), or the most recent ones if there were more
+ * than fit in memory, to @filename in the Chrome trace event JSON
+ * format. The file can be viewed in chrome://tracing or
+ * https://ui.perfetto.dev.
+ *
+ * Returns: %TRUE on success, or %FALSE with @error filled in
+ *
+ * Since: 0.80
+ */
+gboolean
+vte_write_trace(char const* filename,
+                GError** error) noexcept
+try
+{
+        g_return_val_if_fail(filename != nullptr, false);
+        g_return_val_if_fail(error == nullptr || *error == nullptr, false);
+
+        auto const json = vte::base::Tracer::get().to_json();
+        return g_file_set_contents(filename, json.data(), json.size(), error);
+}
+catch (...)
+{
+        vte::glib::set_error_from_exception(error);
+        return false;
+}
+
 /**
  * vte_get_encodings:
  * @include_aliases: whether to include alias names
@@ -7466,6 +7661,294 @@ catch (...)
         return 0;
 }
 
+/**
+ * vte_terminal_set_scrollback_compression:
+ * @terminal: a #VteTerminal
+ * @compression: a #VteScrollbackCompression
+ *
+ * Sets how @terminal compresses the contents of its scrollback buffer.
+ * %VTE_SCROLLBACK_COMPRESSION_FAST, the default, uses LZ4.
+ * %VTE_SCROLLBACK_COMPRESSION_SMALL uses zstd if VTE was built with it,
+ * which typically makes the scrollback about 40% smaller than LZ4 does,
+ * but compresses and uncompresses it at roughly half the speed; without
+ * zstd it is the same as %VTE_SCROLLBACK_COMPRESSION_FAST.
+ *
+ * Only the contents scrolled out from now on are affected.
+ *
+ * Since: 0.80
+ */
+void
+vte_terminal_set_scrollback_compression(VteTerminal* terminal,
+                                        VteScrollbackCompression compression) noexcept
+try
+{
+        g_return_if_fail(VTE_IS_TERMINAL(terminal));
+        g_return_if_fail(compression == VTE_SCROLLBACK_COMPRESSION_FAST ||
+                         compression == VTE_SCROLLBACK_COMPRESSION_SMALL);
+
+        if (IMPL(terminal)->set_scrollback_compression(compression))
+                g_object_notify_by_pspec(G_OBJECT(terminal), pspecs[PROP_SCROLLBACK_COMPRESSION]);
+}
+catch (...)
+{
+        vte::log_exception();
+}
+
+/**
+ * vte_terminal_get_scrollback_compression:
+ * @terminal: a #VteTerminal
+ *
+ * Returns: how @terminal compresses the contents of its scrollback buffer
+ *
+ * Since: 0.80
+ */
+VteScrollbackCompression
+vte_terminal_get_scrollback_compression(VteTerminal* terminal) noexcept
+try
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), VTE_SCROLLBACK_COMPRESSION_FAST);
+
+        return IMPL(terminal)->m_scrollback_compression;
+}
+catch (...)
+{
+        vte::log_exception();
+        return VTE_SCROLLBACK_COMPRESSION_FAST;
+}
+
+/**
+ * vte_terminal_set_scrollback_cache_size:
+ * @terminal: a #VteTerminal
+ * @size: the size of the cache in bytes
+ *
+ * Sets how much memory to spend on caching the scrollback lines that are
+ * read back from their compressed storage, e.g. while scrolling through
+ * the history or searching it. The budget is shared by all of the
+ * terminal's scrollback. It is rounded down to whole blocks of the
+ * storage, but at least one block is always cached, and it is capped
+ * at 4 GiB.
+ *
+ * The default is 1 MiB.
+ *
+ * Since: 0.80
+ */
+void
+vte_terminal_set_scrollback_cache_size(VteTerminal* terminal,
+                                       guint64 size) noexcept
+try
+{
+        g_return_if_fail(VTE_IS_TERMINAL(terminal));
+
+        if (IMPL(terminal)->set_scrollback_cache_size(size_t(MIN(size, G_MAXUINT32))))
+                g_object_notify_by_pspec(G_OBJECT(terminal), pspecs[PROP_SCROLLBACK_CACHE_SIZE]);
+}
+catch (...)
+{
+        vte::log_exception();
+}
+
+/**
+ * vte_terminal_get_scrollback_cache_size:
+ * @terminal: a #VteTerminal
+ *
+ * Returns: the size of the scrollback cache in bytes, see
+ *   vte_terminal_set_scrollback_cache_size()
+ *
+ * Since: 0.80
+ */
+guint64
+vte_terminal_get_scrollback_cache_size(VteTerminal* terminal) noexcept
+try
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), 0);
+
+        return IMPL(terminal)->m_scrollback_cache_size;
+}
+catch (...)
+{
+        vte::log_exception();
+        return 0;
+}
+
+/**
+ * vte_terminal_set_scrollback_storage:
+ * @terminal: a #VteTerminal
+ * @storage: a #VteScrollbackStorage
+ *
+ * Sets where @terminal keeps the contents of its scrollback buffer.
+ * By default they are kept in a temporary file; with
+ * %VTE_SCROLLBACK_STORAGE_MEMORY they are kept in memory instead, which
+ * is useful in sandboxes where the temporary directory is small or
+ * unavailable. Either way the contents are compressed.
+ *
+ * The existing scrollback is copied over to the new storage.
+ *
+ * Since: 0.80
+ */
+void
+vte_terminal_set_scrollback_storage(VteTerminal* terminal,
+                                    VteScrollbackStorage storage) noexcept
+try
+{
+        g_return_if_fail(VTE_IS_TERMINAL(terminal));
+        g_return_if_fail(storage == VTE_SCROLLBACK_STORAGE_FILE ||
+                         storage == VTE_SCROLLBACK_STORAGE_MEMORY);
+
+        if (IMPL(terminal)->set_scrollback_storage(storage))
+                g_object_notify_by_pspec(G_OBJECT(terminal), pspecs[PROP_SCROLLBACK_STORAGE]);
+}
+catch (...)
+{
+        vte::log_exception();
+}
+
+/**
+ * vte_terminal_get_scrollback_storage:
+ * @terminal: a #VteTerminal
+ *
+ * Returns: where @terminal keeps the contents of its scrollback buffer
+ *
+ * Since: 0.80
+ */
+VteScrollbackStorage
+vte_terminal_get_scrollback_storage(VteTerminal* terminal) noexcept
+try
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), VTE_SCROLLBACK_STORAGE_FILE);
+
+        return IMPL(terminal)->m_scrollback_storage;
+}
+catch (...)
+{
+        vte::log_exception();
+        return VTE_SCROLLBACK_STORAGE_FILE;
+}
+
+/**
+ * vte_terminal_get_scrollback_footprint:
+ * @terminal: a #VteTerminal
+ * @memory: (out) (optional): a location to store the memory used, in bytes
+ * @disk: (out) (optional): a location to store the disk space used, in bytes
+ *
+ * Retrieves how much memory and disk space the contents of the
+ * scrollback buffers of @terminal currently take up, after compression.
+ * This does not include the rows kept uncompressed for the screen, nor
+ * the cache of uncompressed scrollback.
+ *
+ * Since: 0.80
+ */
+void
+vte_terminal_get_scrollback_footprint(VteTerminal* terminal,
+                                      guint64* memory,
+                                      guint64* disk) noexcept
+try
+{
+        g_return_if_fail(VTE_IS_TERMINAL(terminal));
+
+        auto scrollback_memory = size_t{0}, scrollback_disk = size_t{0};
+        IMPL(terminal)->scrollback_footprint(scrollback_memory, scrollback_disk);
+        if (memory)
+                *memory = scrollback_memory;
+        if (disk)
+                *disk = scrollback_disk;
+}
+catch (...)
+{
+        vte::log_exception();
+        if (memory)
+                *memory = 0;
+        if (disk)
+                *disk = 0;
+}
+
+/**
+ * vte_terminal_set_scrollback_bytes:
+ * @terminal: a #VteTerminal
+ * @bytes: the maximum size of the scrollback buffer in bytes, or 0
+ *
+ * Limits the size of the scrollback buffer in bytes, in addition to its
+ * number of lines set with vte_terminal_set_scrollback_lines(). Since the
+ * size of a line varies a lot, this makes it possible to bound the
+ * resources a terminal uses. When the limit is exceeded, the oldest lines
+ * are discarded.
+ *
+ * The size counted against the limit is the one returned by
+ * vte_terminal_get_scrollback_usage(). As that is the uncompressed size,
+ * the memory or disk space the scrollback actually takes up stays below
+ * the limit (see vte_terminal_get_scrollback_footprint()), with the
+ * exception of the lines on the screen, which are never discarded.
+ *
+ * A value of 0 means no limit, which is the default.
+ *
+ * Since: 0.80
+ */
+void
+vte_terminal_set_scrollback_bytes(VteTerminal* terminal,
+                                  guint64 bytes) noexcept
+try
+{
+        g_return_if_fail(VTE_IS_TERMINAL(terminal));
+
+        auto const freezer = vte::glib::FreezeObjectNotify{terminal};
+
+        if (IMPL(terminal)->set_scrollback_bytes(size_t(MIN(bytes, G_MAXSIZE))))
+                g_object_notify_by_pspec(freezer.get(), pspecs[PROP_SCROLLBACK_BYTES]);
+}
+catch (...)
+{
+        vte::log_exception();
+}
+
+/**
+ * vte_terminal_get_scrollback_bytes:
+ * @terminal: a #VteTerminal
+ *
+ * Returns: the maximum size of the scrollback buffer in bytes, or 0 for no limit
+ *
+ * Since: 0.80
+ */
+guint64
+vte_terminal_get_scrollback_bytes(VteTerminal* terminal) noexcept
+try
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), 0);
+
+        return IMPL(terminal)->m_scrollback_bytes;
+}
+catch (...)
+{
+        vte::log_exception();
+        return 0;
+}
+
+/**
+ * vte_terminal_get_scrollback_usage:
+ * @terminal: a #VteTerminal
+ *
+ * Returns the current size of the scrollback buffer, as counted against
+ * the limit set with vte_terminal_set_scrollback_bytes(): the
+ * uncompressed size of the scrolled out lines, including their
+ * attributes, plus the size of the lines still kept uncompressed, like
+ * the ones on the screen.
+ *
+ * Returns: the size of the scrollback buffer in bytes
+ *
+ * Since: 0.80
+ */
+guint64
+vte_terminal_get_scrollback_usage(VteTerminal* terminal) noexcept
+try
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), 0);
+
+        return IMPL(terminal)->scrollback_usage();
+}
+catch (...)
+{
+        vte::log_exception();
+        return 0;
+}
+
 /**
  * vte_terminal_set_scroll_on_insert:
  * @terminal: a #VteTerminal
@@ -7825,6 +8308,86 @@ catch (...)
         return vte::glib::set_error_from_exception(error);
 }
 
+/**
+ * vte_terminal_save_snapshot:
+ * @terminal: a #VteTerminal
+ * @stream: a #GOutputStream to write to
+ * @cancellable: (allow-none): a #GCancellable object, or %NULL
+ * @error: (allow-none): a #GError location to store the error occuring, or %NULL
+ *
+ * Writes a snapshot of the normal screen of @terminal, including its
+ * scrollback history, cursor position and modes, to @stream, for
+ * vte_terminal_restore_snapshot() to restore later, for example after
+ * restarting the application.
+ *
+ * The scrollback is written in the compressed form it is stored in, so
+ * this takes about as long as writing the data. The snapshot can only be
+ * restored by the same version of VTE on the same architecture. Images
+ * are not saved.
+ *
+ * This is a synchronous operation, like vte_terminal_write_contents_sync().
+ *
+ * Returns: %TRUE on success, %FALSE if there was an error
+ *
+ * Since: 0.80
+ */
+gboolean
+vte_terminal_save_snapshot(VteTerminal* terminal,
+                           GOutputStream* stream,
+                           GCancellable* cancellable,
+                           GError** error) noexcept
+try
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), false);
+        g_return_val_if_fail(G_IS_OUTPUT_STREAM(stream), false);
+
+        return IMPL(terminal)->save_snapshot(stream, cancellable, error);
+}
+catch (...)
+{
+        return vte::glib::set_error_from_exception(error);
+}
+
+/**
+ * vte_terminal_restore_snapshot:
+ * @terminal: a #VteTerminal
+ * @stream: a #GInputStream to read from
+ * @cancellable: (allow-none): a #GCancellable object, or %NULL
+ * @error: (allow-none): a #GError location to store the error occuring, or %NULL
+ *
+ * Replaces the normal screen of @terminal and its scrollback history by
+ * a snapshot written by vte_terminal_save_snapshot(), and switches to the
+ * normal screen. The contents are rewrapped to the terminal's size if
+ * #VteTerminal:rewrap-on-resize is set, and only as much of the scrollback
+ * as #VteTerminal:scrollback-lines allows is kept.
+ *
+ * If the snapshot is from a different version of VTE or a different
+ * architecture, the error %G_IO_ERROR_NOT_SUPPORTED is returned; if it
+ * is not a snapshot or is corrupt, %G_IO_ERROR_INVALID_DATA or
+ * %G_IO_ERROR_PARTIAL_INPUT. On error, the terminal's contents are
+ * left as they were.
+ *
+ * Returns: %TRUE on success, %FALSE if there was an error
+ *
+ * Since: 0.80
+ */
+gboolean
+vte_terminal_restore_snapshot(VteTerminal* terminal,
+                              GInputStream* stream,
+                              GCancellable* cancellable,
+                              GError** error) noexcept
+try
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), false);
+        g_return_val_if_fail(G_IS_INPUT_STREAM(stream), false);
+
+        return IMPL(terminal)->restore_snapshot(stream, cancellable, error);
+}
+catch (...)
+{
+        return vte::glib::set_error_from_exception(error);
+}
+
 /**
  * vte_terminal_set_clear_background:
  * @terminal: a #VteTerminal
@@ -8219,6 +8782,156 @@ catch (...)
         return true;
 }
 
+/**
+ * vte_terminal_set_enable_threaded_pty_read:
+ * @terminal: a #VteTerminal
+ * @enable: whether to read the PTY on a separate thread
+ *
+ * Sets whether the PTY is read on a separate thread. This decouples
+ * draining the PTY from the main loop, so that a child producing lots
+ * of output is not stalled by slow frames. Data is still processed
+ * on the main thread.
+ *
+ * Since: 0.80
+ */
+void
+vte_terminal_set_enable_threaded_pty_read(VteTerminal* terminal,
+                                          gboolean enable) noexcept
+try
+{
+        g_return_if_fail(VTE_IS_TERMINAL(terminal));
+
+        if (WIDGET(terminal)->set_enable_threaded_pty_read(enable != false))
+                g_object_notify_by_pspec(G_OBJECT(terminal), pspecs[PROP_ENABLE_THREADED_PTY_READ]);
+}
+catch (...)
+{
+        vte::log_exception();
+}
+
+/**
+ * vte_terminal_get_enable_threaded_pty_read:
+ * @terminal: a #VteTerminal
+ *
+ * Returns: %TRUE iff the PTY is read on a separate thread
+ *
+ * Since: 0.80
+ */
+gboolean
+vte_terminal_get_enable_threaded_pty_read(VteTerminal* terminal) noexcept
+try
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), false);
+
+        return WIDGET(terminal)->enable_threaded_pty_read();
+}
+catch (...)
+{
+        vte::log_exception();
+        return false;
+}
+
+/**
+ * vte_terminal_set_scheduling_priority:
+ * @terminal: a #VteTerminal
+ * @priority: a #VteSchedulingPriority
+ *
+ * Sets how much of the processing time available in each frame
+ * @terminal gets, when several terminals of the process have output
+ * to process. For example, an application with tabs can set its
+ * background tabs to %VTE_SCHEDULING_PRIORITY_LOW, so that a tab
+ * flooding output does not slow down the visible one.
+ *
+ * Regardless of this setting, the terminal that has the focus is
+ * processed first, and an unmapped terminal is processed with one
+ * level lower priority.
+ *
+ * Since: 0.80
+ */
+void
+vte_terminal_set_scheduling_priority(VteTerminal* terminal,
+                                     VteSchedulingPriority priority) noexcept
+try
+{
+        g_return_if_fail(VTE_IS_TERMINAL(terminal));
+        g_return_if_fail(priority >= VTE_SCHEDULING_PRIORITY_LOW &&
+                         priority <= VTE_SCHEDULING_PRIORITY_HIGH);
+
+        if (WIDGET(terminal)->set_scheduling_priority(priority))
+                g_object_notify_by_pspec(G_OBJECT(terminal), pspecs[PROP_SCHEDULING_PRIORITY]);
+}
+catch (...)
+{
+        vte::log_exception();
+}
+
+/**
+ * vte_terminal_get_scheduling_priority:
+ * @terminal: a #VteTerminal
+ *
+ * Returns: the scheduling priority of @terminal
+ *
+ * Since: 0.80
+ */
+VteSchedulingPriority
+vte_terminal_get_scheduling_priority(VteTerminal* terminal) noexcept
+try
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), VTE_SCHEDULING_PRIORITY_NORMAL);
+
+        return WIDGET(terminal)->scheduling_priority();
+}
+catch (...)
+{
+        vte::log_exception();
+        return VTE_SCHEDULING_PRIORITY_NORMAL;
+}
+
+/**
+ * vte_terminal_ref_statistics:
+ * @terminal: a #VteTerminal
+ *
+ * Returns cumulative counters of the work @terminal has done since it
+ * was created, as a dictionary (of type "a{sv}") with these entries:
+ *
+ * - "pty-bytes-read" (t): bytes read from the PTY
+ * - "bytes-processed" (t): bytes parsed, from the PTY or vte_terminal_feed()
+ * - "sequences-control", "sequences-escape", "sequences-csi",
+ *   "sequences-dcs", "sequences-osc", "sequences-sci", "sequences-apc",
+ *   "sequences-pm", "sequences-sos" (t): control functions dispatched, by type
+ * - "process-time" (x): microseconds spent processing input
+ * - "frames-drawn" (t): frames drawn
+ * - "draw-time" (x): microseconds spent drawing
+ * - "rows-frozen", "rows-thawed" (t): rows moved to and from the scrollback streams
+ * - "stream-bytes-written", "stream-bytes-read" (t): uncompressed bytes
+ *   written to and read back from the scrollback streams
+ * - "stream-cache-hits", "stream-cache-misses" (t): lookups of uncompressed
+ *   scrollback blocks in the cache
+ * - "font-cache-hits", "font-cache-misses" (t): glyph metrics cache lookups;
+ *   note that the cache is shared by all terminals using the same font
+ * - "regex-time" (x): microseconds spent matching search and match regexes
+ *
+ * More entries may be added in the future.
+ *
+ * Returns: (transfer full): a new reference to a #GVariant; free it
+ *   with g_variant_unref()
+ *
+ * Since: 0.80
+ */
+GVariant*
+vte_terminal_ref_statistics(VteTerminal* terminal) noexcept
+try
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), nullptr);
+
+        return IMPL(terminal)->ref_statistics();
+}
+catch (...)
+{
+        vte::log_exception();
+        return nullptr;
+}
+
 /**
  * vte_terminal_set_context_menu_model: (attributes org.gtk.Method.set_property=context-menu-model)
  * @terminal: a #VteTerminal
@@ -83,6 +83,7 @@ enum {
         PROP_ENABLE_LEGACY_OSC777,
         PROP_ENABLE_SHAPING,
         PROP_ENABLE_SIXEL,
+        PROP_ENABLE_THREADED_PTY_READ,
         PROP_ENCODING,
         PROP_FONT_DESC,
         PROP_FONT_OPTIONS,
@@ -93,7 +94,12 @@ enum {
         PROP_MOUSE_POINTER_AUTOHIDE,
         PROP_PTY,
         PROP_REWRAP_ON_RESIZE,
+        PROP_SCHEDULING_PRIORITY,
+        PROP_SCROLLBACK_BYTES,
+        PROP_SCROLLBACK_CACHE_SIZE,
+        PROP_SCROLLBACK_COMPRESSION,
         PROP_SCROLLBACK_LINES,
+        PROP_SCROLLBACK_STORAGE,
         PROP_SCROLL_ON_INSERT,
         PROP_SCROLL_ON_KEYSTROKE,
         PROP_SCROLL_ON_OUTPUT,
@@ -48,6 +48,7 @@
 #include "buffer.h"
 #include "parser.hh"
 #include "parser-glue.hh"
+#include "sgr-cache.hh"
 #include "modes.hh"
 #include "tabstops.hh"
 #include "termprops.hh"
@@ -62,6 +63,8 @@
 
 #include "chunk.hh"
 #include "pty.hh"
+#include "process-governor.hh"
+#include "pty-reader.hh"
 #include "utf8.hh"
 
 #include <list>
@@ -321,6 +324,10 @@ protected:
         };
 
 public:
+        /* Both @w and @t may be nullptr, for a terminal that only does
+         * emulation: data passed to feed() is processed right away, and
+         * nothing is drawn or emitted.
+         */
         Terminal(vte::platform::Widget* w,
                  VteTerminal *t);
         ~Terminal();
@@ -352,6 +359,7 @@ public:
         vte::terminal::Tabstops m_tabstops{};
 
         vte::parser::Parser m_parser; /* control sequence state machine */
+        vte::parser::SGRCache m_sgr_cache{}; /* fast path for common SGR sequences */
 
         vte::terminal::modes::ECMA m_modes_ecma{};
         vte::terminal::modes::Private m_modes_private{};
@@ -372,6 +380,10 @@ public:
         bool m_eos_pending{false};
         VteReaper *m_reaper;
 
+        /* PTY reader thread, when reading the PTY off the main loop */
+        std::unique_ptr<vte::base::PtyReader> m_pty_reader{};
+        bool m_enable_threaded_pty_read{false};
+
 	/* Queue of chunks of data read from the PTY.
          * Chunks are inserted at the back, and processed from the front.
          */
@@ -427,7 +439,18 @@ public:
         bool m_is_processing{false};
         // FIXMEchpe should these two be g[s]size ?
         size_t m_input_bytes;
-        long m_max_input_bytes{VTE_MAX_INPUT_READ};
+        ProcessGovernor m_governor{};
+
+        /* Cumulative counters; see vte_terminal_ref_statistics() */
+        struct Statistics {
+                uint64_t pty_bytes_read{0};
+                uint64_t bytes_processed{0};
+                std::array<uint64_t, VTE_SEQ_N> sequences{};
+                uint64_t frames_drawn{0};
+                int64_t process_time{0}; /* µs */
+                int64_t draw_time{0}; /* µs */
+                int64_t regex_time{0}; /* µs, matching search and match regexes */
+        } m_statistics{};
 
 	/* Output data queue. */
         VteByteArray *m_outgoing; /* pending input characters */
@@ -510,6 +533,10 @@ public:
         bool m_scroll_on_output{false};
         bool m_scroll_on_keystroke{true};
         vte::grid::row_t m_scrollback_lines{0};
+        VteScrollbackCompression m_scrollback_compression{VTE_SCROLLBACK_COMPRESSION_FAST};
+        size_t m_scrollback_cache_size{vte::base::Ring::k_default_stream_cache_size};
+        VteScrollbackStorage m_scrollback_storage{VTE_SCROLLBACK_STORAGE_FILE};
+        size_t m_scrollback_bytes{0};
 
         inline auto scroll_limit_lower() const noexcept
         {
@@ -582,6 +609,14 @@ public:
                                                             this),
                                                   "mouse-autoscroll-timer"};
 
+        /* Rewrapping the scrollback left over from resizing */
+        bool rewrap_timer_callback();
+        vte::glib::Timer m_rewrap_timer{std::bind(&Terminal::rewrap_timer_callback,
+                                                  this),
+                                        "rewrap-timer"};
+        void finish_rewrap();
+        void rewrap_finished();
+
         /* Inline images */
         bool m_sixel_enabled{VTE_SIXEL_ENABLED_DEFAULT};
         bool m_images_enabled{VTE_SIXEL_ENABLED_DEFAULT};
@@ -838,8 +873,23 @@ public:
         bool m_enable_bidi{true};
         bool m_enable_shaping{true};
 
+        /* The state painted in the current frame, looked up once at the start
+         * of draw() by prepare_paint(); the rows themselves are the copies held
+         * by m_ringview. Painting reads them from here rather than from the
+         * ring, which saves looking each row up again. This is not a handoff
+         * between threads: the emulation still runs on the main thread, and
+         * never while painting.
+         */
+        struct PaintState {
+                vte::grid::row_t first_row{0};
+                vte::grid::row_t end_row{0}; /* exclusive */
+                VteVisualPosition cursor{};
+                bool cursor_visible{false};
+        } m_paint{};
+
         /* FrameClock driven updates */
         gpointer m_scheduler;
+        VteSchedulingPriority m_scheduling_priority{VTE_SCHEDULING_PRIORITY_NORMAL};
 
         /* BiDi parameters outside of ECMA and DEC private modes */
         guint m_bidi_rtl : 1;
@@ -890,6 +940,19 @@ public:
                 m_pending_changes |= vte::to_integral(PendingChanges::TERMPROPS);
         }
 
+        bool set_enable_threaded_pty_read(bool enable);
+        bool set_scheduling_priority(VteSchedulingPriority priority);
+
+        constexpr auto scheduling_priority() const noexcept
+        {
+                return m_scheduling_priority;
+        }
+
+        constexpr auto enable_threaded_pty_read() const noexcept
+        {
+                return m_enable_threaded_pty_read;
+        }
+
         bool m_enable_legacy_osc777{false};
 
         bool set_enable_legacy_osc777(bool enable) noexcept
@@ -1029,6 +1092,8 @@ public:
                          bool invalidate_now);
         void insert_single_width_chars(gunichar const *p,
                                        int len);
+        void insert_double_width_chars(gunichar const *p,
+                                       int len);
 
         #if WITH_SIXEL
         void insert_image(ProcessingContext& context,
@@ -1054,6 +1119,7 @@ public:
         bool invalidate_dirty_rects_and_process_updates();
         void time_process_incoming();
         void process_incoming();
+        GVariant* ref_statistics() const;
         void process_incoming_utf8(ProcessingContext& context,
                                    vte::base::Chunk& chunk);
         #if WITH_ICU
@@ -1229,6 +1295,9 @@ public:
         void connect_pty_read();
         void disconnect_pty_read();
 
+        bool pty_reader_drain(bool bounded);
+        void stop_pty_reader(bool drain);
+
         void connect_pty_write();
         void disconnect_pty_write();
 
@@ -1672,6 +1741,13 @@ public:
         bool set_mouse_autohide(bool autohide);
         bool set_rewrap_on_resize(bool rewrap);
         bool set_scrollback_lines(long lines);
+        bool set_scrollback_bytes(size_t bytes);
+        size_t scrollback_usage();
+        bool set_scrollback_storage(VteScrollbackStorage storage);
+        bool set_scrollback_compression(VteScrollbackCompression compression);
+        bool set_scrollback_cache_size(size_t size);
+        void scrollback_footprint(size_t& memory,
+                                  size_t& disk) const;
         bool set_fallback_scrolling(bool set);
         auto fallback_scrolling() const noexcept { return m_fallback_scrolling; }
         bool set_scroll_on_insert(bool scroll);
@@ -1685,6 +1761,12 @@ public:
                                   VteWriteFlags flags,
                                   GCancellable *cancellable,
                                   GError **error);
+        bool save_snapshot(GOutputStream* stream,
+                           GCancellable* cancellable,
+                           GError** error);
+        bool restore_snapshot(GInputStream* stream,
+                              GCancellable* cancellable,
+                              GError** error);
 
         inline void maybe_retreat_cursor();
         inline void home_cursor();
@@ -1860,6 +1942,8 @@ public:
 
         // ringview
         void ringview_update();
+        void prepare_paint();
+        VteRowData const* painted_row_data(vte::grid::row_t row) const;
 
         /* Sequence handlers */
         // Note: inlining the handlers seems to worsen the performance, so we don't do that
@@ -1878,8 +1962,6 @@ public:
 } // namespace terminal
 } // namespace vte
 
-extern GTimer *process_timer;
-
 vte::terminal::Terminal* _vte_terminal_get_impl(VteTerminal *terminal);
 
 static inline bool
@@ -205,6 +205,9 @@ using namespace vte::osc_colors;
 void
 Terminal::emit_bell()
 {
+        if (!m_terminal)
+                return;
+
         _vte_debug_print(VTE_DEBUG_SIGNALS, "Emitting `bell'.\n");
         g_signal_emit(m_terminal, signals[SIGNAL_BELL], 0);
 }
@@ -222,6 +225,9 @@ Terminal::emit_resize_window(guint columns,
             rows > 511)
                 return;
 
+        if (!m_terminal)
+                return;
+
         _vte_debug_print(VTE_DEBUG_SIGNALS, "Emitting `resize-window' %d columns %d rows.\n",
                          columns, rows);
         g_signal_emit(m_terminal, signals[SIGNAL_RESIZE_WINDOW], 0, columns, rows);
@@ -10126,16 +10132,17 @@ Terminal::XTERM_WM(vte::parser::Sequence const& seq)
                 /* FIMXE: this should really report the monitor's workarea,
                  * or even just a fixed value.
                  */
+                auto height = int(m_row_count * m_cell_height);
+                auto width = int(m_column_count * m_cell_width);
 #if VTE_GTK == 3
-                auto gdkscreen = gtk_widget_get_screen(m_widget);
-                int height = gdk_screen_get_height(gdkscreen);
-                int width = gdk_screen_get_width(gdkscreen);
+                if (m_widget) {
+                        auto gdkscreen = gtk_widget_get_screen(m_widget);
+                        height = gdk_screen_get_height(gdkscreen);
+                        width = gdk_screen_get_width(gdkscreen);
+                }
                 _vte_debug_print(VTE_DEBUG_EMULATION,
                                  "Reporting screen size as %dx%d cells.\n",
                                  height / int(m_cell_height), width / int(m_cell_width));
-#elif VTE_GTK == 4
-                auto height = int(m_row_count * m_cell_height);
-                auto width = int(m_column_count * m_cell_width);
 #endif
 
                 reply(seq, VTE_REPLY_XTERM_WM,
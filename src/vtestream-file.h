@@ -47,6 +47,15 @@
  *   the tail is kinda like a snake, and the mapping to file offsets reminds
  *   me of the well-known game on old mobile phones.
  *
+ *   Blocks are read straight from a read-only shared mapping of the file
+ *   where mmap() is available, saving a pread() syscall and a copy each.
+ *   Writes still go through pwrite(): writing through the mapping into a
+ *   sparse file would turn a full disk into a SIGBUS, and reserving the
+ *   space first would cost just as many syscalls.
+ *
+ *   Alternatively the snake keeps its blocks in memory, each one only as
+ *   large as what was written to it, without touching any file at all.
+ *
  * o The middle layer is called VteBoa. It does compression and encryption
  *   along with integrity check. It has (almost) the same API as the snake,
  *   but the blocksize is a bit smaller to leave room for the required
@@ -67,9 +76,10 @@
  *   data. It doesn't offer random-access-writes, instead, it offers appending
  *   data, and truncating the head (undoing the latest appends). Write
  *   requests are batched up until there's a complete block to be compressed,
- *   encrypted and written to disk. Read requests are answered by reading,
- *   decrypting and uncompressing possibly more underlying blocks, and sped up
- *   by caching the result.
+ *   encrypted and written to disk; this happens in a worker thread, the
+ *   complete blocks wait in a short queue until then. Read requests are
+ *   answered by reading, decrypting and uncompressing possibly more
+ *   underlying blocks (or from that queue), and sped up by caching the result.
  *
  * Design discussions: https://bugzilla.gnome.org/show_bug.cgi?id=738601
  */
@@ -80,9 +90,19 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
+#if HAVE_MADVISE
+# include <sys/mman.h>
+#endif
 #include <lz4.h>
 
+#if WITH_ZSTD
+# include <zstd.h>
+# include <zdict.h>
+#endif
+
+#include "probes.hh"
 #include "vteutils.h"
 
 #if WITH_GNUTLS
@@ -119,6 +139,9 @@ typedef guint8 _vte_overwrite_counter_t;
 #endif
 
 #define VTE_BLOCK_DATALENGTH_SIZE  sizeof(_vte_block_datalength_t)
+/* The top 4 bits of the data length hold the codec tag. */
+#define VTE_BLOCK_CODEC_TAG_SHIFT  (VTE_BLOCK_DATALENGTH_SIZE * 8 - 4)
+#define VTE_BLOCK_DATALENGTH_MASK  ((((_vte_block_datalength_t) 1) << VTE_BLOCK_CODEC_TAG_SHIFT) - 1)
 #define VTE_OVERWRITE_COUNTER_SIZE sizeof(_vte_overwrite_counter_t)
 #define VTE_BOA_BLOCKSIZE (VTE_SNAKE_BLOCKSIZE - VTE_BLOCK_DATALENGTH_SIZE - VTE_OVERWRITE_COUNTER_SIZE - VTE_CIPHER_TAG_SIZE)
 
@@ -248,13 +271,14 @@ _file_read (int fd, char *data, gsize len, gsize offset)
 	return total;
 }
 
-static void
+/* Returns whether all of data was written. */
+static gboolean
 _file_write (int fd, const char *data, gsize len, gsize offset)
 {
 	gsize ret;
 
         if (G_UNLIKELY (fd == -1))
-                return;
+                return FALSE;
 
 	while (len) {
                 ret = pwrite (fd, data, len, offset);
@@ -270,6 +294,7 @@ _file_write (int fd, const char *data, gsize len, gsize offset)
 		len -= ret;
 		offset += ret;
 	}
+	return len == 0;
 }
 
 /******************************************************************************************/
@@ -348,6 +373,21 @@ typedef struct _VteSnake {
                 gsize fd_head;  /* FD's physical head offset. One of these four is redundant, nevermind. */
         } segment[3];           /* At most 3 segments, [0] at the tail. */
         gsize tail, head;       /* These are redundant too, for convenience. */
+
+        /* When kept in memory: a GBytes for each block from the tail to the head,
+         * and their total size. Then there's no file, and we stay in state 1
+         * with segment[0] mapping to indices (times the block size) in this array. */
+        GPtrArray *blocks;
+        gsize blocks_size;
+
+        /* The file mapped for reading, covering at least the segments. */
+        char *map;
+        gsize map_size;
+        gboolean map_failed;    /* Don't retry, fall back to pread(). */
+        /* The file is known to be at least this long. Touching the mapping beyond the
+         * end of the file would raise SIGBUS, e.g. after failing to write on a full disk,
+         * so blocks past this are read with pread() instead. */
+        gsize fd_size;
 } VteSnake;
 #define VTE_SNAKE_SEGMENTS(s) ((s)->state == 4 ? 2 : (s)->state)
 
@@ -410,11 +450,43 @@ _vte_snake_finalize (GObject *object)
 {
         VteSnake *snake = (VteSnake *) object;
 
+#if HAVE_MADVISE
+        if (snake->map != NULL)
+                munmap (snake->map, snake->map_size);
+#endif
         _file_close (snake->fd);
+        if (snake->blocks != NULL)
+                g_ptr_array_unref (snake->blocks);
 
         G_OBJECT_CLASS (_vte_snake_parent_class)->finalize(object);
 }
 
+/* Keep the blocks in memory rather than in a file. Only for a fresh snake. */
+static void
+_vte_snake_set_in_memory (VteSnake *snake)
+{
+        g_assert_cmpint (snake->fd, ==, -1);
+        g_assert_cmpuint (snake->head, ==, 0);
+
+        snake->blocks = g_ptr_array_new_with_free_func ((GDestroyNotify) g_bytes_unref);
+}
+
+/* Memory used by the blocks' contents, and disk space allocated to the file. */
+static void
+_vte_snake_get_footprint (VteSnake *snake, gsize *memory, gsize *disk)
+{
+        struct stat st;
+
+        *memory = 0;
+        *disk = 0;
+
+        if (snake->blocks != NULL)
+                *memory = snake->blocks_size + snake->blocks->len * sizeof (gpointer);
+
+        if (snake->fd != -1 && fstat (snake->fd, &st) == 0)
+                *disk = (gsize) st.st_blocks * 512;
+}
+
 static inline void
 _vte_snake_ensure_file (VteSnake *snake)
 {
@@ -435,6 +507,11 @@ _vte_snake_reset (VteSnake *snake, gsize offset)
 
         if (G_LIKELY (offset >= snake->head)) {
                 _file_reset (snake->fd);
+                snake->fd_size = 0;
+                if (snake->blocks != NULL) {
+                        g_ptr_array_set_size (snake->blocks, 0);
+                        snake->blocks_size = 0;
+                }
                 snake->segment[0].st_tail = snake->segment[0].st_head = snake->tail = snake->head = offset;
                 snake->segment[0].fd_tail = snake->segment[0].fd_head = 0;
                 snake->state = 1;
@@ -478,9 +555,146 @@ _vte_snake_read (VteSnake *snake, gsize offset, char *data)
 
         fd_offset = _vte_snake_offset_map(snake, offset);
 
+        if (snake->blocks != NULL) {
+                /* Only what was written is copied, the rest of data is left untouched.
+                 * An empty block is treated like a hole punched in the file. */
+                GBytes *bytes = (GBytes *) g_ptr_array_index (snake->blocks, fd_offset / VTE_SNAKE_BLOCKSIZE);
+                gsize len;
+                const char *contents = (const char *) g_bytes_get_data (bytes, &len);
+
+                if (G_UNLIKELY (len == 0))
+                        return FALSE;
+                memcpy (data, contents, len);
+                return TRUE;
+        }
+
         return (_file_read (snake->fd, data, VTE_SNAKE_BLOCKSIZE, fd_offset) == VTE_SNAKE_BLOCKSIZE);
 }
 
+/* Make sure that the mapping covers the file up to end. Returns FALSE if it can't. */
+static gboolean
+_vte_snake_ensure_map (VteSnake *snake, gsize end)
+{
+#if HAVE_MADVISE
+        gsize size;
+        void *map;
+
+        if (G_LIKELY (end <= snake->map_size))
+                return TRUE;
+        if (snake->map_failed || snake->fd == -1)
+                return FALSE;
+
+        /* Grow generously to remap rarely. The mapping can extend beyond the end
+         * of the file, we only ever touch the parts within the segments. */
+        size = MAX (end, 2 * snake->map_size);
+        size = MAX (size, 16 * VTE_SNAKE_BLOCKSIZE);
+
+        if (snake->map != NULL)
+                munmap (snake->map, snake->map_size);
+        snake->map = NULL;
+        snake->map_size = 0;
+
+        map = mmap (NULL, size, PROT_READ, MAP_SHARED, snake->fd, 0);
+        if (G_UNLIKELY (map == MAP_FAILED)) {
+                /* E.g. out of address space on 32 bit systems with a huge scrollback */
+                snake->map_failed = TRUE;
+                return FALSE;
+        }
+
+        /* Scrollback is read back in random order, readahead would be wasted. */
+        madvise (map, size, MADV_RANDOM);
+# ifdef MADV_DONTDUMP
+        madvise (map, size, MADV_DONTDUMP);
+# endif
+
+        snake->map = (char *) map;
+        snake->map_size = size;
+        return TRUE;
+#else
+        return FALSE;
+#endif
+}
+
+/*
+ * Return the VTE_SNAKE_BLOCKSIZE bytes of the block at offset without copying,
+ * straight from the memory or the mapping of the file, or NULL if that's not
+ * possible and _vte_snake_read() should be used instead. The pointer is valid
+ * until the next call modifying the snake.
+ *
+ * Blocks in memory are only as long as they were written, but they are
+ * never read beyond that.
+ */
+static const char *
+_vte_snake_peek (VteSnake *snake, gsize offset)
+{
+        gsize fd_offset;
+
+        g_assert_cmpuint (offset % VTE_SNAKE_BLOCKSIZE, ==, 0);
+
+        if (G_UNLIKELY (offset < snake->tail || offset >= snake->head))
+                return NULL;
+
+        fd_offset = _vte_snake_offset_map(snake, offset);
+
+        if (snake->blocks != NULL) {
+                GBytes *bytes = (GBytes *) g_ptr_array_index (snake->blocks, fd_offset / VTE_SNAKE_BLOCKSIZE);
+                return g_bytes_get_size (bytes) > 0 ? (const char *) g_bytes_get_data (bytes, NULL) : NULL;
+        }
+
+        if (G_UNLIKELY (fd_offset + VTE_SNAKE_BLOCKSIZE > snake->fd_size) ||
+            !_vte_snake_ensure_map (snake, fd_offset + VTE_SNAKE_BLOCKSIZE))
+                return NULL;
+
+        return snake->map + fd_offset;
+}
+
+/* Hint the kernel that the block at offset is about to be read. */
+static void
+_vte_snake_prefetch (VteSnake *snake, gsize offset)
+{
+        gsize fd_offset;
+
+        g_assert_cmpuint (offset % VTE_SNAKE_BLOCKSIZE, ==, 0);
+
+        if (G_UNLIKELY (snake->fd == -1 || offset < snake->tail || offset >= snake->head))
+                return;
+
+        fd_offset = _vte_snake_offset_map(snake, offset);
+
+#if HAVE_MADVISE
+        if (fd_offset + VTE_SNAKE_BLOCKSIZE <= snake->fd_size &&
+            _vte_snake_ensure_map (snake, fd_offset + VTE_SNAKE_BLOCKSIZE)) {
+                madvise (snake->map + fd_offset, VTE_SNAKE_BLOCKSIZE, MADV_WILLNEED);
+                return;
+        }
+#endif
+#if HAVE_POSIX_FADVISE
+        posix_fadvise (snake->fd, fd_offset, VTE_SNAKE_BLOCKSIZE, POSIX_FADV_WILLNEED);
+#endif
+}
+
+/* The in-memory counterpart of _vte_snake_write(). */
+static void
+_vte_snake_write_memory (VteSnake *snake, gsize offset, const char *data, gsize len)
+{
+        GBytes *bytes = g_bytes_new (data, len);
+
+        if (G_LIKELY (offset == snake->head)) {
+                g_ptr_array_add (snake->blocks, bytes);
+                snake->segment[0].st_head += VTE_SNAKE_BLOCKSIZE;
+                snake->segment[0].fd_head += VTE_SNAKE_BLOCKSIZE;
+                snake->head = offset + VTE_SNAKE_BLOCKSIZE;
+        } else {
+                guint i = _vte_snake_offset_map(snake, offset) / VTE_SNAKE_BLOCKSIZE;
+                snake->blocks_size -= g_bytes_get_size ((GBytes *) g_ptr_array_index (snake->blocks, i));
+                g_bytes_unref ((GBytes *) g_ptr_array_index (snake->blocks, i));
+                g_ptr_array_index (snake->blocks, i) = bytes;
+        }
+        snake->blocks_size += len;
+
+        _vte_snake_verify(snake);
+}
+
 /*
  * offset is either within the stream (overwrite data), or at its head (append data).
  * data is at most VTE_SNAKE_BLOCKSIZE bytes large; if shorter then the remaining amount is skipped.
@@ -499,6 +713,11 @@ _vte_snake_write (VteSnake *snake, gsize offset, const char *data, gsize len)
         g_assert_cmpuint (offset, <=, snake->head);
         g_assert_cmpuint (offset % VTE_SNAKE_BLOCKSIZE, ==, 0);
 
+        if (snake->blocks != NULL) {
+                _vte_snake_write_memory (snake, offset, data, len);
+                return;
+        }
+
         if (G_LIKELY (offset == snake->head)) {
                 /* Appending a new block to the head. */
                 _vte_snake_ensure_file (snake);
@@ -527,7 +746,8 @@ _vte_snake_write (VteSnake *snake, gsize offset, const char *data, gsize len)
                 if (snake->state != 2) {
                         /* Grow the file with sparse blocks to make sure that later pread() can
                          * read back a whole block, even if we are about to write a shorter one. */
-                        _file_try_truncate (snake->fd, fd_offset + VTE_SNAKE_BLOCKSIZE);
+                        if (_file_try_truncate (snake->fd, fd_offset + VTE_SNAKE_BLOCKSIZE))
+                                snake->fd_size = fd_offset + VTE_SNAKE_BLOCKSIZE;
 #ifdef VTESTREAM_MAIN
                         /* For convenient unit testing only: fill with dots. */
                         _file_try_punch_hole (snake->fd, fd_offset, VTE_SNAKE_BLOCKSIZE);
@@ -540,7 +760,10 @@ _vte_snake_write (VteSnake *snake, gsize offset, const char *data, gsize len)
                 fd_offset = _vte_snake_offset_map(snake, offset);
                 _file_try_punch_hole (snake->fd, fd_offset, VTE_SNAKE_BLOCKSIZE);
         }
-        _file_write (snake->fd, data, len, fd_offset);
+        /* If this fails (e.g. disk full), the block reads back short, empty or
+         * corrupt, which the boa detects. */
+        if (_file_write (snake->fd, data, len, fd_offset))
+                snake->fd_size = MAX (snake->fd_size, fd_offset + len);
 
         _vte_snake_verify(snake);
 }
@@ -562,6 +785,19 @@ _vte_snake_advance_tail (VteSnake *snake, gsize offset)
 		return;
         }
 
+        if (snake->blocks != NULL) {
+                guint i, n = (offset - snake->tail) / VTE_SNAKE_BLOCKSIZE;
+
+                for (i = 0; i < n; i++)
+                        snake->blocks_size -= g_bytes_get_size ((GBytes *) g_ptr_array_index (snake->blocks, i));
+                g_ptr_array_remove_range (snake->blocks, 0, n);
+                snake->segment[0].st_tail = snake->tail = offset;
+                snake->segment[0].fd_head -= (gsize) n * VTE_SNAKE_BLOCKSIZE;
+
+                _vte_snake_verify(snake);
+                return;
+        }
+
         while (offset > snake->segment[0].st_tail) {
                 if (offset < snake->segment[0].st_head) {
                         /* Drop some (but not all) bytes from the first segment. */
@@ -578,6 +814,7 @@ _vte_snake_advance_tail (VteSnake *snake, gsize offset)
                         case 2:
                                 snake->segment[0] = snake->segment[1];
                                 _file_try_truncate (snake->fd, snake->segment[0].fd_head);
+                                snake->fd_size = MIN (snake->fd_size, snake->segment[0].fd_head);
                                 snake->state = 1;
                                 break;
                         case 3:
@@ -632,6 +869,240 @@ _vte_snake_class_init (VteSnakeClass *klass)
 
 /******************************************************************************************/
 
+/*
+ * VteCodec: Compress and uncompress blocks.
+ *
+ * LZ4 is the default. When built with zstd, it can be selected instead; it
+ * compresses terminal output a lot better, at some CPU cost. After seeing the
+ * first few blocks of a stream, zstd trains a dictionary on them, and uses it
+ * for the later blocks if it turns out to help. Each stream has its own
+ * dictionary, since the text, attr and row streams have very different
+ * contents. (With blocks this large, zstd finds most of the repetitions within
+ * the block anyway, so the dictionary often doesn't make enough difference.)
+ *
+ * Each block is tagged with the codec it was compressed with, so that
+ * switching the codec only affects the blocks written afterwards.
+ */
+
+#define VTE_CODEC_TAG_LZ4       0
+#define VTE_CODEC_TAG_ZSTD      1
+#define VTE_CODEC_TAG_ZSTD_DICT 2
+
+#if WITH_ZSTD
+# define VTE_ZSTD_LEVEL 3
+# define VTE_ZSTD_DICT_SIZE (16 * 1024)
+/* The amount of data to train the dictionary on, and the size of the samples it's cut into. */
+# define VTE_ZSTD_TRAINING_SIZE (512 * 1024)
+# define VTE_ZSTD_SAMPLE_SIZE 4096
+#endif
+
+typedef struct _VteCodec {
+        VteStreamCodec codec;
+#if WITH_ZSTD
+        ZSTD_CCtx *zstd_cctx;
+        ZSTD_DCtx *zstd_dctx;
+        ZSTD_CDict *zstd_cdict;
+        ZSTD_DDict *zstd_ddict;
+        /* The dictionary's contents, to save it along with the blocks. */
+        GBytes *zstd_dict;
+        /* Data collected for training the dictionary, NULL once done. */
+        GByteArray *zstd_samples;
+#endif
+} VteCodec;
+
+gboolean
+_vte_stream_codec_is_supported (VteStreamCodec codec)
+{
+        switch (codec) {
+        case VTE_STREAM_CODEC_LZ4:
+                return TRUE;
+        case VTE_STREAM_CODEC_ZSTD:
+                return WITH_ZSTD;
+        default:
+                return FALSE;
+        }
+}
+
+static void
+_vte_codec_init (VteCodec *codec)
+{
+        memset (codec, 0, sizeof (*codec));
+        codec->codec = VTE_STREAM_CODEC_LZ4;
+#if WITH_ZSTD
+        codec->zstd_samples = g_byte_array_new ();
+#endif
+}
+
+static void
+_vte_codec_fini (VteCodec *codec)
+{
+#if WITH_ZSTD
+        ZSTD_freeCCtx (codec->zstd_cctx);
+        ZSTD_freeDCtx (codec->zstd_dctx);
+        ZSTD_freeCDict (codec->zstd_cdict);
+        ZSTD_freeDDict (codec->zstd_ddict);
+        if (codec->zstd_dict != NULL)
+                g_bytes_unref (codec->zstd_dict);
+        if (codec->zstd_samples != NULL)
+                g_byte_array_unref (codec->zstd_samples);
+#endif
+}
+
+static unsigned int
+_vte_codec_compress_bound (unsigned int len)
+{
+#if WITH_ZSTD
+        return MAX((unsigned int) LZ4_compressBound(len), ZSTD_compressBound(len));
+#else
+        return LZ4_compressBound(len);
+#endif
+}
+
+#if WITH_ZSTD
+static void
+_vte_codec_zstd_train (VteCodec *codec, const char *src, unsigned int srclen)
+{
+        GByteArray *samples = codec->zstd_samples;
+        size_t *sample_sizes;
+        void *dict;
+        size_t dict_size;
+        guint i, n_samples;
+
+        g_byte_array_append (samples, (const guint8 *) src, srclen);
+        if (samples->len < VTE_ZSTD_TRAINING_SIZE)
+                return;
+
+        n_samples = samples->len / VTE_ZSTD_SAMPLE_SIZE;
+        sample_sizes = g_new (size_t, n_samples);
+        for (i = 0; i < n_samples; i++)
+                sample_sizes[i] = VTE_ZSTD_SAMPLE_SIZE;
+
+        dict = g_malloc (VTE_ZSTD_DICT_SIZE);
+        dict_size = ZDICT_trainFromBuffer (dict, VTE_ZSTD_DICT_SIZE, samples->data, sample_sizes, n_samples);
+        /* Training fails if the data is too uniform to learn anything from;
+         * carry on without a dictionary then. */
+        if (!ZDICT_isError (dict_size)) {
+                ZSTD_CDict *cdict = ZSTD_createCDict (dict, dict_size, VTE_ZSTD_LEVEL);
+                size_t bound = ZSTD_compressBound (srclen);
+                char *buf = (char *) g_malloc (bound);
+                size_t len_dict, len_plain;
+
+                /* Only keep the dictionary if it makes the latest block at least 3% smaller. */
+                len_dict = ZSTD_compress_usingCDict (codec->zstd_cctx, buf, bound, src, srclen, cdict);
+                len_plain = ZSTD_compressCCtx (codec->zstd_cctx, buf, bound, src, srclen, VTE_ZSTD_LEVEL);
+                if (!ZSTD_isError (len_dict) && !ZSTD_isError (len_plain) && len_dict < len_plain / 100 * 97) {
+                        codec->zstd_cdict = cdict;
+                        codec->zstd_ddict = ZSTD_createDDict (dict, dict_size);
+                        codec->zstd_dict = g_bytes_new (dict, dict_size);
+                } else {
+                        ZSTD_freeCDict (cdict);
+                }
+
+                g_free (buf);
+        }
+
+        g_free (dict);
+        g_free (sample_sizes);
+        g_byte_array_unref (samples);
+        codec->zstd_samples = NULL;
+}
+
+/* Use a dictionary saved along with blocks compressed with it, instead of training one. */
+static gboolean
+_vte_codec_zstd_set_dict (VteCodec *codec, GBytes *dict)
+{
+        gsize dict_size;
+        const void *data = g_bytes_get_data (dict, &dict_size);
+        ZSTD_CDict *cdict = ZSTD_createCDict (data, dict_size, VTE_ZSTD_LEVEL);
+        ZSTD_DDict *ddict = ZSTD_createDDict (data, dict_size);
+
+        if (cdict == NULL || ddict == NULL) {
+                ZSTD_freeCDict (cdict);
+                ZSTD_freeDDict (ddict);
+                return FALSE;
+        }
+
+        ZSTD_freeCDict (codec->zstd_cdict);
+        ZSTD_freeDDict (codec->zstd_ddict);
+        if (codec->zstd_dict != NULL)
+                g_bytes_unref (codec->zstd_dict);
+        codec->zstd_cdict = cdict;
+        codec->zstd_ddict = ddict;
+        codec->zstd_dict = g_bytes_ref (dict);
+
+        if (codec->zstd_samples != NULL) {
+                g_byte_array_unref (codec->zstd_samples);
+                codec->zstd_samples = NULL;
+        }
+        return TRUE;
+}
+#endif
+
+/* Compress; returns the compressed size which might be bigger than the original, and the codec tag. */
+static unsigned int
+_vte_codec_compress (VteCodec *codec, char *dst, unsigned int dstlen, const char *src, unsigned int srclen, unsigned int *tag)
+{
+#if WITH_ZSTD
+        if (codec->codec == VTE_STREAM_CODEC_ZSTD) {
+                size_t len;
+
+                if (G_UNLIKELY (codec->zstd_cctx == NULL))
+                        codec->zstd_cctx = ZSTD_createCCtx ();
+                if (G_UNLIKELY (codec->zstd_samples != NULL))
+                        _vte_codec_zstd_train (codec, src, srclen);
+
+                if (codec->zstd_cdict != NULL) {
+                        len = ZSTD_compress_usingCDict (codec->zstd_cctx, dst, dstlen, src, srclen, codec->zstd_cdict);
+                        *tag = VTE_CODEC_TAG_ZSTD_DICT;
+                } else {
+                        len = ZSTD_compressCCtx (codec->zstd_cctx, dst, dstlen, src, srclen, VTE_ZSTD_LEVEL);
+                        *tag = VTE_CODEC_TAG_ZSTD;
+                }
+                g_assert (!ZSTD_isError (len));
+                return len;
+        }
+#endif
+
+        int len = LZ4_compress_default (src, dst, srclen, dstlen);
+        g_assert_cmpuint (len, >=, 0);
+        *tag = VTE_CODEC_TAG_LZ4;
+        return len;
+}
+
+/* Uncompress; returns the uncompressed size, or 0 if the codec tag is unknown or the data is corrupt. */
+static unsigned int
+_vte_codec_uncompress (VteCodec *codec, unsigned int tag, char *dst, unsigned int dstlen, const char *src, unsigned int srclen)
+{
+        switch (tag) {
+        case VTE_CODEC_TAG_LZ4: {
+                int len = LZ4_decompress_safe (src, dst, srclen, dstlen);
+                return MAX(len, 0);
+        }
+#if WITH_ZSTD
+        case VTE_CODEC_TAG_ZSTD:
+        case VTE_CODEC_TAG_ZSTD_DICT: {
+                size_t len;
+
+                if (G_UNLIKELY (codec->zstd_dctx == NULL))
+                        codec->zstd_dctx = ZSTD_createDCtx ();
+
+                if (tag == VTE_CODEC_TAG_ZSTD_DICT) {
+                        if (G_UNLIKELY (codec->zstd_ddict == NULL))
+                                return 0;
+                        len = ZSTD_decompress_usingDDict (codec->zstd_dctx, dst, dstlen, src, srclen, codec->zstd_ddict);
+                } else {
+                        len = ZSTD_decompressDCtx (codec->zstd_dctx, dst, dstlen, src, srclen);
+                }
+                return ZSTD_isError (len) ? 0 : len;
+        }
+#endif
+        default:
+                return 0;
+        }
+}
+
+/******************************************************************************************/
+
 /*
  * VteBoa: Compress and encrypt an elephant to make it look like a hat.
  *
@@ -659,7 +1130,8 @@ _vte_snake_class_init (VteSnakeClass *klass)
  *                       boa block 65512(7)
  *
  * Structure of the block that we give to the snake:
- * - 0..4 (0..1): The length of the compressed and encrypted Data, that is D-8 (D-2) [VTE_BLOCK_DATALENGTH_SIZE bytes]
+ * - 0..4 (0..1): The length of the compressed and encrypted Data, that is D-8 (D-2), with the codec tag
+ *                in its top 4 bits [VTE_BLOCK_DATALENGTH_SIZE bytes]
  * - 4..8 (1..2): Overwrite counter [VTE_OVERWRITE_COUNTER_SIZE bytes]
  * - 8..D (2..D): The compressed and encrypted Data [<= VTE_BOA_BLOCKSIZE bytes]
  * - D..T: Encryption verification Tag [VTE_CIPHER_TAG_SIZE bytes]
@@ -687,6 +1159,7 @@ typedef struct _VteBoa {
         gnutls_cipher_hd_t cipher_hd;
         VteIv iv;
 #endif
+        VteCodec codec;
         int compressBound;
 } VteBoa;
 
@@ -738,57 +1211,63 @@ _vte_boa_encrypt (VteBoa *boa, gsize offset, guint32 overwrite_counter, char *da
 #endif
 }
 
-/* Decrypt: data is len bytes of data + VTE_CIPHER_TAG_SIZE more bytes of tag. Returns FALSE on tag mismatch. */
-static gboolean
-_vte_boa_decrypt (VteBoa *boa, gsize offset, guint32 overwrite_counter, char *data, unsigned int len)
+/* Decrypt: src is len bytes of data + VTE_CIPHER_TAG_SIZE more bytes of tag, which are left intact.
+ * Returns the decrypted data, placed at dst (which may be the same as src), or without encryption
+ * that's just src. Returns NULL on tag mismatch. */
+static const char *
+_vte_boa_decrypt (VteBoa *boa, gsize offset, guint32 overwrite_counter, const char *src, char *dst, unsigned int len)
 {
         unsigned char tag[VTE_CIPHER_TAG_SIZE];
         unsigned int i, j;
         guint8 faulty = 0;
+        const char *data = src;
 
 #ifndef VTESTREAM_MAIN
 # ifdef WITH_GNUTLS
         boa->iv.offset = offset;
         boa->iv.overwrite_counter = overwrite_counter;
         gnutls_cipher_set_iv (boa->cipher_hd, &boa->iv, VTE_CIPHER_IV_SIZE);
-        gnutls_cipher_decrypt (boa->cipher_hd, data, len);
+        if (src == dst)
+                gnutls_cipher_decrypt (boa->cipher_hd, dst, len);
+        else
+                gnutls_cipher_decrypt2 (boa->cipher_hd, src, len, dst, len);
         gnutls_cipher_tag (boa->cipher_hd, tag, VTE_CIPHER_TAG_SIZE);
+        data = dst;
 # endif
 #else
         /* Fake decryption for unit testing; see above. */
         for (i = 0; i < len; i++) {
-                unsigned char c = data[i];
+                unsigned char c = src[i];
                 if (c >= 0x40) c ^= 0x20;
-                data[i] = c;
+                dst[i] = c;
         }
         *tag = (((offset / VTE_BOA_BLOCKSIZE) & 037) << 3) | (overwrite_counter & 007);
+        data = dst;
 #endif
 
         /* Constant time tag verification: 738601#c66 */
         for (i = 0, j = len; i < VTE_CIPHER_TAG_SIZE; i++, j++) {
-                faulty |= tag[i] ^ data[j];
+                faulty |= tag[i] ^ src[j];
         }
-        return !faulty;
+        return faulty ? NULL : data;
 }
 
 static int
 _vte_boa_compressBound (unsigned int len)
 {
 #ifndef VTESTREAM_MAIN
-        return LZ4_compressBound(len);
+        return _vte_codec_compress_bound(len);
 #else
         return 2 * len;
 #endif
 }
 
-/* Compress; returns the compressed size which might be bigger than the original. */
+/* Compress; returns the compressed size which might be bigger than the original, and the codec tag. */
 static unsigned int
-_vte_boa_compress (char *dst, unsigned int dstlen, const char *src, unsigned int srclen)
+_vte_boa_compress (VteBoa *boa, char *dst, unsigned int dstlen, const char *src, unsigned int srclen, unsigned int *tag)
 {
 #ifndef VTESTREAM_MAIN
-        int len = LZ4_compress_default (src, dst, srclen, dstlen);
-        g_assert_cmpuint (len, >=, 0);
-        return len;
+        return _vte_codec_compress (&boa->codec, dst, dstlen, src, srclen, tag);
 #else
         /* Fake compression for unit testing:
          * Each char gets prefixed by a repetition count. This prefix is omitted if it would be the
@@ -798,8 +1277,10 @@ _vte_boa_compress (char *dst, unsigned int dstlen, const char *src, unsigned int
          *      Mississippi <-> 1Mi2s1i2s1i2p1i
          *      bookkeeper <-> 1b2oke1per
          * The uncompressed string shouldn't contain digits, or more than 9 consecutive identical chars.
+         * The codec only determines the tag.
          */
         unsigned int len = 0, prevrepeat = 0;
+        *tag = boa->codec.codec == VTE_STREAM_CODEC_ZSTD ? VTE_CODEC_TAG_ZSTD : VTE_CODEC_TAG_LZ4;
         while (srclen) {
                 unsigned int repeat = 1;
                 while (repeat < srclen && src[repeat] == src[0]) repeat++;
@@ -816,17 +1297,18 @@ _vte_boa_compress (char *dst, unsigned int dstlen, const char *src, unsigned int
 #endif
 }
 
-/* Uncompress; returns the uncompressed size. */
+/* Uncompress; returns the uncompressed size, or 0 if the codec tag is unknown or the data is corrupt. */
 static unsigned int
-_vte_boa_uncompress (char *dst, unsigned int dstlen, const char *src, unsigned int srclen)
+_vte_boa_uncompress (VteBoa *boa, unsigned int tag, char *dst, unsigned int dstlen, const char *src, unsigned int srclen)
 {
 #ifndef VTESTREAM_MAIN
-        int len = LZ4_decompress_safe (src, dst, srclen, dstlen);
-        g_assert_cmpint (len, >=, 0);
-        return len;
+        return _vte_codec_uncompress (&boa->codec, tag, dst, dstlen, src, srclen);
 #else
         /* Fake decompression for unit testing; see above. */
         unsigned int len = 0, repeat = 0;
+
+        if (tag != VTE_CODEC_TAG_LZ4 && tag != VTE_CODEC_TAG_ZSTD)
+                return 0;
         while (srclen) {
                 unsigned char c = *src;
                 if (c >= '0' && c <= '9') {
@@ -871,15 +1353,18 @@ _vte_boa_init (VteBoa *boa)
         explicit_bzero(&boa->iv, sizeof(boa->iv));
 #endif
 
+        _vte_codec_init (&boa->codec);
         boa->compressBound = _vte_boa_compressBound(VTE_BOA_BLOCKSIZE);
 }
 
 static void
 _vte_boa_finalize (GObject *object)
 {
-#if !defined VTESTREAM_MAIN && defined WITH_GNUTLS
         VteBoa *boa = (VteBoa *) object;
 
+        _vte_codec_fini (&boa->codec);
+
+#if !defined VTESTREAM_MAIN && defined WITH_GNUTLS
         explicit_bzero(&boa->iv, sizeof(boa->iv));
 
         gnutls_cipher_deinit (boa->cipher_hd);
@@ -910,39 +1395,64 @@ _vte_boa_reset (VteBoa *boa, gsize offset)
         boa->head = MAX(boa->head, offset);
 }
 
-/* Place VTE_BOA_BLOCKSIZE bytes at data.
- * data can be NULL if we're only interested in integrity verification and the overwrite_counter. */
-static gboolean
-_vte_boa_read_with_overwrite_counter (VteBoa *boa, gsize offset, char *data, _vte_overwrite_counter_t *overwrite_counter)
+/* Decrypt the block at offset, without uncompressing it. buf is VTE_SNAKE_BLOCKSIZE bytes of scratch space.
+ * Returns the compressed data, which might be in buf or in the snake's map, or NULL on failure. */
+static const char *
+_vte_boa_read_compressed (VteBoa *boa, gsize offset, char *buf, unsigned int *len, unsigned int *tag, _vte_overwrite_counter_t *overwrite_counter)
 {
         _vte_block_datalength_t compressed_len;
-        char *buf = g_newa(char, VTE_SNAKE_BLOCKSIZE);
+        const char *block;
 
         g_assert_cmpuint (offset % VTE_BOA_BLOCKSIZE, ==, 0);
 
-        /* Read */
-        if (G_UNLIKELY (!_vte_snake_read (&boa->parent, OFFSET_BOA_TO_SNAKE(offset), buf)))
-                return FALSE;
+        /* Read, without copying if possible */
+        block = _vte_snake_peek (&boa->parent, OFFSET_BOA_TO_SNAKE(offset));
+        if (block == NULL) {
+                if (G_UNLIKELY (!_vte_snake_read (&boa->parent, OFFSET_BOA_TO_SNAKE(offset), buf)))
+                        return NULL;
+                block = buf;
+        }
 
-        compressed_len = *((_vte_block_datalength_t *) buf);
-        *overwrite_counter = *((_vte_overwrite_counter_t *) (buf + VTE_BLOCK_DATALENGTH_SIZE));
+        memcpy (&compressed_len, block, VTE_BLOCK_DATALENGTH_SIZE);
+        *tag = compressed_len >> VTE_BLOCK_CODEC_TAG_SHIFT;
+        compressed_len &= VTE_BLOCK_DATALENGTH_MASK;
+        memcpy (overwrite_counter, block + VTE_BLOCK_DATALENGTH_SIZE, VTE_OVERWRITE_COUNTER_SIZE);
 
         /* We could have read an empty block due to a previous disk full. Treat that as an error too. Perform other sanity checks. */
         if (G_UNLIKELY (compressed_len <= 0 || compressed_len > VTE_BOA_BLOCKSIZE || *overwrite_counter <= 0))
-                return FALSE;
+                return NULL;
 
         /* Decrypt, bail out on tag mismatch */
-        if (G_UNLIKELY (!_vte_boa_decrypt (boa, offset, *overwrite_counter, buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE, compressed_len)))
+        *len = compressed_len;
+        return _vte_boa_decrypt (boa, offset, *overwrite_counter,
+                                 block + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE,
+                                 buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE,
+                                 compressed_len);
+}
+
+/* Place VTE_BOA_BLOCKSIZE bytes at data.
+ * data can be NULL if we're only interested in integrity verification and the overwrite_counter. */
+static gboolean
+_vte_boa_read_with_overwrite_counter (VteBoa *boa, gsize offset, char *data, _vte_overwrite_counter_t *overwrite_counter)
+{
+        unsigned int compressed_len, tag;
+        char *buf = g_newa(char, VTE_SNAKE_BLOCKSIZE);
+        const char *plain;
+
+        plain = _vte_boa_read_compressed (boa, offset, buf, &compressed_len, &tag, overwrite_counter);
+        if (G_UNLIKELY (plain == NULL))
                 return FALSE;
 
         /* Uncompress, or copy if wasn't compressable */
         if (G_LIKELY (data != NULL)) {
                 if (G_UNLIKELY (compressed_len >= VTE_BOA_BLOCKSIZE)) {
-                        memcpy (data, buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE, VTE_BOA_BLOCKSIZE);
+                        memcpy (data, plain, VTE_BOA_BLOCKSIZE);
                 } else {
                         unsigned int uncompressed_len;
-                        uncompressed_len = _vte_boa_uncompress(data, VTE_BOA_BLOCKSIZE, buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE, compressed_len);
-                        g_assert_cmpuint (uncompressed_len, ==, VTE_BOA_BLOCKSIZE);
+                        uncompressed_len = _vte_boa_uncompress(boa, tag, data, VTE_BOA_BLOCKSIZE, plain, compressed_len);
+                        /* A codec we don't know about, or corrupt data (e.g. from a snapshot) */
+                        if (G_UNLIKELY (uncompressed_len != VTE_BOA_BLOCKSIZE))
+                                return FALSE;
                 }
         }
         return TRUE;
@@ -955,6 +1465,41 @@ _vte_boa_read (VteBoa *boa, gsize offset, char *data)
         return _vte_boa_read_with_overwrite_counter (boa, offset, data, &overwrite_counter);
 }
 
+static void
+_vte_boa_prefetch (VteBoa *boa, gsize offset)
+{
+        g_assert_cmpuint (offset % VTE_BOA_BLOCKSIZE, ==, 0);
+
+        if (offset < boa->tail || offset >= boa->head)
+                return;
+
+        _vte_snake_prefetch (&boa->parent, OFFSET_BOA_TO_SNAKE(offset));
+}
+
+/*
+ * Encrypt and write the block at offset, whose compressed_len bytes of compressed data are in buf,
+ * after room for its header. buf is large enough for a whole snake block.
+ */
+static void
+_vte_boa_write_compressed (VteBoa *boa, gsize offset, char *buf, unsigned int compressed_len, unsigned int tag,
+                           _vte_overwrite_counter_t overwrite_counter)
+{
+        *((_vte_block_datalength_t *) buf) = (_vte_block_datalength_t) (compressed_len | (tag << VTE_BLOCK_CODEC_TAG_SHIFT));
+        *((_vte_overwrite_counter_t *) (buf + VTE_BLOCK_DATALENGTH_SIZE)) = (_vte_overwrite_counter_t) overwrite_counter;
+
+        /* Encrypt */
+        _vte_boa_encrypt (boa, offset, overwrite_counter, buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE, compressed_len);
+
+        /* Write */
+        _vte_snake_write (&boa->parent, OFFSET_BOA_TO_SNAKE(offset), buf, VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE + compressed_len + VTE_CIPHER_TAG_SIZE);
+
+        if (G_LIKELY (offset == boa->head)) {
+                boa->head += VTE_BOA_BLOCKSIZE;
+        }
+
+        VTE_PROBE(boa_write, boa, offset, compressed_len);
+}
+
 /*
  * offset is either within the stream (overwrite data), or at its head (append data).
  * data is VTE_BOA_BLOCKSIZE bytes large.
@@ -996,27 +1541,18 @@ _vte_boa_write (VteBoa *boa, gsize offset, const char *data)
         }
 
         _vte_block_datalength_t compressed_len;
+        unsigned int tag;
 
         /* Compress, or copy if uncompressable */
-        compressed_len = _vte_boa_compress (buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE, boa->compressBound,
-                                            data, VTE_BOA_BLOCKSIZE);
+        compressed_len = _vte_boa_compress (boa, buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE, boa->compressBound,
+                                            data, VTE_BOA_BLOCKSIZE, &tag);
         if (G_UNLIKELY (compressed_len >= VTE_BOA_BLOCKSIZE)) {
                 memcpy (buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE, data, VTE_BOA_BLOCKSIZE);
                 compressed_len = VTE_BOA_BLOCKSIZE;
+                tag = VTE_CODEC_TAG_LZ4;
         }
 
-        *((_vte_block_datalength_t *) buf) = (_vte_block_datalength_t) compressed_len;
-        *((_vte_overwrite_counter_t *) (buf + VTE_BLOCK_DATALENGTH_SIZE)) = (_vte_overwrite_counter_t) overwrite_counter;
-
-        /* Encrypt */
-        _vte_boa_encrypt (boa, offset, overwrite_counter, buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE, compressed_len);
-
-        /* Write */
-        _vte_snake_write (&boa->parent, OFFSET_BOA_TO_SNAKE(offset), buf, VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE + compressed_len + VTE_CIPHER_TAG_SIZE);
-
-        if (G_LIKELY (offset == boa->head)) {
-                boa->head += VTE_BOA_BLOCKSIZE;
-        }
+        _vte_boa_write_compressed (boa, offset, buf, compressed_len, tag, overwrite_counter);
 }
 
 static void
@@ -1061,24 +1597,321 @@ _vte_boa_class_init (VteBoaClass *klass)
 /******************************************************************************************/
 
 /*
- * VteFileStream: Implement buffering/caching on top of VteBoa.
+ * VteBlockCache: A least recently used cache of uncompressed blocks.
+ *
+ * A cache can be shared by multiple streams, typically the text, attr and row
+ * streams of a ring, so that they compete for one memory budget rather than
+ * each of them having their own. Reading back the scrollback alternates
+ * between these streams, and (e.g. when scrolling upwards or searching
+ * backwards) walks over the same few blocks over and over again, each of
+ * which would otherwise have to be decrypted and uncompressed every time.
+ *
+ * The cache can be made large, so blocks are looked up in a hash table by
+ * their owner and offset, and the slots are kept in a list from the most to
+ * the least recently used one, with the unused ones at the end, where the
+ * next block to read goes.
  */
 
-typedef struct _VteFileStream {
-        GObject parent;
+#define VTE_BLOCK_CACHE_NONE G_MAXUINT
+
+typedef struct _VteBlockCacheSlot {
+        const void *owner;      /* The stream this block belongs to, or NULL if unused. */
+        gsize offset;           /* Offset of the block in the owner stream. */
+        guint lru_prev;         /* Neighbours in the LRU list, or VTE_BLOCK_CACHE_NONE. */
+        guint lru_next;
+        char *data;             /* VTE_BOA_BLOCKSIZE bytes, allocated on first use. */
+} VteBlockCacheSlot;
+
+struct _VteBlockCache {
+        int ref_count;
+        guint n_slots;
+        VteBlockCacheSlot *slots;
+        GHashTable *blocks;     /* The used slots, keyed by their owner and offset. */
+        guint lru_first, lru_last;
+        guint64 hits, misses;
+};
+
+static guint
+_vte_block_cache_slot_hash (gconstpointer v)
+{
+        const VteBlockCacheSlot *slot = (const VteBlockCacheSlot *) v;
 
-        VteBoa *boa;
+        return g_direct_hash (slot->owner) ^ (guint) (slot->offset / VTE_BOA_BLOCKSIZE * 2654435761u);
+}
 
-        char *rbuf;
-        /* Offset of the cached record, always a multiple of block size.
-         * Use a value of 1 (or anything that's not a multiple of block size)
-         * to denote if no record is cached. */
-        gsize rbuf_offset;
+static gboolean
+_vte_block_cache_slot_equal (gconstpointer a, gconstpointer b)
+{
+        const VteBlockCacheSlot *slot_a = (const VteBlockCacheSlot *) a;
+        const VteBlockCacheSlot *slot_b = (const VteBlockCacheSlot *) b;
 
-        char *wbuf;
-        gsize wbuf_len;
+        return slot_a->owner == slot_b->owner && slot_a->offset == slot_b->offset;
+}
 
-        gsize head, tail;
+static void
+_vte_block_cache_lru_unlink (VteBlockCache *cache, guint i)
+{
+        VteBlockCacheSlot *slot = &cache->slots[i];
+
+        if (slot->lru_prev != VTE_BLOCK_CACHE_NONE)
+                cache->slots[slot->lru_prev].lru_next = slot->lru_next;
+        else
+                cache->lru_first = slot->lru_next;
+        if (slot->lru_next != VTE_BLOCK_CACHE_NONE)
+                cache->slots[slot->lru_next].lru_prev = slot->lru_prev;
+        else
+                cache->lru_last = slot->lru_prev;
+}
+
+static void
+_vte_block_cache_lru_push_front (VteBlockCache *cache, guint i)
+{
+        VteBlockCacheSlot *slot = &cache->slots[i];
+
+        slot->lru_prev = VTE_BLOCK_CACHE_NONE;
+        slot->lru_next = cache->lru_first;
+        if (cache->lru_first != VTE_BLOCK_CACHE_NONE)
+                cache->slots[cache->lru_first].lru_prev = i;
+        else
+                cache->lru_last = i;
+        cache->lru_first = i;
+}
+
+static void
+_vte_block_cache_lru_push_back (VteBlockCache *cache, guint i)
+{
+        VteBlockCacheSlot *slot = &cache->slots[i];
+
+        slot->lru_next = VTE_BLOCK_CACHE_NONE;
+        slot->lru_prev = cache->lru_last;
+        if (cache->lru_last != VTE_BLOCK_CACHE_NONE)
+                cache->slots[cache->lru_last].lru_next = i;
+        else
+                cache->lru_first = i;
+        cache->lru_last = i;
+}
+
+VteBlockCache *
+_vte_block_cache_new (gsize size)
+{
+        VteBlockCache *cache = g_new0 (VteBlockCache, 1);
+
+        cache->ref_count = 1;
+        cache->blocks = g_hash_table_new (_vte_block_cache_slot_hash, _vte_block_cache_slot_equal);
+        cache->lru_first = cache->lru_last = VTE_BLOCK_CACHE_NONE;
+        _vte_block_cache_set_size (cache, size);
+
+        return cache;
+}
+
+VteBlockCache *
+_vte_block_cache_ref (VteBlockCache *cache)
+{
+        cache->ref_count++;
+        return cache;
+}
+
+void
+_vte_block_cache_unref (VteBlockCache *cache)
+{
+        guint i;
+
+        if (--cache->ref_count > 0)
+                return;
+
+        for (i = 0; i < cache->n_slots; i++)
+                g_free (cache->slots[i].data);
+        g_free (cache->slots);
+        g_hash_table_destroy (cache->blocks);
+        g_free (cache);
+}
+
+/* The size is rounded down to whole blocks, but is at least one block.
+ * When shrinking, the most recently used blocks are kept. */
+void
+_vte_block_cache_set_size (VteBlockCache *cache, gsize size)
+{
+        guint n_slots = MAX(size / VTE_BOA_BLOCKSIZE, 1);
+        VteBlockCacheSlot *slots;
+        guint i, n = 0;
+
+        if (n_slots == cache->n_slots)
+                return;
+
+        /* Move the slots over in LRU order, which puts the unused ones last */
+        slots = g_new0 (VteBlockCacheSlot, n_slots);
+        for (i = cache->lru_first; i != VTE_BLOCK_CACHE_NONE; i = cache->slots[i].lru_next) {
+                if (n < n_slots)
+                        slots[n++] = cache->slots[i];
+                else
+                        g_free (cache->slots[i].data);
+        }
+        g_free (cache->slots);
+
+        cache->slots = slots;
+        cache->n_slots = n_slots;
+        cache->lru_first = cache->lru_last = VTE_BLOCK_CACHE_NONE;
+        g_hash_table_remove_all (cache->blocks);
+        for (i = 0; i < n_slots; i++) {
+                _vte_block_cache_lru_push_back (cache, i);
+                if (slots[i].owner != NULL)
+                        g_hash_table_add (cache->blocks, &slots[i]);
+        }
+}
+
+gsize
+_vte_block_cache_get_size (VteBlockCache *cache)
+{
+        return cache->n_slots * VTE_BOA_BLOCKSIZE;
+}
+
+guint64
+_vte_block_cache_get_hits (VteBlockCache *cache)
+{
+        return cache->hits;
+}
+
+guint64
+_vte_block_cache_get_misses (VteBlockCache *cache)
+{
+        return cache->misses;
+}
+
+/* Returns the slot caching owner's block at offset, or -1. */
+static int
+_vte_block_cache_find (VteBlockCache *cache, const void *owner, gsize offset)
+{
+        VteBlockCacheSlot key;
+        VteBlockCacheSlot *slot;
+
+        key.owner = owner;
+        key.offset = offset;
+        slot = (VteBlockCacheSlot *) g_hash_table_lookup (cache->blocks, &key);
+        return slot != NULL ? slot - cache->slots : -1;
+}
+
+/* Returns the slot to reuse for a new block: an unused one, or else the least recently used one. */
+static guint
+_vte_block_cache_victim (VteBlockCache *cache)
+{
+        return cache->lru_last;
+}
+
+/* Marks the slot as the most recently used one. */
+static void
+_vte_block_cache_touch (VteBlockCache *cache, guint i)
+{
+        if (cache->lru_first == i)
+                return;
+
+        _vte_block_cache_lru_unlink (cache, i);
+        _vte_block_cache_lru_push_front (cache, i);
+}
+
+/* Empties the slot and moves it to the end of the LRU list, to be reused first. */
+static void
+_vte_block_cache_forget (VteBlockCache *cache, guint i)
+{
+        VteBlockCacheSlot *slot = &cache->slots[i];
+
+        if (slot->owner == NULL)
+                return;
+
+        g_hash_table_remove (cache->blocks, slot);
+        slot->owner = NULL;
+        _vte_block_cache_lru_unlink (cache, i);
+        _vte_block_cache_lru_push_back (cache, i);
+}
+
+/* Puts owner's block at offset into the (empty) slot. */
+static void
+_vte_block_cache_assign (VteBlockCache *cache, guint i, const void *owner, gsize offset)
+{
+        VteBlockCacheSlot *slot = &cache->slots[i];
+
+        slot->owner = owner;
+        slot->offset = offset;
+        g_hash_table_add (cache->blocks, slot);
+}
+
+/* Forget owner's blocks at offsets within [start, end). The blocks of a range
+ * no larger than the cache are looked up one by one, for a larger one (like
+ * the whole stream) it's cheaper to go through the slots. */
+static void
+_vte_block_cache_invalidate (VteBlockCache *cache, const void *owner, gsize start, gsize end)
+{
+        guint i;
+        int j;
+
+        if (end > start && (end - start) / VTE_BOA_BLOCKSIZE <= cache->n_slots) {
+                gsize offset;
+
+                for (offset = ALIGN_BOA(start + VTE_BOA_BLOCKSIZE - 1); offset < end; offset += VTE_BOA_BLOCKSIZE) {
+                        j = _vte_block_cache_find (cache, owner, offset);
+                        if (j >= 0)
+                                _vte_block_cache_forget (cache, j);
+                }
+                return;
+        }
+
+        for (i = 0; i < cache->n_slots; i++) {
+                if (cache->slots[i].owner == owner &&
+                    cache->slots[i].offset >= start &&
+                    cache->slots[i].offset < end)
+                        _vte_block_cache_forget (cache, i);
+        }
+}
+
+/******************************************************************************************/
+
+/*
+ * VteFileStream: Implement buffering/caching on top of VteBoa.
+ *
+ * Complete blocks are handed over to a worker thread to be compressed,
+ * encrypted and written, so that bursts of output don't pay for it inline.
+ * At most VTE_FILE_STREAM_PENDING_MAX blocks per stream wait for the worker,
+ * appending more blocks waits for it to catch up. Reads look at these
+ * pending blocks first.
+ *
+ * The boa is only written by the worker; anything else touching the boa
+ * either holds boa_lock (reading, advancing the tail), or first waits for
+ * the pending blocks to be written (truncating, resetting, finalizing).
+ *
+ * There's a single worker thread shared by all the streams, which also
+ * guarantees that each stream's blocks are written in order.
+ */
+
+#define VTE_FILE_STREAM_PENDING_MAX 4
+
+typedef struct _VteFileStreamBlock {
+        gsize offset;
+        char *data;             /* VTE_BOA_BLOCKSIZE bytes, allocated on first use. */
+} VteFileStreamBlock;
+
+typedef struct _VteFileStream {
+        GObject parent;
+
+        VteBoa *boa;
+        GMutex boa_lock;
+
+        /* Blocks waiting to be written by the worker, a ring buffer. */
+        GMutex pending_lock;
+        GCond pending_cond;     /* Signalled when a block has been written. */
+        VteFileStreamBlock pending[VTE_FILE_STREAM_PENDING_MAX];
+        guint pending_first, pending_len;
+
+        VteBlockCache *cache;
+        /* The slot of the block read most recently, checked first. */
+        guint rslot;
+        /* Offset of the block read most recently, to detect the direction
+         * of travel for read-ahead. Use a value of 1 (or anything that's not
+         * a multiple of block size) to denote that there's no such block. */
+        gsize last_read_offset;
+
+        char *wbuf;
+        gsize wbuf_len;
+
+        gsize head, tail;
 } VteFileStream;
 
 typedef VteStreamClass VteFileStreamClass;
@@ -1088,30 +1921,202 @@ static GType _vte_file_stream_get_type (void);
 
 G_DEFINE_TYPE (VteFileStream, _vte_file_stream, VTE_TYPE_STREAM)
 
+/* Whether to write blocks in the background. Only turned off for unit testing. */
+static gboolean _vte_file_stream_background = TRUE;
+
+static void
+_vte_file_stream_write_pending (gpointer data, gpointer user_data G_GNUC_UNUSED)
+{
+        VteFileStream *stream = (VteFileStream *) data;
+        VteFileStreamBlock *block;
+
+        /* The first pending block stays in place until we remove it below. */
+        g_mutex_lock (&stream->pending_lock);
+        g_assert_cmpuint (stream->pending_len, >, 0);
+        block = &stream->pending[stream->pending_first];
+        g_mutex_unlock (&stream->pending_lock);
+
+        g_mutex_lock (&stream->boa_lock);
+        _vte_boa_write (stream->boa, block->offset, block->data);
+        g_mutex_unlock (&stream->boa_lock);
+
+        g_mutex_lock (&stream->pending_lock);
+        stream->pending_first = (stream->pending_first + 1) % VTE_FILE_STREAM_PENDING_MAX;
+        stream->pending_len--;
+        g_cond_broadcast (&stream->pending_cond);
+        g_mutex_unlock (&stream->pending_lock);
+}
+
+/* Returns NULL if blocks are to be written synchronously. */
+static GThreadPool *
+_vte_file_stream_get_pool (void)
+{
+        static GThreadPool *pool = NULL;
+        static gboolean initialized = FALSE;
+
+        if (G_UNLIKELY (!initialized)) {
+                GError *error = NULL;
+
+                /* A single thread, so that the blocks are written in the order they were queued. */
+                pool = g_thread_pool_new (_vte_file_stream_write_pending, NULL, 1, FALSE, &error);
+                if (pool == NULL) {
+                        g_warning ("Failed to create scrollback writer thread: %s", error->message);
+                        g_error_free (error);
+                }
+                initialized = TRUE;
+        }
+
+        return _vte_file_stream_background ? pool : NULL;
+}
+
+/* Wait until the pending blocks at offsets below end have been written. */
+static void
+_vte_file_stream_wait_pending (VteFileStream *stream, gsize end)
+{
+        g_mutex_lock (&stream->pending_lock);
+        while (stream->pending_len > 0 && stream->pending[stream->pending_first].offset < end)
+                g_cond_wait (&stream->pending_cond, &stream->pending_lock);
+        g_mutex_unlock (&stream->pending_lock);
+}
+
+/* Copy the block at offset to data if it's still waiting to be written. */
+static gboolean
+_vte_file_stream_read_pending (VteFileStream *stream, gsize offset, char *data)
+{
+        gboolean found = FALSE;
+        guint i;
+
+        g_mutex_lock (&stream->pending_lock);
+        for (i = 0; i < stream->pending_len; i++) {
+                VteFileStreamBlock *block = &stream->pending[(stream->pending_first + i) % VTE_FILE_STREAM_PENDING_MAX];
+                if (block->offset == offset) {
+                        memcpy (data, block->data, VTE_BOA_BLOCKSIZE);
+                        found = TRUE;
+                        break;
+                }
+        }
+        g_mutex_unlock (&stream->pending_lock);
+
+        return found;
+}
+
+/* Write the full write buffer as the block at offset. */
+static void
+_vte_file_stream_write_block (VteFileStream *stream, gsize offset)
+{
+        GThreadPool *pool = _vte_file_stream_get_pool ();
+        VteFileStreamBlock *block;
+        char *data;
+
+        if (G_UNLIKELY (pool == NULL)) {
+                _vte_boa_write (stream->boa, offset, stream->wbuf);
+                return;
+        }
+
+        g_mutex_lock (&stream->pending_lock);
+        while (stream->pending_len == VTE_FILE_STREAM_PENDING_MAX)
+                g_cond_wait (&stream->pending_cond, &stream->pending_lock);
+
+        /* Hand over the write buffer, and take the block's old buffer in exchange. */
+        block = &stream->pending[(stream->pending_first + stream->pending_len) % VTE_FILE_STREAM_PENDING_MAX];
+        data = block->data ? block->data : (char *)g_malloc(VTE_BOA_BLOCKSIZE);
+        block->data = stream->wbuf;
+        block->offset = offset;
+        stream->wbuf = data;
+        stream->pending_len++;
+        g_mutex_unlock (&stream->pending_lock);
+
+        g_thread_pool_push (pool, stream, NULL);
+}
+
 VteStream *
-_vte_file_stream_new (void)
+_vte_file_stream_new (VteBlockCache *cache)
+{
+        VteFileStream *stream = (VteFileStream *) g_object_new (VTE_TYPE_FILE_STREAM, NULL);
+
+        /* Without a shared cache, cache a single block just for ourselves. */
+        stream->cache = cache ? _vte_block_cache_ref (cache) : _vte_block_cache_new (VTE_BOA_BLOCKSIZE);
+
+	return (VteStream *) stream;
+}
+
+/* A file stream whose blocks are kept in memory, never touching a file. */
+VteStream *
+_vte_memory_stream_new (VteBlockCache *cache)
+{
+        VteStream *astream = _vte_file_stream_new (cache);
+        VteFileStream *stream = (VteFileStream *) astream;
+
+        _vte_snake_set_in_memory (&stream->boa->parent);
+
+        return astream;
+}
+
+/* Memory used by the stream's blocks and buffers (not counting the shared
+ * cache), and disk space used by its file. */
+void
+_vte_file_stream_get_footprint (VteStream *astream, gsize *memory, gsize *disk)
+{
+	VteFileStream *stream = (VteFileStream *) astream;
+        guint i;
+
+        g_mutex_lock (&stream->boa_lock);
+        _vte_snake_get_footprint (&stream->boa->parent, memory, disk);
+        g_mutex_unlock (&stream->boa_lock);
+
+        *memory += VTE_BOA_BLOCKSIZE;  /* wbuf */
+        g_mutex_lock (&stream->pending_lock);
+        for (i = 0; i < VTE_FILE_STREAM_PENDING_MAX; i++) {
+                if (stream->pending[i].data != NULL)
+                        *memory += VTE_BOA_BLOCKSIZE;
+        }
+        g_mutex_unlock (&stream->pending_lock);
+}
+
+/* Set the codec for the blocks written from now on. */
+void
+_vte_file_stream_set_codec (VteStream *astream, VteStreamCodec codec)
 {
-	return (VteStream *) g_object_new (VTE_TYPE_FILE_STREAM, NULL);
+	VteFileStream *stream = (VteFileStream *) astream;
+
+        g_return_if_fail (_vte_stream_codec_is_supported (codec));
+
+        g_mutex_lock (&stream->boa_lock);
+        stream->boa->codec.codec = codec;
+        g_mutex_unlock (&stream->boa_lock);
 }
 
 static void
 _vte_file_stream_init (VteFileStream *stream)
 {
         stream->boa = (VteBoa *)g_object_new (VTE_TYPE_BOA, NULL);
+        g_mutex_init (&stream->boa_lock);
+        g_mutex_init (&stream->pending_lock);
+        g_cond_init (&stream->pending_cond);
 
-        stream->rbuf = (char *)g_malloc(VTE_BOA_BLOCKSIZE);
         stream->wbuf = (char *)g_malloc(VTE_BOA_BLOCKSIZE);
-        stream->rbuf_offset = 1;  /* Invalidate */
+        stream->last_read_offset = 1;
 }
 
 static void
 _vte_file_stream_finalize (GObject *object)
 {
         VteFileStream *stream = (VteFileStream *) object;
+        guint i;
+
+        _vte_file_stream_wait_pending (stream, G_MAXSIZE);
 
-        g_free(stream->rbuf);
+        /* Don't let a future stream at the same address see our blocks. */
+        _vte_block_cache_invalidate (stream->cache, stream, 0, G_MAXSIZE);
+        _vte_block_cache_unref (stream->cache);
+
+        for (i = 0; i < VTE_FILE_STREAM_PENDING_MAX; i++)
+                g_free(stream->pending[i].data);
         g_free(stream->wbuf);
         g_object_unref (stream->boa);
+        g_cond_clear (&stream->pending_cond);
+        g_mutex_clear (&stream->pending_lock);
+        g_mutex_clear (&stream->boa_lock);
 
         G_OBJECT_CLASS (_vte_file_stream_parent_class)->finalize(object);
 }
@@ -1126,6 +2131,7 @@ _vte_file_stream_reset (VteStream *astream, gsize offset)
          * to catch if this expectation is broken within a block. */
         g_assert_cmpuint (offset, >=, stream->head);
 
+        _vte_file_stream_wait_pending (stream, G_MAXSIZE);
         _vte_boa_reset (stream->boa, offset_aligned);
         stream->tail = stream->head = offset;
 
@@ -1140,7 +2146,57 @@ _vte_file_stream_reset (VteStream *astream, gsize offset)
 #endif
 
         stream->wbuf_len = MOD_BOA(offset);
-        stream->rbuf_offset = 1;  /* Invalidate */
+        _vte_block_cache_invalidate (stream->cache, stream, 0, G_MAXSIZE);
+        stream->last_read_offset = 1;
+}
+
+/* Returns the uncompressed block at offset, from the cache if possible. */
+static const char *
+_vte_file_stream_read_block (VteFileStream *stream, gsize offset)
+{
+        VteBlockCache *cache = stream->cache;
+        VteBlockCacheSlot *slot;
+        int i = stream->rslot;
+
+        if (G_UNLIKELY (stream->rslot >= cache->n_slots ||
+                        cache->slots[i].owner != stream ||
+                        cache->slots[i].offset != offset))
+                i = _vte_block_cache_find (cache, stream, offset);
+
+        if (G_LIKELY (i >= 0)) {
+                cache->hits++;
+                slot = &cache->slots[i];
+        } else {
+                cache->misses++;
+                i = _vte_block_cache_victim (cache);
+                _vte_block_cache_forget (cache, i);
+                slot = &cache->slots[i];
+                if (slot->data == NULL)
+                        slot->data = (char *)g_malloc(VTE_BOA_BLOCKSIZE);
+                if (!_vte_file_stream_read_pending (stream, offset, slot->data)) {
+                        gboolean ok;
+
+                        g_mutex_lock (&stream->boa_lock);
+                        ok = _vte_boa_read (stream->boa, offset, slot->data);
+
+                        /* Moving on to the adjacent block suggests that the one after
+                         * it in the same direction is going to be needed soon. */
+                        if (ok && offset == stream->last_read_offset + VTE_BOA_BLOCKSIZE)
+                                _vte_boa_prefetch (stream->boa, offset + VTE_BOA_BLOCKSIZE);
+                        else if (ok && offset + VTE_BOA_BLOCKSIZE == stream->last_read_offset && offset >= VTE_BOA_BLOCKSIZE)
+                                _vte_boa_prefetch (stream->boa, offset - VTE_BOA_BLOCKSIZE);
+                        g_mutex_unlock (&stream->boa_lock);
+
+                        if (G_UNLIKELY (!ok))
+                                return NULL;
+                }
+                _vte_block_cache_assign (cache, i, stream, offset);
+        }
+
+        _vte_block_cache_touch (cache, i);
+        stream->rslot = i;
+        stream->last_read_offset = offset;
+        return slot->data;
 }
 
 static gboolean
@@ -1165,13 +2221,10 @@ _vte_file_stream_read (VteStream *astream, gsize offset, char *data, gsize len)
 
         while (len && offset < ALIGN_BOA(stream->head)) {
                 gsize l = MIN(VTE_BOA_BLOCKSIZE - MOD_BOA(offset), len);
-                gsize offset_aligned = ALIGN_BOA(offset);
-                if (offset_aligned != stream->rbuf_offset) {
-                        if (G_UNLIKELY (!_vte_boa_read (stream->boa, offset_aligned, stream->rbuf)))
-                                return FALSE;
-                        stream->rbuf_offset = offset_aligned;
-                }
-                memcpy(data, stream->rbuf + MOD_BOA(offset), l);
+                const char *block = _vte_file_stream_read_block (stream, ALIGN_BOA(offset));
+                if (G_UNLIKELY (block == NULL))
+                        return FALSE;
+                memcpy(data, block + MOD_BOA(offset), l);
                 offset += l; data += l; len -= l;
         }
         if (len) {
@@ -1191,7 +2244,7 @@ _vte_file_stream_append (VteStream *astream, const char *data, gsize len)
                 memcpy(stream->wbuf + stream->wbuf_len, data, l);
                 stream->wbuf_len += l; data += l; len -= l;
                 if (stream->wbuf_len == VTE_BOA_BLOCKSIZE) {
-                        _vte_boa_write (stream->boa, ALIGN_BOA(stream->head), stream->wbuf);
+                        _vte_file_stream_write_block (stream, ALIGN_BOA(stream->head));
                         stream->wbuf_len = 0;
                 }
                 stream->head += l;
@@ -1214,14 +2267,14 @@ _vte_file_stream_truncate (VteStream *astream, gsize offset)
                  * intact, that is, read back the new partial last block to
                  * the write cache. */
                 gsize offset_aligned = ALIGN_BOA(offset);
+                _vte_file_stream_wait_pending (stream, G_MAXSIZE);
                 if (G_UNLIKELY (!_vte_boa_read (stream->boa, offset_aligned, stream->wbuf))) {
                         /* what now? */
                         memset(stream->wbuf, 0, VTE_BOA_BLOCKSIZE);
                 }
 
-                if (stream->rbuf_offset >= offset_aligned) {
-                        stream->rbuf_offset = 1;  /* Invalidate */
-                }
+                /* Blocks are only cached below the head */
+                _vte_block_cache_invalidate (stream->cache, stream, offset_aligned, ALIGN_BOA(stream->head));
         }
         stream->wbuf_len = MOD_BOA(offset);
 	stream->head = offset;
@@ -1235,8 +2288,15 @@ _vte_file_stream_advance_tail (VteStream *astream, gsize offset)
         g_assert_cmpuint (offset, >=, stream->tail);
         g_assert_cmpuint (offset, <=, stream->head);
 
-        if (ALIGN_BOA(offset) > ALIGN_BOA(stream->tail))
+        if (ALIGN_BOA(offset) > ALIGN_BOA(stream->tail)) {
+                /* The boa needs to know about the blocks it's dropping. */
+                _vte_file_stream_wait_pending (stream, ALIGN_BOA(offset));
+                g_mutex_lock (&stream->boa_lock);
                 _vte_boa_advance_tail (stream->boa, ALIGN_BOA(offset));
+                g_mutex_unlock (&stream->boa_lock);
+                /* Make room for blocks that can still be read. */
+                _vte_block_cache_invalidate (stream->cache, stream, ALIGN_BOA(stream->tail), ALIGN_BOA(offset));
+        }
 
         stream->tail = offset;
 }
@@ -1257,6 +2317,202 @@ _vte_file_stream_head (VteStream *astream)
 	return stream->head;
 }
 
+/*
+ * Snapshots: a stream's blocks written out as they are compressed, so that
+ * saving and restoring the scrollback doesn't compress or uncompress anything,
+ * only the encryption (whose key is thrown away with the stream) is undone and
+ * redone. A snapshot consists of:
+ * - a VteStreamSnapshotHeader,
+ * - the zstd dictionary the blocks were compressed with, if any [dict_len bytes],
+ * - for each block from the one containing the tail up to the one containing the head:
+ *   its compressed length with the codec tag in the top 4 bits [4 bytes], and its compressed data,
+ * - the head's partial block, uncompressed [head % blocksize bytes].
+ * Numbers are in host byte order; the caller is expected to check that.
+ */
+
+#define VTE_SNAPSHOT_TAG_SHIFT 28
+
+typedef struct _VteStreamSnapshotHeader {
+        guint64 tail, head;
+        guint32 blocksize;
+        guint32 dict_len;
+} VteStreamSnapshotHeader;
+
+static gboolean
+_vte_snapshot_write (GOutputStream *output, const void *data, gsize len, GCancellable *cancellable, GError **error)
+{
+        gsize bytes_written;
+
+        return g_output_stream_write_all (output, data, len, &bytes_written, cancellable, error);
+}
+
+static gboolean
+_vte_snapshot_read (GInputStream *input, void *data, gsize len, GCancellable *cancellable, GError **error)
+{
+        gsize bytes_read;
+
+        if (!g_input_stream_read_all (input, data, len, &bytes_read, cancellable, error))
+                return FALSE;
+        if (G_UNLIKELY (bytes_read < len)) {
+                g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT, "Truncated scrollback snapshot");
+                return FALSE;
+        }
+        return TRUE;
+}
+
+/* Whether we can uncompress the blocks tagged with tag. */
+static gboolean
+_vte_snapshot_tag_is_supported (unsigned int tag)
+{
+#ifndef VTESTREAM_MAIN
+        return tag == VTE_CODEC_TAG_LZ4 ||
+                (WITH_ZSTD && (tag == VTE_CODEC_TAG_ZSTD || tag == VTE_CODEC_TAG_ZSTD_DICT));
+#else
+        return tag == VTE_CODEC_TAG_LZ4 || tag == VTE_CODEC_TAG_ZSTD;
+#endif
+}
+
+gboolean
+_vte_file_stream_save (VteStream *astream, GOutputStream *output, GCancellable *cancellable, GError **error)
+{
+	VteFileStream *stream = (VteFileStream *) astream;
+        VteStreamSnapshotHeader header;
+        GBytes *dict = NULL;
+        char *buf;
+        gboolean ok;
+        gsize offset;
+
+        /* Then the boa has all the blocks, and nothing else is writing it. */
+        _vte_file_stream_wait_pending (stream, G_MAXSIZE);
+
+#if WITH_ZSTD && !defined VTESTREAM_MAIN
+        if (stream->boa->codec.zstd_dict != NULL)
+                dict = g_bytes_ref (stream->boa->codec.zstd_dict);
+#endif
+
+        memset (&header, 0, sizeof (header));
+        header.tail = stream->tail;
+        header.head = stream->head;
+        header.blocksize = VTE_BOA_BLOCKSIZE;
+        header.dict_len = dict != NULL ? g_bytes_get_size (dict) : 0;
+        ok = _vte_snapshot_write (output, &header, sizeof (header), cancellable, error) &&
+                (dict == NULL || _vte_snapshot_write (output, g_bytes_get_data (dict, NULL), header.dict_len, cancellable, error));
+        if (dict != NULL)
+                g_bytes_unref (dict);
+
+        buf = (char *) g_malloc (VTE_SNAKE_BLOCKSIZE);
+        for (offset = ALIGN_BOA(stream->tail); ok && offset < ALIGN_BOA(stream->head); offset += VTE_BOA_BLOCKSIZE) {
+                _vte_overwrite_counter_t overwrite_counter;
+                unsigned int len, tag;
+                const char *data;
+                guint32 word;
+
+                g_mutex_lock (&stream->boa_lock);
+                data = _vte_boa_read_compressed (stream->boa, offset, buf, &len, &tag, &overwrite_counter);
+                if (G_LIKELY (data != NULL)) {
+                        word = len | (tag << VTE_SNAPSHOT_TAG_SHIFT);
+                        ok = _vte_snapshot_write (output, &word, sizeof (word), cancellable, error) &&
+                                _vte_snapshot_write (output, data, len, cancellable, error);
+                } else {
+                        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Failed to read the scrollback");
+                        ok = FALSE;
+                }
+                g_mutex_unlock (&stream->boa_lock);
+        }
+        g_free (buf);
+
+        return ok && _vte_snapshot_write (output, stream->wbuf, MOD_BOA(stream->head), cancellable, error);
+}
+
+/* Restore a snapshot written by _vte_file_stream_save() into a newly created
+ * stream. On failure, the stream is left with some of the data. */
+gboolean
+_vte_file_stream_load (VteStream *astream, GInputStream *input, GCancellable *cancellable, GError **error)
+{
+	VteFileStream *stream = (VteFileStream *) astream;
+        VteStreamSnapshotHeader header;
+        char *buf;
+        gboolean ok;
+        gsize offset;
+
+        g_return_val_if_fail (stream->head == 0, FALSE);
+
+        if (!_vte_snapshot_read (input, &header, sizeof (header), cancellable, error))
+                return FALSE;
+        if (header.blocksize != VTE_BOA_BLOCKSIZE) {
+                g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                                     "Scrollback snapshot has a different block size");
+                return FALSE;
+        }
+        if (header.tail > header.head || header.head > G_MAXSIZE - VTE_BOA_BLOCKSIZE ||
+            header.dict_len > VTE_SNAKE_BLOCKSIZE) {
+                g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Corrupt scrollback snapshot");
+                return FALSE;
+        }
+
+        buf = (char *) g_malloc (VTE_SNAKE_BLOCKSIZE);
+        ok = TRUE;
+
+        if (header.dict_len > 0) {
+#if WITH_ZSTD && !defined VTESTREAM_MAIN
+                GBytes *dict;
+
+                ok = _vte_snapshot_read (input, buf, header.dict_len, cancellable, error);
+                if (ok) {
+                        dict = g_bytes_new (buf, header.dict_len);
+                        g_mutex_lock (&stream->boa_lock);
+                        ok = _vte_codec_zstd_set_dict (&stream->boa->codec, dict);
+                        g_mutex_unlock (&stream->boa_lock);
+                        g_bytes_unref (dict);
+                        if (!ok)
+                                g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Corrupt scrollback snapshot");
+                }
+#else
+                g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                                     "Scrollback snapshot needs zstd support");
+                ok = FALSE;
+#endif
+        }
+
+        if (ok)
+                _vte_file_stream_reset (astream, ALIGN_BOA(header.tail));
+
+        for (offset = ALIGN_BOA(header.tail); ok && offset < ALIGN_BOA(header.head); offset += VTE_BOA_BLOCKSIZE) {
+                unsigned int len, tag;
+                guint32 word;
+
+                if (!_vte_snapshot_read (input, &word, sizeof (word), cancellable, error)) {
+                        ok = FALSE;
+                        break;
+                }
+                len = word & ((1u << VTE_SNAPSHOT_TAG_SHIFT) - 1);
+                tag = word >> VTE_SNAPSHOT_TAG_SHIFT;
+                if (len == 0 || len > VTE_BOA_BLOCKSIZE || !_vte_snapshot_tag_is_supported (tag)) {
+                        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Corrupt scrollback snapshot");
+                        ok = FALSE;
+                        break;
+                }
+                if (!_vte_snapshot_read (input, buf + VTE_BLOCK_DATALENGTH_SIZE + VTE_OVERWRITE_COUNTER_SIZE, len, cancellable, error)) {
+                        ok = FALSE;
+                        break;
+                }
+
+                g_mutex_lock (&stream->boa_lock);
+                _vte_boa_write_compressed (stream->boa, offset, buf, len, tag, 1);
+                g_mutex_unlock (&stream->boa_lock);
+        }
+        g_free (buf);
+
+        if (ok)
+                ok = _vte_snapshot_read (input, stream->wbuf, MOD_BOA(header.head), cancellable, error);
+        if (ok) {
+                stream->wbuf_len = MOD_BOA(header.head);
+                stream->tail = header.tail;
+                stream->head = header.head;
+        }
+        return ok;
+}
+
 static void
 _vte_file_stream_class_init (VteFileStreamClass *klass)
 {
@@ -1337,6 +2593,7 @@ static void
 test_fakes (void)
 {
         char buf[100], buf2[100];
+        unsigned int tag;
         VteBoa *boa = (VteBoa *)g_object_new (VTE_TYPE_BOA, NULL);
 
         /* Encrypt */
@@ -1344,8 +2601,13 @@ test_fakes (void)
         _vte_boa_encrypt (boa, 35, 6, buf, 14);
         g_assert(strncmp (buf, "ABCDxyz1234!!!\056", 15) == 0);
 
-        /* Decrypt */
-        g_assert_true(_vte_boa_decrypt (boa, 35, 6, buf, 14));
+        /* Decrypt to another buffer, leaving the source intact */
+        g_assert_true(_vte_boa_decrypt (boa, 35, 6, buf, buf2, 14) == buf2);
+        g_assert(strncmp (buf2, "abcdXYZ1234!!!", 14) == 0);
+        g_assert(strncmp (buf, "ABCDxyz1234!!!\056", 15) == 0);
+
+        /* Decrypt in place */
+        g_assert_true(_vte_boa_decrypt (boa, 35, 6, buf, buf, 14) == buf);
         g_assert(strncmp (buf, "abcdXYZ1234!!!", 14) == 0);
 
         /* Encrypt again */
@@ -1354,42 +2616,54 @@ test_fakes (void)
 
         /* Decrypting with corrupted tag should fail */
         buf[14]++;
-        g_assert_false(_vte_boa_decrypt (boa, 35, 6, buf, 14));
+        g_assert_null(_vte_boa_decrypt (boa, 35, 6, buf, buf, 14));
 
         /* Compress, but becomes bigger */
         strcpy(buf, "abcdef");
-        g_assert_cmpuint(_vte_boa_compress (buf2, 100, buf, 6), ==, 7);
+        g_assert_cmpuint(_vte_boa_compress (boa, buf2, 100, buf, 6, &tag), ==, 7);
         g_assert(strncmp (buf2, "1abcdef", 7) == 0);
+        g_assert_cmpuint(tag, ==, VTE_CODEC_TAG_LZ4);
 
         /* Uncompress */
         strcpy(buf, "1abcdef");
-        g_assert_cmpuint(_vte_boa_uncompress (buf2, 100, buf, 7), ==, 6);
+        g_assert_cmpuint(_vte_boa_uncompress (boa, VTE_CODEC_TAG_LZ4, buf2, 100, buf, 7), ==, 6);
         g_assert(strncmp (buf2, "abcdef", 6) == 0);
 
         /* Compress, becomes smaller */
         strcpy(buf, "www");
-        g_assert_cmpuint(_vte_boa_compress (buf2, 100, buf, 3), ==, 2);
+        g_assert_cmpuint(_vte_boa_compress (boa, buf2, 100, buf, 3, &tag), ==, 2);
         g_assert(strncmp (buf2, "3w", 2) == 0);
 
         /* Uncompress */
         strcpy(buf, "3w");
-        g_assert_cmpuint(_vte_boa_uncompress (buf2, 100, buf, 2), ==, 3);
+        g_assert_cmpuint(_vte_boa_uncompress (boa, VTE_CODEC_TAG_LZ4, buf2, 100, buf, 2), ==, 3);
         g_assert(strncmp (buf2, "www", 3) == 0);
 
         /* Compress, remains the same size */
         strcpy(buf, "zebraaa");
-        g_assert_cmpuint(_vte_boa_compress (buf2, 100, buf, 7), ==, 7);
+        g_assert_cmpuint(_vte_boa_compress (boa, buf2, 100, buf, 7, &tag), ==, 7);
         g_assert(strncmp (buf2, "1zebr3a", 7) == 0);
 
         /* Uncompress */
         strcpy(buf, "1zebr3a");
-        g_assert_cmpuint(_vte_boa_uncompress (buf2, 100, buf, 7), ==, 7);
+        g_assert_cmpuint(_vte_boa_uncompress (boa, VTE_CODEC_TAG_LZ4, buf2, 100, buf, 7), ==, 7);
         g_assert(strncmp (buf2, "zebraaa", 7) == 0);
 
         /* Trying to uncompress the original does *not* give back the same contents.
          * This will be important below. */
         strcpy(buf, "zebraaa");
-        g_assert_cmpuint(_vte_boa_uncompress (buf2, 100, buf, 7), ==, 0);
+        g_assert_cmpuint(_vte_boa_uncompress (boa, VTE_CODEC_TAG_LZ4, buf2, 100, buf, 7), ==, 0);
+
+        /* The codec only changes the tag */
+        boa->codec.codec = VTE_STREAM_CODEC_ZSTD;
+        strcpy(buf, "www");
+        g_assert_cmpuint(_vte_boa_compress (boa, buf2, 100, buf, 3, &tag), ==, 2);
+        g_assert_cmpuint(tag, ==, VTE_CODEC_TAG_ZSTD);
+        strcpy(buf, "3w");
+        g_assert_cmpuint(_vte_boa_uncompress (boa, VTE_CODEC_TAG_ZSTD, buf2, 100, buf, 2), ==, 3);
+
+        /* Unknown codec */
+        g_assert_cmpuint(_vte_boa_uncompress (boa, 15, buf2, 100, buf, 2), ==, 0);
 
         g_object_unref (boa);
 }
@@ -1583,7 +2857,7 @@ test_stream (void)
         VteSnake *snake;
         char buf[8];
 
-        VteStream *astream = _vte_file_stream_new();
+        VteStream *astream = _vte_file_stream_new(NULL);
         VteFileStream *stream = (VteFileStream *) astream;
         _vte_file_stream_init (stream);
         boa = stream->boa;
@@ -1635,12 +2909,12 @@ test_stream (void)
 
         /* Test that the read cache is invalidated on truncate */
         _vte_stream_read (astream, 12, buf, 2);
-        g_assert_cmpuint (stream->rbuf_offset, ==, 7);
+        g_assert_cmpint (_vte_block_cache_find (stream->cache, stream, 7), ==, 0);
         _vte_stream_truncate (astream, 13);
-        g_assert_cmpuint (stream->rbuf_offset, ==, 1);
+        g_assert_cmpint (_vte_block_cache_find (stream->cache, stream, 7), ==, -1);
         stream_append (astream, "z" "cat");
         _vte_stream_read (astream, 12, buf, 2);
-        g_assert_cmpuint (stream->rbuf_offset, ==, 7);
+        g_assert_cmpint (_vte_block_cache_find (stream->cache, stream, 7), ==, 0);
         buf[2] = '\0';
         g_assert_cmpstr (buf, ==, "ez");
         assert_file (snake->fd, "\007\001AXOLOTL\001" "\006\0031B5E1Z\013.");
@@ -1799,14 +3073,487 @@ test_stream (void)
         g_object_unref (astream);
 }
 
+static void
+test_cache (void)
+{
+        char buf[8];
+
+        /* Room for three blocks, shared by two streams */
+        VteBlockCache *cache = _vte_block_cache_new (3 * VTE_BOA_BLOCKSIZE + 1);
+        VteStream *astream1 = _vte_file_stream_new (cache);
+        VteStream *astream2 = _vte_file_stream_new (cache);
+        VteFileStream *stream1 = (VteFileStream *) astream1;
+        VteFileStream *stream2 = (VteFileStream *) astream2;
+        g_assert_cmpuint (_vte_block_cache_get_size (cache), ==, 3 * VTE_BOA_BLOCKSIZE);
+
+        stream_append (astream1, "axolotl" "beeeees" "catfish");
+        stream_append (astream2, "dolphin" "echidna");
+        assert_stream (astream1, 0, 21, "axolotl" "beeeees" "catfish");
+        assert_stream (astream2, 0, 14, "dolphin" "echidna");
+        g_assert_cmpuint (_vte_block_cache_get_hits (cache), ==, 0);
+        g_assert_cmpuint (_vte_block_cache_get_misses (cache), ==, 5);
+
+        /* The least recently used blocks were evicted */
+        g_assert_cmpint (_vte_block_cache_find (cache, stream1, 0), ==, -1);
+        g_assert_cmpint (_vte_block_cache_find (cache, stream1, 7), ==, -1);
+        g_assert_cmpint (_vte_block_cache_find (cache, stream1, 14), >=, 0);
+        g_assert_cmpint (_vte_block_cache_find (cache, stream2, 0), >=, 0);
+        g_assert_cmpint (_vte_block_cache_find (cache, stream2, 7), >=, 0);
+
+        /* Alternating between the streams hits the cache */
+        g_assert (_vte_stream_read (astream2, 8, buf, 3));
+        g_assert (_vte_stream_read (astream1, 16, buf, 3));
+        g_assert (_vte_stream_read (astream2, 1, buf, 3));
+        g_assert (_vte_stream_read (astream1, 14, buf, 2));
+        g_assert_cmpuint (_vte_block_cache_get_hits (cache), ==, 4);
+        g_assert_cmpuint (_vte_block_cache_get_misses (cache), ==, 5);
+
+        /* The least recently read block is evicted first */
+        g_assert (_vte_stream_read (astream2, 0, buf, 7));
+        g_assert (_vte_stream_read (astream1, 7, buf, 7));
+        buf[7] = '\0';
+        g_assert_cmpstr (buf, ==, "beeeees");
+        g_assert_cmpuint (_vte_block_cache_get_misses (cache), ==, 6);
+        g_assert_cmpint (_vte_block_cache_find (cache, stream1, 14), >=, 0);
+        g_assert_cmpint (_vte_block_cache_find (cache, stream2, 0), >=, 0);
+        g_assert_cmpint (_vte_block_cache_find (cache, stream2, 7), ==, -1);
+
+        /* Advancing the tail and resetting drop the stream's blocks */
+        _vte_stream_advance_tail (astream1, 15);
+        g_assert_cmpint (_vte_block_cache_find (cache, stream1, 7), ==, -1);
+        g_assert_cmpint (_vte_block_cache_find (cache, stream1, 14), >=, 0);
+        _vte_stream_reset (astream1, 21);
+        g_assert_cmpint (_vte_block_cache_find (cache, stream1, 14), ==, -1);
+
+        /* Shrinking keeps the most recently used blocks */
+        g_assert (_vte_stream_read (astream2, 8, buf, 3));
+        _vte_block_cache_set_size (cache, 0);
+        g_assert_cmpuint (_vte_block_cache_get_size (cache), ==, VTE_BOA_BLOCKSIZE);
+        g_assert_cmpint (_vte_block_cache_find (cache, stream2, 7), ==, 0);
+        g_assert_cmpint (_vte_block_cache_find (cache, stream2, 0), ==, -1);
+        assert_stream (astream2, 0, 14, "dolphin" "echidna");
+        g_assert_cmpint (_vte_block_cache_find (cache, stream2, 7), ==, 0);
+
+        /* Finalizing a stream drops its blocks, the cache outlives the streams */
+        g_object_unref (astream2);
+        g_assert_cmpint (_vte_block_cache_find (cache, stream2, 7), ==, -1);
+        g_object_unref (astream1);
+        _vte_block_cache_unref (cache);
+}
+
+static void
+test_codec (void)
+{
+        VteStream *astream = _vte_file_stream_new (NULL);
+        VteFileStream *stream = (VteFileStream *) astream;
+        VteBoa *boa = stream->boa;
+        VteSnake *snake = (VteSnake *) &boa->parent;
+
+        stream_append (astream, "axolotl");
+        assert_file (snake->fd, "\007\001AXOLOTL\001");
+
+        /* Switching the codec only affects new blocks, tagged in the length's top bits */
+        boa->codec.codec = VTE_STREAM_CODEC_ZSTD;
+        stream_append (astream, "beeeees");
+        assert_file (snake->fd, "\007\001AXOLOTL\001" "\026\0011B5E1S\011.");
+        assert_boa (boa, 0, 14, "axolotl" "beeeees");
+        assert_stream (astream, 0, 14, "axolotl" "beeeees");
+
+        g_object_unref (astream);
+}
+
+static void
+test_map (void)
+{
+#if HAVE_MADVISE
+        char expected[400], buf[400];
+        int i;
+        VteStream *astream = _vte_file_stream_new (NULL);
+        VteFileStream *stream = (VteFileStream *) astream;
+        VteSnake *snake = (VteSnake *) &stream->boa->parent;
+
+        for (i = 0; i < 400; i++)
+                expected[i] = 'a' + i % 26;
+
+        /* Blocks are read from the mapping, which grows with the file */
+        _vte_stream_append (astream, expected, 70);
+        g_assert (_vte_stream_read (astream, 0, buf, 70));
+        g_assert (memcmp (buf, expected, 70) == 0);
+        g_assert_nonnull (snake->map);
+        g_assert_cmpuint (snake->map_size, ==, 16 * VTE_SNAKE_BLOCKSIZE);
+
+        _vte_stream_append (astream, expected + 70, 210);
+        g_assert (_vte_stream_read (astream, 0, buf, 280));
+        g_assert (memcmp (buf, expected, 280) == 0);
+        g_assert_cmpuint (snake->map_size, >=, 400);
+        g_assert_false (snake->map_failed);
+
+        /* Wrapping around to the beginning of the file */
+        _vte_stream_advance_tail (astream, 210);
+        _vte_stream_append (astream, expected + 280, 70);
+        g_assert_cmpint (snake->state, ==, 2);
+        g_assert (_vte_stream_read (astream, 210, buf, 140));
+        g_assert (memcmp (buf, expected + 210, 140) == 0);
+
+        g_object_unref (astream);
+
+        /* Blocks that couldn't be written, e.g. on a full disk, are not read
+         * from the mapping beyond the end of the file, that'd be SIGBUS */
+        astream = _vte_file_stream_new (NULL);
+        stream = (VteFileStream *) astream;
+        snake = (VteSnake *) &stream->boa->parent;
+
+        /* Past the first page of the file, so that the mapping beyond its end isn't backed by a page */
+        for (i = 0; i < 50; i++)
+                _vte_stream_append (astream, expected, 70);
+        g_assert (_vte_stream_read (astream, 0, buf, 70));
+        g_assert_nonnull (snake->map);
+
+        {
+                int fd = snake->fd;
+                char *path = g_strdup_printf ("/proc/self/fd/%d", fd);
+
+                /* Neither growing nor writing the file works with this one */
+                snake->fd = open (path, O_RDONLY);
+                g_free (path);
+                g_assert_cmpint (snake->fd, !=, -1);
+
+                for (i = 0; i < 50; i++)
+                        _vte_stream_append (astream, expected, 70);
+                g_assert_cmpuint (OFFSET_BOA_TO_SNAKE (ALIGN_BOA (6300)), >=, 2 * 4096);
+                g_assert (!_vte_stream_read (astream, 6300, buf, 70));
+                g_assert (_vte_stream_read (astream, 0, buf, 70));
+                g_assert (memcmp (buf, expected, 70) == 0);
+
+                close (snake->fd);
+                snake->fd = fd;
+        }
+
+        g_object_unref (astream);
+#endif
+}
+
+static void
+test_memory (void)
+{
+        gsize memory, disk;
+        VteStream *astream = _vte_memory_stream_new (NULL);
+        VteFileStream *stream = (VteFileStream *) astream;
+        VteSnake *snake = (VteSnake *) &stream->boa->parent;
+
+        /* Each block takes as much memory as was written to the snake */
+        stream_append (astream, "axolotl" "beeeees" "cat");
+        assert_stream (astream, 0, 17, "axolotl" "beeeees" "cat");
+        g_assert_cmpint (snake->fd, ==, -1);
+        g_assert_cmpuint (snake->blocks->len, ==, 2);
+        g_assert_cmpuint (snake->blocks_size, ==, 10 + 9);
+        _vte_file_stream_get_footprint (astream, &memory, &disk);
+        g_assert_cmpuint (memory, ==, 10 + 9 + 2 * sizeof (gpointer) + VTE_BOA_BLOCKSIZE);
+        g_assert_cmpuint (disk, ==, 0);
+
+        /* Overwriting a block */
+        _vte_stream_truncate (astream, 10);
+        stream_append (astream, "ffff");
+        assert_stream (astream, 0, 14, "axolotl" "beeffff");
+        g_assert_cmpuint (snake->blocks_size, ==, 10 + 9);
+
+        /* Dropping blocks from the tail */
+        _vte_stream_advance_tail (astream, 8);
+        assert_stream (astream, 8, 14, "eeffff");
+        g_assert_cmpuint (snake->blocks->len, ==, 1);
+        g_assert_cmpuint (snake->blocks_size, ==, 9);
+
+        _vte_stream_reset (astream, 21);
+        assert_stream (astream, 21, 21, "");
+        stream_append (astream, "dolphin");
+        assert_stream (astream, 21, 28, "dolphin");
+        g_assert_cmpuint (snake->blocks->len, ==, 1);
+        g_assert_cmpuint (snake->blocks_size, ==, 10);
+        g_assert_cmpint (snake->fd, ==, -1);
+
+        g_object_unref (astream);
+}
+
+static GInputStream *
+snapshot_input (GBytes *bytes, gsize len)
+{
+        GBytes *part = g_bytes_new_from_bytes (bytes, 0, len);
+        GInputStream *input = g_memory_input_stream_new_from_bytes (part);
+
+        g_bytes_unref (part);
+        return input;
+}
+
+static void
+test_snapshot (void)
+{
+        VteStream *astream = _vte_file_stream_new (NULL);
+        VteStream *acopy = _vte_file_stream_new (NULL);
+        VteBoa *boa = ((VteFileStream *) acopy)->boa;
+        GOutputStream *output = g_memory_output_stream_new_resizable ();
+        GInputStream *input;
+        GBytes *bytes, *corrupt;
+        GError *error = NULL;
+        char *data;
+        gsize len;
+        guint32 word;
+
+        /* The tail and the head in the middle of blocks */
+        stream_append (astream, "axolotl" "beeeees" "cat");
+        _vte_stream_advance_tail (astream, 10);
+        g_assert (_vte_file_stream_save (astream, output, NULL, &error));
+        g_assert_no_error (error);
+        g_assert (g_output_stream_close (output, NULL, NULL));
+        bytes = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (output));
+
+        /* The blocks from the tail's one on as they are compressed, without encryption, then the partial block */
+        data = (char *) g_bytes_unref_to_data (g_bytes_ref (bytes), &len);
+        g_assert_cmpuint (len, ==, sizeof (VteStreamSnapshotHeader) + 4 + 6 + 3);
+        memcpy (&word, data + sizeof (VteStreamSnapshotHeader), 4);
+        g_assert_cmpuint (word, ==, 6 | (VTE_CODEC_TAG_LZ4 << VTE_SNAPSHOT_TAG_SHIFT));
+        g_assert (memcmp (data + sizeof (VteStreamSnapshotHeader) + 4, "1b5e1s" "cat", 9) == 0);
+
+        /* Restored with the same offsets, and carries on like the original */
+        input = snapshot_input (bytes, len);
+        g_assert (_vte_file_stream_load (acopy, input, NULL, &error));
+        g_assert_no_error (error);
+        g_object_unref (input);
+        assert_stream (acopy, 10, 17, "eees" "cat");
+        stream_append (acopy, "dingo");
+        assert_stream (acopy, 10, 22, "eees" "cat" "dingo");
+        assert_boa (boa, 7, 21, "beeeees" "catding");
+        g_object_unref (acopy);
+
+        /* A truncated snapshot */
+        acopy = _vte_file_stream_new (NULL);
+        input = snapshot_input (bytes, len - 1);
+        g_assert_false (_vte_file_stream_load (acopy, input, NULL, &error));
+        g_assert_error (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT);
+        g_clear_error (&error);
+        g_object_unref (input);
+        g_object_unref (acopy);
+
+        /* A block compressed with a codec we don't know about */
+        word |= 7u << VTE_SNAPSHOT_TAG_SHIFT;
+        memcpy (data + sizeof (VteStreamSnapshotHeader), &word, 4);
+        corrupt = g_bytes_new_take (data, len);
+        acopy = _vte_file_stream_new (NULL);
+        input = snapshot_input (corrupt, len);
+        g_assert_false (_vte_file_stream_load (acopy, input, NULL, &error));
+        g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+        g_clear_error (&error);
+        g_object_unref (input);
+        g_object_unref (acopy);
+
+        g_bytes_unref (corrupt);
+        g_bytes_unref (bytes);
+        g_object_unref (output);
+        g_object_unref (astream);
+}
+
+static void
+test_background (void)
+{
+        char expected[200], buf[200];
+        int i;
+
+        _vte_file_stream_background = TRUE;
+
+        VteStream *astream = _vte_file_stream_new (NULL);
+        VteFileStream *stream = (VteFileStream *) astream;
+
+        /* More blocks than can be pending at once, read back right away */
+        for (i = 0; i < 150; i++)
+                expected[i] = 'a' + i % 26;
+        for (i = 0; i < 150; i += 5) {
+                _vte_stream_append (astream, expected + i, 5);
+                g_assert (_vte_stream_read (astream, 0, buf, i + 5));
+                g_assert (memcmp (buf, expected, i + 5) == 0);
+        }
+        g_assert_cmpuint (stream->pending_len, <=, VTE_FILE_STREAM_PENDING_MAX);
+
+        /* Truncating back into the written blocks */
+        _vte_stream_truncate (astream, 100);
+        g_assert_cmpuint (stream->pending_len, ==, 0);
+        memcpy (expected + 100, "zebra", 5);
+        stream_append (astream, "zebra");
+        g_assert (_vte_stream_read (astream, 0, buf, 105));
+        g_assert (memcmp (buf, expected, 105) == 0);
+
+        /* Advancing the tail past blocks that might still be pending */
+        memcpy (expected + 105, "abcdefghijklmnopqrstu", 21);
+        stream_append (astream, "abcdefghijklmnopqrstu");
+        _vte_stream_advance_tail (astream, 120);
+        g_assert_cmpuint (stream->boa->tail, ==, ALIGN_BOA(120));
+        g_assert (_vte_stream_read (astream, 120, buf, 6));
+        g_assert (memcmp (buf, expected + 120, 6) == 0);
+
+        _vte_stream_reset (astream, 130);
+        g_assert_cmpuint (stream->pending_len, ==, 0);
+        assert_stream (astream, 130, 130, "");
+
+        g_object_unref (astream);
+
+        _vte_file_stream_background = FALSE;
+}
+
+/*
+ * Benchmark the real codecs (the tests above use fake ones) on data resembling
+ * what ends up in the text, attr and row streams. Run as: test-stream --benchmark
+ */
+
+#define BENCHMARK_BLOCKSIZE 65512
+#define BENCHMARK_BLOCKS 64
+
+static guint32
+benchmark_random (guint32 *seed)
+{
+        *seed = *seed * 1103515245 + 12345;
+        return *seed >> 16;
+}
+
+static void
+benchmark_fill (const char *kind, char *data, gsize len)
+{
+        static const char *levels[] = { "INFO", "DEBUG", "WARN", "ERROR" };
+        guint32 seed = 1;
+        guint64 text_offset = 0, attr_offset = 0;
+        gsize pos = 0;
+
+        while (pos < len) {
+                char record[128];
+                gsize l;
+
+                if (strcmp (kind, "text") == 0) {
+                        /* Log lines, with timestamps and repeating prefixes */
+                        guint ms = benchmark_random (&seed) % 1000;
+                        guint level = benchmark_random (&seed) % 4;
+                        guint worker = benchmark_random (&seed) % 8;
+                        guint duration = benchmark_random (&seed) % 500;
+                        l = g_snprintf (record, sizeof (record),
+                                        "2026-10-16 12:%02u:%02u.%03u [%s] worker-%u: processed request %u in %u ms\n",
+                                        (guint) (pos / 100000 % 60), (guint) (pos / 1000 % 60), ms,
+                                        levels[level], worker, (guint) (pos / 80), duration);
+                } else if (strcmp (kind, "attr") == 0) {
+                        /* Attribute changes: the text offset where they end, the attributes, the hyperlink length twice */
+                        struct { guint64 text_end_offset; guint64 attr; guint16 hyperlink_length, hyperlink_length_again; } change = { 0, 0, 0, 0 };
+                        text_offset += 5 + benchmark_random (&seed) % 40;
+                        change.text_end_offset = text_offset;
+                        change.attr = benchmark_random (&seed) % 4 == 0 ? 0x100000001ULL << (benchmark_random (&seed) % 8) : 0;
+                        l = sizeof (change);
+                        memcpy (record, &change, l);
+                } else {
+                        /* Row records: where each row starts in the text and attr streams, whether it's soft wrapped */
+                        struct { guint64 text_start_offset; guint64 attr_start_offset; guint32 soft_wrapped; } row = { 0, 0, 0 };
+                        text_offset += 20 + benchmark_random (&seed) % 60;
+                        attr_offset += benchmark_random (&seed) % 3 * 20;
+                        row.text_start_offset = text_offset;
+                        row.attr_start_offset = attr_offset;
+                        row.soft_wrapped = benchmark_random (&seed) % 10 == 0;
+                        l = sizeof (row);
+                        memcpy (record, &row, l);
+                }
+
+                l = MIN(l, len - pos);
+                memcpy (data + pos, record, l);
+                pos += l;
+        }
+}
+
+static void
+benchmark_codecs (void)
+{
+        static const char *kinds[] = { "text", "attr", "row" };
+        static const struct { VteStreamCodec codec; const char *name; } codecs[] = {
+                { VTE_STREAM_CODEC_LZ4, "lz4" },
+                { VTE_STREAM_CODEC_ZSTD, "zstd" },
+        };
+        gsize len = BENCHMARK_BLOCKS * BENCHMARK_BLOCKSIZE;
+        unsigned int bound = _vte_codec_compress_bound (BENCHMARK_BLOCKSIZE);
+        char *data = (char *) g_malloc (len);
+        char *compressed = (char *) g_malloc ((gsize) BENCHMARK_BLOCKS * bound);
+        char *uncompressed = (char *) g_malloc (BENCHMARK_BLOCKSIZE);
+        unsigned int compressed_len[BENCHMARK_BLOCKS], tags[BENCHMARK_BLOCKS];
+        guint i, j, k;
+
+        for (i = 0; i < G_N_ELEMENTS (kinds); i++) {
+                benchmark_fill (kinds[i], data, len);
+
+                for (j = 0; j < G_N_ELEMENTS (codecs); j++) {
+                        VteCodec codec;
+                        gint64 start, training_time = 0, compress_time, uncompress_time;
+                        gsize total = 0;
+
+                        if (!_vte_stream_codec_is_supported (codecs[j].codec))
+                                continue;
+
+                        _vte_codec_init (&codec);
+                        codec.codec = codecs[j].codec;
+
+#if WITH_ZSTD
+                        /* Train the dictionary up front, as a stream does once, so that it's
+                         * timed on its own rather than counted as compression time */
+                        if (codec.codec == VTE_STREAM_CODEC_ZSTD) {
+                                start = g_get_monotonic_time ();
+                                for (k = 0; codec.zstd_samples != NULL && k < BENCHMARK_BLOCKS; k++)
+                                        _vte_codec_compress (&codec, compressed, bound,
+                                                             data + k * BENCHMARK_BLOCKSIZE, BENCHMARK_BLOCKSIZE, &tags[0]);
+                                training_time = g_get_monotonic_time () - start;
+                        }
+#endif
+
+                        start = g_get_monotonic_time ();
+                        for (k = 0; k < BENCHMARK_BLOCKS; k++) {
+                                compressed_len[k] = _vte_codec_compress (&codec, compressed + k * bound, bound,
+                                                                         data + k * BENCHMARK_BLOCKSIZE, BENCHMARK_BLOCKSIZE, &tags[k]);
+                                total += compressed_len[k];
+                        }
+                        compress_time = MAX(g_get_monotonic_time () - start, 1);
+
+                        start = g_get_monotonic_time ();
+                        for (k = 0; k < BENCHMARK_BLOCKS; k++) {
+                                g_assert_cmpuint (_vte_codec_uncompress (&codec, tags[k], uncompressed, BENCHMARK_BLOCKSIZE,
+                                                                         compressed + k * bound, compressed_len[k]), ==, BENCHMARK_BLOCKSIZE);
+                                g_assert (memcmp (uncompressed, data + k * BENCHMARK_BLOCKSIZE, BENCHMARK_BLOCKSIZE) == 0);
+                        }
+                        uncompress_time = MAX(g_get_monotonic_time () - start, 1);
+
+                        printf ("%-4s  %-4s  ratio %6.2f  compress %8.1f MB/s  uncompress %8.1f MB/s  training %6.1f ms\n",
+                                kinds[i], codecs[j].name, (double) len / total,
+                                (double) len / compress_time, (double) len / uncompress_time,
+                                training_time / 1000.);
+
+                        _vte_codec_fini (&codec);
+                }
+        }
+
+        g_free (uncompressed);
+        g_free (compressed);
+        g_free (data);
+}
+
 int
 main (int argc, char **argv)
 {
+        if (argc > 1 && strcmp (argv[1], "--benchmark") == 0) {
+                benchmark_codecs ();
+                return 0;
+        }
+
         test_fakes();
 
         test_snake();
         test_boa();
+
+        /* These check the file's contents right after appending */
+        _vte_file_stream_background = FALSE;
         test_stream();
+        test_cache();
+        test_codec();
+        test_map();
+        test_memory();
+        test_snapshot();
+        test_background();
 
         printf("vtestream-file tests passed :)\n");
         return 0;
@@ -35,10 +35,39 @@ void _vte_stream_advance_tail (VteStream *stream, gsize offset);
 gsize _vte_stream_tail (VteStream *stream);
 gsize _vte_stream_head (VteStream *stream);
 
+/* A cache of uncompressed blocks, shared by file streams */
+
+typedef struct _VteBlockCache VteBlockCache;
+
+VteBlockCache *_vte_block_cache_new (gsize size);
+VteBlockCache *_vte_block_cache_ref (VteBlockCache *cache);
+void _vte_block_cache_unref (VteBlockCache *cache);
+void _vte_block_cache_set_size (VteBlockCache *cache, gsize size);
+gsize _vte_block_cache_get_size (VteBlockCache *cache);
+guint64 _vte_block_cache_get_hits (VteBlockCache *cache);
+guint64 _vte_block_cache_get_misses (VteBlockCache *cache);
+
+/* Compression of the file streams' blocks */
+
+typedef enum {
+        VTE_STREAM_CODEC_LZ4,
+        VTE_STREAM_CODEC_ZSTD,
+} VteStreamCodec;
+
+gboolean _vte_stream_codec_is_supported (VteStreamCodec codec);
+
 /* Various streams */
 
 VteStream *
-_vte_file_stream_new (void);
+_vte_file_stream_new (VteBlockCache *cache);
+VteStream *
+_vte_memory_stream_new (VteBlockCache *cache);
+void _vte_file_stream_set_codec (VteStream *stream, VteStreamCodec codec);
+void _vte_file_stream_get_footprint (VteStream *stream, gsize *memory, gsize *disk);
+gboolean _vte_file_stream_save (VteStream *stream, GOutputStream *output,
+                                GCancellable *cancellable, GError **error);
+gboolean _vte_file_stream_load (VteStream *stream, GInputStream *input,
+                                GCancellable *cancellable, GError **error);
 
 G_END_DECLS
 
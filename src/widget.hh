@@ -541,6 +541,11 @@ public:
         bool set_enable_legacy_osc777(bool enable) { return terminal()->set_enable_legacy_osc777(enable); }
         auto enable_legacy_osc777() const noexcept { return terminal()->enable_legacy_osc777(); }
 
+        bool set_enable_threaded_pty_read(bool enable) { return terminal()->set_enable_threaded_pty_read(enable); }
+        auto enable_threaded_pty_read() const noexcept { return terminal()->enable_threaded_pty_read(); }
+        bool set_scheduling_priority(VteSchedulingPriority priority) { return terminal()->set_scheduling_priority(priority); }
+        auto scheduling_priority() const noexcept { return terminal()->scheduling_priority(); }
+
         char const* encoding() const noexcept { return m_terminal->encoding(); }
 
         void emit_child_exited(int status) noexcept;